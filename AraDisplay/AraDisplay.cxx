@@ -152,6 +152,7 @@
 #include "AraIcrrCanvasMaker.h"
 #include "AraControlPanel.h"
 #include "AraGeomTool.h"
+#include "AraEventIndexFile.h"
 
 //Event Reader Includes
 #include "UsefulIcrrStationEvent.h"
@@ -189,6 +190,7 @@ void AraDisplay::zeroPointers()
   fEventTreeIndexEntry=-1;
   fEventEntry=0;
   fEventFile=0;
+  fEventIndexFile=0;
   fIcrrUsefulEventPtr=0;
   fIcrrRawEventPtr=0;
   fAtriUsefulEventPtr=0;
@@ -387,8 +389,23 @@ int AraDisplay::loadEventTree(char *eventFile)
   fEventTree->SetBranchAddress("run",&fCurrentRun);  
   fEventEntry=0;
 
-  fEventTree->BuildIndex("event.head.eventNumber");
-  fEventIndex = (TTreeIndex*) fEventTree->GetTreeIndex();
+  //The event index written by the rootifier saves reading every event to build the TTreeIndex
+  if(fEventIndexFile) {
+    delete fEventIndexFile;
+    fEventIndexFile=0;
+  }
+  if(eventFile) {
+    fEventIndexFile = new AraEventIndexFile();
+    if(!fEventIndexFile->open(AraEventIndexFile::getIndexFileName(eventFile).c_str()) ||
+       fEventIndexFile->getNumEntries()!=fEventTree->GetEntries()) {
+      delete fEventIndexFile;
+      fEventIndexFile=0;
+    }
+  }
+  if(!fEventIndexFile) {
+    fEventTree->BuildIndex("event.head.eventNumber");
+    fEventIndex = (TTreeIndex*) fEventTree->GetTreeIndex();
+  }
 
   return 0;
 }
@@ -632,7 +649,10 @@ int AraDisplay::displayThisEvent(UInt_t eventNumber)
     fEventEntry=0;
   }
   else {
-    fEventEntry=fEventTree->GetEntryNumberWithIndex(eventNumber);
+    if(fEventIndexFile)
+      fEventEntry=fEventIndexFile->findEventNumber(eventNumber);
+    else
+      fEventEntry=fEventTree->GetEntryNumberWithIndex(eventNumber);
     if(fEventEntry<0) 
       return -1;      
   }
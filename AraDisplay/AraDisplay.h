@@ -36,6 +36,7 @@ class RawAraStationEvent;
 
 class TButton;
 class TTreeIndex;
+class AraEventIndexFile;
 class TFile;
 class TEventList;
 
@@ -122,6 +123,7 @@ class AraDisplay
   Long64_t fEventEntry; ///< The current event+header entry.
 
   TTreeIndex *fEventIndex; ///< Reused
+  AraEventIndexFile *fEventIndexFile; //!< The index written by the rootifier next to a single event file, used instead of fEventIndex
   UInt_t fCurrentFileTime; ///< The current file time
   Char_t fCurrentBaseDir[180]; ///< The base directory for the ROOT files.
   
@@ -0,0 +1,162 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraAtriCalibBundle.cxx      ATRI calibration bundle files         /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Writes and reads the binary files holding all the ATRI timing  /////
+/////     and voltage calibration tables of one station and epoch        /////
+//////////////////////////////////////////////////////////////////////////////
+
+//C++ includes
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <zlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//class definition includes
+#include "AraAtriCalibBundle.h"
+
+//AraRoot Includes
+#include "AraEventCalibrator.h"
+
+//! The fixed size members of AraAtriCalibTables, in the order they are stored in a bundle
+struct AraAtriCalibBundleBlock {
+    void *data;
+    size_t size;
+};
+
+static int getFixedBlocks(AraAtriCalibTables *tables, AraAtriCalibBundleBlock blocks[])
+{
+    int numBlocks=0;
+#define ARA_BUNDLE_BLOCK(member) blocks[numBlocks].data=&(tables->member); blocks[numBlocks].size=sizeof(tables->member); numBlocks++;
+    ARA_BUNDLE_BLOCK(fAtriSampleIndex);
+    ARA_BUNDLE_BLOCK(fAtriSampleTimes);
+    ARA_BUNDLE_BLOCK(fAtriEpsilonTimes);
+    ARA_BUNDLE_BLOCK(fAtriNumSamples);
+    ARA_BUNDLE_BLOCK(fAtriVoltsConvChan);
+    ARA_BUNDLE_BLOCK(fAtriHighAdcLimit);
+    ARA_BUNDLE_BLOCK(fAtriAdcOffset);
+    ARA_BUNDLE_BLOCK(fAtriConvStation5);
+    ARA_BUNDLE_BLOCK(fNumVoltsConvFallbacks);
+#undef ARA_BUNDLE_BLOCK
+    return numBlocks;
+}
+
+#define ARA_BUNDLE_MAX_BLOCKS 16
+
+/*!
+    The file is written to fileName.tmp and then renamed, so a bundle being mapped by another process is never rewritten in place.
+    \param fileName the bundle file
+    \param tables the tables to write
+    \return kTRUE on success
+*/
+Bool_t AraAtriCalibBundle::write(const char *fileName, const AraAtriCalibTables *tables)
+{
+    AraAtriCalibBundleBlock blocks[ARA_BUNDLE_MAX_BLOCKS];
+    int numBlocks=getFixedBlocks(const_cast<AraAtriCalibTables*>(tables), blocks);
+
+    AraAtriCalibBundleHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ARA_ATRI_CALIB_BUNDLE_MAGIC, sizeof(ARA_ATRI_CALIB_BUNDLE_MAGIC));
+    header.version = ARA_ATRI_CALIB_BUNDLE_VERSION;
+    header.headerSize = sizeof(header);
+    header.stationId = tables->fStationId;
+    header.epoch = tables->fEpoch;
+    header.numVoltsConv = tables->fAtriVoltsConv.size();
+    header.voltsConvSize = sizeof(AraAtriVoltsConv);
+    uLong checksum = crc32(0L, Z_NULL, 0);
+    for(int i=0;i<numBlocks;i++) {
+        header.fixedSize += blocks[i].size;
+        checksum = crc32(checksum, (const Bytef*)blocks[i].data, blocks[i].size);
+    }
+    if(header.numVoltsConv)
+        checksum = crc32(checksum, (const Bytef*)&(tables->fAtriVoltsConv[0]), header.numVoltsConv*sizeof(AraAtriVoltsConv));
+    header.checksum = checksum;
+
+    std::string tmpName = std::string(fileName) + ".tmp";
+    FILE *fp = fopen(tmpName.c_str(), "wb");
+    if(!fp){
+        fprintf(stderr, "AraAtriCalibBundle::write -- ERROR Can't open %s: %s\n", tmpName.c_str(), strerror(errno));
+        return kFALSE;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fp)==1;
+    for(int i=0;i<numBlocks;i++)
+        ok = ok && fwrite(blocks[i].data, blocks[i].size, 1, fp)==1;
+    if(header.numVoltsConv)
+        ok = ok && fwrite(&(tables->fAtriVoltsConv[0]), sizeof(AraAtriVoltsConv), header.numVoltsConv, fp)==header.numVoltsConv;
+    ok = (fclose(fp)==0) && ok;
+    if(!ok || rename(tmpName.c_str(), fileName)!=0){
+        fprintf(stderr, "AraAtriCalibBundle::write -- ERROR Can't write %s: %s\n", fileName, strerror(errno));
+        remove(tmpName.c_str());
+        return kFALSE;
+    }
+    return kTRUE;
+}
+
+/*!
+    The station, epoch, table sizes and checksum are all checked before any table is used.
+    \param fileName the bundle file
+    \param stationId the station the tables are expected for
+    \param epoch the calibration epoch the tables are expected for
+    \return the tables, NULL if the bundle can't be used
+*/
+AraAtriCalibTables *AraAtriCalibBundle::read(const char *fileName, AraStationId_t stationId, Int_t epoch)
+{
+    int fd = open(fileName, O_RDONLY);
+    if(fd<0){
+        fprintf(stderr, "AraAtriCalibBundle::read -- ERROR Can't open %s: %s\n", fileName, strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if(fstat(fd, &st)!=0 || size_t(st.st_size) < sizeof(AraAtriCalibBundleHeader)){
+        fprintf(stderr, "AraAtriCalibBundle::read -- ERROR %s is too short\n", fileName);
+        close(fd);
+        return NULL;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base==MAP_FAILED){
+        fprintf(stderr, "AraAtriCalibBundle::read -- ERROR Can't map %s: %s\n", fileName, strerror(errno));
+        return NULL;
+    }
+
+    AraAtriCalibTables *tables = new AraAtriCalibTables(stationId, epoch);
+    AraAtriCalibBundleBlock blocks[ARA_BUNDLE_MAX_BLOCKS];
+    int numBlocks=getFixedBlocks(tables, blocks);
+    size_t fixedSize=0;
+    for(int i=0;i<numBlocks;i++) fixedSize += blocks[i].size;
+
+    const AraAtriCalibBundleHeader *header = (const AraAtriCalibBundleHeader*)base;
+    const char *body = (const char*)base + header->headerSize;
+    size_t bodySize = fixedSize + size_t(header->numVoltsConv)*sizeof(AraAtriVoltsConv);
+    const char *problem = NULL;
+    if(memcmp(header->magic, ARA_ATRI_CALIB_BUNDLE_MAGIC, sizeof(ARA_ATRI_CALIB_BUNDLE_MAGIC))!=0) problem = "is not a calibration bundle";
+    else if(header->version!=ARA_ATRI_CALIB_BUNDLE_VERSION) problem = "has an unknown version";
+    else if(header->stationId!=stationId) problem = "is for another station";
+    else if(header->epoch!=epoch) problem = "is for another calibration epoch";
+    else if(header->fixedSize!=fixedSize || header->voltsConvSize!=sizeof(AraAtriVoltsConv)) problem = "was made with different table sizes";
+    else if(header->headerSize < sizeof(AraAtriCalibBundleHeader) || size_t(st.st_size) < header->headerSize + bodySize) problem = "is truncated";
+    else if(crc32(crc32(0L, Z_NULL, 0), (const Bytef*)body, bodySize)!=header->checksum) problem = "fails the checksum";
+
+    if(!problem){
+        for(int i=0;i<numBlocks;i++) {
+            memcpy(blocks[i].data, body, blocks[i].size);
+            body += blocks[i].size;
+        }
+        tables->fAtriVoltsConv.resize(header->numVoltsConv);
+        if(header->numVoltsConv)
+            memcpy(&(tables->fAtriVoltsConv[0]), body, header->numVoltsConv*sizeof(AraAtriVoltsConv));
+    }
+    munmap(base, st.st_size);
+
+    if(problem){
+        fprintf(stderr, "AraAtriCalibBundle::read -- ERROR %s %s\n", fileName, problem);
+        delete tables;
+        return NULL;
+    }
+    return tables;
+}
@@ -0,0 +1,56 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraAtriCalibBundle.h        ATRI calibration bundle files         /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Writes and reads the binary files holding all the ATRI timing  /////
+/////     and voltage calibration tables of one station and epoch        /////
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARAATRICALIBBUNDLE_H
+#define ARAATRICALIBBUNDLE_H
+
+//Includes
+#include "Rtypes.h"
+#include "araSoft.h"
+#include "araAtriStructures.h"
+
+class AraAtriCalibTables;
+
+#define ARA_ATRI_CALIB_BUNDLE_MAGIC "ARACALB"
+#define ARA_ATRI_CALIB_BUNDLE_VERSION 2
+
+//! Part of AraEvent library. The header at the start of an ATRI calibration bundle.
+/*!
+    The header is followed by the fixed size AraAtriCalibTables arrays and constants, fixedSize bytes,
+    and then by the numVoltsConv AraAtriVoltsConv of AraAtriCalibTables::fAtriVoltsConv.
+    Everything is stored in the byte order of the machine that wrote it.
+*/
+struct AraAtriCalibBundleHeader
+{
+    char magic[8]; ///< ARA_ATRI_CALIB_BUNDLE_MAGIC
+    UInt_t version; ///< ARA_ATRI_CALIB_BUNDLE_VERSION
+    UInt_t headerSize; ///< sizeof(AraAtriCalibBundleHeader), the tables start at this offset
+    UInt_t stationId; ///< The station the tables belong to
+    Int_t epoch; ///< The calibration epoch, see AraEventCalibrator::getAtriCalibEpoch()
+    UInt_t fixedSize; ///< Bytes of fixed size tables, changes with the table dimensions
+    UInt_t numVoltsConv; ///< Number of voltage conversions
+    UInt_t voltsConvSize; ///< sizeof(AraAtriVoltsConv)
+    UInt_t checksum; ///< zlib crc32 of everything after the header
+    UInt_t reserved[6]; ///< Padding, zero
+};
+
+//! Part of AraEvent library. Writes and reads ATRI calibration bundles.
+/*!
+    A bundle is AraAtriCalibTables as built by AraEventCalibrator::loadAtriCalibFromText(), after the sample timing checks
+    and the voltage conversion fallbacks have been applied, so loading one is a copy out of the mapped file.
+    Bundles are made by makeAtriCalibBundle and are not updated when the text files change, they have to be remade.
+    \ingroup rootclasses
+*/
+class AraAtriCalibBundle
+{
+    public:
+        static Bool_t write(const char *fileName, const AraAtriCalibTables *tables); ///< Writes the tables to a bundle
+        static AraAtriCalibTables *read(const char *fileName, AraStationId_t stationId, Int_t epoch); ///< Maps a bundle and checks it, returns new tables or NULL
+};
+
+#endif //ARAATRICALIBBUNDLE_H
@@ -0,0 +1,207 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraAtriEventView.cxx        Views of ATRI event samples           /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Lightweight non owning views of the header and blocks of an    /////
+/////     ATRI event, used to calibrate samples held elsewhere           /////
+//////////////////////////////////////////////////////////////////////////////
+
+//C++ includes
+#include <cstring>
+
+//class definition includes
+#include "AraAtriEventView.h"
+
+//AraRoot Includes
+#include "RawAtriStationEvent.h"
+#include "AraRootVersion.h"
+
+/*!
+    \param event the event to copy the header fields of
+*/
+void AraAtriEventFields::getFrom(const RawAtriStationEvent *event)
+{
+    memset(this, 0, sizeof(AraAtriEventFields));
+    unixTime=event->unixTime;
+    unixTimeUs=event->unixTimeUs;
+    eventNumber=event->eventNumber;
+    ppsNumber=event->ppsNumber;
+    numStationBytes=event->numStationBytes;
+    timeStamp=event->timeStamp;
+    eventId=event->eventId;
+    numBytes=event->numBytes;
+    versionId=event->versionId;
+    numReadoutBlocks=event->numReadoutBlocks;
+    reserved=event->reserved;
+    checksum=event->checksum;
+    for(int trig=0;trig<MAX_TRIG_BLOCKS;trig++) {
+        triggerInfo[trig]=event->triggerInfo[trig];
+        triggerBlock[trig]=event->triggerBlock[trig];
+    }
+    filterInfo=event->filterInfo;
+    softVerMajor=event->softVerMajor;
+    softVerMinor=event->softVerMinor;
+    typeId=event->typeId;
+    verId=event->verId;
+    subVerId=event->subVerId;
+    stationId=event->stationId;
+}
+
+/*!
+    The timestamp is Gray decoded and the AraRoot version filled in, just as RawAtriStationEvent does.
+    \param hdPtr the event header as written by the DAQ
+*/
+void AraAtriEventFields::getFrom(const AraStationEventHeader_t *hdPtr)
+{
+    memset(this, 0, sizeof(AraAtriEventFields));
+    unixTime=hdPtr->unixTime;
+    unixTimeUs=hdPtr->unixTimeUs;
+    eventNumber=hdPtr->eventNumber;
+    ppsNumber=hdPtr->ppsNumber;
+    numStationBytes=hdPtr->numBytes;
+    timeStamp=hdPtr->timeStamp;
+    timeStamp ^= (timeStamp >> 1);
+    timeStamp ^= (timeStamp >> 2);
+    timeStamp ^= (timeStamp >> 4);
+    timeStamp ^= (timeStamp >> 8);
+    timeStamp ^= (timeStamp >> 16);
+    eventId=hdPtr->eventId;
+    versionId=hdPtr->versionNumber;
+    numReadoutBlocks=hdPtr->numReadoutBlocks;
+    for(int trig=0;trig<MAX_TRIG_BLOCKS;trig++) {
+        triggerInfo[trig]=hdPtr->triggerInfo[trig];
+        triggerBlock[trig]=hdPtr->triggerBlock[trig];
+    }
+    numBytes=hdPtr->gHdr.numBytes;
+    reserved=hdPtr->gHdr.reserved;
+    checksum=hdPtr->gHdr.checksum;
+    softVerMajor=ARA_ROOT_MAJOR;
+    softVerMinor=ARA_ROOT_MINOR;
+    typeId=hdPtr->gHdr.typeId;
+    verId=hdPtr->gHdr.verId;
+    subVerId=hdPtr->gHdr.subVerId;
+    stationId=hdPtr->gHdr.stationId;
+}
+
+/*!
+    \param event the event whose header fields are set, its blocks are not touched
+*/
+void AraAtriEventFields::setTo(RawAtriStationEvent *event) const
+{
+    event->unixTime=unixTime;
+    event->unixTimeUs=unixTimeUs;
+    event->eventNumber=eventNumber;
+    event->ppsNumber=ppsNumber;
+    event->numStationBytes=numStationBytes;
+    event->timeStamp=timeStamp;
+    event->eventId=eventId;
+    event->numBytes=numBytes;
+    event->versionId=versionId;
+    event->numReadoutBlocks=numReadoutBlocks;
+    event->reserved=reserved;
+    event->checksum=checksum;
+    for(int trig=0;trig<MAX_TRIG_BLOCKS;trig++) {
+        event->triggerInfo[trig]=triggerInfo[trig];
+        event->triggerBlock[trig]=triggerBlock[trig];
+    }
+    event->filterInfo=filterInfo;
+    event->softVerMajor=softVerMajor;
+    event->softVerMinor=softVerMinor;
+    event->typeId=typeId;
+    event->verId=verId;
+    event->subVerId=subVerId;
+    event->stationId=stationId;
+}
+
+/*!
+    \param theIrsBlockNumber the IRS block number
+    \param theChannelMask the channel mask
+    \param theSamples the samples of the channels in the mask, one row of SAMPLES_PER_BLOCK after the other
+*/
+void AraAtriBlockView::set(UShort_t theIrsBlockNumber, UShort_t theChannelMask, const UShort_t *theSamples)
+{
+    irsBlockNumber=theIrsBlockNumber;
+    channelMask=theChannelMask;
+    numChannels=0;
+    for(int bit=0;bit<8;bit++) {
+        if(channelMask&(1<<bit))
+            numChannels++;
+    }
+    samples=theSamples;
+}
+
+/*!
+    \param block the block, the view points at its sample buffer
+*/
+void AraAtriBlockView::set(const RawAtriStationBlock &block)
+{
+    irsBlockNumber=block.irsBlockNumber;
+    channelMask=block.channelMask;
+    numChannels=block.numChannels;
+    samples=block.samples[0];
+}
+
+/*!
+    \param event the event to view
+*/
+void AraAtriEventView::setEvent(const RawAtriStationEvent *event)
+{
+    header.getFrom(event);
+    blocks.resize(event->blockVec.size());
+    for(size_t blk=0;blk<event->blockVec.size();blk++)
+        blocks[blk].set(event->blockVec[blk]);
+}
+
+/*!
+    Nothing is copied but the header fields, the block views point into dataBuffer, which must stay put while the view is used.
+    Filters that only look at an event and maybe pass its bytes on need no RawAtriStationEvent at all this way.
+    \param hdPtr the event header as written by the DAQ
+    \param dataBuffer the numStationBytes of blocks that follow the header
+    \param numDataBytes the number of bytes in dataBuffer
+    \return the number of bytes of dataBuffer used by the blocks, -1 if the blocks run past numDataBytes
+*/
+Int_t AraAtriEventView::setFromBuffer(const AraStationEventHeader_t *hdPtr, const char *dataBuffer, Int_t numDataBytes)
+{
+    header.getFrom(hdPtr);
+    blocks.resize(header.numReadoutBlocks);
+    Int_t uptoByte=0;
+    for(int blk=0;blk<header.numReadoutBlocks;blk++) {
+        if(uptoByte+Int_t(sizeof(AraStationEventBlockHeader_t))>numDataBytes) {
+            blocks.resize(blk);
+            return -1;
+        }
+        const AraStationEventBlockHeader_t *blkPtr = (const AraStationEventBlockHeader_t*)&dataBuffer[uptoByte];
+        uptoByte+=sizeof(AraStationEventBlockHeader_t);
+        blocks[blk].set(blkPtr->irsBlockNumber, blkPtr->channelMask, (const UShort_t*)&dataBuffer[uptoByte]);
+        uptoByte+=sizeof(AraStationEventBlockChannel_t)*blocks[blk].numChannels;
+        if(uptoByte>numDataBytes) {
+            blocks.resize(blk);
+            return -1;
+        }
+    }
+    return uptoByte;
+}
+
+bool AraAtriEventView::isCalpulserEvent() const
+{
+    return RawAtriStationEvent::isCalpulserTimeStamp(header.stationId, header.timeStamp);
+}
+
+/*!
+    Used where a real event object is needed, for example to calibrate an event the fast paths of AraEventCalibrator don't handle.
+    \return a new event, owned by the caller
+*/
+RawAtriStationEvent *AraAtriEventView::makeRawEvent() const
+{
+    RawAtriStationEvent *event = new RawAtriStationEvent();
+    header.setTo(event);
+    event->blockVec.resize(blocks.size());
+    for(size_t blk=0;blk<blocks.size();blk++) {
+        RawAtriStationBlock &block=event->blockVec[blk];
+        block.irsBlockNumber=blocks[blk].irsBlockNumber;
+        block.channelMask=blocks[blk].channelMask;
+        block.numChannels=blocks[blk].numChannels;
+        memcpy(block.samples, blocks[blk].samples, blocks[blk].numChannels*SAMPLES_PER_BLOCK*sizeof(UShort_t));
+    }
+    return event;
+}
@@ -0,0 +1,98 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraAtriEventView.h          Views of ATRI event samples           /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Lightweight non owning views of the header and blocks of an    /////
+/////     ATRI event, used to calibrate samples held elsewhere           /////
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARAATRIEVENTVIEW_H
+#define ARAATRIEVENTVIEW_H
+
+//Includes
+#include <vector>
+#include "Rtypes.h"
+#include "araSoft.h"
+#include "araAtriStructures.h"
+
+class RawAtriStationEvent;
+class RawAtriStationBlock;
+
+//! Part of AraEvent library. The header fields of a RawAtriStationEvent, including the ones of RawAraGenericHeader, as a plain struct.
+/*!
+    The struct has no pointers and a fixed layout, so it can be stored in files as it is (see AraAtriWaveformFile).
+*/
+struct AraAtriEventFields
+{
+    ULong64_t unixTime; ///< Software event time in seconds
+    UInt_t unixTimeUs; ///< Software event time in microseconds
+    UInt_t eventNumber; ///< Software event number
+    UInt_t ppsNumber; ///< For matching up with thresholds etc.
+    UInt_t numStationBytes; ///< Bytes in station readout
+    UInt_t timeStamp; ///< Timestamp, already Gray decoded
+    UInt_t eventId; ///< Event Id
+    UInt_t triggerInfo[MAX_TRIG_BLOCKS]; ///< The trigger pattern
+    UInt_t numBytes; ///< RawAraGenericHeader::numBytes
+    UShort_t versionId; ///< Version Id for event header
+    UShort_t numReadoutBlocks; ///< Number of readout blocks
+    UShort_t reserved; ///< RawAraGenericHeader::reserved, the filter flag
+    UShort_t checksum; ///< RawAraGenericHeader::checksum
+    UChar_t triggerBlock[MAX_TRIG_BLOCKS]; ///< Which block the triggers occured in
+    UChar_t filterInfo; ///< The filter information
+    UChar_t softVerMajor; ///< RawAraGenericHeader::softVerMajor
+    UChar_t softVerMinor; ///< RawAraGenericHeader::softVerMinor
+    UChar_t typeId; ///< RawAraGenericHeader::typeId
+    UChar_t verId; ///< RawAraGenericHeader::verId
+    UChar_t subVerId; ///< RawAraGenericHeader::subVerId
+    UChar_t stationId; ///< RawAraGenericHeader::stationId
+    UChar_t padding; ///< Zero
+
+    void getFrom(const RawAtriStationEvent *event); ///< Copies the header fields of event
+    void getFrom(const AraStationEventHeader_t *hdPtr); ///< Decodes the header fields of a DAQ event header
+    void setTo(RawAtriStationEvent *event) const; ///< Copies the fields into the header of event
+};
+
+//! Part of AraEvent library. A non owning view of one readout block, with the same getters as RawAtriStationBlock.
+struct AraAtriBlockView
+{
+    UShort_t irsBlockNumber; ///< The IRS block number
+    UShort_t channelMask; ///< Channel mask, including the dda in bits 8-9
+    UChar_t numChannels; ///< Number of channels in channelMask
+    const UShort_t *samples; ///< numChannels rows of SAMPLES_PER_BLOCK samples, in mask bit order
+
+    void set(UShort_t theIrsBlockNumber, UShort_t theChannelMask, const UShort_t *theSamples); ///< Points the view at a block, counting its channels
+    void set(const RawAtriStationBlock &block); ///< Points the view at the samples of block
+
+    int getNumChannels() const {return (int) numChannels;}
+    const UShort_t *getSamples(int chanIndex) const {return samples+chanIndex*SAMPLES_PER_BLOCK;} ///< Returns the SAMPLES_PER_BLOCK samples of the chanIndex'th channel read out in this block
+    int getDda() const {return (channelMask&0x300)>>8;}
+    int getBlock() const {return irsBlockNumber&0x1ff;}
+    int getCapArray() const { return irsBlockNumber&0x1;} //Event Format version 2
+};
+
+//! Part of AraEvent library. A non owning view of an ATRI event, its header fields and views of its blocks.
+/*!
+    The samples stay wherever they are, in a RawAtriStationEvent, in a mapped AraAtriWaveformFile, in a DAQ read buffer...,
+    which has to outlive the view.
+    AraEventCalibrator::calibrateEvents() calibrates views directly, without a RawAtriStationEvent.
+    The block vector keeps its capacity, so a view that is reused for event after event stops allocating.
+    \ingroup rootclasses
+*/
+class AraAtriEventView
+{
+    public:
+        AraAtriEventFields header; ///< The header fields
+        std::vector<AraAtriBlockView> blocks; ///< The blocks in readout order
+        std::vector<UShort_t> decodedSamples; ///< Holds the samples the blocks point at when they had to be decoded, from packed files
+
+        AraStationId_t getStationId() const {return header.stationId;}
+        Double_t getUnixTime() const {return header.unixTime;}
+        Int_t getNumBlocks() const {return blocks.size();}
+
+        void setEvent(const RawAtriStationEvent *event); ///< Views event, which must not change while the view is used
+        Int_t setFromBuffer(const AraStationEventHeader_t *hdPtr, const char *dataBuffer, Int_t numDataBytes); ///< Views the blocks of a DAQ event in place
+        bool isCalpulserEvent() const; ///< RawAtriStationEvent::isCalpulserEvent() of the event
+        RawAtriStationEvent *makeRawEvent() const; ///< Returns a new RawAtriStationEvent with copies of the header and samples
+};
+
+#endif //ARAATRIEVENTVIEW_H
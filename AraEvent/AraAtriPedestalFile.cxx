@@ -0,0 +1,228 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraAtriPedestalFile.cxx     ATRI pedestal file reading/writing    /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Reads the text pedestal files and reads, writes and maps the   /////
+/////     binary pedestal files                                          /////
+//////////////////////////////////////////////////////////////////////////////
+
+//C++ includes
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <sstream>
+#include <zlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//class definition includes
+#include "AraAtriPedestalFile.h"
+
+//AraRoot Includes
+#include "RawAtriStationEvent.h"
+
+/*!
+    \param fileName the pedestal file
+    \return kTRUE if the file is a binary pedestal file
+*/
+Bool_t AraAtriPedestalFile::isBinary(const char *fileName)
+{
+    FILE *fp = fopen(fileName, "rb");
+    if(!fp) return kFALSE;
+    char magic[sizeof(ARA_ATRI_PED_FILE_MAGIC)];
+    size_t nRead = fread(magic, 1, sizeof(magic), fp);
+    fclose(fp);
+    return nRead==sizeof(magic) && memcmp(magic, ARA_ATRI_PED_FILE_MAGIC, sizeof(magic))==0;
+}
+
+/*!
+    Used to spot truncated or corrupted pedestal files before loading them.
+    For a binary file this is just the count in the header, the checksum is only checked by mapBinary().
+    \param fileName the pedestal file
+    \return the number of pedestals in the file
+*/
+Int_t AraAtriPedestalFile::numberOfValues(const char *fileName)
+{
+    if(isBinary(fileName)){
+        AraAtriPedestalFileHeader header;
+        FILE *fp = fopen(fileName, "rb");
+        if(!fp) return 0;
+        size_t nRead = fread(&header, sizeof(header), 1, fp);
+        fclose(fp);
+        if(nRead!=1 || header.version!=ARA_ATRI_PED_FILE_VERSION) return 0;
+        return header.numPeds;
+    }
+
+    Int_t numPedVals=0;
+    gzFile inPed = gzopen(fileName, "r");
+    if(!inPed) return 0;
+    std::string string_buffer;
+    std::vector<char> buffer(1<<20);
+    int nRead;
+    while((nRead = gzread(inPed, &buffer[0], buffer.size())) > 0)
+        string_buffer.append(&buffer[0], nRead);
+    gzclose(inPed);
+    std::stringstream ss(string_buffer);
+
+    std::string dummy;
+    while( ss >> dummy >> dummy >> dummy){
+        for(int samp=0; samp < SAMPLES_PER_BLOCK; samp++){
+            ss >> dummy;
+            numPedVals++;
+        }
+    }
+    return numPedVals;
+}
+
+/*!
+    \param fileName the text pedestal file, may be gzipped
+    \param peds filled with the pedestals in RawAtriStationEvent::getPedIndex() order
+    \return the number of pedestals read, ARA_ATRI_PED_FILE_NUM_PEDS for a complete file
+*/
+Int_t AraAtriPedestalFile::readText(const char *fileName, std::vector<UShort_t> &peds)
+{
+    peds.assign(ARA_ATRI_PED_FILE_NUM_PEDS, 0);
+
+    // now, we open and load the pedestal files
+    gzFile inPed = gzopen(fileName, "r");
+    if(!inPed) return 0;
+
+    // we then put the buffer (which are characters at this point)
+    // into a string object that we can manipulate
+    std::string string_buffer;
+    std::vector<char> buffer(1<<20);
+    int nRead;
+    while((nRead = gzread(inPed, &buffer[0], buffer.size())) > 0)
+        string_buffer.append(&buffer[0], nRead);
+    gzclose(inPed);
+    std::stringstream ss(string_buffer);
+
+    // to do this, we need "buffer" variables
+    std::string dda_buf;
+    std::string block_buf;
+    std::string chan_buf;
+    std::string ped_buf;
+
+    Int_t numPedVals=0;
+    while ( ss >> dda_buf >> block_buf >> chan_buf){
+        // we cast the dda, block, and channels into integers
+        int dda = std::stoi(dda_buf);
+        int block = std::stoi(block_buf);
+        int chan = std::stoi(chan_buf);
+        if(dda<0 || dda>=DDA_PER_ATRI || block<0 || block>=BLOCKS_PER_DDA || chan<0 || chan>=RFCHAN_PER_DDA) break;
+
+        // the pedestal values are cast as shorts
+        for(int samp=0; samp < SAMPLES_PER_BLOCK; samp++){
+            if(!(ss >> ped_buf)) break;
+            short pedVal = short(std::stoi(ped_buf));
+            peds[RawAtriStationEvent::getPedIndex(dda,block,chan,samp)]=pedVal;
+            numPedVals++;
+        }
+    }
+    return numPedVals;
+}
+
+/*!
+    The file is written to fileName.tmp and then renamed, so a file being mapped by another process is never rewritten in place.
+    \param fileName the binary pedestal file
+    \param stationId the station the pedestals belong to
+    \param peds the pedestals in RawAtriStationEvent::getPedIndex() order
+    \param numPeds number of pedestals, should be ARA_ATRI_PED_FILE_NUM_PEDS
+    \return kTRUE on success
+*/
+Bool_t AraAtriPedestalFile::writeBinary(const char *fileName, AraStationId_t stationId, const UShort_t *peds, UInt_t numPeds)
+{
+    AraAtriPedestalFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ARA_ATRI_PED_FILE_MAGIC, sizeof(ARA_ATRI_PED_FILE_MAGIC));
+    header.version = ARA_ATRI_PED_FILE_VERSION;
+    header.headerSize = sizeof(header);
+    header.stationId = stationId;
+    header.numPeds = numPeds;
+    header.checksum = crc32(crc32(0L, Z_NULL, 0), (const Bytef*)peds, numPeds*sizeof(UShort_t));
+
+    std::string tmpName = std::string(fileName) + ".tmp";
+    FILE *fp = fopen(tmpName.c_str(), "wb");
+    if(!fp){
+        fprintf(stderr, "AraAtriPedestalFile::writeBinary -- ERROR Can't open %s: %s\n", tmpName.c_str(), strerror(errno));
+        return kFALSE;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fp)==1 && fwrite(peds, sizeof(UShort_t), numPeds, fp)==numPeds;
+    ok = (fclose(fp)==0) && ok;
+    if(!ok || rename(tmpName.c_str(), fileName)!=0){
+        fprintf(stderr, "AraAtriPedestalFile::writeBinary -- ERROR Can't write %s: %s\n", fileName, strerror(errno));
+        remove(tmpName.c_str());
+        return kFALSE;
+    }
+    return kTRUE;
+}
+
+/*!
+    The mapping is read only and shared, so every process using the same pedestal file shares the same pages.
+    The station, the number of pedestals and the checksum are all checked before the pedestals are returned.
+    \param fileName the binary pedestal file
+    \param stationId the station the pedestals are expected for
+    \param mapBase set to the start of the mapping, to be passed to unmapBinary()
+    \param mapLength set to the length of the mapping, to be passed to unmapBinary()
+    \return the ARA_ATRI_PED_FILE_NUM_PEDS pedestals, NULL if the file can't be used
+*/
+const UShort_t *AraAtriPedestalFile::mapBinary(const char *fileName, AraStationId_t stationId, void *&mapBase, size_t &mapLength)
+{
+    mapBase = NULL;
+    mapLength = 0;
+
+    int fd = open(fileName, O_RDONLY);
+    if(fd<0){
+        fprintf(stderr, "AraAtriPedestalFile::mapBinary -- ERROR Can't open %s: %s\n", fileName, strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if(fstat(fd, &st)!=0 || size_t(st.st_size) < sizeof(AraAtriPedestalFileHeader)){
+        fprintf(stderr, "AraAtriPedestalFile::mapBinary -- ERROR %s is too short\n", fileName);
+        close(fd);
+        return NULL;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base==MAP_FAILED){
+        fprintf(stderr, "AraAtriPedestalFile::mapBinary -- ERROR Can't map %s: %s\n", fileName, strerror(errno));
+        return NULL;
+    }
+
+    const AraAtriPedestalFileHeader *header = (const AraAtriPedestalFileHeader*)base;
+    const char *problem = NULL;
+    if(memcmp(header->magic, ARA_ATRI_PED_FILE_MAGIC, sizeof(ARA_ATRI_PED_FILE_MAGIC))!=0) problem = "is not a binary pedestal file";
+    else if(header->version!=ARA_ATRI_PED_FILE_VERSION) problem = "has an unknown version";
+    else if(header->stationId!=stationId) problem = "is for another station";
+    else if(header->numPeds!=ARA_ATRI_PED_FILE_NUM_PEDS) problem = "has the wrong number of pedestals";
+    else if(header->headerSize < sizeof(AraAtriPedestalFileHeader) || header->headerSize%sizeof(UShort_t)
+            || size_t(st.st_size) < header->headerSize + header->numPeds*sizeof(UShort_t)) problem = "is truncated";
+
+    const UShort_t *peds = NULL;
+    if(!problem){
+        peds = (const UShort_t*)((const char*)base + header->headerSize);
+        uLong checksum = crc32(crc32(0L, Z_NULL, 0), (const Bytef*)peds, header->numPeds*sizeof(UShort_t));
+        if(checksum!=header->checksum) problem = "fails the checksum";
+    }
+    if(problem){
+        fprintf(stderr, "AraAtriPedestalFile::mapBinary -- ERROR %s %s\n", fileName, problem);
+        munmap(base, st.st_size);
+        return NULL;
+    }
+
+    mapBase = base;
+    mapLength = st.st_size;
+    return peds;
+}
+
+/*!
+    \param mapBase the mapping returned by mapBinary()
+    \param mapLength its length
+*/
+void AraAtriPedestalFile::unmapBinary(void *mapBase, size_t mapLength)
+{
+    if(mapBase) munmap(mapBase, mapLength);
+}
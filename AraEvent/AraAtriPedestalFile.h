@@ -0,0 +1,59 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraAtriPedestalFile.h       ATRI pedestal file reading/writing    /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Reads the text pedestal files and reads, writes and maps the   /////
+/////     binary pedestal files                                          /////
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARAATRIPEDESTALFILE_H
+#define ARAATRIPEDESTALFILE_H
+
+//Includes
+#include <vector>
+#include <cstddef>
+#include "Rtypes.h"
+#include "araSoft.h"
+#include "araAtriStructures.h"
+
+#define ARA_ATRI_PED_FILE_MAGIC "ARAPEDB"
+#define ARA_ATRI_PED_FILE_VERSION 1
+#define ARA_ATRI_PED_FILE_NUM_PEDS (DDA_PER_ATRI*BLOCKS_PER_DDA*RFCHAN_PER_DDA*SAMPLES_PER_BLOCK)
+
+//! Part of AraEvent library. The header at the start of a binary ATRI pedestal file.
+/*!
+    The header is followed by numPeds UShort_t pedestals in RawAtriStationEvent::getPedIndex() order,
+    so the file can be mapped and used as the pedestal table without any parsing.
+    Everything is stored in the byte order of the machine that wrote it, which is checked through the magic and version when reading.
+    The header is padded to 64 bytes to keep the pedestals aligned.
+*/
+struct AraAtriPedestalFileHeader
+{
+    char magic[8]; ///< ARA_ATRI_PED_FILE_MAGIC
+    UInt_t version; ///< ARA_ATRI_PED_FILE_VERSION
+    UInt_t headerSize; ///< sizeof(AraAtriPedestalFileHeader), the pedestals start at this offset
+    UInt_t stationId; ///< The station the pedestals belong to
+    UInt_t numPeds; ///< Number of pedestals, ARA_ATRI_PED_FILE_NUM_PEDS
+    UInt_t checksum; ///< zlib crc32 of the pedestals
+    UInt_t reserved[9]; ///< Padding, zero
+};
+
+//! Part of AraEvent library. Reads and writes ATRI pedestal files.
+/*!
+    There are two formats. The text format is the one written by the DAQ and by repeder,
+    one line per dda, block and channel with the 64 pedestals of the block, optionally gzipped.
+    The binary format (see AraAtriPedestalFileHeader) is written by pedtobin and is memory mapped by mapBinary().
+    \ingroup rootclasses
+*/
+class AraAtriPedestalFile
+{
+    public:
+        static Bool_t isBinary(const char *fileName); ///< Does the file start with the binary pedestal magic
+        static Int_t numberOfValues(const char *fileName); ///< Number of pedestals in a text or binary file, without the full checks of mapBinary()
+        static Int_t readText(const char *fileName, std::vector<UShort_t> &peds); ///< Reads a (gzipped) text file into peds, which is resized to ARA_ATRI_PED_FILE_NUM_PEDS, returns the number of pedestals read
+        static Bool_t writeBinary(const char *fileName, AraStationId_t stationId, const UShort_t *peds, UInt_t numPeds); ///< Writes a binary file
+        static const UShort_t *mapBinary(const char *fileName, AraStationId_t stationId, void *&mapBase, size_t &mapLength); ///< Maps a binary file and checks it, returns the pedestals or NULL
+        static void unmapBinary(void *mapBase, size_t mapLength); ///< Releases a file mapped by mapBinary()
+};
+
+#endif //ARAATRIPEDESTALFILE_H
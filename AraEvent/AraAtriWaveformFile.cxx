@@ -0,0 +1,456 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraAtriWaveformFile.cxx     Columnar ATRI raw waveform files      /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Writes and memory maps files holding the raw ATRI events of a  /////
+/////     run as plain arrays, read back as AraAtriEventView             /////
+//////////////////////////////////////////////////////////////////////////////
+
+//C++ includes
+#include <cstring>
+#include <cerrno>
+#include <cstddef>
+#include <zlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//class definition includes
+#include "AraAtriWaveformFile.h"
+
+//AraRoot Includes
+#include "RawAtriStationEvent.h"
+#include "AraAtriPedestalFile.h"
+
+//! Writes size bytes, counting them into offset
+static Bool_t writeBytes(FILE *fp, const void *data, size_t size, ULong64_t &offset)
+{
+    offset += size;
+    return size==0 || fwrite(data, size, 1, fp)==1;
+}
+
+//! Size of the header of a version 1 file, which stopped before compression
+#define ARA_ATRI_WAVEFORM_FILE_V1_HEADER_SIZE offsetof(AraAtriWaveformFileHeader, compression)
+
+//! Size of a packed row of bits bit values, a 4 byte row header and the values packed least significant bit first
+static size_t packedRowSize(Int_t bits)
+{
+    return 4 + (SAMPLES_PER_BLOCK*bits+7)/8;
+}
+
+/*!
+    The samples, less their pedestals if there are any, are stored as their minimum followed by the differences from it
+    in just enough bits for the largest. The row header is the minimum (Short_t) and the number of bits (UChar_t).
+    The values are taken modulo 2^16 as Short_t, which unpackRow() undoes, so any 16 bit samples and pedestals fit in 16 bits.
+    \param samples the SAMPLES_PER_BLOCK samples of the row
+    \param peds the pedestals of the row, or NULL
+    \param out at least packedRowSize(16) bytes
+    \return the size of the packed row
+*/
+static size_t packRow(const UShort_t *samples, const UShort_t *peds, unsigned char *out)
+{
+    Int_t values[SAMPLES_PER_BLOCK];
+    Int_t minValue=0, maxValue=0;
+    for(int samp=0;samp<SAMPLES_PER_BLOCK;samp++) {
+        values[samp] = Short_t(UShort_t(samples[samp]-(peds ? peds[samp] : 0)));
+        if(samp==0 || values[samp]<minValue) minValue=values[samp];
+        if(samp==0 || values[samp]>maxValue) maxValue=values[samp];
+    }
+    Int_t bits=0;
+    while((maxValue-minValue)>>bits) bits++;
+
+    Short_t base=minValue;
+    memcpy(out, &base, sizeof(base));
+    out[2]=bits;
+    out[3]=0;
+    size_t upto=4;
+    ULong64_t acc=0;
+    Int_t accBits=0;
+    for(int samp=0;samp<SAMPLES_PER_BLOCK;samp++) {
+        acc |= ULong64_t(values[samp]-minValue)<<accBits;
+        accBits+=bits;
+        while(accBits>=8) {
+            out[upto++]=acc&0xff;
+            acc>>=8;
+            accBits-=8;
+        }
+    }
+    if(accBits) out[upto++]=acc&0xff;
+    return upto;
+}
+
+/*!
+    \param in the packed row
+    \param available bytes from in to the end of the packed rows
+    \param peds the pedestals of the row, or NULL
+    \param samples filled with the SAMPLES_PER_BLOCK samples
+    \return the size of the packed row, 0 if it is damaged
+*/
+static size_t unpackRow(const unsigned char *in, size_t available, const UShort_t *peds, UShort_t *samples)
+{
+    if(available<4) return 0;
+    Short_t base;
+    memcpy(&base, in, sizeof(base));
+    Int_t bits=in[2];
+    if(bits>16 || packedRowSize(bits)>available) return 0;
+
+    const UInt_t mask=(1u<<bits)-1;
+    size_t upto=4;
+    ULong64_t acc=0;
+    Int_t accBits=0;
+    for(int samp=0;samp<SAMPLES_PER_BLOCK;samp++) {
+        while(accBits<bits) {
+            acc |= ULong64_t(in[upto++])<<accBits;
+            accBits+=8;
+        }
+        Int_t value = base + Int_t(acc&mask);
+        acc>>=bits;
+        accBits-=bits;
+        samples[samp] = UShort_t(peds ? value+peds[samp] : value);
+    }
+    return packedRowSize(bits);
+}
+
+//! The pedestals of row chanIndex of a block, in a full pedestal table
+static const UShort_t *rowPeds(const UShort_t *peds, const AraAtriBlockView &block, Int_t chanIndex)
+{
+    if(!peds) return NULL;
+    Int_t chan=-1;
+    for(int bit=0;bit<RFCHAN_PER_DDA && chanIndex>=0;bit++) {
+        if(block.channelMask&(1<<bit)) {
+            chan=bit;
+            chanIndex--;
+        }
+    }
+    return peds+RawAtriStationEvent::getPedIndex(block.getDda(), block.getBlock(), chan, 0);
+}
+
+AraAtriWaveformFileWriter::AraAtriWaveformFileWriter()
+    : fFile(NULL), fOk(kFALSE), fPacked(kFALSE), fNumRows(0), fRowBytes(0)
+{
+}
+
+AraAtriWaveformFileWriter::~AraAtriWaveformFileWriter()
+{
+    if(fFile) close();
+}
+
+/*!
+    Packed rows are lossless and keep each sample in only as many bits as the spread of its row needs, which referencing
+    the rows to the pedestals of the station shrinks further, at the cost of decoding the samples when reading.
+    Raw rows are the default.
+    \param packed kTRUE to pack the rows of the files opened from now on
+    \param peds NULL, or the ARA_ATRI_PED_FILE_NUM_PEDS pedestals of the station to pack the differences from, which are copied into the file
+*/
+void AraAtriWaveformFileWriter::setPackedRows(Bool_t packed, const UShort_t *peds)
+{
+    fPacked = packed;
+    if(packed && peds) fPeds.assign(peds, peds+ARA_ATRI_PED_FILE_NUM_PEDS);
+    else fPeds.clear();
+}
+
+/*!
+    \param fileName the waveform file
+    \return kTRUE on success
+*/
+Bool_t AraAtriWaveformFileWriter::open(const char *fileName)
+{
+    if(fFile) close();
+    fFileName = fileName;
+    fNumRows = 0;
+    fRowBytes = 0;
+    fEvents.clear();
+    fFirstRow.clear();
+    fIrsBlockNumber.clear();
+    fChannelMask.clear();
+    fPackedOffset.clear();
+
+    std::string tmpName = fFileName + ".tmp";
+    fFile = fopen(tmpName.c_str(), "wb");
+    if(!fFile) {
+        fprintf(stderr, "AraAtriWaveformFileWriter::open -- ERROR Can't open %s: %s\n", tmpName.c_str(), strerror(errno));
+        fOk = kFALSE;
+        return kFALSE;
+    }
+    //! The header is rewritten by close() once the offsets are known
+    AraAtriWaveformFileHeader header;
+    memset(&header, 0, sizeof(header));
+    ULong64_t offset=0;
+    fOk = writeBytes(fFile, &header, sizeof(header), offset);
+    return fOk;
+}
+
+/*!
+    \param event the event to append
+    \return kTRUE on success
+*/
+Bool_t AraAtriWaveformFileWriter::addEvent(const AraAtriEventView &event)
+{
+    if(!fFile) return kFALSE;
+    AraAtriWaveformFileEvent row;
+    memset(&row, 0, sizeof(row));
+    row.header = event.header;
+    row.firstBlock = fFirstRow.size();
+    row.numBlocks = event.blocks.size();
+    fEvents.push_back(row);
+
+    for(size_t blk=0;blk<event.blocks.size();blk++) {
+        const AraAtriBlockView &block = event.blocks[blk];
+        fFirstRow.push_back(fNumRows);
+        fIrsBlockNumber.push_back(block.irsBlockNumber);
+        fChannelMask.push_back(block.channelMask);
+        if(fPacked) {
+            fPackedOffset.push_back(fRowBytes);
+            fPackBuffer.resize(block.numChannels*packedRowSize(16));
+            size_t packedBytes=0;
+            for(int chanIndex=0;chanIndex<block.numChannels;chanIndex++)
+                packedBytes += packRow(block.getSamples(chanIndex), rowPeds(fPeds.empty() ? NULL : fPeds.data(), block, chanIndex), &fPackBuffer[packedBytes]);
+            fOk = writeBytes(fFile, fPackBuffer.data(), packedBytes, fRowBytes) && fOk;
+        }
+        else {
+            fOk = writeBytes(fFile, block.samples, block.numChannels*SAMPLES_PER_BLOCK*sizeof(UShort_t), fRowBytes) && fOk;
+        }
+        fNumRows += block.numChannels;
+    }
+    return fOk;
+}
+
+/*!
+    \param event the event to append
+    \return kTRUE on success
+*/
+Bool_t AraAtriWaveformFileWriter::addEvent(const RawAtriStationEvent *event)
+{
+    fView.setEvent(event);
+    return addEvent(fView);
+}
+
+/*!
+    \return kTRUE if the whole file was written and renamed into place
+*/
+Bool_t AraAtriWaveformFileWriter::close()
+{
+    if(!fFile) return kFALSE;
+    AraAtriWaveformFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ARA_ATRI_WAVEFORM_FILE_MAGIC, sizeof(ARA_ATRI_WAVEFORM_FILE_MAGIC));
+    header.version = ARA_ATRI_WAVEFORM_FILE_VERSION;
+    header.headerSize = sizeof(header);
+    header.eventSize = sizeof(AraAtriWaveformFileEvent);
+    header.numEvents = fEvents.size();
+    header.numBlocks = fFirstRow.size();
+    header.numRows = fNumRows;
+    header.rowOffset = sizeof(header);
+    header.compression = fPacked ? kAraWaveformPackedRows : kAraWaveformRawRows;
+    header.hasPedestals = fPacked && !fPeds.empty();
+    header.rowBytes = fRowBytes;
+
+    //! The tables are padded to start 8 byte aligned
+    static const char zeros[8] = {0};
+    ULong64_t offset = header.rowOffset + fRowBytes;
+    fOk = writeBytes(fFile, zeros, (8-offset%8)%8, offset) && fOk;
+    header.eventOffset = offset;
+    fOk = writeBytes(fFile, fEvents.data(), fEvents.size()*sizeof(AraAtriWaveformFileEvent), offset) && fOk;
+    header.blockOffset = offset;
+    fOk = writeBytes(fFile, fFirstRow.data(), fFirstRow.size()*sizeof(ULong64_t), offset) && fOk;
+    fOk = writeBytes(fFile, fIrsBlockNumber.data(), fIrsBlockNumber.size()*sizeof(UShort_t), offset) && fOk;
+    fOk = writeBytes(fFile, fChannelMask.data(), fChannelMask.size()*sizeof(UShort_t), offset) && fOk;
+    if(fPacked) {
+        fOk = writeBytes(fFile, zeros, (8-offset%8)%8, offset) && fOk;
+        header.packedOffset = offset;
+        fOk = writeBytes(fFile, fPackedOffset.data(), fPackedOffset.size()*sizeof(ULong64_t), offset) && fOk;
+    }
+    if(header.hasPedestals) {
+        header.pedOffset = offset;
+        fOk = writeBytes(fFile, fPeds.data(), fPeds.size()*sizeof(UShort_t), offset) && fOk;
+    }
+
+    uLong checksum = crc32(0L, Z_NULL, 0);
+    checksum = crc32(checksum, (const Bytef*)fEvents.data(), fEvents.size()*sizeof(AraAtriWaveformFileEvent));
+    checksum = crc32(checksum, (const Bytef*)fFirstRow.data(), fFirstRow.size()*sizeof(ULong64_t));
+    checksum = crc32(checksum, (const Bytef*)fIrsBlockNumber.data(), fIrsBlockNumber.size()*sizeof(UShort_t));
+    checksum = crc32(checksum, (const Bytef*)fChannelMask.data(), fChannelMask.size()*sizeof(UShort_t));
+    if(fPacked) checksum = crc32(checksum, (const Bytef*)fPackedOffset.data(), fPackedOffset.size()*sizeof(ULong64_t));
+    if(header.hasPedestals) checksum = crc32(checksum, (const Bytef*)fPeds.data(), fPeds.size()*sizeof(UShort_t));
+    header.tableChecksum = checksum;
+
+    offset=0;
+    fOk = fseek(fFile, 0, SEEK_SET)==0 && writeBytes(fFile, &header, sizeof(header), offset) && fOk;
+    fOk = (fclose(fFile)==0) && fOk;
+    fFile = NULL;
+
+    std::string tmpName = fFileName + ".tmp";
+    if(!fOk || rename(tmpName.c_str(), fFileName.c_str())!=0) {
+        fprintf(stderr, "AraAtriWaveformFileWriter::close -- ERROR Can't write %s: %s\n", fFileName.c_str(), strerror(errno));
+        remove(tmpName.c_str());
+        fOk = kFALSE;
+    }
+    fEvents.clear();
+    fFirstRow.clear();
+    fIrsBlockNumber.clear();
+    fChannelMask.clear();
+    fPackedOffset.clear();
+    return fOk;
+}
+
+AraAtriWaveformFile::AraAtriWaveformFile()
+    : fMapBase(NULL), fMapLength(0), fHeader(NULL), fRows(NULL), fPackedRows(NULL), fPackedOffset(NULL), fPeds(NULL),
+      fEvents(NULL), fFirstRow(NULL), fIrsBlockNumber(NULL), fChannelMask(NULL)
+{
+}
+
+AraAtriWaveformFile::~AraAtriWaveformFile()
+{
+    close();
+}
+
+/*!
+    The mapping is read only and shared, so several jobs reading the same run share the same pages.
+    \param fileName the waveform file
+    \return kTRUE if the file was mapped and passed the checks
+*/
+Bool_t AraAtriWaveformFile::open(const char *fileName)
+{
+    close();
+    int fd = ::open(fileName, O_RDONLY);
+    if(fd<0) {
+        fprintf(stderr, "AraAtriWaveformFile::open -- ERROR Can't open %s: %s\n", fileName, strerror(errno));
+        return kFALSE;
+    }
+    struct stat st;
+    if(fstat(fd, &st)!=0 || size_t(st.st_size) < sizeof(AraAtriWaveformFileHeader)) {
+        fprintf(stderr, "AraAtriWaveformFile::open -- ERROR %s is too short\n", fileName);
+        ::close(fd);
+        return kFALSE;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(base==MAP_FAILED) {
+        fprintf(stderr, "AraAtriWaveformFile::open -- ERROR Can't map %s: %s\n", fileName, strerror(errno));
+        return kFALSE;
+    }
+
+    //! Version 1 headers are shorter, the fields after them are left zero, which means raw rows
+    const AraAtriWaveformFileHeader *mapped = (const AraAtriWaveformFileHeader*)base;
+    AraAtriWaveformFileHeader *header = &fHeaderCopy;
+    memset(header, 0, sizeof(AraAtriWaveformFileHeader));
+    Bool_t knownVersion = (mapped->version==ARA_ATRI_WAVEFORM_FILE_VERSION && mapped->headerSize==sizeof(AraAtriWaveformFileHeader))
+        || (mapped->version==1 && mapped->headerSize==ARA_ATRI_WAVEFORM_FILE_V1_HEADER_SIZE);
+    if(knownVersion && size_t(st.st_size)>=mapped->headerSize) memcpy(header, mapped, mapped->headerSize);
+    if(knownVersion && mapped->version==1) header->rowBytes = header->numRows*SAMPLES_PER_BLOCK*sizeof(UShort_t);
+
+    const char *data = (const char*)base;
+    ULong64_t fileSize = st.st_size;
+    ULong64_t eventBytes = header->numEvents*sizeof(AraAtriWaveformFileEvent);
+    ULong64_t blockBytes = header->numBlocks*(sizeof(ULong64_t)+2*sizeof(UShort_t));
+    ULong64_t packedBytes = header->compression==kAraWaveformPackedRows ? header->numBlocks*sizeof(ULong64_t) : 0;
+    ULong64_t pedBytes = header->hasPedestals ? ARA_ATRI_PED_FILE_NUM_PEDS*sizeof(UShort_t) : 0;
+    const char *problem = NULL;
+    if(memcmp(mapped->magic, ARA_ATRI_WAVEFORM_FILE_MAGIC, sizeof(ARA_ATRI_WAVEFORM_FILE_MAGIC))!=0) problem = "is not a waveform file";
+    else if(!knownVersion) problem = "has an unknown version";
+    else if(header->eventSize!=sizeof(AraAtriWaveformFileEvent)) problem = "was made with different table sizes";
+    else if(header->compression!=kAraWaveformRawRows && header->compression!=kAraWaveformPackedRows) problem = "has an unknown row format";
+    else if((header->compression==kAraWaveformRawRows && (header->rowBytes!=header->numRows*SAMPLES_PER_BLOCK*sizeof(UShort_t) || header->hasPedestals))
+            || (header->compression==kAraWaveformPackedRows && header->packedOffset%sizeof(ULong64_t))
+            || header->rowOffset%sizeof(ULong64_t) || header->eventOffset%sizeof(ULong64_t) || header->blockOffset%sizeof(ULong64_t)
+            || header->rowOffset+header->rowBytes>fileSize || header->eventOffset+eventBytes>fileSize || header->blockOffset+blockBytes>fileSize
+            || header->packedOffset+packedBytes>fileSize || header->pedOffset+pedBytes>fileSize) problem = "is truncated";
+    else if(header->blockOffset!=header->eventOffset+eventBytes) problem = "has its block table in the wrong place";
+    else {
+        uLong checksum = crc32(crc32(0L, Z_NULL, 0), (const Bytef*)(data+header->eventOffset), eventBytes+blockBytes);
+        if(packedBytes) checksum = crc32(checksum, (const Bytef*)(data+header->packedOffset), packedBytes);
+        if(pedBytes) checksum = crc32(checksum, (const Bytef*)(data+header->pedOffset), pedBytes);
+        if(checksum!=header->tableChecksum) problem = "fails the checksum";
+    }
+    if(problem) {
+        fprintf(stderr, "AraAtriWaveformFile::open -- ERROR %s %s\n", fileName, problem);
+        munmap(base, st.st_size);
+        return kFALSE;
+    }
+
+    fMapBase = base;
+    fMapLength = st.st_size;
+    fHeader = header;
+    if(header->compression==kAraWaveformPackedRows) {
+        fPackedRows = (const unsigned char*)(data+header->rowOffset);
+        fPackedOffset = (const ULong64_t*)(data+header->packedOffset);
+    }
+    else {
+        fRows = (const UShort_t*)(data+header->rowOffset);
+    }
+    if(header->hasPedestals) fPeds = (const UShort_t*)(data+header->pedOffset);
+    fEvents = (const AraAtriWaveformFileEvent*)(data+header->eventOffset);
+    fFirstRow = (const ULong64_t*)(data+header->blockOffset);
+    fIrsBlockNumber = (const UShort_t*)(fFirstRow+header->numBlocks);
+    fChannelMask = fIrsBlockNumber+header->numBlocks;
+    return kTRUE;
+}
+
+void AraAtriWaveformFile::close()
+{
+    if(fMapBase) munmap(fMapBase, fMapLength);
+    fMapBase = NULL;
+    fMapLength = 0;
+    fHeader = NULL;
+    fRows = NULL;
+    fPackedRows = NULL;
+    fPackedOffset = NULL;
+    fPeds = NULL;
+}
+
+/*!
+    \param entry the event, from 0 to getNumEvents()-1
+    \return the header fields, NULL if entry is out of range
+*/
+const AraAtriEventFields *AraAtriWaveformFile::getEventFields(Long64_t entry) const
+{
+    if(entry<0 || entry>=getNumEvents()) return NULL;
+    return &(fEvents[entry].header);
+}
+
+/*!
+    \param entry the event, from 0 to getNumEvents()-1
+    \param view set to the event, its blocks point into the mapping, or into view.decodedSamples for packed rows,
+    and stay valid until the file is closed or the view is set again
+    \return kFALSE if entry is out of range or the event's blocks run past the columns or their rows are damaged
+*/
+Bool_t AraAtriWaveformFile::getEvent(Long64_t entry, AraAtriEventView &view) const
+{
+    if(entry<0 || entry>=getNumEvents()) return kFALSE;
+    const AraAtriWaveformFileEvent &event = fEvents[entry];
+    if(event.firstBlock+event.numBlocks>fHeader->numBlocks) return kFALSE;
+    view.header = event.header;
+    view.blocks.resize(event.numBlocks);
+    if(!fPackedRows) {
+        for(UInt_t blk=0;blk<event.numBlocks;blk++) {
+            ULong64_t block = event.firstBlock+blk;
+            view.blocks[blk].set(fIrsBlockNumber[block], fChannelMask[block], fRows+fFirstRow[block]*SAMPLES_PER_BLOCK);
+            if(fFirstRow[block]+view.blocks[blk].numChannels>fHeader->numRows) return kFALSE;
+        }
+        return kTRUE;
+    }
+
+    //! Packed rows are decoded into the view, which is sized first so the block views can point into it
+    size_t numRows=0;
+    for(UInt_t blk=0;blk<event.numBlocks;blk++) {
+        ULong64_t block = event.firstBlock+blk;
+        view.blocks[blk].set(fIrsBlockNumber[block], fChannelMask[block], NULL);
+        numRows += view.blocks[blk].numChannels;
+    }
+    view.decodedSamples.resize(numRows*SAMPLES_PER_BLOCK);
+    UShort_t *samples = view.decodedSamples.data();
+    for(UInt_t blk=0;blk<event.numBlocks;blk++) {
+        AraAtriBlockView &blockView = view.blocks[blk];
+        ULong64_t upto = fPackedOffset[event.firstBlock+blk];
+        blockView.samples = samples;
+        for(int chanIndex=0;chanIndex<blockView.numChannels;chanIndex++) {
+            if(upto>=fHeader->rowBytes) return kFALSE;
+            size_t used = unpackRow(fPackedRows+upto, fHeader->rowBytes-upto, rowPeds(fPeds, blockView, chanIndex), samples);
+            if(!used) return kFALSE;
+            upto += used;
+            samples += SAMPLES_PER_BLOCK;
+        }
+    }
+    return kTRUE;
+}
@@ -0,0 +1,147 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraAtriWaveformFile.h       Columnar ATRI raw waveform files      /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Writes and memory maps files holding the raw ATRI events of a  /////
+/////     run as plain arrays, read back as AraAtriEventView             /////
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARAATRIWAVEFORMFILE_H
+#define ARAATRIWAVEFORMFILE_H
+
+//Includes
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Rtypes.h"
+#include "araSoft.h"
+#include "AraAtriEventView.h"
+
+#define ARA_ATRI_WAVEFORM_FILE_MAGIC "ARAWAVE"
+#define ARA_ATRI_WAVEFORM_FILE_VERSION 2
+
+//! How the sample rows of an ATRI waveform file are stored
+enum AraAtriWaveformRows {
+    kAraWaveformRawRows = 0, ///< Plain rows of SAMPLES_PER_BLOCK UShort_t, the views point straight at them
+    kAraWaveformPackedRows = 1 ///< Bit packed rows, see AraAtriWaveformFileWriter::setPackedRows()
+};
+
+//! Part of AraEvent library. The header at the start of an ATRI waveform file.
+/*!
+    The header is followed by
+    - the sample rows, numRows rows of SAMPLES_PER_BLOCK samples, one row per channel read out in each block, rowBytes in all
+    - the event table, numEvents AraAtriWaveformFileEvent
+    - the block columns, numBlocks each of the first row (ULong64_t), irsBlockNumber (UShort_t) and channelMask (UShort_t) of every block
+    - for packed rows, the packed column, numBlocks ULong64_t offsets of the first row of each block from rowOffset
+    - if hasPedestals, the ARA_ATRI_PED_FILE_NUM_PEDS pedestals the packed rows are referenced to, in RawAtriStationEvent::getPedIndex() order
+
+    All the offsets are from the start of the file. Everything is stored in the byte order of the machine that wrote it.
+    Version 1 files end the header at compression and always have raw rows, they are still read.
+*/
+struct AraAtriWaveformFileHeader
+{
+    char magic[8]; ///< ARA_ATRI_WAVEFORM_FILE_MAGIC
+    UInt_t version; ///< ARA_ATRI_WAVEFORM_FILE_VERSION
+    UInt_t headerSize; ///< sizeof(AraAtriWaveformFileHeader)
+    UInt_t eventSize; ///< sizeof(AraAtriWaveformFileEvent)
+    UInt_t tableChecksum; ///< zlib crc32 of the event table, the block columns, the packed column and the pedestals
+    ULong64_t numEvents; ///< Number of events
+    ULong64_t numBlocks; ///< Number of blocks of all the events
+    ULong64_t numRows; ///< Number of sample rows
+    ULong64_t rowOffset; ///< Offset of the sample rows
+    ULong64_t eventOffset; ///< Offset of the event table
+    ULong64_t blockOffset; ///< Offset of the block columns
+    UInt_t compression; ///< AraAtriWaveformRows
+    UInt_t hasPedestals; ///< Are the packed rows referenced to pedestals
+    ULong64_t rowBytes; ///< Bytes of sample rows
+    ULong64_t packedOffset; ///< Offset of the packed column, 0 for raw rows
+    ULong64_t pedOffset; ///< Offset of the pedestals, 0 if there are none
+};
+
+//! Part of AraEvent library. One row of the event table of an ATRI waveform file.
+struct AraAtriWaveformFileEvent
+{
+    AraAtriEventFields header; ///< The header fields of the event
+    ULong64_t firstBlock; ///< Index of the first block of the event in the block columns
+    UInt_t numBlocks; ///< Number of blocks of the event
+    UInt_t padding; ///< Zero
+};
+
+//! Part of AraEvent library. Writes an ATRI waveform file event by event.
+/*!
+    The sample rows are written as the events come, the tables are kept in memory and written by close().
+    The file is written to fileName.tmp and renamed by close(), so a half written file is never mistaken for a complete one.
+    \ingroup rootclasses
+*/
+class AraAtriWaveformFileWriter
+{
+    public:
+        AraAtriWaveformFileWriter(); ///< Default constructor
+        ~AraAtriWaveformFileWriter(); ///< Destructor, closes the file if it is still open
+
+        void setPackedRows(Bool_t packed, const UShort_t *peds=NULL); ///< Packs the rows of the next file, optionally referenced to a pedestal table
+        Bool_t open(const char *fileName); ///< Starts a new file
+        Bool_t addEvent(const AraAtriEventView &event); ///< Appends an event
+        Bool_t addEvent(const RawAtriStationEvent *event); ///< Appends an event
+        Bool_t close(); ///< Writes the tables and renames the file into place, returns kFALSE if anything failed to be written
+
+    private:
+        AraAtriWaveformFileWriter(const AraAtriWaveformFileWriter&);
+        AraAtriWaveformFileWriter &operator=(const AraAtriWaveformFileWriter&);
+
+        FILE *fFile;
+        std::string fFileName;
+        Bool_t fOk;
+        Bool_t fPacked;
+        ULong64_t fNumRows;
+        ULong64_t fRowBytes;
+        std::vector<AraAtriWaveformFileEvent> fEvents;
+        std::vector<ULong64_t> fFirstRow;
+        std::vector<UShort_t> fIrsBlockNumber;
+        std::vector<UShort_t> fChannelMask;
+        std::vector<ULong64_t> fPackedOffset;
+        std::vector<UShort_t> fPeds;
+        std::vector<unsigned char> fPackBuffer;
+        AraAtriEventView fView;
+};
+
+//! Part of AraEvent library. Maps an ATRI waveform file and hands out its events as AraAtriEventView.
+/*!
+    Nothing is read or converted when the file is opened beyond the table checksum. For raw rows the views point straight
+    into the mapping, so repeated passes over a run cost no more than touching the pages of the samples they use.
+    Packed rows are decoded by getEvent() into AraAtriEventView::decodedSamples of the view, with the same result.
+    \ingroup rootclasses
+*/
+class AraAtriWaveformFile
+{
+    public:
+        AraAtriWaveformFile(); ///< Default constructor
+        ~AraAtriWaveformFile(); ///< Destructor, unmaps the file
+
+        Bool_t open(const char *fileName); ///< Maps a file and checks it
+        void close(); ///< Unmaps the file, any views of it become invalid
+
+        Long64_t getNumEvents() const {return fHeader ? fHeader->numEvents : 0;}
+        Bool_t hasPackedRows() const {return fPackedOffset!=NULL;}
+        const AraAtriEventFields *getEventFields(Long64_t entry) const; ///< The header fields of an event, without its blocks
+        Bool_t getEvent(Long64_t entry, AraAtriEventView &view) const; ///< Points view at an event
+
+    private:
+        AraAtriWaveformFile(const AraAtriWaveformFile&);
+        AraAtriWaveformFile &operator=(const AraAtriWaveformFile&);
+
+        void *fMapBase;
+        size_t fMapLength;
+        AraAtriWaveformFileHeader fHeaderCopy; ///< The header, zero extended if the file is version 1
+        const AraAtriWaveformFileHeader *fHeader;
+        const UShort_t *fRows;
+        const unsigned char *fPackedRows;
+        const ULong64_t *fPackedOffset;
+        const UShort_t *fPeds;
+        const AraAtriWaveformFileEvent *fEvents;
+        const ULong64_t *fFirstRow;
+        const UShort_t *fIrsBlockNumber;
+        const UShort_t *fChannelMask;
+};
+
+#endif //ARAATRIWAVEFORMFILE_H
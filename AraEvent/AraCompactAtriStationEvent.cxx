@@ -0,0 +1,229 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraCompactAtriStationEvent.cxx  Compact calibrated ATRI events    /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Stores the calibrated samples of an ATRI event with float      /////
+/////     voltages and table references for the times, no raw blocks     /////
+//////////////////////////////////////////////////////////////////////////////
+
+//C++ includes
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+//class definition includes
+#include "AraCompactAtriStationEvent.h"
+
+//AraRoot Includes
+#include "UsefulAtriStationEvent.h"
+#include "AraAtriEventView.h"
+
+ClassImp(AraCompactAtriStationEvent);
+
+AraCompactAtriStationEvent::AraCompactAtriStationEvent()
+{
+  fCalType=0;
+  fCalibEpoch=0;
+  memset(fNumSamples,0,sizeof(fNumSamples));
+  memset(fTimeMode,0,sizeof(fTimeMode));
+  memset(fFirstBlock,0,sizeof(fFirstBlock));
+  memset(fTimeOffset,0,sizeof(fTimeOffset));
+  memset(fNumDdaBlocks,0,sizeof(fNumDdaBlocks));
+}
+
+/*!
+  \param usefulEvent the calibrated event, which must still have its raw blocks
+  \param calType the calibration type it was calibrated with
+*/
+AraCompactAtriStationEvent::AraCompactAtriStationEvent(UsefulAtriStationEvent *usefulEvent, AraCalType::AraCalType_t calType)
+{
+  pack(usefulEvent,calType);
+}
+
+AraCompactAtriStationEvent::~AraCompactAtriStationEvent()
+{
+}
+
+/*!
+  \param usefulEvent the calibrated event, which must still have its raw blocks for the cap arrays
+  \param calType the calibration type it was calibrated with
+*/
+void AraCompactAtriStationEvent::pack(UsefulAtriStationEvent *usefulEvent, AraCalType::AraCalType_t calType)
+{
+  AraAtriEventFields header;
+  header.getFrom(usefulEvent);
+  header.setTo(this);
+  blockVec.clear();
+  fCalType=calType;
+  fCalibEpoch=AraEventCalibrator::getAtriCalibEpoch(stationId,unixTime);
+  memset(fNumSamples,0,sizeof(fNumSamples));
+  memset(fTimeMode,0,sizeof(fTimeMode));
+  memset(fFirstBlock,0,sizeof(fFirstBlock));
+  memset(fTimeOffset,0,sizeof(fTimeOffset));
+  memset(fNumDdaBlocks,0,sizeof(fNumDdaBlocks));
+  fCapArrays.clear();
+  fVolts.clear();
+  fStoredTimes.clear();
+
+  //The cap arrays, in the order the calibrator unpacks the blocks of each dda
+  for(int dda=0;dda<DDA_PER_ATRI;dda++) {
+    for(size_t blk=0;blk<usefulEvent->blockVec.size();blk++) {
+      if(usefulEvent->blockVec[blk].getDda()!=dda) continue;
+      fCapArrays.push_back(usefulEvent->blockVec[blk].getCapArray());
+      fNumDdaBlocks[dda]++;
+    }
+  }
+
+  std::shared_ptr<const AraAtriCalibTables> calib=AraEventCalibrator::Instance()->getAtriCalibTables(stationId,unixTime);
+  std::vector<Double_t> rebuilt;
+  for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) {
+    Int_t numSamples=usefulEvent->getNumSamplesInElecChan(chanId);
+    if(numSamples==0) continue;
+    const Double_t *times=usefulEvent->getTimesFromElecChan(chanId);
+    const Double_t *volts=usefulEvent->getVoltsFromElecChan(chanId);
+    fNumSamples[chanId]=numSamples;
+    fVolts.insert(fVolts.end(),volts,volts+numSamples);
+
+    //Try the table times with and without the first block, then uniform times, keeping the first that reproduces the times
+    rebuilt.resize(numSamples);
+    const UChar_t tryModes[3]={kAraCompactTableTimes,kAraCompactTableTimes,kAraCompactUniformTimes};
+    const UChar_t tryFirstBlock[3]={0,1,0};
+    for(int attempt=0;attempt<3 && !fTimeMode[chanId];attempt++) {
+      fTimeMode[chanId]=tryModes[attempt];
+      fFirstBlock[chanId]=tryFirstBlock[attempt];
+      Bool_t matches=rebuildTimes(chanId,calib.get(),&rebuilt[0]);
+      Double_t offset=matches ? times[0]-rebuilt[0] : 0;
+      for(int samp=0;matches && samp<numSamples;samp++) {
+        if(std::fabs(rebuilt[samp]+offset-times[samp])>1e-6) matches=kFALSE;
+      }
+      if(matches) fTimeOffset[chanId]=offset;
+      else {
+        fTimeMode[chanId]=kAraCompactNoTimes;
+        fFirstBlock[chanId]=0;
+      }
+    }
+    if(!fTimeMode[chanId]) {
+      fTimeMode[chanId]=kAraCompactStoredTimes;
+      fStoredTimes.insert(fStoredTimes.end(),times,times+numSamples);
+    }
+  }
+}
+
+/*!
+  \param chanId the electronics channel
+  \param calib the timing tables of the event, only needed for table times
+  \param times filled with the fNumSamples[chanId] times, without fTimeOffset
+  \return kFALSE if the blocks don't give exactly fNumSamples[chanId] samples
+*/
+Bool_t AraCompactAtriStationEvent::rebuildTimes(int chanId, const AraAtriCalibTables *calib, Double_t *times) const
+{
+  Int_t numSamples=fNumSamples[chanId];
+  if(fTimeMode[chanId]==kAraCompactUniformTimes) {
+    for(int samp=0;samp<numSamples;samp++) times[samp]=samp*NSPERSAMP_ATRI;
+    return kTRUE;
+  }
+  if(fTimeMode[chanId]!=kAraCompactTableTimes || !calib) return kFALSE;
+
+  //As in AraEventCalibrator::TimingCalibrationAndBadSampleReomval(), counting the blocks from the first one read out
+  Int_t dda=chanId/RFCHAN_PER_DDA;
+  Int_t chan=chanId%RFCHAN_PER_DDA;
+  size_t firstCapArray=0;
+  for(int otherDda=0;otherDda<dda;otherDda++) firstCapArray+=fNumDdaBlocks[otherDda];
+  if(firstCapArray+fNumDdaBlocks[dda]>fCapArrays.size()) return kFALSE;
+  Int_t upto=0;
+  for(int blk=fFirstBlock[chanId];blk<fNumDdaBlocks[dda];blk++) {
+    Int_t capArrayNumber=fCapArrays[firstCapArray+blk];
+    Int_t blockSamples=calib->fAtriNumSamples[dda][chan][capArrayNumber];
+    if(upto+blockSamples>numSamples) return kFALSE;
+    for(int samp=0;samp<blockSamples;samp++)
+      times[upto++]=blk * 20.0 + calib->fAtriSampleTimes[dda][chan][capArrayNumber][samp] - 20.0*capArrayNumber;
+  }
+  return upto==numSamples;
+}
+
+/*!
+  \param usefulEvent the event to fill, any samples or blocks it had are dropped
+  \return kFALSE if the timing tables of the event can't be loaded
+*/
+Bool_t AraCompactAtriStationEvent::unpack(UsefulAtriStationEvent *usefulEvent) const
+{
+  AraAtriEventFields header;
+  header.getFrom(this);
+  header.setTo(usefulEvent);
+  usefulEvent->blockVec.clear();
+  usefulEvent->fTimes.clear();
+  usefulEvent->fVolts.clear();
+  usefulEvent->fLazyChanMask=0;
+  usefulEvent->fIsConditioned=0;
+  usefulEvent->fConditioningList.clear();
+  usefulEvent->setUseArena(kTRUE);
+  usefulEvent->fNumChannels=getNumElecChannels();
+  memset(usefulEvent->fArenaOffset,0,sizeof(usefulEvent->fArenaOffset));
+  memset(usefulEvent->fArenaLength,0,sizeof(usefulEvent->fArenaLength));
+  usefulEvent->fArenaTimes.resize(fVolts.size());
+  usefulEvent->fArenaVolts.resize(fVolts.size());
+
+  std::shared_ptr<const AraAtriCalibTables> calib;
+  for(int chanId=0;chanId<CHANNELS_PER_ATRI && !calib;chanId++) {
+    if(fTimeMode[chanId]!=kAraCompactTableTimes) continue;
+    calib=AraEventCalibrator::Instance()->getAtriCalibTables(stationId,unixTime);
+    if(!calib) {
+      fprintf(stderr, "AraCompactAtriStationEvent::unpack -- ERROR No timing tables for stationId %i\n", stationId);
+      return kFALSE;
+    }
+    if(calib->fEpoch!=fCalibEpoch)
+      fprintf(stderr, "AraCompactAtriStationEvent::unpack -- WARNING Event was packed with calibration epoch %d, the tables are epoch %d\n", fCalibEpoch, calib->fEpoch);
+  }
+
+  Int_t upto=0;
+  Int_t storedUpto=0;
+  for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) {
+    Int_t numSamples=fNumSamples[chanId];
+    if(numSamples==0) continue;
+    if(upto+numSamples>(Int_t)fVolts.size()) {
+      fprintf(stderr, "AraCompactAtriStationEvent::unpack -- ERROR Event %u has fewer voltages than samples\n", eventNumber);
+      return kFALSE;
+    }
+    usefulEvent->fArenaOffset[chanId]=upto;
+    usefulEvent->fArenaLength[chanId]=numSamples;
+    Double_t *times=&(usefulEvent->fArenaTimes[upto]);
+    Double_t *volts=&(usefulEvent->fArenaVolts[upto]);
+    for(int samp=0;samp<numSamples;samp++) volts[samp]=fVolts[upto+samp];
+    if(fTimeMode[chanId]==kAraCompactStoredTimes) {
+      if(storedUpto+numSamples>(Int_t)fStoredTimes.size()) {
+        fprintf(stderr, "AraCompactAtriStationEvent::unpack -- ERROR Event %u has fewer stored times than samples\n", eventNumber);
+        return kFALSE;
+      }
+      memcpy(times,&fStoredTimes[storedUpto],numSamples*sizeof(Double_t));
+      storedUpto+=numSamples;
+    }
+    else {
+      if(!rebuildTimes(chanId,calib.get(),times)) {
+        fprintf(stderr, "AraCompactAtriStationEvent::unpack -- ERROR Can't rebuild the times of event %u channel %d\n", eventNumber, chanId);
+        return kFALSE;
+      }
+      for(int samp=0;samp<numSamples;samp++) times[samp]+=fTimeOffset[chanId];
+    }
+    upto+=numSamples;
+  }
+  return kTRUE;
+}
+
+UsefulAtriStationEvent *AraCompactAtriStationEvent::makeUsefulEvent() const
+{
+  UsefulAtriStationEvent *usefulEvent = new UsefulAtriStationEvent();
+  if(!unpack(usefulEvent)) {
+    delete usefulEvent;
+    return NULL;
+  }
+  return usefulEvent;
+}
+
+Int_t AraCompactAtriStationEvent::getNumElecChannels() const
+{
+  Int_t numChannels=0;
+  for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) {
+    if(fNumSamples[chanId]) numChannels++;
+  }
+  return numChannels;
+}
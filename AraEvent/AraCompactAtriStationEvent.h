@@ -0,0 +1,73 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraCompactAtriStationEvent.h  Compact calibrated ATRI event class /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Stores the calibrated samples of an ATRI event with float      /////
+/////     voltages and table references for the times, no raw blocks     /////
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARACOMPACTATRISTATIONEVENT_H
+#define ARACOMPACTATRISTATIONEVENT_H
+
+//Includes
+#include <vector>
+#include <TObject.h>
+#include "RawAtriStationEvent.h"
+#include "AraEventCalibrator.h"
+#include "araSoft.h"
+
+class UsefulAtriStationEvent;
+
+//! How the sample times of a channel of an AraCompactAtriStationEvent are stored
+enum AraCompactTimeMode {
+  kAraCompactNoTimes = 0, ///< The channel was not read out
+  kAraCompactTableTimes = 1, ///< Rebuilt from the calibrator's sample timing tables, the cap arrays of the blocks and an offset
+  kAraCompactUniformTimes = 2, ///< The offset plus NSPERSAMP_ATRI a sample, as for calibrations without bin width calibration
+  kAraCompactStoredTimes = 3 ///< Stored sample by sample, for anything the other two can't reproduce
+};
+
+//!  Part of AraEvent library. A calibrated ATRI event without the raw samples, a few times smaller than a UsefulAtriStationEvent.
+/*!
+  The header fields are those of the RawAtriStationEvent it inherits from, whose blockVec is left empty.
+  The voltages are stored as floats. The times of a channel are nearly always the calibrator's timing table entries of the
+  cap array of each block, shifted by the block number and the cable delay, so only the cap arrays and one offset per channel are
+  stored. pack() rebuilds the times it would store and compares them to the calibrated ones, any channel that doesn't agree to
+  within 1e-6 ns has its times stored in full instead, so the times read back are always those of the calibration.
+
+  unpack() fills a UsefulAtriStationEvent with the header and the samples in its dense arena, reading the timing tables from the
+  calibrator cache. That is much quicker than calibrating the raw event again, and the event works with all the usual accessors.
+  \ingroup rootclasses
+*/
+class AraCompactAtriStationEvent: public RawAtriStationEvent
+{
+ public:
+  AraCompactAtriStationEvent(); ///< Default constructor
+  AraCompactAtriStationEvent(UsefulAtriStationEvent *usefulEvent, AraCalType::AraCalType_t calType); ///< Packs a calibrated event
+  ~AraCompactAtriStationEvent(); ///< Destructor
+
+  void pack(UsefulAtriStationEvent *usefulEvent, AraCalType::AraCalType_t calType); ///< Replaces the contents with a calibrated event, which must still have its raw blocks
+  Bool_t unpack(UsefulAtriStationEvent *usefulEvent) const; ///< Fills usefulEvent with the header and calibrated samples, in arena mode
+  UsefulAtriStationEvent *makeUsefulEvent() const; ///< Returns a new UsefulAtriStationEvent filled by unpack(), NULL if it fails
+
+  Int_t getNumElecChannels() const; ///< Number of electronics channels read out
+  Int_t getNumSamplesInElecChan(int chanId) const {return (chanId>=0 && chanId<CHANNELS_PER_ATRI) ? fNumSamples[chanId] : 0;}
+  AraCalType::AraCalType_t getCalType() const {return (AraCalType::AraCalType_t)fCalType;}
+
+  Int_t fCalType; ///< The AraCalType the event was calibrated with
+  Int_t fCalibEpoch; ///< AraEventCalibrator::getAtriCalibEpoch() of the event when it was packed
+  Int_t fNumSamples[CHANNELS_PER_ATRI]; ///< Calibrated samples of each electronics channel, 0 if it was not read out
+  UChar_t fTimeMode[CHANNELS_PER_ATRI]; ///< AraCompactTimeMode of each channel
+  UChar_t fFirstBlock[CHANNELS_PER_ATRI]; ///< For table times, the first block of the dda with samples in the channel, 1 if the first block was trimmed
+  Double_t fTimeOffset[CHANNELS_PER_ATRI]; ///< Added to the table or uniform times, the cable delay and any other shift
+  UShort_t fNumDdaBlocks[DDA_PER_ATRI]; ///< Number of blocks read out by each dda
+  std::vector<UChar_t> fCapArrays; ///< The cap array of each block, all the blocks of dda 0 then dda 1...
+  std::vector<Float_t> fVolts; ///< The voltages of all channels in electronics channel order
+  std::vector<Double_t> fStoredTimes; ///< The times of the kAraCompactStoredTimes channels, in electronics channel order
+
+ private:
+  Bool_t rebuildTimes(int chanId, const AraAtriCalibTables *calib, Double_t *times) const; ///< Rebuilds the times of a table or uniform channel without the offset
+
+  ClassDef(AraCompactAtriStationEvent,1);
+};
+
+#endif //ARACOMPACTATRISTATIONEVENT_H
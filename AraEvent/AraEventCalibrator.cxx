@@ -10,6 +10,8 @@
 #include "UsefulIcrrStationEvent.h"
 #include "UsefulAtriStationEvent.h"
 #include "AraGeomTool.h"
+#include "AraAtriPedestalFile.h"
+#include "AraAtriCalibBundle.h"
 #include "araSoft.h"
 #include "TMath.h"
 #include "TGraph.h"
@@ -21,6 +23,18 @@
 #include <cstdlib>
 #include <sstream>
 #include <numeric>
+#include <mutex>
+#include <condition_variable>
+#include <list>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /*!
     Returns if a calibration type should or should not trim the first block of a waveform., 27-09-2021 -MK-
@@ -168,6 +182,435 @@ Bool_t AraCalType::hasUnDiplexing(AraCalType::AraCalType_t calType)
 
 
 
+//! Readers-writer lock guarding the calibration tables of one AraEventCalibrator
+/*!
+    Calibrating an event holds the lock shared for as long as it reads the tables.
+    (Re)loading the tables, e.g. when the station changes, takes it exclusively: it waits for the events in flight
+    and holds back new ones until the load is done, so no thread ever reads a half-loaded table.
+*/
+class AraCalibTableLock
+{
+    public:
+        AraCalibTableLock() : fReaders(0), fWriting(false), fWritersWaiting(0) {}
+
+        //! Takes the lock shared, first running load() exclusively if needsLoad() says the tables are not in memory
+        template<class NeedsLoad, class Load> void lockShared(NeedsLoad needsLoad, Load load)
+        {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fCond.wait(lock, [this]{ return !fWriting && fWritersWaiting==0; });
+            if(needsLoad()) {
+                waitExclusive(lock);
+                if(needsLoad()) {
+                    lock.unlock();
+                    load();
+                    lock.lock();
+                }
+                // Downgrade to shared without letting anybody else in, so the tables we loaded are the ones we read
+                fWriting=false;
+                fCond.notify_all();
+            }
+            fReaders++;
+        }
+
+        void unlockShared()
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fReaders--;
+            if(fReaders==0) fCond.notify_all();
+        }
+
+        //! Runs load() with the lock held exclusively
+        template<class Load> void runExclusive(Load load)
+        {
+            std::unique_lock<std::mutex> lock(fMutex);
+            waitExclusive(lock);
+            lock.unlock();
+            load();
+            lock.lock();
+            fWriting=false;
+            fCond.notify_all();
+        }
+
+    private:
+        void waitExclusive(std::unique_lock<std::mutex> &lock)
+        {
+            fWritersWaiting++;
+            fCond.wait(lock, [this]{ return !fWriting && fReaders==0; });
+            fWritersWaiting--;
+            fWriting=true;
+        }
+
+        std::mutex fMutex;
+        std::condition_variable fCond;
+        Int_t fReaders; ///< Number of events being calibrated
+        Bool_t fWriting; ///< A thread is loading tables
+        Int_t fWritersWaiting; ///< Threads waiting to load tables, new readers queue behind them
+};
+
+//! Releases a shared AraCalibTableLock when calibrateEvent returns
+class AraCalibTableReadGuard
+{
+    public:
+        AraCalibTableReadGuard(AraCalibTableLock *tableLock) : fLock(tableLock) {}
+        ~AraCalibTableReadGuard() { fLock->unlockShared(); }
+    private:
+        AraCalibTableLock *fLock;
+};
+
+//! Least recently used cache of the Atri calibration tables and pedestals
+/*!
+    Entries are keyed by station and calibration epoch, so several stations and epochs can be in memory at once.
+    Once the entries use more than the memory limit the least recently used ones are dropped.
+    Entries are handed out as shared pointers, so a thread still calibrating with a dropped entry keeps it alive until it is done.
+    Looking up an entry that is in memory only takes a short mutex, loading one is done outside it so other stations are not held up.
+*/
+class AraAtriCalibCache
+{
+    public:
+        AraAtriCalibCache() : fMemoryLimit(512LL*1024*1024), fMemoryUsed(0) {}
+
+        static Long64_t calibKey(Int_t calibIndex, Int_t epoch) { return (((Long64_t)calibIndex)<<16 | epoch)<<1; }
+        static Long64_t pedKey(Int_t calibIndex) { return (((Long64_t)calibIndex)<<16)<<1 | 1; }
+
+        //! Returns the entry for key, running load() to build it if it is not in memory. With reload an entry in memory is replaced
+        template<class T, class Load> std::shared_ptr<const T> get(Long64_t key, Load load, Bool_t reload=false)
+        {
+            if(!reload) {
+                std::lock_guard<std::mutex> lock(fMutex);
+                std::shared_ptr<const void> entry=find(key);
+                if(entry) return std::static_pointer_cast<const T>(entry);
+            }
+            // Only one load at a time, and check again as another thread may have just loaded this entry
+            std::lock_guard<std::mutex> loadLock(fLoadMutex);
+            if(!reload) {
+                std::lock_guard<std::mutex> lock(fMutex);
+                std::shared_ptr<const void> entry=find(key);
+                if(entry) return std::static_pointer_cast<const T>(entry);
+            }
+            std::shared_ptr<const T> loaded(load());
+            if(!loaded) return loaded;
+            std::lock_guard<std::mutex> lock(fMutex);
+            remove(key);
+            fEntries.push_front(AraAtriCacheEntry(key,loaded,loaded->getMemory()));
+            fIndex[key]=fEntries.begin();
+            fMemoryUsed+=loaded->getMemory();
+            evict();
+            return loaded;
+        }
+
+        void setMemoryLimit(Long64_t bytes)
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fMemoryLimit=bytes;
+            evict();
+        }
+
+        //! Drops every entry, threads still using one keep it alive until they are done
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fEntries.clear();
+            fIndex.clear();
+            fMemoryUsed=0;
+        }
+
+    private:
+        struct AraAtriCacheEntry {
+            AraAtriCacheEntry(Long64_t theKey, std::shared_ptr<const void> theData, Long64_t theBytes) : key(theKey), data(theData), bytes(theBytes) {}
+            Long64_t key;
+            std::shared_ptr<const void> data;
+            Long64_t bytes;
+        };
+
+        //! Needs fMutex. Moves the entry to the front of the list, as the most recently used
+        std::shared_ptr<const void> find(Long64_t key)
+        {
+            std::map<Long64_t, std::list<AraAtriCacheEntry>::iterator>::iterator it=fIndex.find(key);
+            if(it==fIndex.end()) return std::shared_ptr<const void>();
+            fEntries.splice(fEntries.begin(),fEntries,it->second);
+            return it->second->data;
+        }
+
+        //! Needs fMutex
+        void remove(Long64_t key)
+        {
+            std::map<Long64_t, std::list<AraAtriCacheEntry>::iterator>::iterator it=fIndex.find(key);
+            if(it==fIndex.end()) return;
+            fMemoryUsed-=it->second->bytes;
+            fEntries.erase(it->second);
+            fIndex.erase(it);
+        }
+
+        //! Needs fMutex. Drops the least recently used entries until under the limit, always keeping the newest one
+        void evict()
+        {
+            while(fMemoryUsed>fMemoryLimit && fEntries.size()>1) {
+                remove(fEntries.back().key);
+            }
+        }
+
+        std::mutex fMutex; ///< Guards the entries
+        std::mutex fLoadMutex; ///< Held while an entry is loaded
+        std::list<AraAtriCacheEntry> fEntries; ///< Most recently used first
+        std::map<Long64_t, std::list<AraAtriCacheEntry>::iterator> fIndex; ///< The entries by key
+        Long64_t fMemoryLimit; ///< Bytes the entries may use
+        Long64_t fMemoryUsed; ///< Bytes the entries use
+};
+
+//! The steps timed by AraCalibStats
+enum EAraCalibStage {
+    kStageCalibLoad = 0,
+    kStagePedLoad,
+    kStageUnpack,
+    kStageCommonMode,
+    kStageTrimFirstBlock,
+    kStageTiming,
+    kStagePedestal,
+    kStageAdcZeroMean,
+    kStageVoltage,
+    kStageVoltZeroMean,
+    kStageInvert,
+    kStageCableDelay,
+    kStageArena,
+    kStageFused,
+    kStageLazyChannel,
+    kStageBatch,
+    kNumCalibStages
+};
+
+static const char *gCalibStageNames[kNumCalibStages] = {
+    "calib table load", "pedestal load", "unpack", "common mode", "trim first block", "timing selection", "pedestal subtract",
+    "ADC zero mean", "voltage conversion", "volt zero mean", "invert A3 chans", "cable delay", "fill arena",
+    "fused (steps 3-13)", "lazy channel", "batch"
+};
+
+//! Cumulative time and sample counts of the ATRI calibration steps, see AraEventCalibrator::setCollectStats()
+/*!
+    The counters are atomics shared by every thread, so they add up the work of all of them.
+    Events calibrated by FusedCalibration() do all the steps in one pass, so they only show up as the fused stage,
+    setUseFusedCalibration(kFALSE) gives the split between the steps.
+*/
+class AraCalibStats
+{
+    public:
+        AraCalibStats() : fEnabled(false) { reset(); }
+
+        void reset()
+        {
+            for(int stage=0;stage<kNumCalibStages;stage++) {
+                fCalls[stage]=0;
+                fNanoSecs[stage]=0;
+                fSamples[stage]=0;
+            }
+            fEvents=0;
+            fVoltsConvFallbacks=0;
+        }
+
+        void add(EAraCalibStage stage, Long64_t nanoSecs, Long64_t samples)
+        {
+            fCalls[stage].fetch_add(1, std::memory_order_relaxed);
+            fNanoSecs[stage].fetch_add(nanoSecs, std::memory_order_relaxed);
+            fSamples[stage].fetch_add(samples, std::memory_order_relaxed);
+        }
+
+        void print(FILE *fp)
+        {
+            fprintf(fp, "AraEventCalibrator statistics: %lld ATRI events, %lld voltage conversion fallbacks in the loaded tables\n",
+                    (long long)fEvents.load(), (long long)fVoltsConvFallbacks.load());
+            fprintf(fp, "%-20s %10s %12s %12s %14s %10s\n", "stage", "calls", "total ms", "us / call", "samples", "ns / samp");
+            for(int stage=0;stage<kNumCalibStages;stage++) {
+                Long64_t calls=fCalls[stage].load();
+                if(calls==0) continue;
+                Long64_t nanoSecs=fNanoSecs[stage].load();
+                Long64_t samples=fSamples[stage].load();
+                fprintf(fp, "%-20s %10lld %12.3f %12.3f %14lld %10.3f\n", gCalibStageNames[stage], (long long)calls, nanoSecs*1e-6, nanoSecs*1e-3/calls,
+                        (long long)samples, samples ? double(nanoSecs)/samples : 0.0);
+            }
+        }
+
+    std::atomic<bool> fEnabled; ///< Are the statistics collected
+    std::atomic<Long64_t> fCalls[kNumCalibStages]; ///< Number of times each stage ran
+    std::atomic<Long64_t> fNanoSecs[kNumCalibStages]; ///< Wall time spent in each stage
+    std::atomic<Long64_t> fSamples[kNumCalibStages]; ///< Samples in the channels after each stage
+    std::atomic<Long64_t> fEvents; ///< Number of ATRI events calibrated
+    std::atomic<Long64_t> fVoltsConvFallbacks; ///< Samples whose voltage conversion fit was replaced by a neighbour's in the tables loaded, see AraAtriVoltsConvLoader::resolve()
+};
+
+//! Times one stage while it is in scope, if the statistics are switched on
+/*!
+    Given an event, the samples of all its channels are counted at the end of the stage, through the calibrator calibrating it.
+*/
+class AraCalibStageTimer
+{
+    public:
+        AraCalibStageTimer(AraCalibStats *stats, EAraCalibStage stage, AraEventCalibrator *calibrator=NULL, UsefulAtriStationEvent *theEvent=NULL)
+            : fStats(stats->fEnabled.load(std::memory_order_relaxed) ? stats : NULL), fStage(stage), fCalibrator(calibrator), fEvent(theEvent), fSamples(0)
+        {
+            if(fStats) fStart=std::chrono::steady_clock::now();
+        }
+
+        ~AraCalibStageTimer()
+        {
+            if(!fStats) return;
+            Long64_t nanoSecs=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-fStart).count();
+            if(fCalibrator && fEvent) {
+                for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) {
+                    std::vector<Double_t> *volts=fCalibrator->getChanVolts(fEvent,chanId);
+                    if(volts) fSamples+=volts->size();
+                }
+            }
+            fStats->add(fStage, nanoSecs, fSamples);
+        }
+
+        Bool_t isActive() const {return fStats!=NULL;} ///< Are the statistics switched on
+        void setSamples(Long64_t samples) {fSamples=samples;} ///< Number of samples processed, for stages without an event
+
+    private:
+        AraCalibStats *fStats;
+        EAraCalibStage fStage;
+        AraEventCalibrator *fCalibrator;
+        UsefulAtriStationEvent *fEvent;
+        Long64_t fSamples;
+        std::chrono::steady_clock::time_point fStart;
+};
+
+//! The worker threads of AraEventCalibrator::calibrateEvents(), started on the first batch and kept for the following ones
+/*!
+    run() hands the workers a job and does its share in the calling thread. The threads take the next event from a shared counter,
+    so a few slow events do not hold up the others. Batches from several threads take turns using the workers.
+*/
+class AraCalibThreadPool
+{
+    public:
+        AraCalibThreadPool() : fWork(NULL), fNumEvents(0), fNextEvent(0), fJob(0), fFreeSlots(0), fActive(0), fStop(false) {}
+
+        ~AraCalibThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(fMutex);
+                fStop=true;
+            }
+            fJobCond.notify_all();
+            for(size_t thread=0;thread<fThreads.size();thread++) fThreads[thread].join();
+        }
+
+        //! Runs work(0) to work(numEvents-1), spread over numThreads threads (0 for one per core, 1 to do the work in the calling thread)
+        void run(Int_t numEvents, Int_t numThreads, const std::function<void(Int_t)> &work)
+        {
+            if(numThreads==0) numThreads=std::thread::hardware_concurrency();
+            if(numThreads>numEvents) numThreads=numEvents;
+            if(numThreads<=1) {
+                for(Int_t event=0;event<numEvents;event++) work(event);
+                return;
+            }
+            std::lock_guard<std::mutex> runLock(fRunMutex);
+            std::unique_lock<std::mutex> lock(fMutex);
+            // The calling thread is one of the numThreads
+            while((Int_t)fThreads.size()<numThreads-1) fThreads.push_back(std::thread(&AraCalibThreadPool::workerLoop, this));
+            fWork=&work;
+            fNumEvents=numEvents;
+            fNextEvent=0;
+            fFreeSlots=numThreads-1;
+            fJob++;
+            lock.unlock();
+            fJobCond.notify_all();
+            for(Int_t event=fNextEvent++;event<numEvents;event=fNextEvent++) work(event);
+            // Workers that have not picked the job up yet would find no events left, keep them from touching work once we return
+            lock.lock();
+            fFreeSlots=0;
+            fDoneCond.wait(lock, [this]{ return fActive==0; });
+            fWork=NULL;
+        }
+
+    private:
+        void workerLoop()
+        {
+            Long64_t lastJob=0;
+            std::unique_lock<std::mutex> lock(fMutex);
+            while(true) {
+                fJobCond.wait(lock, [&]{ return fStop || fJob!=lastJob; });
+                if(fStop) return;
+                lastJob=fJob;
+                if(fFreeSlots==0) continue;
+                fFreeSlots--;
+                fActive++;
+                const std::function<void(Int_t)> &work=*fWork;
+                Int_t numEvents=fNumEvents;
+                lock.unlock();
+                for(Int_t event=fNextEvent++;event<numEvents;event=fNextEvent++) work(event);
+                lock.lock();
+                fActive--;
+                if(fActive==0) fDoneCond.notify_all();
+            }
+        }
+
+        std::mutex fRunMutex; ///< Held for the whole of run(), one batch at a time
+        std::mutex fMutex; ///< Guards the job below
+        std::condition_variable fJobCond; ///< Wakes the workers for a new job or to stop
+        std::condition_variable fDoneCond; ///< Wakes run() when the last worker is done
+        std::vector<std::thread> fThreads;
+        const std::function<void(Int_t)> *fWork; ///< The work of the current job
+        Int_t fNumEvents; ///< Number of events of the current job
+        std::atomic<Int_t> fNextEvent; ///< The next event to be taken
+        Long64_t fJob; ///< Counts the jobs, so the workers can tell a new one
+        Int_t fFreeSlots; ///< Workers that may still join the current job
+        Int_t fActive; ///< Workers busy with the current job
+        Bool_t fStop; ///< The workers should exit
+};
+
+AraAtriCalibTables::AraAtriCalibTables(AraStationId_t stationId, Int_t epoch)
+    : fStationId(stationId), fEpoch(epoch)
+{
+    memset(fAtriSampleIndex,0,sizeof(fAtriSampleIndex));
+    memset(fAtriSampleTimes,0,sizeof(fAtriSampleTimes));
+    memset(fAtriEpsilonTimes,0,sizeof(fAtriEpsilonTimes));
+    memset(fAtriNumSamples,0,sizeof(fAtriNumSamples));
+    for(int dda=0;dda<DDA_PER_ATRI;dda++)
+        for(int chan=0;chan<RFCHAN_PER_DDA;chan++)
+            fAtriVoltsConvChan[dda][chan]=-1;
+    fAtriHighAdcLimit=400;
+    fAtriAdcOffset=-11.0;
+    fAtriConvStation5=kFALSE;
+    fNumVoltsConvFallbacks=0;
+}
+
+size_t AraAtriCalibTables::getMemory() const
+{
+    return sizeof(AraAtriCalibTables)+fAtriVoltsConv.size()*sizeof(AraAtriVoltsConv);
+}
+
+AraAtriPedestals::AraAtriPedestals(AraStationId_t stationId)
+    : fStationId(stationId), fAtriPeds(NULL), fMapBase(NULL), fMapLength(0)
+{
+    fPedFile[0]=0;
+}
+
+AraAtriPedestals::~AraAtriPedestals()
+{
+    AraAtriPedestalFile::unmapBinary(fMapBase, fMapLength);
+}
+
+AraCalibrationContext::AraCalibrationContext()
+    : sampleList(CHANNELS_PER_ATRI), capArrayList(DDA_PER_ATRI)
+{
+    memset(chanPresent,0,sizeof(chanPresent));
+    memset(ddaChanIndex,0,sizeof(ddaChanIndex));
+    memset(invertChan,0,sizeof(invertChan));
+    memset(clockAlignVals,0,sizeof(clockAlignVals));
+    memset(clockLagVals,0,sizeof(clockLagVals));
+}
+
+void AraCalibrationContext::clearAtriLists()
+{
+    for(size_t i=0;i<sampleList.size();i++) sampleList[i].clear();
+    for(size_t i=0;i<capArrayList.size();i++) capArrayList[i].clear();
+    for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) {
+        chanTimes[chanId].clear();
+        chanVolts[chanId].clear();
+        chanPresent[chanId]=kFALSE;
+    }
+}
+
 ClassImp(AraEventCalibrator);
 
 AraEventCalibrator * AraEventCalibrator::fgInstance=0;
@@ -179,16 +622,70 @@ AraEventCalibrator::AraEventCalibrator()
     // Loop through and set the got ped / calib flags to zero. This assumes stationId's first n elements
     // are for ICRR stations and the remaining N-n are ATRI
     memset(fGotAtriPedFile,0,sizeof(Int_t)*ATRI_NO_STATIONS);
-    memset(fGotAtriCalibFile,0,sizeof(Int_t)*ATRI_NO_STATIONS);
     memset(gotIcrrPedFile,0,sizeof(Int_t)*ICRR_NO_STATIONS);
     memset(gotIcrrCalibFile,0,sizeof(Int_t)*ICRR_NO_STATIONS);
-    fAtriPeds=0;
+    fTableLock=new AraCalibTableLock();
+    fUseFusedCalibration=kTRUE;
+
+    // The Atri tables of several stations / epochs can stay in memory, ARA_CALIB_CACHE_MB sets how much they may use
+    fAtriCache=new AraAtriCalibCache();
+    char *cacheEnv=getenv("ARA_CALIB_CACHE_MB");
+    if(cacheEnv) fAtriCache->setMemoryLimit(atol(cacheEnv)*1024LL*1024LL);
+
+    // ARA_CALIB_STATS=1 times the calibration steps and prints the summary when the program exits
+    fStats=new AraCalibStats();
+    char *statsEnv=getenv("ARA_CALIB_STATS");
+    if(statsEnv && atoi(statsEnv)>0) {
+        fStats->fEnabled=true;
+        atexit(printStatsAtExit);
+    }
+
+    // The threads of calibrateEvents() are started on first use
+    fThreadPool=new AraCalibThreadPool();
 
 
 }
 
 AraEventCalibrator::~AraEventCalibrator() {
     // Default Destructor
+    delete fTableLock;
+    delete fAtriCache;
+    delete fStats;
+    delete fThreadPool;
+}
+
+void AraEventCalibrator::printStatsAtExit()
+{
+    if(fgInstance) fgInstance->printStats(stderr);
+}
+
+//! Switches the timing of the calibration steps on or off
+/*!
+    The statistics can also be switched on with the environment variable ARA_CALIB_STATS=1, which also prints them when the program exits.
+    \param collect kTRUE to collect the statistics
+*/
+void AraEventCalibrator::setCollectStats(Bool_t collect)
+{
+    fStats->fEnabled=collect;
+}
+
+Bool_t AraEventCalibrator::getCollectStats()
+{
+    return fStats->fEnabled.load();
+}
+
+//! Prints the time spent in each calibration step, the samples processed and the table loads
+/*!
+    \param fp where to print, stdout by default
+*/
+void AraEventCalibrator::printStats(FILE *fp)
+{
+    fStats->print(fp ? fp : stdout);
+}
+
+void AraEventCalibrator::resetStats()
+{
+    fStats->reset();
 }
 
 AraEventCalibrator*  AraEventCalibrator::Instance()
@@ -196,6 +693,8 @@ AraEventCalibrator*  AraEventCalibrator::Instance()
     
     // printf("AraEventCalibrator::Instance() creating an instance of the calibrator\n");
     // static function
+    static std::mutex instanceMutex;
+    std::lock_guard<std::mutex> lock(instanceMutex);
     if(fgInstance)
         return fgInstance;
 
@@ -204,6 +703,12 @@ AraEventCalibrator*  AraEventCalibrator::Instance()
     return fgInstance;
 }
 
+AraCalibrationContext *AraEventCalibrator::getContext()
+{
+    static thread_local AraCalibrationContext context;
+    return &context;
+}
+
 
 void AraEventCalibrator::setPedFile(char fileName[], AraStationId_t stationId)
 {
@@ -222,7 +727,7 @@ void AraEventCalibrator::setPedFile(char fileName[], AraStationId_t stationId)
         fprintf(stderr, "AraEventCalibrator::setPedFile() -- not ICRR station, stationId %d\n", stationId);
         return;
     }
-    loadIcrrPedestals(stationId);
+    fTableLock->runExclusive([&]{ loadIcrrPedestals(stationId); });
 }
 
 void AraEventCalibrator::loadIcrrPedestals(AraStationId_t stationId)
@@ -356,6 +861,13 @@ int AraEventCalibrator::doBinCalibration(UsefulIcrrStationEvent *theEvent, int c
     char hbextra = (theEvent->chan[chanIndex].chipIdFlag&0xf0)>>4;
     short hbstart=theEvent->chan[chanIndex].firstHitbus;
     short hbend=theEvent->chan[chanIndex].lastHitbus+hbextra;
+    AraCalibrationContext *ctx=getContext();
+    double *rawadc=ctx->rawadc;
+    double *calwv=ctx->calwv;
+    double *pedsubadc=ctx->pedsubadc;
+    double *tempTimeNums=ctx->tempTimeNums;
+    int *indexNums=ctx->indexNums;
+    double *v=ctx->v;
  
     double calTime=0;
     for(int samp=0;samp<MAX_NUMBER_SAMPLES_LAB3;++samp){
@@ -420,8 +932,8 @@ int AraEventCalibrator::doBinCalibration(UsefulIcrrStationEvent *theEvent, int c
     
     // Now we just have to make sure the times are monotonically increasing
     for(int i=0;i<MAX_NUMBER_SAMPLES_LAB3;i++) {
-        calTimeNums[i]=tempTimeNums[indexNums[i]];
-        calVoltNums[i]=v[indexNums[i]];
+        ctx->calTimeNums[i]=tempTimeNums[indexNums[i]];
+        ctx->calVoltNums[i]=v[indexNums[i]];
         // std::cout << i << "\t" << indexNums[i] << "\t" << calTimeNums[i] << "\t" << calVoltNums[i] << "\n";
     }
     return numValid;
@@ -432,13 +944,22 @@ void AraEventCalibrator::calibrateEvent(UsefulIcrrStationEvent *theEvent, AraCal
 {
 
     AraStationId_t stationId=theEvent->stationId;
-    if(gotIcrrPedFile[stationId]==0){
-        loadIcrrPedestals(stationId); //This will only load the pedestals once
-    }
-    
-    if(gotIcrrCalibFile[stationId]==0){
-        loadIcrrCalib(stationId); //This will only load the calib values once
-    }
+    fTableLock->lockShared([&]{ return gotIcrrPedFile[stationId]==0 || gotIcrrCalibFile[stationId]==0; },
+                           [&]{
+                               if(gotIcrrPedFile[stationId]==0){
+                                   loadIcrrPedestals(stationId); //This will only load the pedestals once
+                               }
+                               if(gotIcrrCalibFile[stationId]==0){
+                                   loadIcrrCalib(stationId); //This will only load the calib values once
+                               }
+                           });
+    AraCalibTableReadGuard tableGuard(fTableLock);
+    AraCalibrationContext *ctx=getContext();
+    double *sampNums=ctx->sampNums;
+    double *timeNums=ctx->timeNums;
+    double *rawadc=ctx->rawadc;
+    double *pedsubadc=ctx->pedsubadc;
+    double *v=ctx->v;
 
     if(AraCalType::hasBinWidthCalib(calType))
         theEvent->guessRCO(0); //Forces the calculation of the RCO phase from the clock
@@ -505,9 +1026,9 @@ void AraEventCalibrator::calibrateEvent(UsefulIcrrStationEvent *theEvent, AraCal
             //Almost always want this
             theEvent->fNumPoints[chanIndex]=numValid;
             for(int samp=0;samp<MAX_NUMBER_SAMPLES_LAB3;samp++) {
-                theEvent->fTimes[chanIndex][samp]=calTimeNums[samp];
+                theEvent->fTimes[chanIndex][samp]=ctx->calTimeNums[samp];
                 if(samp<numValid) {
-                    theEvent->fVolts[chanIndex][samp]=calVoltNums[samp];
+                    theEvent->fVolts[chanIndex][samp]=ctx->calVoltNums[samp];
                 }
                 else {
                     theEvent->fVolts[chanIndex][samp]=0;
@@ -524,7 +1045,7 @@ void AraEventCalibrator::calibrateEvent(UsefulIcrrStationEvent *theEvent, AraCal
         for(int  chanIndex = 0; chanIndex < NUM_DIGITIZED_ICRR_CHANNELS; ++chanIndex ){
             int nChip=theEvent->chan[chanIndex].chanId/CHANNELS_PER_LAB3;
             for(int samp=0;samp<MAX_NUMBER_SAMPLES_LAB3;samp++) {
-                theEvent->fTimes[chanIndex][samp]+=clockAlignVals[stationId][nChip];
+                theEvent->fTimes[chanIndex][samp]+=ctx->clockAlignVals[nChip];
             }
         }
     }
@@ -738,29 +1259,29 @@ void AraEventCalibrator::loadIcrrCalib(AraStationId_t stationId)
 
 void AraEventCalibrator::calcClockAlignVals(UsefulIcrrStationEvent *theEvent, AraCalType::AraCalType_t calType)
 {
-    AraStationId_t stationId=theEvent->stationId;
-
     if(!AraCalType::hasClockAlignment(calType)) return;
+    AraCalibrationContext *ctx=getContext();
+    double *clockAlignVals=ctx->clockAlignVals;
     TGraph *grClock[LAB3_PER_ICRR]={0};
     Double_t lag[LAB3_PER_ICRR]={0};
     for(int chip=0;chip<LAB3_PER_ICRR;chip++) {
-        clockAlignVals[stationId][chip]=0;    
+        clockAlignVals[chip]=0;    
         int chanIndex=ICRR1_CLOCK_CHANNEL+CHANNELS_PER_LAB3*chip; 
         grClock[chip]=theEvent->getGraphFromElecChan(chanIndex);
         lag[chip]=estimateClockLag(grClock[chip]);
-        clockLagVals[stationId][chip]=lag[chip];
+        ctx->clockLagVals[chip]=lag[chip];
         delete grClock[chip];
 
         if(chip>0) {
             // Then can actually do some alignment
-            clockAlignVals[stationId][chip]=lag[0]-lag[chip];
+            clockAlignVals[chip]=lag[0]-lag[chip];
             // The below fudge factors were "tuned" using pulser data 
             // to try and remove period ambiguities resulting from wrong cycle lag
             // jpd -- updated the fudge factors to remove 1e-3 failures in 
             if(lag[chip]<8.5 && lag[0]>8.5) 
-                clockAlignVals[stationId][chip]-=25;
+                clockAlignVals[chip]-=25;
             if(lag[chip]>8.5 && lag[0]<8.5) 
-                clockAlignVals[stationId][chip]+=25;
+                clockAlignVals[chip]+=25;
             // std::cout << "clockAlignVals[ " << chip << "] = " << clockAlignVals[chip] << "\n";
         }
     }
@@ -861,6 +1382,9 @@ Double_t AraEventCalibrator::estimateClockPeriod(Int_t numPoints, Double_t &rms)
 {
     // This funciton estimates the period by just using all the negative-positive zero crossing
     if(numPoints<3) return 0;
+    AraCalibrationContext *ctx=getContext();
+    double *calVoltNums=ctx->calVoltNums;
+    double *calTimeNums=ctx->calTimeNums;
     Double_t mean=0;
     Double_t vVals[MAX_NUMBER_SAMPLES_LAB3]={0};
     for(int i=0;i<numPoints;i++) {
@@ -920,27 +1444,41 @@ void AraEventCalibrator::calibrateEvent(UsefulAtriStationEvent *theEvent, AraCal
     //! 1st step. Configures basic information (station id, unixtime) and arrays (time,volt, sample index, etc.)
     AraStationId_t thisStationId = theEvent->stationId;
     Double_t unixtime = theEvent->unixTime; ///< The unixtime line was added by UAL 01/26/2019.
-    std::map< Int_t, std::vector <Double_t> >::iterator timeMapIt;
-    std::map< Int_t, std::vector <Double_t> >::iterator voltMapIt;
-    std::vector<std::vector<int> > *sampleList = new std::vector<std::vector<int> >(CHANNELS_PER_ATRI, std::vector<int>(0)); ///< pointer for WF sample numbers
-    std::vector<std::vector<int> > *capArrayList = new std::vector<std::vector<int> >(DDA_PER_ATRI, std::vector<int>(0)); ///< pointer for 'block number' modulo 2
+    AraCalibrationContext *ctx = getContext(); ///< Per-thread scratch, so several threads can calibrate at once
+    ctx->clearAtriLists();
+    std::vector<std::vector<int> > *sampleList = &(ctx->sampleList); ///< pointer for WF sample numbers
+    std::vector<std::vector<int> > *capArrayList = &(ctx->capArrayList); ///< pointer for 'block number' modulo 2
     Bool_t hasTrimFirstBlk = false;
     Bool_t hasTimingCalib = false; 
 
     //! 2nd step. Loads Tables (Pedestal, Conversion factor, Sample timing) 
-    Int_t calibIndex = AraGeomTool::getStationCalibIndex(thisStationId);
-    //! RJN debug
-    // std::cout << "Station Id fun: " << (int)thisStationId << "\t" << calibIndex << "\n";
-    //! Only load the pedestals / calib if they are not already loaded
-    if(fGotAtriCalibFile[calibIndex]==0){
-        loadAtriCalib(thisStationId, unixtime); ///< Adds unix time to select the new timing table for A3 2019 data. MK added 08-02-2022
+    //! The tables come from the cache, which only reads them from disk the first time a station / epoch is seen
+    //! The context holds on to them until the next event, so they can not be dropped while this event uses them
+    ctx->atriCalib=getAtriCalibTables(thisStationId, unixtime); ///< Adds unix time to select the new timing table for A3 2019 data. MK added 08-02-2022
+    ctx->atriPeds=getAtriPedestals(thisStationId);
+    if(fStats->fEnabled.load(std::memory_order_relaxed)) fStats->fEvents.fetch_add(1, std::memory_order_relaxed);
+    if(!ctx->atriCalib || !ctx->atriPeds) {
+        fprintf(stderr, "AraEventCalibrator::calibrateEvent -- ERROR No calibration for stationId %i\n", thisStationId);
+        return;
     }
-    if(fGotAtriPedFile[calibIndex]==0){
-        loadAtriPedestals(thisStationId);
+
+    //! The common calibration types do steps 3 to 13 in a single pass over the raw blocks
+    if(fUseFusedCalibration && SetupFusedCalibration(theEvent, calType)) {
+        //! Events in lazy mode only have their channels calibrated when they are asked for, see CalibrateLazyChannel()
+        if(theEvent->fLazyCalibration && !theEvent->fUseArena) {
+            SetupLazyCalibration(theEvent, calType);
+            return;
+        }
+        AraCalibStageTimer timer(fStats, kStageFused, this, theEvent);
+        FusedCalibration(theEvent, calType, unixtime, thisStationId);
+        return;
     }
 
     //! 3rd step. Converts DAQ data format to Electronic channel format
-    UnpackDAQFormatToElecChanFormat(theEvent, voltMapIt, timeMapIt, sampleList, capArrayList);
+    {
+        AraCalibStageTimer timer(fStats, kStageUnpack, this, theEvent);
+        UnpackDAQFormatToElecChanFormat(theEvent, sampleList, capArrayList);
+    }
 
     /*! 
 	4th step. Common mode
@@ -950,7 +1488,8 @@ void AraEventCalibrator::calibrateEvent(UsefulAtriStationEvent *theEvent, AraCal
 	It is placed before TrimFirstBlock() and TimingCalibrationAndBadSampleReomval()
     */
     if(hasCommonMode(calType)) {
-        CommonMode(theEvent, voltMapIt);
+        AraCalibStageTimer timer(fStats, kStageCommonMode, this, theEvent);
+        CommonMode(theEvent);
     }
 
     /*!
@@ -961,18 +1500,21 @@ void AraEventCalibrator::calibrateEvent(UsefulAtriStationEvent *theEvent, AraCal
     //! 5th step. Erase first block that currupted by trigger
     //! Apply conditioner function here
     if(hasTrimFirstBlock(calType)) {
-        hasTrimFirstBlk = TrimFirstBlock(theEvent, voltMapIt, timeMapIt, sampleList, capArrayList, hasTimingCalib);
+        AraCalibStageTimer timer(fStats, kStageTrimFirstBlock, this, theEvent);
+        hasTrimFirstBlk = TrimFirstBlock(theEvent, sampleList, capArrayList, hasTimingCalib);
     }
 
     //! 6th step. Timing calibration and bad sample removal
     //! This step calibrates the time of each sample and only selecting the samples that have good performance
     if(hasBinWidthCalib(calType)){ 
-        hasTimingCalib = TimingCalibrationAndBadSampleReomval(theEvent, voltMapIt, timeMapIt, sampleList, capArrayList, hasTrimFirstBlk);    
+        AraCalibStageTimer timer(fStats, kStageTiming, this, theEvent);
+        hasTimingCalib = TimingCalibrationAndBadSampleReomval(theEvent, sampleList, capArrayList, hasTrimFirstBlk);    
     }
     
     //! 7th step. Pedestal subtraction
     if(hasPedestalSubtraction(calType)) {
-        PedestalSubtraction(theEvent, voltMapIt, sampleList, calType);
+        AraCalibStageTimer timer(fStats, kStagePedestal, this, theEvent);
+        PedestalSubtraction(theEvent, sampleList, calType);
     }
     
     /*!
@@ -1003,12 +1545,14 @@ void AraEventCalibrator::calibrateEvent(UsefulAtriStationEvent *theEvent, AraCal
         In the future, we might need to check whether A5 also has outlier event or not
     */
     if(hasADCZeroMean(calType) && thisStationId != 5) {
-        ApplyZeroMean(theEvent, voltMapIt, capArrayList, hasTrimFirstBlk, hasTimingCalib);
+        AraCalibStageTimer timer(fStats, kStageAdcZeroMean, this, theEvent);
+        ApplyZeroMean(theEvent, capArrayList, hasTrimFirstBlk, hasTimingCalib);
     }
 
     //! 9th step. Voltage calibration
     if(hasVoltCal(calType)) {
-        VoltageCalibration(theEvent, voltMapIt, sampleList, thisStationId);
+        AraCalibStageTimer timer(fStats, kStageVoltage, this, theEvent);
+        VoltageCalibration(theEvent, sampleList, thisStationId);
     }
    
     /*! 
@@ -1021,43 +1565,575 @@ void AraEventCalibrator::calibrateEvent(UsefulAtriStationEvent *theEvent, AraCal
         In the future, we might need to perform recalibration to get a better conversion factor
     */
     if(hasVoltZeroMean(calType)) {
-        ApplyZeroMean(theEvent, voltMapIt, capArrayList, hasTrimFirstBlk, hasTimingCalib);
+        AraCalibStageTimer timer(fStats, kStageVoltZeroMean, this, theEvent);
+        ApplyZeroMean(theEvent, capArrayList, hasTrimFirstBlk, hasTimingCalib);
     }
 
     //! 11th step. Inverts only RF channels = 0,4,8 in A3
     //! Apply conditioner function here
     if (hasInvertA3Chans(calType) && thisStationId ==3) {
-        InvertA3Chans(theEvent, voltMapIt, thisStationId);
+        AraCalibStageTimer timer(fStats, kStageInvert, this, theEvent);
+        InvertA3Chans(theEvent, thisStationId);
     }
 
     //! 12th step. Remove knwon cable delay
     //! jpd change 25-03-13
     //! now subtract off the cable delays
     if(hasCableDelays(calType)){
-        ApplyCableDelay(theEvent, timeMapIt, unixtime, thisStationId);
+        AraCalibStageTimer timer(fStats, kStageCableDelay, this, theEvent);
+        ApplyCableDelay(theEvent, unixtime, thisStationId);
+    }
+
+    //! 13th step. Events using the dense arena get their calibrated channels packed into it
+    if(theEvent->fUseArena) {
+        AraCalibStageTimer timer(fStats, kStageArena, this, theEvent);
+        FillWaveformArena(theEvent);
     }
-    delete sampleList, capArrayList; ///< delete the pointer
 
     // fprintf(stderr, "AraEventCalibrator::CalibrateEvent() -- finished calibrating event\n");//DEBUG                        
 }
 
+//! Calibrates a batch of ATRI events into one output arena
+/*!
+    The batch is meant to hold events of one station and calibration epoch, whose tables are looked up once for the whole batch.
+    These events go through FusedCalibrateChannel() straight into the batch arena, without building a UsefulAtriStationEvent.
+    Any other event, and any event FusedCalibration() does not handle, is calibrated by calibrateEvent() through a UsefulAtriStationEvent and copied in,
+    so the samples are always the same as the ones of a UsefulAtriStationEvent.
+    The events are first counted, then the arena is laid out and then they are calibrated, both passes spread over numThreads threads.
+    \param numEvents number of events
+    \param rawEvents the raw events, they are not modified
+    \param batch filled with the calibrated events, in the same order
+    \param calType the calibration type
+    \param numThreads number of threads, 0 for one per core, 1 to calibrate in the calling thread
+    \return void
+*/
+void AraEventCalibrator::calibrateEvents(Int_t numEvents, RawAtriStationEvent **rawEvents, AraAtriCalibratedBatch *batch, AraCalType::AraCalType_t calType, Int_t numThreads)
+{
+    std::vector<AraAtriEventView> events(numEvents>0 ? numEvents : 0);
+    for(Int_t event=0;event<numEvents;event++) events[event].setEvent(rawEvents[event]);
+    calibrateEventViews(numEvents, events.data(), rawEvents, batch, calType, numThreads);
+}
+
+//! Calibrates a batch of views of ATRI events into one output arena
+/*!
+    The same as calibrateEvents() for RawAtriStationEvent, the samples are read where the views point, for example in a mapped AraAtriWaveformFile.
+    Only the odd event the fused path does not handle is copied into a RawAtriStationEvent, see AraAtriEventView::makeRawEvent().
+    \param numEvents number of events
+    \param events the views of the events
+    \param batch filled with the calibrated events, in the same order
+    \param calType the calibration type
+    \param numThreads number of threads, 0 for one per core, 1 to calibrate in the calling thread
+    \return void
+*/
+void AraEventCalibrator::calibrateEvents(Int_t numEvents, const AraAtriEventView *events, AraAtriCalibratedBatch *batch, AraCalType::AraCalType_t calType, Int_t numThreads)
+{
+    calibrateEventViews(numEvents, events, NULL, batch, calType, numThreads);
+}
+
+/*!
+    \param numEvents number of events
+    \param events the views of the events
+    \param rawEvents the events the views are of, used for the fallback, or NULL
+    \param batch filled with the calibrated events, in the same order
+    \param calType the calibration type
+    \param numThreads number of threads, 0 for one per core, 1 to calibrate in the calling thread
+    \return void
+*/
+void AraEventCalibrator::calibrateEventViews(Int_t numEvents, const AraAtriEventView *events, RawAtriStationEvent **rawEvents, AraAtriCalibratedBatch *batch, AraCalType::AraCalType_t calType, Int_t numThreads)
+{
+    batch->fNumEvents=numEvents;
+    batch->fOffset.resize(numEvents*CHANNELS_PER_ATRI);
+    batch->fLength.resize(numEvents*CHANNELS_PER_ATRI);
+    batch->fNumChannels.resize(numEvents);
+    if(numEvents<=0) return;
+    AraCalibStageTimer timer(fStats, kStageBatch);
+
+    //! The tables of the batch, taken from the first event
+    AraStationId_t batchStationId=events[0].getStationId();
+    Int_t batchEpoch=getAtriCalibEpoch(batchStationId, events[0].getUnixTime());
+    std::shared_ptr<const AraAtriCalibTables> batchCalib=getAtriCalibTables(batchStationId, events[0].getUnixTime());
+    std::shared_ptr<const AraAtriPedestals> batchPeds=getAtriPedestals(batchStationId);
+    Bool_t useFused=fUseFusedCalibration && batchCalib && batchPeds;
+
+    //! Events that can not be calibrated straight into the arena, only used for the odd event
+    std::vector<UsefulAtriStationEvent*> fallback(numEvents, (UsefulAtriStationEvent*)NULL);
+
+    //! Sets up an event of the batch for FusedCalibrateChannel() in this thread, kFALSE if it needs the fallback
+    auto setupEvent = [&](Int_t event) -> Bool_t {
+        const AraAtriEventView &theEvent=events[event];
+        if(!useFused || theEvent.getStationId()!=batchStationId || getAtriCalibEpoch(theEvent.getStationId(), theEvent.getUnixTime())!=batchEpoch) return kFALSE;
+        AraCalibrationContext *ctx=getContext();
+        if(ctx->atriCalib!=batchCalib) ctx->atriCalib=batchCalib;
+        if(ctx->atriPeds!=batchPeds) ctx->atriPeds=batchPeds;
+        return SetupFusedCalibration(theEvent, calType);
+    };
+
+    //! First pass: the number of samples of each channel
+    fThreadPool->run(numEvents, numThreads, [&](Int_t event) {
+        Int_t *length=&(batch->fLength[event*CHANNELS_PER_ATRI]);
+        if(setupEvent(event)) {
+            Int_t numOut[CHANNELS_PER_ATRI];
+            batch->fNumChannels[event]=CountFusedSamples(calType, numOut);
+            for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) length[chanId]=numOut[chanId]>0 ? numOut[chanId] : 0;
+            return;
+        }
+        RawAtriStationEvent *rawEvent=rawEvents ? rawEvents[event] : events[event].makeRawEvent();
+        fallback[event]=new UsefulAtriStationEvent(rawEvent, calType, kTRUE);
+        if(!rawEvents) delete rawEvent;
+        batch->fNumChannels[event]=fallback[event]->fNumChannels;
+        for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) length[chanId]=fallback[event]->fArenaLength[chanId];
+    });
+
+    //! Lay out the arena
+    Long64_t numSamples=0;
+    for(Int_t index=0;index<numEvents*CHANNELS_PER_ATRI;index++) {
+        batch->fOffset[index]=numSamples;
+        numSamples+=batch->fLength[index];
+    }
+    batch->fTimes.resize(numSamples);
+    batch->fVolts.resize(numSamples);
+    timer.setSamples(numSamples);
+    if(timer.isActive()) fStats->fEvents.fetch_add(numEvents, std::memory_order_relaxed);
+
+    //! Second pass: calibrate into the arena
+    fThreadPool->run(numEvents, numThreads, [&](Int_t event) {
+        Long64_t *offset=&(batch->fOffset[event*CHANNELS_PER_ATRI]);
+        Int_t *length=&(batch->fLength[event*CHANNELS_PER_ATRI]);
+        if(fallback[event]) {
+            UsefulAtriStationEvent *theEvent=fallback[event];
+            if(!theEvent->fArenaTimes.empty()) {
+                std::copy(theEvent->fArenaTimes.begin(),theEvent->fArenaTimes.end(),batch->fTimes.begin()+offset[0]);
+                std::copy(theEvent->fArenaVolts.begin(),theEvent->fArenaVolts.end(),batch->fVolts.begin()+offset[0]);
+            }
+            delete theEvent;
+            fallback[event]=NULL;
+            return;
+        }
+        setupEvent(event);
+        SetupFusedCorrections(calType, events[event].getUnixTime(), batchStationId);
+        for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) {
+            if(length[chanId]==0) continue;
+            FusedCalibrateChannel(calType, batchStationId, chanId, length[chanId], &(batch->fTimes[offset[chanId]]), &(batch->fVolts[offset[chanId]]));
+        }
+    });
+}
+
+//! The voltages of an electronics channel being calibrated
+/*!
+    Events using the dense arena are calibrated in the per-thread context, all other events in their fVolts map
+    \param theEvent the useful atri event pointer
+    \param chanId the electronics channel
+    \return pointer to the voltages, NULL if the channel was not read out
+*/
+std::vector<Double_t> *AraEventCalibrator::getChanVolts(UsefulAtriStationEvent *theEvent, Int_t chanId)
+{
+    if(theEvent->fUseArena) {
+        AraCalibrationContext *ctx = getContext();
+        if(chanId<0 || chanId>=CHANNELS_PER_ATRI) return NULL;
+        return ctx->chanPresent[chanId] ? &(ctx->chanVolts[chanId]) : NULL;
+    }
+    std::map< Int_t, std::vector <Double_t> >::iterator voltMapIt=theEvent->fVolts.find(chanId);
+    if(voltMapIt==theEvent->fVolts.end()) return NULL;
+    return &(voltMapIt->second);
+}
+
+//! The times of an electronics channel being calibrated
+/*!
+    \param theEvent the useful atri event pointer
+    \param chanId the electronics channel
+    \return pointer to the times, NULL if the channel was not read out
+*/
+std::vector<Double_t> *AraEventCalibrator::getChanTimes(UsefulAtriStationEvent *theEvent, Int_t chanId)
+{
+    if(theEvent->fUseArena) {
+        AraCalibrationContext *ctx = getContext();
+        if(chanId<0 || chanId>=CHANNELS_PER_ATRI) return NULL;
+        return ctx->chanPresent[chanId] ? &(ctx->chanTimes[chanId]) : NULL;
+    }
+    std::map< Int_t, std::vector <Double_t> >::iterator timeMapIt=theEvent->fTimes.find(chanId);
+    if(timeMapIt==theEvent->fTimes.end()) return NULL;
+    return &(timeMapIt->second);
+}
+
+//! Packs the calibrated channels into the event's dense arena
+/*!
+    The channels are laid out one after the other in electronics channel order.
+    The arena vectors keep their capacity, so an event object that is recalibrated does not allocate again.
+    \param theEvent the useful atri event pointer
+    \return void
+*/
+void AraEventCalibrator::FillWaveformArena(UsefulAtriStationEvent *theEvent)
+{
+    AraCalibrationContext *ctx = getContext();
+    Int_t numSamples=0;
+    for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) {
+        theEvent->fArenaOffset[chanId]=numSamples;
+        theEvent->fArenaLength[chanId]=ctx->chanPresent[chanId] ? ctx->chanVolts[chanId].size() : 0;
+        numSamples+=theEvent->fArenaLength[chanId];
+    }
+    theEvent->fArenaTimes.resize(numSamples);
+    theEvent->fArenaVolts.resize(numSamples);
+    for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) {
+        if(theEvent->fArenaLength[chanId]==0) continue;
+        std::copy(ctx->chanTimes[chanId].begin(),ctx->chanTimes[chanId].end(),theEvent->fArenaTimes.begin()+theEvent->fArenaOffset[chanId]);
+        std::copy(ctx->chanVolts[chanId].begin(),ctx->chanVolts[chanId].end(),theEvent->fArenaVolts.begin()+theEvent->fArenaOffset[chanId]);
+    }
+}
+
+//! Checks whether FusedCalibration() can calibrate an event
+/*!
+    FusedCalibration() covers the calibration types that trim the first block and subtract the pedestals, with or without the timing calibration.
+    It also needs every dda to have read out at least two blocks with the same channels, as the step by step path assumes this as well.
+    Anything else goes through the step by step path, which stays the reference.
+    \param theEvent the useful atri event pointer
+    \param calType the calibration type
+    \return boolean True: the event can be calibrated by FusedCalibration(), False: use the step by step path
+*/
+Bool_t AraEventCalibrator::SetupFusedCalibration(RawAtriStationEvent *theEvent, AraCalType::AraCalType_t calType)
+{
+    AraCalibrationContext *ctx = getContext();
+    ctx->eventView.setEvent(theEvent);
+    return SetupFusedCalibration(ctx->eventView, calType);
+}
+
+/*!
+    \param theEvent the view of the event, its blocks are used until the event has been calibrated
+    \param calType the calibration type
+    \return boolean True: the event can be calibrated by FusedCalibrateChannel(), False: use the step by step path
+*/
+Bool_t AraEventCalibrator::SetupFusedCalibration(const AraAtriEventView &theEvent, AraCalType::AraCalType_t calType)
+{
+    if(!hasTrimFirstBlock(calType) || !hasPedestalSubtraction(calType) || hasCommonMode(calType)) return false;
+    if(calType==AraCalType::kOnlyPed
+        || calType==AraCalType::kOnlyPedWithOut1stBlock
+        || calType==AraCalType::kOnlyPedWithOut1stBlockAndBadSamples) return false;
+
+    AraCalibrationContext *ctx = getContext();
+    for(int dda=0;dda<DDA_PER_ATRI;dda++) ctx->ddaBlocks[dda].clear();
+
+    for(size_t blk=0;blk<theEvent.blocks.size();blk++) {
+        const AraAtriBlockView &block=theEvent.blocks[blk];
+        Int_t dda=block.getDda();
+        if(!ctx->ddaBlocks[dda].empty() && ctx->ddaBlocks[dda][0].channelMask!=block.channelMask) return false;
+        ctx->ddaBlocks[dda].push_back(block);
+    }
+
+    for(int dda=0;dda<DDA_PER_ATRI;dda++) {
+        if(ctx->ddaBlocks[dda].size()<2) return false;
+        Int_t numChans=0;
+        for(Int_t chan=0;chan<RFCHAN_PER_DDA;chan++) {
+            if((ctx->ddaBlocks[dda][0].channelMask)&(1<<chan)) ctx->ddaChanIndex[dda][chan]=numChans++;
+            else ctx->ddaChanIndex[dda][chan]=-1;
+        }
+        if(numChans!=ctx->ddaBlocks[dda][0].getNumChannels()) return false;
+    }
+    return true;
+}
+
+//! Prepares an event for lazy calibration, no channel is calibrated yet
+/*!
+    Only events that FusedCalibration() can calibrate are calibrated lazily. Its steps work on each channel on its own,
+    and the one decision taken for all the ddas, trimming the first block, is always taken when SetupFusedCalibration() accepts the event.
+    So calibrating the channels one at a time gives the same samples as calibrating them all at once.
+    The tables, the blocks of each dda and the corrections are looked up here, once, and kept in the event's fLazySetup.
+    \param theEvent the useful atri event pointer, already accepted by SetupFusedCalibration()
+    \param calType the calibration type
+    \return void
+*/
+void AraEventCalibrator::SetupLazyCalibration(UsefulAtriStationEvent *theEvent, AraCalType::AraCalType_t calType)
+{
+    AraCalibrationContext *ctx = getContext();
+    AraAtriLazyCalibration &setup = theEvent->fLazySetup;
+    SetupFusedCorrections(calType, theEvent->unixTime, theEvent->stationId);
+    theEvent->fNumChannels=CountFusedSamples(calType, setup.numOut);
+    theEvent->fLazyCalType=calType;
+    theEvent->fLazyChanMask=0;
+    for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) {
+        if(setup.numOut[chanId]>=0) theEvent->fLazyChanMask|=(1u<<chanId);
+    }
+
+    //! The vectors keep their capacity, so an event that is recalibrated over and over stops allocating here
+    setup.atriCalib=ctx->atriCalib;
+    setup.atriPeds=ctx->atriPeds;
+    setup.blockBase=theEvent->blockVec.empty() ? 0 : &(theEvent->blockVec[0]);
+    for(int dda=0;dda<DDA_PER_ATRI;dda++) setup.ddaBlocks[dda]=ctx->ddaBlocks[dda];
+    memcpy(setup.ddaChanIndex,ctx->ddaChanIndex,sizeof(setup.ddaChanIndex));
+    for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) setup.cableDelays[chanId]=ctx->cableDelays[chanId];
+    memcpy(setup.invertChan,ctx->invertChan,sizeof(setup.invertChan));
+}
+
+//! Calibrates one channel of an event prepared by SetupLazyCalibration()
+/*!
+    Called by UsefulAtriStationEvent the first time a channel is accessed, the result is kept in the event's fTimes / fVolts.
+    The event's setup is swapped into this thread's context for FusedCalibrateChannel() and back out again, nothing is looked up.
+    \param theEvent the useful atri event pointer
+    \param chanId the electronics channel
+    \return void
+*/
+void AraEventCalibrator::CalibrateLazyChannel(UsefulAtriStationEvent *theEvent, Int_t chanId)
+{
+    if(chanId<0 || chanId>=CHANNELS_PER_ATRI || !(theEvent->fLazyChanMask&(1u<<chanId))) return;
+    theEvent->fLazyChanMask&=~(1u<<chanId);
+
+    AraCalibStageTimer timer(fStats, kStageLazyChannel);
+    AraAtriLazyCalibration &setup = theEvent->fLazySetup;
+    AraCalType::AraCalType_t calType = (AraCalType::AraCalType_t)theEvent->fLazyCalType;
+    AraCalibrationContext *ctx = getContext();
+    //! A copied event still has the views of the blocks it was copied from, so they are set up again from its own
+    if(setup.blockBase!=(theEvent->blockVec.empty() ? 0 : &(theEvent->blockVec[0]))) {
+        SetupFusedCalibration(theEvent, calType);
+        setup.blockBase=theEvent->blockVec.empty() ? 0 : &(theEvent->blockVec[0]);
+        for(int dda=0;dda<DDA_PER_ATRI;dda++) setup.ddaBlocks[dda]=ctx->ddaBlocks[dda];
+    }
+
+    Int_t dda=chanId/RFCHAN_PER_DDA;
+    ctx->atriCalib=setup.atriCalib;
+    ctx->atriPeds=setup.atriPeds;
+    ctx->ddaBlocks[dda].swap(setup.ddaBlocks[dda]);
+    memcpy(ctx->ddaChanIndex,setup.ddaChanIndex,sizeof(ctx->ddaChanIndex));
+    ctx->cableDelays[chanId].swap(setup.cableDelays[chanId]);
+    ctx->invertChan[chanId]=setup.invertChan[chanId];
+
+    Int_t numPoints=setup.numOut[chanId];
+    theEvent->fTimes[chanId].resize(numPoints);
+    theEvent->fVolts[chanId].resize(numPoints);
+    if(numPoints>0) FusedCalibrateChannel(calType, theEvent->stationId, chanId, numPoints, theEvent->fTimes[chanId].data(), theEvent->fVolts[chanId].data());
+
+    ctx->ddaBlocks[dda].swap(setup.ddaBlocks[dda]);
+    ctx->cableDelays[chanId].swap(setup.cableDelays[chanId]);
+    if(timer.isActive()) timer.setSamples(numPoints);
+}
+
+//! Single pass calibration of the calibration types accepted by SetupFusedCalibration()
+/*!
+    Reads the ADC values straight from the raw blocks and writes each calibrated sample once.
+    The output is the same, bit for bit, as running these steps one after the other:
+    UnpackDAQFormatToElecChanFormat(), TrimFirstBlock(), TimingCalibrationAndBadSampleReomval(), PedestalSubtraction(),
+    ApplyZeroMean() on ADC, VoltageCalibration(), ApplyZeroMean() on voltage, InvertA3Chans(), ApplyCableDelay() and FillWaveformArena().
+    Every floating point operation is done in the same order as there, and the means are running sums over the samples as they are written.
+    \param theEvent the useful atri event pointer
+    \param calType the calibration type
+    \param unixtime unixtime of the event, used for the cable delays
+    \param thisStationId id of the station
+    \return void
+*/
+void AraEventCalibrator::FusedCalibration(UsefulAtriStationEvent *theEvent, AraCalType::AraCalType_t calType, Double_t unixtime, AraStationId_t thisStationId)
+{
+    SetupFusedCorrections(calType, unixtime, thisStationId);
+
+    //! Number of calibrated samples of each channel, so the output can be sized once
+    Int_t numOut[CHANNELS_PER_ATRI];
+    theEvent->fNumChannels=CountFusedSamples(calType, numOut);
+
+    //! Size the output, either the event's maps or its dense arena
+    if(theEvent->fUseArena) {
+        Int_t numSamples=0;
+        for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) {
+            theEvent->fArenaOffset[chanId]=numSamples;
+            theEvent->fArenaLength[chanId]=numOut[chanId]>0 ? numOut[chanId] : 0;
+            numSamples+=theEvent->fArenaLength[chanId];
+        }
+        theEvent->fArenaTimes.resize(numSamples);
+        theEvent->fArenaVolts.resize(numSamples);
+    }
+    else {
+        for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) {
+            if(numOut[chanId]<0) continue;
+            theEvent->fTimes[chanId].resize(numOut[chanId]);
+            theEvent->fVolts[chanId].resize(numOut[chanId]);
+        }
+    }
+
+    for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) {
+        if(numOut[chanId]<=0) continue;
+        if(theEvent->fUseArena) {
+            FusedCalibrateChannel(calType, thisStationId, chanId, numOut[chanId],
+                                  theEvent->fArenaTimes.data()+theEvent->fArenaOffset[chanId], theEvent->fArenaVolts.data()+theEvent->fArenaOffset[chanId]);
+        }
+        else {
+            FusedCalibrateChannel(calType, thisStationId, chanId, numOut[chanId], theEvent->fTimes[chanId].data(), theEvent->fVolts[chanId].data());
+        }
+    }
+}
+
+//! Looks up the A3 inversions and the cable delays used by FusedCalibrateChannel()
+/*!
+    They are looked up in the same order as InvertA3Chans() and ApplyCableDelay(), so the delays are subtracted in the same order.
+    \param calType the calibration type
+    \param unixtime unixtime of the event, used for the cable delays
+    \param thisStationId id of the station
+    \return void
+*/
+void AraEventCalibrator::SetupFusedCorrections(AraCalType::AraCalType_t calType, Double_t unixtime, AraStationId_t thisStationId)
+{
+    AraCalibrationContext *ctx = getContext();
+    memset(ctx->invertChan,0,sizeof(ctx->invertChan));
+    for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) ctx->cableDelays[chanId].clear();
+    if(hasInvertA3Chans(calType) && thisStationId==3) {
+        Int_t list_to_invert[3]={0,4,8};
+        for(int i=0;i<3;i++) {
+            Int_t elec_chan = AraGeomTool::Instance()->getElecChanFromRFChan(list_to_invert[i], thisStationId);
+            if(elec_chan>=0 && elec_chan<CHANNELS_PER_ATRI) ctx->invertChan[elec_chan]=!ctx->invertChan[elec_chan];
+        }
+    }
+    if(hasCableDelays(calType)) {
+        for(int rfChan=0;rfChan<ANTS_PER_ATRI;rfChan++){
+            AraGeomTool* tempGeom = AraGeomTool::Instance();
+            tempGeom->LoadSQLDbAtri(unixtime,thisStationId);
+            Double_t delay=tempGeom->getStationInfo(thisStationId)->getCableDelay(rfChan);
+            int chanId = tempGeom->getElecChanFromRFChan(rfChan, thisStationId);
+            if(chanId>=0 && chanId<CHANNELS_PER_ATRI) ctx->cableDelays[chanId].push_back(delay);
+        }
+    }
+}
+
+//! Number of samples FusedCalibrateChannel() writes for each channel of the event set up by SetupFusedCalibration()
+/*!
+    \param calType the calibration type
+    \param numOut filled with the number of samples of each electronics channel, -1 for channels that were not read out
+    \return the number of channels read out
+*/
+Int_t AraEventCalibrator::CountFusedSamples(AraCalType::AraCalType_t calType, Int_t numOut[CHANNELS_PER_ATRI])
+{
+    const AraAtriCalibTables *calib = getContext()->atriCalib.get(); ///< Tables of the station / epoch being calibrated
+    AraCalibrationContext *ctx = getContext();
+    Bool_t hasTimingCalib = hasBinWidthCalib(calType);
+    Int_t numChannels=0;
+    for(int dda=0;dda<DDA_PER_ATRI;dda++) {
+        Int_t numBlocks=ctx->ddaBlocks[dda].size();
+        for(Int_t chan=0;chan<RFCHAN_PER_DDA;chan++) {
+            Int_t chanId=chan+RFCHAN_PER_DDA*dda;
+            numOut[chanId]=-1;
+            if(ctx->ddaChanIndex[dda][chan]<0) continue;
+            numChannels++;
+            numOut[chanId]=0;
+            for(int blk=1;blk<numBlocks;blk++) {
+                numOut[chanId]+=hasTimingCalib ? calib->fAtriNumSamples[dda][chan][ctx->ddaBlocks[dda][blk].getCapArray()] : SAMPLES_PER_BLOCK;
+            }
+        }
+    }
+    return numChannels;
+}
+
+//! Calibrates one channel of the event set up by SetupFusedCalibration() and SetupFusedCorrections()
+/*!
+    \param calType the calibration type
+    \param thisStationId id of the station
+    \param chanId the electronics channel
+    \param numPoints the number of samples, from CountFusedSamples()
+    \param times filled with the numPoints calibrated times
+    \param volts filled with the numPoints calibrated voltages
+    \return void
+*/
+void AraEventCalibrator::FusedCalibrateChannel(AraCalType::AraCalType_t calType, AraStationId_t thisStationId, Int_t chanId, Int_t numPoints, Double_t *times, Double_t *volts)
+{
+    const AraAtriCalibTables *calib = getContext()->atriCalib.get(); ///< Tables of the station / epoch being calibrated
+    const UShort_t *atriPeds = getContext()->atriPeds->fAtriPeds;
+    AraCalibrationContext *ctx = getContext();
+    int samples_per_block = SAMPLES_PER_BLOCK;
+    Bool_t hasTimingCalib = hasBinWidthCalib(calType);
+    Bool_t hasAdcMean = hasADCZeroMean(calType) && thisStationId != 5;
+    Bool_t hasVolts = hasVoltCal(calType);
+    Bool_t hasVoltMean = hasVoltZeroMean(calType);
+
+    Int_t dda=chanId/RFCHAN_PER_DDA;
+    Int_t chan=chanId%RFCHAN_PER_DDA;
+    const std::vector<AraAtriBlockView> &blocks = ctx->ddaBlocks[dda];
+    Int_t numBlocks=blocks.size();
+    Int_t chanIndex=ctx->ddaChanIndex[dda][chan];
+    const std::vector<Double_t> &delays = ctx->cableDelays[chanId];
+    Int_t numDelays=delays.size();
+    std::vector<int> &sampleIndexList = ctx->tempSamps;
+    sampleIndexList.resize(numPoints);
+
+    //! First pass: select the good samples, subtract the pedestals and set the times, summing the ADC for the mean
+    Double_t sum=0.0;
+    Int_t out=0;
+    if(hasTimingCalib) {
+        for(int blk=0;blk<numBlocks-1;blk++) {
+            Int_t capArrayNumber=blocks[blk+1].getCapArray();
+            Int_t numSamples=calib->fAtriNumSamples[dda][chan][capArrayNumber];
+            for(int trim=0;trim<numSamples;trim++) {
+                //! The sample index is counted from the start of the trimmed waveform, as in TimingCalibrationAndBadSampleReomval()
+                Int_t voltIndex=calib->fAtriSampleIndex[dda][chan][capArrayNumber][trim] + blk * samples_per_block;
+                const AraAtriBlockView *theBlock=&blocks[1+voltIndex/samples_per_block];
+                Int_t sampleNumber=voltIndex%samples_per_block;
+                Int_t blockIndex=theBlock->getBlock();
+
+                Double_t time=(blk + 1) * 20.0 + calib->fAtriSampleTimes[dda][chan][capArrayNumber][trim] - 20.0*capArrayNumber;
+                for(int i=0;i<numDelays;i++) time-=delays[i];
+                Double_t volt=theBlock->getSamples(chanIndex)[sampleNumber];
+                volt-=(Int_t)atriPeds[RawAtriStationEvent::getPedIndex(dda,blockIndex,chan,sampleNumber)];
+
+                times[out]=time;
+                volts[out]=volt;
+                sampleIndexList[out]=blockIndex * samples_per_block + sampleNumber;
+                sum+=volt;
+                out++;
+            }
+        }
+    }
+    else {
+        //! The unpacked times are a running sum that starts in the trimmed first block
+        Double_t time=0;
+        for(int samp=0;samp<samples_per_block;samp++) time+=NSPERSAMP_ATRI;
+        for(int blk=1;blk<numBlocks;blk++) {
+            const UShort_t *blockSamples=blocks[blk].getSamples(chanIndex);
+            Int_t blockIndex=blocks[blk].getBlock();
+            for(int samp=0;samp<samples_per_block;samp++) {
+                time+=NSPERSAMP_ATRI;
+                Double_t thisTime=time;
+                for(int i=0;i<numDelays;i++) thisTime-=delays[i];
+                Double_t volt=blockSamples[samp];
+                volt-=(Int_t)atriPeds[RawAtriStationEvent::getPedIndex(dda,blockIndex,chan,samp)];
+
+                times[out]=thisTime;
+                volts[out]=volt;
+                sampleIndexList[out]=blockIndex * samples_per_block + samp;
+                sum+=volt;
+                out++;
+            }
+        }
+    }
+
+    //! Second pass: ADC zero mean and conversion to millivolts
+    if(hasAdcMean) {
+        Double_t mean=sum;
+        mean/=numPoints;
+        for(int samp=0;samp<numPoints;samp++) volts[samp]-=mean;
+    }
+    if(hasVolts) {
+        calib->convertChanADCtoMilliVolts(numPoints, volts, &(sampleIndexList[0]), dda, chan, volts);
+    }
+    if(hasAdcMean || hasVolts) {
+        sum=0.0;
+        for(int samp=0;samp<numPoints;samp++) sum+=volts[samp];
+    }
+
+    //! Third pass: voltage zero mean and the A3 inversion
+    if(hasVoltMean || ctx->invertChan[chanId]) {
+        Double_t mean=sum;
+        mean/=numPoints;
+        for(int samp=0;samp<numPoints;samp++) {
+            if(hasVoltMean) volts[samp]-=mean;
+            if(ctx->invertChan[chanId]) volts[samp]*=-1.;
+        }
+    }
+}
+
 //! Converts DAQ data format to Electronic channel format
 /*!
     \param theEvent the useful atri event pointer
-    \param voltMapIt the iterator referring to the voltage elements in the 2d map container
-    \param timeMapIt the iterator referring to the time elements in the 2d map container
     \param sampleList the pointer of WF sample numbers
     \param capArrayList the pointer of 'block number' modulo 2
     \return void
 */
-void AraEventCalibrator::UnpackDAQFormatToElecChanFormat(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt, std::map< Int_t, std::vector <Double_t> >::iterator &timeMapIt, std::vector<std::vector<int> > *sampleList, std::vector<std::vector<int> > *capArrayList)
+void AraEventCalibrator::UnpackDAQFormatToElecChanFormat(UsefulAtriStationEvent *theEvent, std::vector<std::vector<int> > *sampleList, std::vector<std::vector<int> > *capArrayList)
 {
 
     int samples_per_block = SAMPLES_PER_BLOCK;
 
     std::vector<RawAtriStationBlock>::iterator blockIt;
-    std::vector< std::vector<UShort_t> >::iterator vecVecIt;
-    std::vector< UShort_t >::iterator shortIt;
 
     //! Step one is loop over the blocks 
     for(blockIt = theEvent->blockVec.begin();
@@ -1081,9 +2157,8 @@ void AraEventCalibrator::UnpackDAQFormatToElecChanFormat(UsefulAtriStationEvent
 
         //! Step three is loop over the channels within a block
         Int_t uptoChan=0;
-        for(vecVecIt=blockIt->data.begin();
-            vecVecIt!=blockIt->data.end();
-            vecVecIt++) {
+        for(Int_t chanIndex=0;chanIndex<blockIt->getNumChannels();chanIndex++) {
+            const UShort_t *blockSamples=blockIt->getSamples(chanIndex);
             Int_t chanId=irsChan[uptoChan] | ((blockIt->channelMask&0x300)>>5);
             Int_t chan=irsChan[uptoChan];
 
@@ -1092,41 +2167,38 @@ void AraEventCalibrator::UnpackDAQFormatToElecChanFormat(UsefulAtriStationEvent
             uptoChan++;
 
             //! Step four is to check if we have already got this chanId
-            timeMapIt=theEvent->fTimes.find(chanId);
+            std::vector <Double_t> *times=getChanTimes(theEvent,chanId);
             Double_t time=0;
-            Int_t firstTime=1;
-            if(timeMapIt==theEvent->fTimes.end()) {
+            if(!times) {
                 //! First time round for this channel
-                std::vector <Double_t> tempTimes;
-                std::vector <Double_t> tempVolts;
-                //! Now need to insert empty vector into map
-                theEvent->fTimes.insert( std::pair< Int_t, std::vector <Double_t> >(chanId,tempTimes));
-                theEvent->fVolts.insert( std::pair< Int_t, std::vector <Double_t> >(chanId,tempVolts));
+                if(theEvent->fUseArena) {
+                    getContext()->chanPresent[chanId]=kTRUE;
+                }
+                else {
+                    //! Now need to insert empty vector into map
+                    std::vector <Double_t> tempTimes;
+                    std::vector <Double_t> tempVolts;
+                    theEvent->fTimes.insert( std::pair< Int_t, std::vector <Double_t> >(chanId,tempTimes));
+                    theEvent->fVolts.insert( std::pair< Int_t, std::vector <Double_t> >(chanId,tempVolts));
+                }
                 theEvent->fNumChannels++;
+                times=getChanTimes(theEvent,chanId);
             }
             else {
                 //! Just get the last time
-                time=timeMapIt->second.back();
+                time=times->back();
                 // if(dda==1 &&chan==1)
-                // std::cout << "Last time " << time << "\t" << timeMapIt->second.size() << "\n";
-                firstTime=0;
+                // std::cout << "Last time " << time << "\t" << times->size() << "\n";
             }
-   
-            //! Set the iterators to point to the correct channel in the map
-            timeMapIt=theEvent->fTimes.find(chanId);
-            voltMapIt=theEvent->fVolts.find(chanId);
+            std::vector <Double_t> *volts=getChanVolts(theEvent,chanId);
 
-            int samp=0;
             //! Now loop over the 64 samples
-            for(shortIt=vecVecIt->begin();
-                shortIt!=vecVecIt->end();
-                shortIt++){
+            for(int samp=0;samp<samples_per_block;samp++){
 
                 time+=NSPERSAMP_ATRI;
-                timeMapIt->second.push_back(time); ///< Filling with time
-                voltMapIt->second.push_back((*shortIt)); ///< Filling with volts
+                times->push_back(time); ///< Filling with time
+                volts->push_back(blockSamples[samp]); ///< Filling with volts
                 sampleList->at(chanId).push_back(block * samples_per_block + samp); ///< Filling with sample number. It is needed for pedestal subtraction and voltage calibration
-                samp++;
 
             }
         }
@@ -1143,33 +2215,34 @@ void AraEventCalibrator::UnpackDAQFormatToElecChanFormat(UsefulAtriStationEvent
 */
 /*!
     \param theEvent the useful atri event pointer
-    \param voltMapIt the iterator referring to the voltage elements in the 2d map container
-    \param timeMapIt the iterator referring to the time elements in the 2d map container
     \param sampleList the pointer of WF sample numbers
     \param capArrayList the pointer of 'block number' modulo 2
     \param hasTrimFirstBlk boolean statement that whether first block trimming is already performed or not
     \return boolean true or false
 */
-Bool_t AraEventCalibrator::TimingCalibrationAndBadSampleReomval(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt, std::map< Int_t, std::vector <Double_t> >::iterator &timeMapIt, std::vector<std::vector<int> > *sampleList, std::vector<std::vector<int> > *capArrayList, Bool_t hasTrimFirstBlk)
+Bool_t AraEventCalibrator::TimingCalibrationAndBadSampleReomval(UsefulAtriStationEvent *theEvent, std::vector<std::vector<int> > *sampleList, std::vector<std::vector<int> > *capArrayList, Bool_t hasTrimFirstBlk)
 {
+    const AraAtriCalibTables *calib = getContext()->atriCalib.get(); ///< Tables of the station / epoch being calibrated
  
     int capArrayNumber = 0;
     int samples_per_block = SAMPLES_PER_BLOCK;
+    AraCalibrationContext *ctx = getContext();
 
     for(int dda=0;dda<DDA_PER_ATRI;dda++) {
         for(Int_t chan=0;chan<RFCHAN_PER_DDA;chan++) {
             Int_t chanId=chan+RFCHAN_PER_DDA*dda; ///< make electronic channel number
-            voltMapIt=theEvent->fVolts.find(chanId);
-            timeMapIt=theEvent->fTimes.find(chanId);
-            if(voltMapIt!=theEvent->fVolts.end()) {
-                Int_t numPoints=(voltMapIt->second).size();
+            std::vector <Double_t> *volts=getChanVolts(theEvent,chanId);
+            std::vector <Double_t> *times=getChanTimes(theEvent,chanId);
+            if(volts) {
+                Int_t numPoints=volts->size();
                
                 //! copy the voltage and sample index in temperary array and clear them before filling with calibrated values
-                std::vector<double> tempVolts;
-                tempVolts = voltMapIt->second;
-                voltMapIt->second.clear();
-                timeMapIt->second.clear();
-                std::vector<int> tempSamps;
+                //! The copies live in the thread's context, so their memory is reused from one channel and event to the next
+                std::vector<double> &tempVolts = ctx->tempVolts;
+                tempVolts = *volts;
+                volts->clear();
+                times->clear();
+                std::vector<int> &tempSamps = ctx->tempSamps;
                 tempSamps = sampleList->at(chanId);
                 sampleList->at(chanId).clear();
            
@@ -1183,14 +2256,14 @@ Bool_t AraEventCalibrator::TimingCalibrationAndBadSampleReomval(UsefulAtriStatio
 
                     for (int samp=0; samp<samples_per_block; samp++){
                         //! Select index and time of well calibrated samples from the tables
-                        voltIndex[samp] = fAtriSampleIndex[dda][chan][capArrayNumber][samp] + blk * samples_per_block;
-                        tempTimes[samp] = (blk + hasTrimFirstBlk) * 20.0 + fAtriSampleTimes[dda][chan][capArrayNumber][samp] - 20.0*capArrayNumber; ///< hasTrimFirstBlk will take into account whether first block is trimmed or not
+                        voltIndex[samp] = calib->fAtriSampleIndex[dda][chan][capArrayNumber][samp] + blk * samples_per_block;
+                        tempTimes[samp] = (blk + hasTrimFirstBlk) * 20.0 + calib->fAtriSampleTimes[dda][chan][capArrayNumber][samp] - 20.0*capArrayNumber; ///< hasTrimFirstBlk will take into account whether first block is trimmed or not
                     }   
          
-                    Int_t numSamples=fAtriNumSamples[dda][chan][capArrayNumber]; ///< number of samples in each block after timing calibration
+                    Int_t numSamples=calib->fAtriNumSamples[dda][chan][capArrayNumber]; ///< number of samples in each block after timing calibration
                     for (int trim=0; trim<numSamples; trim++){
-                        timeMapIt->second.push_back(tempTimes[trim]); ///< Filling with time
-                        voltMapIt->second.push_back(tempVolts[voltIndex[trim]]); ///< Filling with volt
+                        times->push_back(tempTimes[trim]); ///< Filling with time
+                        volts->push_back(tempVolts[voltIndex[trim]]); ///< Filling with volt
                         sampleList->at(chanId).push_back(tempSamps[voltIndex[trim]]); ///< Filling with sample index
                     }
                 }
@@ -1203,11 +2276,11 @@ Bool_t AraEventCalibrator::TimingCalibrationAndBadSampleReomval(UsefulAtriStatio
 //! Pedestal subtraction
 /*!
     \param theEvent the useful atri event pointer
-    \param voltMapIt the iterator referring to the voltage elements in the 2d map container
     \param sampleList the pointer of WF sample numbers
 */
-void AraEventCalibrator::PedestalSubtraction(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt, std::vector<std::vector<int> > *sampleList, AraCalType::AraCalType_t calType)
+void AraEventCalibrator::PedestalSubtraction(UsefulAtriStationEvent *theEvent, std::vector<std::vector<int> > *sampleList, AraCalType::AraCalType_t calType)
 {
+    const UShort_t *atriPeds = getContext()->atriPeds->fAtriPeds;
 
     int sampleIndex, sampleNumber, blockIndex = 0; ///< capacitor sample index, block sample index, capacitor block index
     int samples_per_block = SAMPLES_PER_BLOCK;
@@ -1215,13 +2288,13 @@ void AraEventCalibrator::PedestalSubtraction(UsefulAtriStationEvent *theEvent, s
     for(int dda=0;dda<DDA_PER_ATRI;dda++) {
         for(Int_t chan=0;chan<RFCHAN_PER_DDA;chan++) {
             Int_t chanId=chan+RFCHAN_PER_DDA*dda; ///< make electronic channel number
-            voltMapIt=theEvent->fVolts.find(chanId);
-            if(voltMapIt!=theEvent->fVolts.end()) {
-                Int_t numPoints=(voltMapIt->second).size();
+            std::vector <Double_t> *volts=getChanVolts(theEvent,chanId);
+            if(volts) {
+                Int_t numPoints=volts->size();
                 if(calType==AraCalType::kOnlyPed
                     || calType==AraCalType::kOnlyPedWithOut1stBlock
                     || calType==AraCalType::kOnlyPedWithOut1stBlockAndBadSamples)
-                { voltMapIt->second.clear(); } ///< clear voltMapIt iterator before filling with pedestal values
+                { volts->clear(); } ///< clear the voltages before filling with pedestal values
 
                 for(int samp=0;samp<numPoints;samp++) {
                     sampleIndex = sampleList->at(chanId)[samp];
@@ -1231,9 +2304,9 @@ void AraEventCalibrator::PedestalSubtraction(UsefulAtriStationEvent *theEvent, s
                     if(calType==AraCalType::kOnlyPed 
                         || calType==AraCalType::kOnlyPedWithOut1stBlock 
                         || calType==AraCalType::kOnlyPedWithOut1stBlockAndBadSamples) 
-                    { voltMapIt->second.push_back((Int_t)fAtriPeds[RawAtriStationEvent::getPedIndex(dda,blockIndex,chan,sampleNumber)]);
+                    { volts->push_back((Int_t)atriPeds[RawAtriStationEvent::getPedIndex(dda,blockIndex,chan,sampleNumber)]);
                     //! Filling with ADC-Pedestal. Iunputted pedestal will be stored in fAtriPeds table 
-                    } else { voltMapIt->second[samp] -= (Int_t)fAtriPeds[RawAtriStationEvent::getPedIndex(dda,blockIndex,chan,sampleNumber)]; }
+                    } else { (*volts)[samp] -= (Int_t)atriPeds[RawAtriStationEvent::getPedIndex(dda,blockIndex,chan,sampleNumber)]; }
                 }
             }
         }
@@ -1243,30 +2316,18 @@ void AraEventCalibrator::PedestalSubtraction(UsefulAtriStationEvent *theEvent, s
 //! Voltage calibration. Converts ADC to voltage sample by sample
 /*!
     \param theEvent the useful atri event pointer
-    \param voltMapIt the iterator referring to the voltage elements in the 2d map container
     \param stationId id of the station
     \return void
 */
-void AraEventCalibrator::VoltageCalibration(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt, std::vector<std::vector<int> > *sampleList, AraStationId_t thisStationId)
+void AraEventCalibrator::VoltageCalibration(UsefulAtriStationEvent *theEvent, std::vector<std::vector<int> > *sampleList, AraStationId_t thisStationId)
 {
-    int blockIndex = 0;///< This is now filled in the code below- KAH
-    int sampleIndex, sampleNumber = 0; ///< removed this and instead use "samp" variable below. re-use this for the trimmed sample index -MK-
-    int samples_per_block = SAMPLES_PER_BLOCK;
-
     for(int dda=0;dda<DDA_PER_ATRI;dda++) {
         for(Int_t chan=0;chan<RFCHAN_PER_DDA;chan++) {
             Int_t chanId=chan+RFCHAN_PER_DDA*dda;
-            voltMapIt=theEvent->fVolts.find(chanId);
-            if(voltMapIt!=theEvent->fVolts.end()) {
-                Int_t numPoints=(voltMapIt->second).size();
-                for(int samp=0;samp<numPoints;samp++) {
-                    sampleIndex = sampleList->at(chanId)[samp]; ///< capacitor sample index
-                    sampleNumber = sampleIndex%samples_per_block; ///< block sample index
-                    blockIndex = int(sampleIndex/samples_per_block); ///< capacitor block index
-                    //! Move to conversion function
-                    //! Apply conversion parameter on each sample
-                    voltMapIt->second[samp] = convertADCtoMilliVolts( voltMapIt->second[samp], dda, blockIndex, chan, sampleNumber, thisStationId);
-                }
+            std::vector <Double_t> *volts=getChanVolts(theEvent,chanId);
+            if(volts && !volts->empty()) {
+                //! Apply conversion parameter on each sample, the sample list holds the capacitor sample index (block * 64 + sample) -MK-
+                convertChanADCtoMilliVolts(volts->size(), &((*volts)[0]), &(sampleList->at(chanId)[0]), dda, chan, thisStationId, &((*volts)[0]));
             }
         }
     }
@@ -1276,11 +2337,10 @@ void AraEventCalibrator::VoltageCalibration(UsefulAtriStationEvent *theEvent, st
 //! Apply Brian's conditioner inside of calibration
 /*!
     \param theEvent the useful atri event pointer
-    \param voltMapIt the iterator referring to the voltage elements in the 2d map container
     \param stationId id of the station
     \return void
 */
-void AraEventCalibrator::InvertA3Chans(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt, AraStationId_t thisStationId)
+void AraEventCalibrator::InvertA3Chans(UsefulAtriStationEvent *theEvent, AraStationId_t thisStationId)
 {
     
     std::vector<Int_t> list_to_invert;
@@ -1294,13 +2354,13 @@ void AraEventCalibrator::InvertA3Chans(UsefulAtriStationEvent *theEvent, std::ma
         Int_t rf_chan = list_to_invert[i];
         Int_t elec_chan = AraGeomTool::Instance()->getElecChanFromRFChan(rf_chan, thisStationId);
  
-        voltMapIt=theEvent->fVolts.find(elec_chan);
-        if(voltMapIt!=theEvent->fVolts.end()) {
-            Int_t numPoints=(voltMapIt->second).size();
+        std::vector <Double_t> *volts=getChanVolts(theEvent,elec_chan);
+        if(volts) {
+            Int_t numPoints=volts->size();
            
             //! perform inversion on every sample
             for(int samp=0;samp<numPoints;samp++) {
-                voltMapIt->second[samp]*=-1.;
+                (*volts)[samp]*=-1.;
             }
         }
     }
@@ -1309,11 +2369,10 @@ void AraEventCalibrator::InvertA3Chans(UsefulAtriStationEvent *theEvent, std::ma
 //! Remove knwon cable delay
 /*!
     \param theEvent the useful atri event pointer
-    \param timeMapIt the iterator referring to the time elements in the 2d map container
     \param stationId id of the station
     \return void
 */
-void AraEventCalibrator::ApplyCableDelay(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &timeMapIt, Double_t unixtime, AraStationId_t thisStationId)
+void AraEventCalibrator::ApplyCableDelay(UsefulAtriStationEvent *theEvent, Double_t unixtime, AraStationId_t thisStationId)
 {
     
     for(int rfChan=0;rfChan<ANTS_PER_ATRI;rfChan++){
@@ -1321,11 +2380,11 @@ void AraEventCalibrator::ApplyCableDelay(UsefulAtriStationEvent *theEvent, std::
         tempGeom->LoadSQLDbAtri(unixtime,thisStationId); ///< LoadSQLDbAtri() added by UAL 01/25/2019
         Double_t delay=tempGeom->getStationInfo(thisStationId)->getCableDelay(rfChan);
         int chanId = tempGeom->getElecChanFromRFChan(rfChan, thisStationId);
-        timeMapIt=theEvent->fTimes.find(chanId);
-        if(timeMapIt!=theEvent->fTimes.end()) {
-            Int_t numPoints = (timeMapIt->second).size();
+        std::vector <Double_t> *times=getChanTimes(theEvent,chanId);
+        if(times) {
+            Int_t numPoints = times->size();
             for(int samp=0;samp<numPoints;samp++){
-                timeMapIt->second[samp]-=delay;
+                (*times)[samp]-=delay;
             }
         }
     }
@@ -1334,15 +2393,14 @@ void AraEventCalibrator::ApplyCableDelay(UsefulAtriStationEvent *theEvent, std::
 //! Erase first block that currupted by trigger
 /*!
     \param theEvent the useful atri event pointer
-    \param voltMapIt the iterator referring to the voltage elements in the 2d map container
-    \param timeMapIt the iterator referring to the time elements in the 2d map container
     \param sampleList the pointer of WF sample number
     \param capArrayList the pointer of  'block number' modulo 2
     \param hasTimingCalib boolean statement that whether TimingCalibrationAndBadSampleReomval is already performed or not
     \return boolean true or false
 */
-Bool_t AraEventCalibrator::TrimFirstBlock(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt, std::map< Int_t, std::vector <Double_t> >::iterator &timeMapIt, std::vector<std::vector<int> > *sampleList, std::vector<std::vector<int> > *capArrayList, Bool_t hasTimingCalib)
+Bool_t AraEventCalibrator::TrimFirstBlock(UsefulAtriStationEvent *theEvent, std::vector<std::vector<int> > *sampleList, std::vector<std::vector<int> > *capArrayList, Bool_t hasTimingCalib)
 {
+    const AraAtriCalibTables *calib = getContext()->atriCalib.get(); ///< Tables of the station / epoch being calibrated
 
     int first_block_len = 0;
     int first_capNumber = 0;
@@ -1353,11 +2411,11 @@ Bool_t AraEventCalibrator::TrimFirstBlock(UsefulAtriStationEvent *theEvent, std:
         first_capNumber = capArrayList->at(dda)[0];
         for(Int_t chan=0;chan<RFCHAN_PER_DDA;chan++) {
             Int_t chanId=chan+RFCHAN_PER_DDA*dda;
-            voltMapIt=theEvent->fVolts.find(chanId);
-            if(voltMapIt!=theEvent->fVolts.end()) {
-                Int_t numPoints=(voltMapIt->second).size();
+            std::vector <Double_t> *volts=getChanVolts(theEvent,chanId);
+            if(volts) {
+                Int_t numPoints=volts->size();
                 if (hasTimingCalib){
-                    first_block_len = fAtriNumSamples[dda][chan][first_capNumber]; ///< use the exact number of samples in the first if timing calibration has already happened
+                    first_block_len = calib->fAtriNumSamples[dda][chan][first_capNumber]; ///< use the exact number of samples in the first if timing calibration has already happened
                 } else {
                     first_block_len = SAMPLES_PER_BLOCK;
                 }
@@ -1380,16 +2438,16 @@ Bool_t AraEventCalibrator::TrimFirstBlock(UsefulAtriStationEvent *theEvent, std:
         capArrayList->at(dda).erase(capArrayList->at(dda).begin(),capArrayList->at(dda).begin()+1); ///< delete the first block number. This trimming is needed for TimingCalibrationAndBadSampleReomval()
         for(Int_t chan=0;chan<RFCHAN_PER_DDA;chan++) {
             Int_t chanId=chan+RFCHAN_PER_DDA*dda;
-            voltMapIt=theEvent->fVolts.find(chanId);
-            timeMapIt=theEvent->fTimes.find(chanId);
-            if(voltMapIt!=theEvent->fVolts.end()) {
+            std::vector <Double_t> *volts=getChanVolts(theEvent,chanId);
+            std::vector <Double_t> *times=getChanTimes(theEvent,chanId);
+            if(volts) {
                 if (hasTimingCalib){
-                    first_block_len = fAtriNumSamples[dda][chan][first_capNumber]; ///< use the exact number of samples in the first if timing calibration has already happened
+                    first_block_len = calib->fAtriNumSamples[dda][chan][first_capNumber]; ///< use the exact number of samples in the first if timing calibration has already happened
                 } else {
                     first_block_len = SAMPLES_PER_BLOCK;
                 }
-                voltMapIt->second.erase(voltMapIt->second.begin(),voltMapIt->second.begin()+first_block_len); ///< delete the times in the first block
-                timeMapIt->second.erase(timeMapIt->second.begin(),timeMapIt->second.begin()+first_block_len); ///< delete the ADC (or volt) in the first block
+                volts->erase(volts->begin(),volts->begin()+first_block_len); ///< delete the times in the first block
+                times->erase(times->begin(),times->begin()+first_block_len); ///< delete the ADC (or volt) in the first block
                 sampleList->at(chanId).erase(sampleList->at(chanId).begin(),sampleList->at(chanId).begin()+first_block_len); ///< delete the samples in the first block
             }
         }
@@ -1398,10 +2456,9 @@ Bool_t AraEventCalibrator::TrimFirstBlock(UsefulAtriStationEvent *theEvent, std:
 
 /*!
     \param theEvent the useful atri event pointer
-    \param voltMapIt the iterator referring to the voltage elements in the 2d map container
     \return void
 */
-void AraEventCalibrator::CommonMode(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt)
+void AraEventCalibrator::CommonMode(UsefulAtriStationEvent *theEvent)
 {
     /*!
         Then we need to do a common mode correction
@@ -1409,17 +2466,15 @@ void AraEventCalibrator::CommonMode(UsefulAtriStationEvent *theEvent, std::map<
         loop over chan
         loop over times and subtract one
     */
-    std::map< Int_t, std::vector <Double_t> >::iterator voltMapIt2;
-
     for(int dda=0;dda<DDA_PER_ATRI;dda++) {
         for(Int_t chan=0;chan<5;chan++) {
             Int_t chanId=chan+RFCHAN_PER_DDA*dda;
-            voltMapIt= theEvent->fVolts.find(chanId);
+            std::vector <Double_t> *volts=getChanVolts(theEvent,chanId);
             Int_t chanId2=5+RFCHAN_PER_DDA*dda;
-            voltMapIt2= theEvent->fVolts.find(chanId2);
-            Int_t numPoints=(voltMapIt->second).size();
+            std::vector <Double_t> *volts2=getChanVolts(theEvent,chanId2);
+            Int_t numPoints=volts->size();
             for(int samp=0;samp<numPoints;samp++) {
-                voltMapIt->second[samp]-= voltMapIt2->second[samp];
+                (*volts)[samp]-= (*volts2)[samp];
             }
         }
     }
@@ -1432,11 +2487,11 @@ void AraEventCalibrator::CommonMode(UsefulAtriStationEvent *theEvent, std::map<
 */
 /*!
     \param theEvent the useful atri event pointer
-    \param voltMapIt the iterator referring to the voltage elements in the 2d map container
     \return void
 */
-void AraEventCalibrator::ApplyZeroMean(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt, std::vector<std::vector<int> > *capArrayList, Bool_t hasTrimFirstBlk, Bool_t hasTimingCalib)
+void AraEventCalibrator::ApplyZeroMean(UsefulAtriStationEvent *theEvent, std::vector<std::vector<int> > *capArrayList, Bool_t hasTrimFirstBlk, Bool_t hasTimingCalib)
 {
+    const AraAtriCalibTables *calib = getContext()->atriCalib.get(); ///< Tables of the station / epoch being calibrated
     int first_block_len = 0;
     int numPoints_for_mean = 0;
     int first_capNumber = 0;
@@ -1446,12 +2501,12 @@ void AraEventCalibrator::ApplyZeroMean(UsefulAtriStationEvent *theEvent, std::ma
         first_capNumber = capArrayList->at(dda)[0];
         for(Int_t chan=0;chan<RFCHAN_PER_DDA;chan++) {
             Int_t chanId=chan+RFCHAN_PER_DDA*dda;
-            voltMapIt=theEvent->fVolts.find(chanId);
-            if(voltMapIt!=theEvent->fVolts.end()) {
-                Int_t numPoints=(voltMapIt->second).size();
+            std::vector <Double_t> *volts=getChanVolts(theEvent,chanId);
+            if(volts) {
+                Int_t numPoints=volts->size();
                 if (!hasTrimFirstBlk) {
                     if (hasTimingCalib) {
-                        first_block_len = fAtriNumSamples[dda][chan][first_capNumber]; ///< use the exact number of samples in the first if timing calibration has already happened
+                        first_block_len = calib->fAtriNumSamples[dda][chan][first_capNumber]; ///< use the exact number of samples in the first if timing calibration has already happened
                     } else { 
                         first_block_len = samples_per_block;
                     }
@@ -1462,10 +2517,10 @@ void AraEventCalibrator::ApplyZeroMean(UsefulAtriStationEvent *theEvent, std::ma
                 }
                 //! compute the mean, and let C++ help by doing the addition for us
                 //! If 1st block is still in the WF, exclude the samples in the 1st block from mean calculation
-                Double_t mean = std::accumulate((voltMapIt->second).begin() + first_block_len, (voltMapIt->second).end(), 0.0);
+                Double_t mean = std::accumulate(volts->begin() + first_block_len, volts->end(), 0.0);
                 mean /= numPoints_for_mean;
                 for(int samp=0;samp<numPoints;samp++) {
-                    voltMapIt->second[samp]-=mean;
+                    (*volts)[samp]-=mean;
                 }
             }
         }
@@ -1475,12 +2530,106 @@ void AraEventCalibrator::ApplyZeroMean(UsefulAtriStationEvent *theEvent, std::ma
 void AraEventCalibrator::setAtriPedFile(char *filename, AraStationId_t stationId)
 {
     Int_t calibIndex = AraGeomTool::getStationCalibIndex(stationId);
-    strncpy(fAtriPedFile[calibIndex],filename,FILENAME_MAX);
-    fGotAtriPedFile[calibIndex]=1; //Protects us from loading the default pedfile
-    loadAtriPedestals(stationId);
+    if(calibIndex==-1){
+        fprintf(stderr, "AraEventCalibrator::setAtriPedFile -- ERROR Unknown stationId %i\n", stationId);
+        return;
+    }
+    //! Replaces the station's pedestals in the cache, events calibrated from now on use this file
+    fAtriCache->get<AraAtriPedestals>(AraAtriCalibCache::pedKey(calibIndex), [&]{
+        strncpy(fAtriPedFile[calibIndex],filename,FILENAME_MAX);
+        fGotAtriPedFile[calibIndex]=1; //Protects us from loading the default pedfile
+        return loadAtriPedestals(stationId);
+    }, true);
+}
+
+//! The calibration tables of a station, from the cache
+/*!
+    \param stationId id of the station
+    \param unixtime time of the event, picks the calibration epoch
+    \return the tables, empty if the station is unknown
+*/
+std::shared_ptr<const AraAtriCalibTables> AraEventCalibrator::getAtriCalibTables(AraStationId_t stationId, Double_t unixtime)
+{
+    Int_t calibIndex = AraGeomTool::getStationCalibIndex(stationId);
+    if(calibIndex==-1) return std::shared_ptr<const AraAtriCalibTables>(loadAtriCalib(stationId, unixtime));
+    return fAtriCache->get<AraAtriCalibTables>(AraAtriCalibCache::calibKey(calibIndex, getAtriCalibEpoch(stationId, unixtime)), [&]{
+        AraCalibStageTimer timer(fStats, kStageCalibLoad);
+        AraAtriCalibTables *tables=loadAtriCalib(stationId, unixtime);
+        if(tables && timer.isActive()) fStats->fVoltsConvFallbacks.fetch_add(tables->fNumVoltsConvFallbacks, std::memory_order_relaxed);
+        return tables;
+    });
+}
+
+//! The pedestals of a station, from the cache
+/*!
+    \param stationId id of the station
+    \return the pedestals
+*/
+std::shared_ptr<const AraAtriPedestals> AraEventCalibrator::getAtriPedestals(AraStationId_t stationId)
+{
+    Int_t calibIndex = AraGeomTool::getStationCalibIndex(stationId);
+    if(calibIndex==-1) return std::shared_ptr<const AraAtriPedestals>(loadAtriPedestals(stationId));
+    return fAtriCache->get<AraAtriPedestals>(AraAtriCalibCache::pedKey(calibIndex), [&]{
+        AraCalibStageTimer timer(fStats, kStagePedLoad);
+        return loadAtriPedestals(stationId);
+    });
+}
+
+void AraEventCalibrator::setAtriCacheMemoryLimit(Long64_t bytes)
+{
+    fAtriCache->setMemoryLimit(bytes);
 }
 
-void AraEventCalibrator::loadAtriPedestals(AraStationId_t stationId)
+void AraEventCalibrator::clearAtriCache()
+{
+    fAtriCache->clear();
+}
+
+/*!
+    MK added 08-02-2022
+    WFs that recorded from A3 string 4 show ADC counts duplication from December 2018
+    It looks like every even group of 16 samples is duplicated (overwriting) to an odd group of 16 samples
+    In order to remove duplicate samples, a new timing table for the 2019 data set are implemented 
+    It will exclude the samples that contain duplicated ADC
+    Related talk: https://aradocs.wipac.wisc.edu/cgi-bin/DocDB/ShowDocument?docid=2535
+
+    MK added 10-09-2022
+    It looks like duplication is disappeared from 2019-2020 pole season
+    The new timing table will be only used between Run12866 and Run16481
+*/
+/*!
+    \param stationId id of the station
+    \param unixtime time of the event
+    \return 1 for A3 between Run12866 (2018/12/21) and Run16481 (2019/12/13), 0 otherwise
+*/
+Int_t AraEventCalibrator::getAtriCalibEpoch(AraStationId_t stationId, Double_t unixtime)
+{
+    if (stationId==3 && unixtime > 1544125405 && unixtime < 1576210568) return 1;
+    return 0;
+}
+
+//! Loads the pedestals of a station from a binary or text pedestal file
+/*!
+    \param peds filled with the pedestals, mapped from a binary file or read into its own store from a text one
+    \param pedFile the pedestal file
+    \param stationId the station, checked against the header of a binary file
+    \return the number of pedestals loaded, ARA_ATRI_PED_FILE_NUM_PEDS if the file is complete
+*/
+static Int_t loadAtriPedFile(AraAtriPedestals *peds, const char *pedFile, AraStationId_t stationId)
+{
+    strncpy(peds->fPedFile,pedFile,FILENAME_MAX);
+    if(AraAtriPedestalFile::isBinary(pedFile)){
+        // binary pedestals are used straight from the mapped file
+        peds->fAtriPeds = AraAtriPedestalFile::mapBinary(pedFile, stationId, peds->fMapBase, peds->fMapLength);
+        return peds->fAtriPeds ? ARA_ATRI_PED_FILE_NUM_PEDS : 0;
+    }
+    // the count readText returns is the check on the file, it is only parsed once
+    Int_t numPeds = AraAtriPedestalFile::readText(pedFile, peds->fPedStore);
+    peds->fAtriPeds = &(peds->fPedStore[0]);
+    return numPeds;
+}
+
+AraAtriPedestals *AraEventCalibrator::loadAtriPedestals(AraStationId_t stationId)
 {  
     Int_t calibIndex = AraGeomTool::getStationCalibIndex(stationId);
     Int_t stationNumber = AraGeomTool::getStationNumber(stationId);
@@ -1488,14 +2637,20 @@ void AraEventCalibrator::loadAtriPedestals(AraStationId_t stationId)
         fprintf(stderr, "AraEventCalibrator::loadAtriPedestals -- ERROR Unknown stationId %i\n", stationId);
         exit(0);
     }
+    if(fGotAtriPedFile[calibIndex]==1 && !fileExists(fAtriPedFile[calibIndex])){
+        fGotAtriPedFile[calibIndex]=0;
+        fprintf(stderr, "%s -- pedFile does not exist!\n", __FUNCTION__);
+    }
+
+    // Other stations' pedestals stay in the cache, these get their own storage
+    AraAtriPedestals *peds = new AraAtriPedestals(stationId);
     if(fGotAtriPedFile[calibIndex]==1){
-        if(!fileExists(fAtriPedFile[calibIndex])){
-            fGotAtriPedFile[calibIndex]=0;
-            fprintf(stderr, "%s -- pedFile does not exist!\n", __FUNCTION__);
-        }
-        else if(numberOfPedestalValsInFile(fAtriPedFile[calibIndex]) != RFCHAN_PER_DDA*DDA_PER_ATRI*BLOCKS_PER_DDA*SAMPLES_PER_BLOCK){
+        fprintf(stdout, "%s : Loading fAtriPedFile - %s\n", __FUNCTION__, fAtriPedFile[calibIndex]);
+        if(loadAtriPedFile(peds, fAtriPedFile[calibIndex], stationId) != ARA_ATRI_PED_FILE_NUM_PEDS){
             fGotAtriPedFile[calibIndex]=0;
             fprintf(stderr, "%s -- pedFile has too few values!\n", __FUNCTION__);
+            delete peds;
+            peds = new AraAtriPedestals(stationId);
         }
     }
 
@@ -1518,59 +2673,39 @@ void AraEventCalibrator::loadAtriPedestals(AraStationId_t stationId)
                 strncpy(calibDir,calibEnv,FILENAME_MAX);
                 // fprintf(stdout,"AraEventCalibrator::loadAtriPedestals(): INFO - Pedestal file [from ARA_CALIB_DIR]");
             }
-            sprintf(fAtriPedFile[calibIndex],"%s/ATRI/araAtriStation%iPedestals.txt",calibDir, stationId);
+            // the binary pedestals made by pedtobin are preferred over the text ones
+            sprintf(fAtriPedFile[calibIndex],"%s/ATRI/araAtriStation%iPedestals.bin",calibDir, stationId);
+            if(!fileExists(fAtriPedFile[calibIndex]))
+                sprintf(fAtriPedFile[calibIndex],"%s/ATRI/araAtriStation%iPedestals.txt",calibDir, stationId);
             // fprintf(stdout," = %s\n",fAtriPedFile[calibIndex]);
         } // end of IF-block for pedestal file not specified by environment variable
         else {
             strncpy(fAtriPedFile[calibIndex],pedFileEnv,FILENAME_MAX);
             // fprintf(stdout,"AraEventCalibrator::loadAtriPedestals(): INFO - Pedestal file [from ARA_ONE_PEDESTAL_FILE] = %s\n",fAtriPedFile[calibIndex]);
         } // end of IF-block for pedestal file specified by environment variable
-    }
-    
-    // Pedestal file
-    
-    fprintf(stdout, "%s : Loading fAtriPedFile - %s\n", __FUNCTION__, fAtriPedFile[calibIndex]);
-    
-    // If there are pedestals in memory already then we need to delete them and replace with this station's
-    if(fAtriPeds)
-        delete fAtriPeds;
-
-    fAtriPeds = new UShort_t [DDA_PER_ATRI*BLOCKS_PER_DDA*RFCHAN_PER_DDA*SAMPLES_PER_BLOCK];
-    if(!fAtriPeds) {
-        std::cerr << "Can not allocate memory for pedestal file\n";
-        exit(0);
-    }
 
-    // now, we open and load the pedestal files
-    gzFile inPed = gzopen(fAtriPedFile[calibIndex], "r");
-    std::vector<char> buffer(6000000);
-    int nRead = gzread(inPed, &buffer[0], sizeof(char)*6000000);
-
-    // we then put the buffer (which are characters at this point)
-    // into a string object that we can manipulate
-    std::string string_buffer(buffer.begin(), buffer.end()); // convert the vector of chars to a string    
-    std::stringstream ss(string_buffer);
-
-    // to do this, we need "buffer" variables
-    std::string dda_buf;
-    std::string block_buf;
-    std::string chan_buf;
-    std::string ped_buf;
-   
-    while ( ss >> dda_buf >> block_buf >> chan_buf){
-        // we cast the dda, block, and channels into integers
-        int dda = std::stoi(dda_buf);
-        int block = std::stoi(block_buf);
-        int chan = std::stoi(chan_buf);
-
-        // the pedestal values are cast as shorts
-        for(int samp=0; samp < SAMPLES_PER_BLOCK; samp++){
-            ss >> ped_buf;
-            short pedVal = short(std::stoi(ped_buf));
-            fAtriPeds[RawAtriStationEvent::getPedIndex(dda,block,chan,samp)]=pedVal;
+        // Pedestal file
+
+        fprintf(stdout, "%s : Loading fAtriPedFile - %s\n", __FUNCTION__, fAtriPedFile[calibIndex]);
+        Int_t numPeds = loadAtriPedFile(peds, fAtriPedFile[calibIndex], stationId);
+        size_t nameLength = strlen(fAtriPedFile[calibIndex]);
+        if(numPeds==0 && AraAtriPedestalFile::isBinary(fAtriPedFile[calibIndex])
+           && nameLength>4 && strcmp(fAtriPedFile[calibIndex]+nameLength-4,".bin")==0){
+            // a damaged or mismatched binary file falls back to the text pedestals it was made from
+            fprintf(stderr, "%s -- WARNING Can't use binary pedFile %s, trying the text one\n", __FUNCTION__, fAtriPedFile[calibIndex]);
+            strcpy(fAtriPedFile[calibIndex]+nameLength-4,".txt");
+            delete peds;
+            peds = new AraAtriPedestals(stationId);
+            numPeds = loadAtriPedFile(peds, fAtriPedFile[calibIndex], stationId);
+        }
+        if(!peds->fAtriPeds){
+            fprintf(stderr, "%s -- ERROR No pedestals for stationId %i\n", __FUNCTION__, stationId);
+            delete peds;
+            return NULL;
         }
+        if(numPeds != ARA_ATRI_PED_FILE_NUM_PEDS)
+            fprintf(stderr, "%s -- pedFile has too few values!\n", __FUNCTION__);
     }
-    gzclose(inPed);
     
     // Now we set the gotPedFile flags to indicate which station we have in memory
     
@@ -1583,23 +2718,18 @@ void AraEventCalibrator::loadAtriPedestals(AraStationId_t stationId)
     // }
 
     // RJN change 13-Feb-2013
-    memset(fGotAtriPedFile,ATRI_NO_STATIONS*sizeof(Int_t),0);
     calibIndex = AraGeomTool::getStationCalibIndex(stationId);
     fGotAtriPedFile[calibIndex]=1;
+    return peds;
 }
 
 
-void AraEventCalibrator::loadAtriCalib(AraStationId_t stationId, Double_t unixtime)
+//! Finds the directory holding the calibration files
+/*!
+    \param calibDir filled with ARA_CALIB_DIR, ARA_UTIL_INSTALL_DIR/share/araCalib or calib, whichever is found first
+*/
+static void getAtriCalibDir(char calibDir[FILENAME_MAX])
 {
-    Int_t calibIndex = AraGeomTool::getStationCalibIndex(stationId);
-    // std::cout << "Loading calibration info for station: " << (int)stationId << "\t" << calibIndex << "\n";
-    if(calibIndex==-1){
-        fprintf(stderr, "AraEventCalibrator::loadAtriCalib -- ERROR Unknown stationId %i\n", stationId);
-        return;
-    }
-
-    char calibFile[FILENAME_MAX];
-    char calibDir[FILENAME_MAX];
     char *calibEnv=getenv("ARA_CALIB_DIR");
     if(!calibEnv) {
         char *utilEnv=getenv("ARA_UTIL_INSTALL_DIR");
@@ -1611,8 +2741,179 @@ void AraEventCalibrator::loadAtriCalib(AraStationId_t stationId, Double_t unixti
     else {
         strncpy(calibDir,calibEnv,FILENAME_MAX);
     }  
+}
+
+/*!
+    Uses the calibration bundle of the station and epoch, araAtriStation<N>CalibBundleEpoch<E>.bin, if there is one.
+    Otherwise, or if the bundle is unusable, the tables are read from the text files by loadAtriCalibFromText().
+    \param stationId id of the station
+    \param unixtime time of the event, picks the calibration epoch
+    \return the tables, NULL if the station is unknown
+*/
+AraAtriCalibTables *AraEventCalibrator::loadAtriCalib(AraStationId_t stationId, Double_t unixtime)
+{
+    Int_t epoch = getAtriCalibEpoch(stationId, unixtime);
+    if(AraGeomTool::getStationCalibIndex(stationId)!=-1){
+        char calibDir[FILENAME_MAX];
+        getAtriCalibDir(calibDir);
+        char bundleFile[FILENAME_MAX];
+        snprintf(bundleFile,FILENAME_MAX,"%s/ATRI/araAtriStation%iCalibBundleEpoch%i.bin",calibDir, stationId, epoch);
+        if(fileExists(bundleFile)){
+            fprintf(stdout, "AraEventCalibrator::loadAtriCalib(): INFO - Calibration bundle = %s\n", bundleFile);
+            AraAtriCalibTables *tables = AraAtriCalibBundle::read(bundleFile, stationId, epoch);
+            if(tables) return tables;
+            fprintf(stderr, "AraEventCalibrator::loadAtriCalib -- WARNING Falling back to the text calibration files\n");
+        }
+    }
+    return loadAtriCalibFromText(stationId, epoch);
+}
+
+//! Reads the ADC to volts conversion fits of a station straight into AraAtriCalibTables::fAtriVoltsConv
+/*!
+    The text files have the fits of every sample of every channel, about 120 MB as doubles, but only the calibrated channels are used.
+    Each fit is read into its place in fAtriVoltsConv with a flag for a bad Chi^2/NDF, and resolve() then replaces the bad ones by a neighbour's.
+    The A5 search can run on into the next channel of the dda, so on A5 the channel after the last calibrated one of each dda is kept too, on the side.
+*/
+class AraAtriVoltsConvLoader
+{
+    public:
+        AraAtriVoltsConvLoader(AraAtriCalibTables *tables);
+
+        //! Where the fit of a sample is read to, NULL if the channel's fits are never used
+        AraAtriVoltsConv *getConv(int dda, int chan, int sample) {
+            Int_t slot=fSlot[dda][chan];
+            if(slot<0) return NULL;
+            if(slot<fNumConvChans) return &(fTables->fAtriVoltsConv[slot*SAMPLES_PER_DDA + sample]);
+            return &(fSpillConv[(slot-fNumConvChans)*SAMPLES_PER_DDA + sample]);
+        }
+        //! Flags the fit of a sample as having a bad Chi^2/NDF
+        void setChi2(int dda, int chan, int sample, Double_t chi2) {
+            if(fSlot[dda][chan]>=0) fBadFit[fSlot[dda][chan]*SAMPLES_PER_DDA + sample]=(chi2>1.0);
+        }
+        void resolve(); ///< Replaces the fits with a bad Chi^2/NDF, once all the fits are read
+
+    private:
+        //! A sample of the search, which may have run on into the next channel of the dda
+        Bool_t isBad(int dda, int chan, int sample) {
+            if(sample>=SAMPLES_PER_DDA) {
+                chan++;
+                sample-=SAMPLES_PER_DDA;
+            }
+            return fBadFit[fSlot[dda][chan]*SAMPLES_PER_DDA + sample];
+        }
+        AraAtriVoltsConv *getSearchConv(int dda, int chan, int sample) {
+            if(sample>=SAMPLES_PER_DDA) return getConv(dda, chan+1, sample-SAMPLES_PER_DDA);
+            return getConv(dda, chan, sample);
+        }
+
+        AraAtriCalibTables *fTables;
+        Int_t fNumConvChans; ///< Channels in fAtriVoltsConv
+        Int_t fSlot[DDA_PER_ATRI][RFCHAN_PER_DDA]; ///< fAtriVoltsConvChan, or numConvChans plus the channel's place in fSpillConv, -1 if not kept
+        std::vector<AraAtriVoltsConv> fSpillConv; ///< The A5 channels after the calibrated ones
+        std::vector<UChar_t> fBadFit; ///< Does the fit of each sample kept have a Chi^2/NDF above 1, indexed by slot and sample
+};
+
+/*!
+    There is an offset induced in the pedestal numbers, due to asymmetry of the chip. 
+    From calibration files this offset with the given noise will be around 11 ADC counts.
+    If it's not station 5, subtract an offset of 11. (THM)
+    \param tables the tables, whose fAtriVoltsConv is laid out here
+*/
+AraAtriVoltsConvLoader::AraAtriVoltsConvLoader(AraAtriCalibTables *tables)
+    : fTables(tables), fNumConvChans(0)
+{
+    fTables->fAtriConvStation5 = (fTables->fStationId == 5);
+    if (!fTables->fAtriConvStation5){
+        fTables->fAtriHighAdcLimit = 400;
+        fTables->fAtriAdcOffset = -11.0;
+    } else {
+        fTables->fAtriHighAdcLimit = 500;
+        fTables->fAtriAdcOffset = 0.0;
+    }
+    fTables->fNumVoltsConvFallbacks=0;
+
+    for(int dda=0;dda<DDA_PER_ATRI;dda++) {
+        for(int chan=0;chan<RFCHAN_PER_DDA;chan++) {
+            fSlot[dda][chan]=-1;
+            fTables->fAtriVoltsConvChan[dda][chan]=-1;
+            if( !((dda==0 && chan<6)||(dda==1 && chan<4)||(dda==2 && chan<4)||(dda==3 && chan<6)) ) continue;
+            fSlot[dda][chan]=fTables->fAtriVoltsConvChan[dda][chan]=fNumConvChans++;
+        }
+    }
+    Int_t numSpillChans=0;
+    for(int dda=0;dda<DDA_PER_ATRI && fTables->fAtriConvStation5;dda++) {
+        for(int chan=0;chan+1<RFCHAN_PER_DDA;chan++) {
+            if(fSlot[dda][chan]>=0 && fSlot[dda][chan+1]<0) fSlot[dda][chan+1]=fNumConvChans+numSpillChans++;
+        }
+    }
+    //! Samples missing from the files keep a fit of zeros, as the full tables used to be initialised
+    fTables->fAtriVoltsConv.assign(ATRI_VOLTS_CONV_CHANS*SAMPLES_PER_DDA, AraAtriVoltsConv());
+    fSpillConv.assign(numSpillChans*SAMPLES_PER_DDA, AraAtriVoltsConv());
+    fBadFit.assign((fNumConvChans+numSpillChans)*SAMPLES_PER_DDA, 0);
+}
+
+/*!
+    Check if the fit worked out well parameter[8] is the Chi^2/NDF of the fit. Normally it is very good if <1.0.
+    For A2/3, If Chi^2/NDF is > 1.0, the conversion factor of the same sample number in a neighboring block, provided it has a better Chi^2/NDF value, will be used. -- Thomas's thesis p.69
+    For A5, the conversion factor of the neighboring sample, provided it has a better Chi^2/NDF value, will be used, and even samples are dumped.
+    This used to be searched for every sample of every event. The A5 search runs over the samples of the whole dda, so it can end up in the next channel's table, as it always did.
+
+    The search only ever ends on a fit that is good or on the sample it started from, and the next channel is resolved after this one,
+    so the fits it ends on have not been replaced yet and can be copied in place.
+*/
+void AraAtriVoltsConvLoader::resolve()
+{
+    int blocks_per_dda = BLOCKS_PER_DDA;
+    int samples_per_dda = SAMPLES_PER_DDA;
+    int neighboring_index = 2; ///< Define neighboring sample or block offset. Based on Thomas's thesis p.69
+
+    for(int dda=0;dda<DDA_PER_ATRI;dda++) {
+        for(int chan=0;chan<RFCHAN_PER_DDA;chan++) {
+            if(fTables->fAtriVoltsConvChan[dda][chan]<0) continue;
+            for(int block=0;block<blocks_per_dda;block++) {
+                for(int sample=0;sample<SAMPLES_PER_BLOCK;sample++) {
+                    //! Walk to the fit that is used, giving up after a full turn rather than looping for ever
+                    int useBlock=block;
+                    int useSample=sample;
+                    int step=0;
+                    if (!fTables->fAtriConvStation5){
+                        for(step=0;step<blocks_per_dda && isBad(dda, chan, useBlock*SAMPLES_PER_BLOCK + useSample);step++)
+                            useBlock = (useBlock - neighboring_index + blocks_per_dda)%blocks_per_dda;
+                    } else {
+                        if (useSample%2==0 && chan>0) useSample=(useSample+1)%samples_per_dda; ///< Dumping even samples
+                        for(step=0;step<samples_per_dda && isBad(dda, chan, useBlock*SAMPLES_PER_BLOCK + useSample);step++)
+                            useSample = (useSample - neighboring_index + samples_per_dda)%samples_per_dda;
+                    }
+                    if(step>0) fTables->fNumVoltsConvFallbacks++;
+                    AraAtriVoltsConv *conv=getConv(dda, chan, block*SAMPLES_PER_BLOCK + sample);
+                    AraAtriVoltsConv *useConv=getSearchConv(dda, chan, useBlock*SAMPLES_PER_BLOCK + useSample);
+                    if(useConv!=conv) *conv=*useConv;
+                }
+            }
+        }
+    }
+}
+
+/*!
+    \param stationId id of the station
+    \param epoch the calibration epoch, see getAtriCalibEpoch()
+    \return the tables, NULL if the station is unknown
+*/
+AraAtriCalibTables *AraEventCalibrator::loadAtriCalibFromText(AraStationId_t stationId, Int_t epoch)
+{
+    Int_t calibIndex = AraGeomTool::getStationCalibIndex(stationId);
+    // std::cout << "Loading calibration info for station: " << (int)stationId << "\t" << calibIndex << "\n";
+    if(calibIndex==-1){
+        fprintf(stderr, "AraEventCalibrator::loadAtriCalib -- ERROR Unknown stationId %i\n", stationId);
+        return NULL;
+    }
+
+    char calibFile[FILENAME_MAX];
+    char calibDir[FILENAME_MAX];
+    getAtriCalibDir(calibDir);
 
     int dda,chan,sample,capArray;
+    AraAtriCalibTables *tables = new AraAtriCalibTables(stationId, epoch);
 
 
     // Reading the reference VadjValues from file (only for ARA02). -THM-
@@ -1636,19 +2937,7 @@ void AraEventCalibrator::loadAtriCalib(AraStationId_t stationId, Double_t unixti
     } //end modification -THM-
 
     // sprintf(calibFile,"%s/ATRI/araAtriStation%iSampleTiming.txt",calibDir, stationId);
-    /*!    
-        MK added 08-02-2022
-        WFs that recorded from A3 string 4 show ADC counts duplication from December 2018
-        It looks like every even group of 16 samples is duplicated (overwriting) to an odd group of 16 samples
-        In order to remove duplicate samples, a new timing table for the 2019 data set are implemented 
-        It will exclude the samples that contain duplicated ADC
-        Related talk: https://aradocs.wipac.wisc.edu/cgi-bin/DocDB/ShowDocument?docid=2535
-    
-        MK added 10-09-2022
-        It looks like duplication is disappeared from 2019-2020 pole season
-        The new timing table will be only used between Run12866 and Run16481
-    */
-    if (stationId==3 && unixtime > 1544125405 && unixtime < 1576210568){ ///< use new timing table from A3 Run12866 (2018/12/21) until Run16481 (2019/12/13)
+    if (tables->fEpoch==1){ ///< use new timing table from A3 Run12866 (2018/12/21) until Run16481 (2019/12/13), see getAtriCalibEpoch() -MK-
         sprintf(calibFile,"%s/ATRI/araAtriStation%iSampleTimingNew_2019DataSet.txt",calibDir, stationId);
     }
     else {
@@ -1666,10 +2955,10 @@ void AraEventCalibrator::loadAtriCalib(AraStationId_t stationId, Double_t unixti
         for(chan=0;chan<RFCHAN_PER_DDA;chan++) {
             for(capArray=0;capArray<2;capArray++) {
                 for(sample=0;sample<SAMPLES_PER_BLOCK;sample++) {
-                    fAtriSampleTimes[dda][chan][capArray][sample]=sample/3.2;
-                    fAtriSampleIndex[dda][chan][capArray][sample]=-1;
+                    tables->fAtriSampleTimes[dda][chan][capArray][sample]=sample/3.2;
+                    tables->fAtriSampleIndex[dda][chan][capArray][sample]=-1;
                 }
-                fAtriEpsilonTimes[dda][chan][capArray]=1/3.2;
+                tables->fAtriEpsilonTimes[dda][chan][capArray]=1/3.2;
             }
         }
     }
@@ -1677,49 +2966,61 @@ void AraEventCalibrator::loadAtriCalib(AraStationId_t stationId, Double_t unixti
     Double_t value;
     Int_t index;
     while(SampleFile >> dda >> chan >> capArray){
-        SampleFile >> fAtriNumSamples[dda][chan][capArray];
-        // std::cerr <<  dda << "\t" << chan << "\t" << capArray << "\t" << fAtriNumSamples[dda][chan][capArray] << "\t";
-        for(sample=0;sample<fAtriNumSamples[dda][chan][capArray];sample++) {
+        SampleFile >> tables->fAtriNumSamples[dda][chan][capArray];
+        // std::cerr <<  dda << "\t" << chan << "\t" << capArray << "\t" << tables->fAtriNumSamples[dda][chan][capArray] << "\t";
+        for(sample=0;sample<tables->fAtriNumSamples[dda][chan][capArray];sample++) {
             SampleFile >> index;
-            fAtriSampleIndex[dda][chan][capArray][sample]=index;
-            // std::cerr << fAtriSampleIndex[dda][chan][capArray][sample] << " ";    
+            tables->fAtriSampleIndex[dda][chan][capArray][sample]=index;
+            // std::cerr << tables->fAtriSampleIndex[dda][chan][capArray][sample] << " ";    
         }
         // std::cerr << "\n";
-        SampleFile >> dda >> chan >> capArray >> fAtriNumSamples[dda][chan][capArray];
-        // std::cerr <<  dda << "\t" << chan << "\t" << capArray << "\t" << fAtriNumSamples[dda][chan][capArray] << "\t";
-        for(sample=0;sample<fAtriNumSamples[dda][chan][capArray];sample++) {
+        SampleFile >> dda >> chan >> capArray >> tables->fAtriNumSamples[dda][chan][capArray];
+        // std::cerr <<  dda << "\t" << chan << "\t" << capArray << "\t" << tables->fAtriNumSamples[dda][chan][capArray] << "\t";
+        for(sample=0;sample<tables->fAtriNumSamples[dda][chan][capArray];sample++) {
             SampleFile >> value;
             // Now the sample times are read and corrected compared to the TSA reference for a change of Vadj. Note that this should be only done for ARA02 so far. 
             // Only for ARA02 we have data about the dependency of the sampling speed on Vadj which look reliable. Maybe we can fix this with future measurements.
             // Current Vadj somehow needs to get here from the eventHk-file. Not sure what the best way is. -THM- 
             if(stationId==2){
-                fAtriSampleTimes[dda][chan][capArray][sample]=value * 1.0/(0.9978 - 0.0002*(VadjRef[dda] - currentVadj[dda]));
+                tables->fAtriSampleTimes[dda][chan][capArray][sample]=value * 1.0/(0.9978 - 0.0002*(VadjRef[dda] - currentVadj[dda]));
             }
             else{
-                fAtriSampleTimes[dda][chan][capArray][sample]=value;
+                tables->fAtriSampleTimes[dda][chan][capArray][sample]=value;
             } //end modification -THM-
-            // std::cerr << fAtriSampleTimes[dda][chan][capArray][sample] << " ";    
+            // std::cerr << tables->fAtriSampleTimes[dda][chan][capArray][sample] << " ";    
         }
         // std::cerr << "\n";
     }
     SampleFile.close();
 
     // RJN -- Add call to check sample timing
-    checkAtriSampleTiming();
+    tables->checkSampleTiming();
 
     // Read the ADC to volts conversion factors for the range between -400 and 400 ADC counts. -THM-
+    // The fits go straight into the tables, only for the channels that use them, see AraAtriVoltsConvLoader
     int blockNumber;
     double conv;
+    AraAtriVoltsConvLoader voltsConv(tables);
     char adcToVoltageConvFile[200];
     sprintf(adcToVoltageConvFile,"%s/ATRI/araAtriStation%iadcToVoltsConv.txt", calibDir, stationId );
     fprintf(stdout, "AraEventCalibrator::loadAtriCalib(): INFO - Voltage-calibration file = %s\n", adcToVoltageConvFile);//DEBUG
     std::ifstream ADCConvFile(adcToVoltageConvFile);
     if(ADCConvFile.is_open()) {
          while(ADCConvFile >> dda >> chan >> blockNumber){
+            if(dda<0 || dda>=DDA_PER_ATRI || chan<0 || chan>=RFCHAN_PER_DDA || blockNumber<0 || blockNumber>=BLOCKS_PER_DDA) {
+                std::cerr << "Bad dda / chan / block " << dda << " " << chan << " " << blockNumber << " in: " << adcToVoltageConvFile << "\n";
+                abort();
+            }
             for(sample=0;sample<64;sample++){
+                // pos_fit_x, pos_fit_x^2, pos_fit_x^3, neg_fit_x, neg_fit_x^2, neg_fit_x^3, fit_const, zeroval, chi2
+                AraAtriVoltsConv *sampleConv=voltsConv.getConv(dda, chan, blockNumber*SAMPLES_PER_BLOCK + sample);
                 for(int cv=0;cv<9;cv++){
                     ADCConvFile >> conv;
-                    fAtriSampleADCVoltsConversion[dda][chan][blockNumber][sample][cv] = conv;
+                    if(!sampleConv) continue;
+                    if(cv<6) sampleConv->fit[cv/3][cv%3] = conv;
+                    else if(cv==6) sampleConv->fitConst = tables->fAtriConvStation5 ? 0.0 : conv;
+                    else if(cv==7) sampleConv->zeroVal = conv;
+                    else voltsConv.setChi2(dda, chan, blockNumber*SAMPLES_PER_BLOCK + sample, conv);
                 }
             }
         }
@@ -1738,10 +3039,16 @@ void AraEventCalibrator::loadAtriCalib(AraStationId_t stationId, Double_t unixti
     std::ifstream highADCConvFile(highAdcToVoltageConvFile);
     if(highADCConvFile.is_open()) {
         while(highADCConvFile >> dda >> chan >> blockNumber){
+            if(dda<0 || dda>=DDA_PER_ATRI || chan<0 || chan>=RFCHAN_PER_DDA || blockNumber<0 || blockNumber>=BLOCKS_PER_DDA) {
+                std::cerr << "Bad dda / chan / block " << dda << " " << chan << " " << blockNumber << " in: " << highAdcToVoltageConvFile << "\n";
+                abort();
+            }
             for(sample=0;sample<64;sample++){
+                // pos_fit_const, pos_fit_x, neg_fit_const, neg_fit_x, chi2
+                AraAtriVoltsConv *sampleConv=voltsConv.getConv(dda, chan, blockNumber*SAMPLES_PER_BLOCK + sample);
                 for(int cv=0;cv<5;cv++){
                     highADCConvFile >> conv;
-                    fAtriSampleHighADCVoltsConversion[dda][chan][blockNumber][sample][cv] = conv;
+                    if(sampleConv && cv<4) sampleConv->highFit[cv/2][cv%2] = conv;
                 }
             }
         }
@@ -1751,6 +3058,7 @@ void AraEventCalibrator::loadAtriCalib(AraStationId_t stationId, Double_t unixti
         std::cerr << "Can not open: " << highAdcToVoltageConvFile << "\n";
         abort();
     }
+    voltsConv.resolve();
     // end modification -THM-
 
     char epsilonFileName[100];
@@ -1760,7 +3068,7 @@ void AraEventCalibrator::loadAtriCalib(AraStationId_t stationId, Double_t unixti
     if(epsilonFile.is_open()) {
          while(epsilonFile >> dda >> chan >> capArray){
             epsilonFile >> value;
-            fAtriEpsilonTimes[dda][chan][capArray]=value;
+            tables->fAtriEpsilonTimes[dda][chan][capArray]=value;
             // printf("%s : dda %i channel %i capArray %f\n", __FUNCTION__, dda, chan, value);
          }
         epsilonFile.close();
@@ -1778,9 +3086,9 @@ void AraEventCalibrator::loadAtriCalib(AraStationId_t stationId, Double_t unixti
 //  int thisDda=0;
 //  int thisChan=6;
 //  int thisCapArray=block%2;
-//  if(block!=0) time+=fAtriEpsilonTimes[thisDda][thisChan][thisCapArray];
-//  for (int samp=0;samp<fAtriNumSamples[thisDda][thisChan][thisCapArray];samp++) {
-//     Double_t sampTime=time+fAtriSampleTimes[thisDda][thisChan][thisCapArray][samp];
+//  if(block!=0) time+=tables->fAtriEpsilonTimes[thisDda][thisChan][thisCapArray];
+//  for (int samp=0;samp<tables->fAtriNumSamples[thisDda][thisChan][thisCapArray];samp++) {
+//     Double_t sampTime=time+tables->fAtriSampleTimes[thisDda][thisChan][thisCapArray][samp];
 //     std::cout << index << "\t" << sampTime << "\t" << sampTime-lastTime << "\n";
 //     index++;
 //     lastTime=sampTime;
@@ -1803,13 +3111,10 @@ void AraEventCalibrator::loadAtriCalib(AraStationId_t stationId, Double_t unixti
 
 
 
-    // RJN change 13-Feb-2013
-    memset(fGotAtriCalibFile,ATRI_NO_STATIONS*sizeof(Int_t),0);
-    calibIndex = AraGeomTool::getStationCalibIndex(stationId);
-    fGotAtriCalibFile[calibIndex]=1;
+    return tables;
 }
 
-void AraEventCalibrator::checkAtriSampleTiming() {
+void AraAtriCalibTables::checkSampleTiming() {
     for(int dda=0;dda<DDA_PER_ATRI;dda++) {
         for(int chan=0;chan<RFCHAN_PER_DDA;chan++) {
             int madeChange=0;
@@ -1852,24 +3157,7 @@ Bool_t AraEventCalibrator::fileExists(char *fileName){
 
 
 Int_t AraEventCalibrator::numberOfPedestalValsInFile(char *fileName){
-    Int_t numPedVals=0;
-    gzFile inPed = gzopen(fileName, "r");
-    if(inPed){
-        std::vector<char> buffer(6000000);
-        int nRead = gzread(inPed, &buffer[0], sizeof(char)*6000000);
-        std::string string_buffer(buffer.begin(), buffer.end()); // convert the vector of chars to a string
-        std::stringstream ss(string_buffer); // and then convert the string to a stringstream
-
-        std::string dummy;
-        while( ss >> dummy >> dummy >> dummy){
-            for(int samp=0; samp < SAMPLES_PER_BLOCK; samp++){
-                ss >> dummy;
-                numPedVals++;
-            }
-        }
-    }
-    gzclose(inPed);
-    return numPedVals;
+    return AraAtriPedestalFile::numberOfValues(fileName);
 }
 
 /*! 
@@ -1877,6 +3165,9 @@ Int_t AraEventCalibrator::numberOfPedestalValsInFile(char *fileName){
     Currently, the way to treat for the loaded conversion table is optimized for just A2/3 and A5 
     And default treatment for the loaded conversion table is following A2/3 optimization
     In the future, If the conversion table for A1/4 has a different number of parameters or need different treatment, It need to be updated 
+
+    The fits with a bad Chi^2/NDF and the station dependent constants are already resolved by AraAtriVoltsConvLoader when the tables are loaded,
+    so this is just a lookup in fAtriVoltsConv.
 */
 /*!
     \param adcCountsIn ADC value from the WF sample 
@@ -1884,119 +3175,212 @@ Int_t AraEventCalibrator::numberOfPedestalValsInFile(char *fileName){
     \param block corresponding black number of adcCountsIn
     \param chan corresponding dda channel number of adcCountsIn
     \param sample corresponding sample number of adcCountsIn
-    \param stationId id of the station
     \return void
 */
-Double_t AraEventCalibrator::convertADCtoMilliVolts(Double_t adcCountsIn, int dda, int block, int chan, int sample, AraStationId_t stationId) ///< -THM-, -MK- imports the station id to optimize conversion for each station
+Double_t AraAtriCalibTables::convertADCtoMilliVolts(Double_t adcCountsIn, int dda, int block, int chan, int sample) const ///< -THM-, -MK- imports the station id to optimize conversion for each station
 {
-    
-    Double_t volts = 0.0;
-    int samples_per_block = SAMPLES_PER_BLOCK;
-    int blocks_per_dda = BLOCKS_PER_DDA;
-    int samples_per_dda = SAMPLES_PER_DDA;
+    //! Offset needs to be subtracted
+    double adcCounts = adcCountsIn + fAtriAdcOffset;
 
-    /*!
-       There is an offset induced in the pedestal numbers, due to asymmetry of the chip. 
-       From calibration files this offset with the given noise will be around 11 ADC counts.
-       If it's not station 5, subtract an offset of 11. (THM)
-    */
-    double adc_offset; 
-    int high_adc_limit; ///< Define the high ADC limit here (MK)
-    if (stationId != 5){
-        high_adc_limit = 400;
-        adc_offset = -11.0;
-    } else {
-        high_adc_limit = 500;
-        adc_offset = 0.0;
-    }
+    //! Only apply calibration on calibrated channels (RF channels)!
+    Int_t convChan=fAtriVoltsConvChan[dda][chan];
+    if(convChan<0) return adcCounts;
 
-    //! Define neighboring sample or block offset. Based on Thomas's thesis p.69
-    int neighboring_index = 2;
+    const AraAtriVoltsConv &conv=fAtriVoltsConv[(convChan*BLOCKS_PER_DDA + block)*SAMPLES_PER_BLOCK + sample];
 
-    /*! 
-        Each conversion parameter in fAtriSampleADCVoltsConversion: pos_fit_x, pos_fit_x^2, pos_fit_x^3, neg_fit_x, neg_fit_x^2, neg_fit_x^3, fit_const, zeroval, chi2
-        Each conversion parameter in fAtriSampleHighADCVoltsConversion: pos_fit_const, pos_fit_x, neg_fit_const, neg_fit_x
-    */
-    //std::cout << chan << ", "<< block<<", " << sample << std::endl;
-    //! Only apply calibration on calibrated channels (RF channels)!
-    if( (dda==0 && chan<6)||(dda==1 && chan<4)||(dda==2 && chan<4)||(dda==3 && chan<6) ){
-
-        /*! 
-            Check if the fit worked out well parameter[8] is the Chi^2/NDF of the fit. Normally it is very good if <1.0.
-            For A2/3, If Chi^2/NDF is > 1.0, the conversion factor of the same sample number in a neighboring block, provided it has a better Chi^2/NDF value, will be used. -- Thomas's thesis p.69
-            For A5, the conversion factor of the neighboring sample, provided it has a better Chi^2/NDF value, will be used.
-        */
-        if (stationId != 5){
-            while(fAtriSampleADCVoltsConversion[dda][chan][block][sample][8]>1.0) block = (block - neighboring_index + blocks_per_dda)%blocks_per_dda;
-        } else {
-            if (sample%2==0 && chan>0) sample=(sample+1)%samples_per_dda; ///< Dumping even samples
-            while(fAtriSampleADCVoltsConversion[dda][chan][block][sample][8]>1.0) sample = (sample - neighboring_index + samples_per_dda)%samples_per_dda;
-        }
-
-        //! Offset needs to be subtracted
-        double adcCounts = adcCountsIn + adc_offset;
-
-        //! Start ADC to voltage conversion
-        if(TMath::Abs(adcCounts)<high_adc_limit){
-            //! conversion factors for higher ADC values have strong errors, therefore we need the alternative calibration (see below)
-            //! RJN chnaged the below to remove calls to pow for code optimisation
-            double modAdcCounts=adcCounts-fAtriSampleADCVoltsConversion[dda][chan][block][sample][7];
-            //double modAdcCounts=adcCounts;//-fAtriSampleADCVoltsConversion[dda][chan][block][sample][7];
-
-            Double_t fit_const; ///< Define the fit_const here (MK)
-            double adc_zero_def; ///< Define which value will be used to choose a positive or negative conversion
-            if (stationId != 5) {
-                fit_const = fAtriSampleADCVoltsConversion[dda][chan][block][sample][6];
-                adc_zero_def = adcCounts;
-            } else {
-                fit_const = 0.0;
-                adc_zero_def = modAdcCounts;
-            }
+    //! Start ADC to voltage conversion
+    if(TMath::Abs(adcCounts)<fAtriHighAdcLimit){
+        //! conversion factors for higher ADC values have strong errors, therefore we need the alternative calibration (see below)
+        double modAdcCounts=adcCounts-conv.zeroVal;
 
-            if(adc_zero_def>0){
-                //! positive and negative values need different calibration constants
-                volts = fit_const
-                    +modAdcCounts*fAtriSampleADCVoltsConversion[dda][chan][block][sample][0] 
-                    +modAdcCounts*modAdcCounts*fAtriSampleADCVoltsConversion[dda][chan][block][sample][1] 
-                    +modAdcCounts*modAdcCounts*modAdcCounts*fAtriSampleADCVoltsConversion[dda][chan][block][sample][2]; 
-            }
-            else{
-                volts = fit_const      
-                    +modAdcCounts*fAtriSampleADCVoltsConversion[dda][chan][block][sample][3] 
-                    +modAdcCounts*modAdcCounts*fAtriSampleADCVoltsConversion[dda][chan][block][sample][4]
-                    +modAdcCounts*modAdcCounts*modAdcCounts*fAtriSampleADCVoltsConversion[dda][chan][block][sample][5];
-            }
+        //! positive and negative values need different calibration constants. A5 picks them by the zero corrected ADC
+        double adc_zero_def = fAtriConvStation5 ? modAdcCounts : adcCounts;
+        const Float_t *fit = conv.fit[adc_zero_def>0 ? 0 : 1];
+        Double_t volts = conv.fitConst
+            +modAdcCounts*fit[0]
+            +modAdcCounts*modAdcCounts*fit[1]
+            +modAdcCounts*modAdcCounts*modAdcCounts*fit[2];
 
-            /*!
-                For A5, since there is no high ADC calibration data, use ADC count
-                If ADC count between -500 ~ 500 is converted to over 800 mV, this condition decides to use just ADC value instead of the conversion result
-                It seems ADC values between -400 ~ 400 are not converted to over 800 millivolts on A2/3
-                Related talk: https://aradocs.wipac.wisc.edu/cgi-bin/DocDB/ShowDocument?docid=2464 (slide 16 ~17)
-                I leave this condition just for A5 -MK-
-            */
-            if (stationId == 5 && volts > 800) volts=modAdcCounts;
+        //! For A5, since there is no high ADC calibration data, use ADC count if the conversion goes over 800 mV -MK-
+        if (fAtriConvStation5 && volts > 800) volts=modAdcCounts;
+        return volts;
+    }
+
+    //! For A5, since there is no high ADC calibration data, use ADC count for conervison result in case A5 encount high ADC count
+    if(fAtriConvStation5) return adcCounts;
+
+    //! here is the alternative calibration (used only for A2 and A3) if the ADC count exceeds 400
+    const Float_t *highFit = conv.highFit[adcCounts>0 ? 0 : 1];
+    return highFit[0] + adcCounts*highFit[1];
+}
 
+//! Field offsets, in floats, of the coefficients in an AraAtriVoltsConv
+enum EAraAtriVoltsConvField {
+    kConvPosFit = 0,
+    kConvNegFit = 3,
+    kConvFitConst = 6,
+    kConvZeroVal = 7,
+    kConvHighPos = 8,
+    kConvHighNeg = 10,
+    kConvNumFloats = 12
+};
+static_assert(sizeof(AraAtriVoltsConv)==kConvNumFloats*sizeof(Float_t), "AraAtriVoltsConv must be packed floats");
+
+#if defined(__AVX2__)
+//! AVX2 version of convertChanADCtoMilliVolts(), four samples at a time
+/*!
+    Every branch of convertADCtoMilliVolts() is evaluated and the result is picked by mask.
+    The arithmetic is done in double in the same order as the scalar code.
+    \return the number of samples converted, a multiple of four
+*/
+static Int_t convertAtriVoltsAVX2(const AraAtriVoltsConv *chanConv, Int_t numSamples, const Double_t *adcCountsIn, const Int_t *sampleIndex, Double_t *voltsOut, Double_t adcOffset, Int_t highAdcLimit, Bool_t station5)
+{
+    const float *base = (const float*)chanConv;
+    const __m256d offset = _mm256_set1_pd(adcOffset);
+    const __m256d limit = _mm256_set1_pd((double)highAdcLimit);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d clamp = _mm256_set1_pd(800.);
+    const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+    const __m128i stride = _mm_set1_epi32(kConvNumFloats);
+
+    Int_t samp=0;
+    for(;samp+4<=numSamples;samp+=4) {
+        __m128i idx = _mm_mullo_epi32(_mm_loadu_si128((const __m128i*)(sampleIndex+samp)), stride);
+#define ARA_CONV_GATHER(field) _mm256_cvtps_pd(_mm_i32gather_ps(base+(field), idx, 4))
+        __m256d adcCounts = _mm256_add_pd(_mm256_loadu_pd(adcCountsIn+samp), offset);
+        __m256d modAdcCounts = _mm256_sub_pd(adcCounts, ARA_CONV_GATHER(kConvZeroVal));
+        __m256d pos = _mm256_cmp_pd(station5 ? modAdcCounts : adcCounts, zero, _CMP_GT_OQ);
+        __m256d fit0 = _mm256_blendv_pd(ARA_CONV_GATHER(kConvNegFit+0), ARA_CONV_GATHER(kConvPosFit+0), pos);
+        __m256d fit1 = _mm256_blendv_pd(ARA_CONV_GATHER(kConvNegFit+1), ARA_CONV_GATHER(kConvPosFit+1), pos);
+        __m256d fit2 = _mm256_blendv_pd(ARA_CONV_GATHER(kConvNegFit+2), ARA_CONV_GATHER(kConvPosFit+2), pos);
+        __m256d mod2 = _mm256_mul_pd(modAdcCounts, modAdcCounts);
+        __m256d mod3 = _mm256_mul_pd(mod2, modAdcCounts);
+        __m256d volts = _mm256_add_pd(ARA_CONV_GATHER(kConvFitConst), _mm256_mul_pd(modAdcCounts, fit0));
+        volts = _mm256_add_pd(volts, _mm256_mul_pd(mod2, fit1));
+        volts = _mm256_add_pd(volts, _mm256_mul_pd(mod3, fit2));
+
+        __m256d high;
+        if(station5) {
+            volts = _mm256_blendv_pd(volts, modAdcCounts, _mm256_cmp_pd(volts, clamp, _CMP_GT_OQ));
+            high = adcCounts;
         }
         else {
-            if (stationId != 5){
-                //! here is the alternative calibration (used only for A2 and A3) if the ADC count exceeds 400
-                if(adcCounts>0) {
-                    volts = fAtriSampleHighADCVoltsConversion[dda][chan][block][sample][0] 
-                    + adcCounts*fAtriSampleHighADCVoltsConversion[dda][chan][block][sample][1];
-                }
-                else{
-                    volts = fAtriSampleHighADCVoltsConversion[dda][chan][block][sample][2] 
-                    + adcCounts*fAtriSampleHighADCVoltsConversion[dda][chan][block][sample][3];
-                }
-            } else {
-                //! For A5, since there is no high ADC calibration data, use ADC count for conervison result in case A5 encount high ADC count
-                volts = adcCountsIn + adc_offset;
-            }
+            __m256d highPos = _mm256_add_pd(ARA_CONV_GATHER(kConvHighPos), _mm256_mul_pd(adcCounts, ARA_CONV_GATHER(kConvHighPos+1)));
+            __m256d highNeg = _mm256_add_pd(ARA_CONV_GATHER(kConvHighNeg), _mm256_mul_pd(adcCounts, ARA_CONV_GATHER(kConvHighNeg+1)));
+            high = _mm256_blendv_pd(highNeg, highPos, _mm256_cmp_pd(adcCounts, zero, _CMP_GT_OQ));
         }
-        
+#undef ARA_CONV_GATHER
+        __m256d low = _mm256_cmp_pd(_mm256_and_pd(adcCounts, absMask), limit, _CMP_LT_OQ);
+        _mm256_storeu_pd(voltsOut+samp, _mm256_blendv_pd(high, volts, low));
     }
-    else{
-        volts = adcCountsIn + adc_offset;
+    return samp;
+}
+#elif defined(__SSE2__)
+//! Picks a where mask is set and b elsewhere
+static inline __m128d sse2Select(__m128d mask, __m128d a, __m128d b)
+{
+    return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+//! SSE2 version of convertChanADCtoMilliVolts(), two samples at a time
+/*!
+    Every branch of convertADCtoMilliVolts() is evaluated and the result is picked by mask.
+    The arithmetic is done in double in the same order as the scalar code.
+    \return the number of samples converted, a multiple of two
+*/
+static Int_t convertAtriVoltsSSE2(const AraAtriVoltsConv *chanConv, Int_t numSamples, const Double_t *adcCountsIn, const Int_t *sampleIndex, Double_t *voltsOut, Double_t adcOffset, Int_t highAdcLimit, Bool_t station5)
+{
+    const __m128d offset = _mm_set1_pd(adcOffset);
+    const __m128d limit = _mm_set1_pd((double)highAdcLimit);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d clamp = _mm_set1_pd(800.);
+    const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+
+    Int_t samp=0;
+    for(;samp+2<=numSamples;samp+=2) {
+        const float *c0 = (const float*)(chanConv+sampleIndex[samp]);
+        const float *c1 = (const float*)(chanConv+sampleIndex[samp+1]);
+#define ARA_CONV_LOAD(field) _mm_set_pd(c1[field], c0[field])
+        __m128d adcCounts = _mm_add_pd(_mm_loadu_pd(adcCountsIn+samp), offset);
+        __m128d modAdcCounts = _mm_sub_pd(adcCounts, ARA_CONV_LOAD(kConvZeroVal));
+        __m128d pos = _mm_cmpgt_pd(station5 ? modAdcCounts : adcCounts, zero);
+        __m128d fit0 = sse2Select(pos, ARA_CONV_LOAD(kConvPosFit+0), ARA_CONV_LOAD(kConvNegFit+0));
+        __m128d fit1 = sse2Select(pos, ARA_CONV_LOAD(kConvPosFit+1), ARA_CONV_LOAD(kConvNegFit+1));
+        __m128d fit2 = sse2Select(pos, ARA_CONV_LOAD(kConvPosFit+2), ARA_CONV_LOAD(kConvNegFit+2));
+        __m128d mod2 = _mm_mul_pd(modAdcCounts, modAdcCounts);
+        __m128d mod3 = _mm_mul_pd(mod2, modAdcCounts);
+        __m128d volts = _mm_add_pd(ARA_CONV_LOAD(kConvFitConst), _mm_mul_pd(modAdcCounts, fit0));
+        volts = _mm_add_pd(volts, _mm_mul_pd(mod2, fit1));
+        volts = _mm_add_pd(volts, _mm_mul_pd(mod3, fit2));
+
+        __m128d high;
+        if(station5) {
+            volts = sse2Select(_mm_cmpgt_pd(volts, clamp), modAdcCounts, volts);
+            high = adcCounts;
+        }
+        else {
+            __m128d highPos = _mm_add_pd(ARA_CONV_LOAD(kConvHighPos), _mm_mul_pd(adcCounts, ARA_CONV_LOAD(kConvHighPos+1)));
+            __m128d highNeg = _mm_add_pd(ARA_CONV_LOAD(kConvHighNeg), _mm_mul_pd(adcCounts, ARA_CONV_LOAD(kConvHighNeg+1)));
+            high = sse2Select(_mm_cmpgt_pd(adcCounts, zero), highPos, highNeg);
+        }
+#undef ARA_CONV_LOAD
+        __m128d low = _mm_cmplt_pd(_mm_and_pd(adcCounts, absMask), limit);
+        _mm_storeu_pd(voltsOut+samp, sse2Select(low, volts, high));
+    }
+    return samp;
+}
+#endif
+
+//! Converts a whole channel from ADC counts to millivolts
+/*!
+    Gives the same result as calling convertADCtoMilliVolts() for every sample, but uses SSE2 or, when built with AVX2, AVX2 for all but the last few samples.
+    Builds without either use the scalar conversion throughout.
+    \param numSamples number of samples in the channel
+    \param adcCountsIn ADC values of the WF samples
+    \param sampleIndex capacitor sample index (block * SAMPLES_PER_BLOCK + sample) of each WF sample
+    \param dda corresponding dda board number
+    \param chan corresponding dda channel number
+    \param voltsOut converted voltages, may be the same array as adcCountsIn
+    \return void
+*/
+void AraAtriCalibTables::convertChanADCtoMilliVolts(Int_t numSamples, const Double_t *adcCountsIn, const Int_t *sampleIndex, int dda, int chan, Double_t *voltsOut) const
+{
+    Int_t samp=0;
+    Int_t convChan=fAtriVoltsConvChan[dda][chan];
+    if(convChan>=0) {
+#if defined(__AVX2__)
+        samp=convertAtriVoltsAVX2(&fAtriVoltsConv[convChan*BLOCKS_PER_DDA*SAMPLES_PER_BLOCK], numSamples, adcCountsIn, sampleIndex, voltsOut, fAtriAdcOffset, fAtriHighAdcLimit, fAtriConvStation5);
+#elif defined(__SSE2__)
+        samp=convertAtriVoltsSSE2(&fAtriVoltsConv[convChan*BLOCKS_PER_DDA*SAMPLES_PER_BLOCK], numSamples, adcCountsIn, sampleIndex, voltsOut, fAtriAdcOffset, fAtriHighAdcLimit, fAtriConvStation5);
+#endif
+    }
+    for(;samp<numSamples;samp++) {
+        voltsOut[samp]=convertADCtoMilliVolts(adcCountsIn[samp], dda, sampleIndex[samp]/SAMPLES_PER_BLOCK, chan, sampleIndex[samp]%SAMPLES_PER_BLOCK);
     }
-    return volts;
+}
+
+//! ADC to millivolts conversion of one sample with the tables of a station
+/*!
+    Uses the tables of the event this thread is calibrating, or last calibrated, if it is from this station, otherwise the station's epoch 0 tables.
+    \param adcCountsIn ADC value from the WF sample 
+    \param dda corresponding dda board number of adcCountsIn
+    \param block corresponding black number of adcCountsIn
+    \param chan corresponding dda channel number of adcCountsIn
+    \param sample corresponding sample number of adcCountsIn
+    \param stationId id of the station
+    \return the voltage in millivolts
+*/
+Double_t AraEventCalibrator::convertADCtoMilliVolts(Double_t adcCountsIn, int dda, int block, int chan, int sample, AraStationId_t stationId)
+{
+    AraCalibrationContext *ctx = getContext();
+    if(!ctx->atriCalib || ctx->atriCalib->fStationId!=stationId) ctx->atriCalib=getAtriCalibTables(stationId, 0);
+    return ctx->atriCalib->convertADCtoMilliVolts(adcCountsIn, dda, block, chan, sample);
+}
+
+//! Whole channel version of convertADCtoMilliVolts(), choosing the tables the same way
+void AraEventCalibrator::convertChanADCtoMilliVolts(Int_t numSamples, const Double_t *adcCountsIn, const Int_t *sampleIndex, int dda, int chan, AraStationId_t stationId, Double_t *voltsOut)
+{
+    AraCalibrationContext *ctx = getContext();
+    if(!ctx->atriCalib || ctx->atriCalib->fStationId!=stationId) ctx->atriCalib=getAtriCalibTables(stationId, 0);
+    ctx->atriCalib->convertChanADCtoMilliVolts(numSamples, adcCountsIn, sampleIndex, dda, chan, voltsOut);
 }
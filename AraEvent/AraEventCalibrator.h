@@ -15,7 +15,12 @@
 #include "araAtriStructures.h"
 #include "araIcrrStructures.h"
 #include "araIcrrDefines.h"
+#include "AraAtriEventView.h"
 #include <map>
+#include <vector>
+#ifndef __CINT__
+#include <memory>
+#endif
 
 #define ADCMV 0.939   /* mV/adc, per Gary's email of 05/04/2006 */
 #define SATURATION 1300 
@@ -48,7 +53,7 @@ namespace AraCalType {
             Useful CalType for raw data debugging, 19-12-2021 -MK- 
             kOnlyADC~: Get the raw ADC WF
             kOnlyPed~: Get the pedestal values for the corresponding WF.
-                       If user selects kOnlyPed~, PedestalSubtraction() will replace voltMapIt iterator as a pedestal values
+                       If user selects kOnlyPed~, PedestalSubtraction() will replace the voltages with the pedestal values
 
             ~WithOut1stBlock: Remove 1st block by applying TrimFirstBlock()
             ~WithOut1stBlockAndBadSamples:  Remove 1st block and bad samples by applying TrimFirstBlock(), TimingCalibrationAndBadSampleReomval(), and ApplyCableDelay() 
@@ -80,8 +85,184 @@ namespace AraCalType {
 } 
 
 class UsefulAtriStationEvent;
+class RawAtriStationEvent;
 class UsefulIcrrStationEvent;
+class RawAtriStationBlock;
 class TGraph; 
+class AraCalibTableLock;
+class AraAtriCalibCache;
+class AraCalibStats;
+class AraCalibThreadPool;
+
+#define ATRI_VOLTS_CONV_CHANS 20 ///< Number of ATRI electronics channels with a voltage calibration
+
+//!  Part of AraEvent library. The ADC to millivolts conversion coefficients of one ATRI sample.
+/*!
+    Fits with a bad Chi^2/NDF have already been replaced by a neighbouring one when the tables were loaded.
+    \ingroup rootclasses
+*/
+struct AraAtriVoltsConv
+{
+    Float_t fit[2][3]; ///< x, x^2, x^3 coefficients for positive [0] and negative [1] ADC counts
+    Float_t fitConst; ///< Constant term, 0 on A5
+    Float_t zeroVal; ///< ADC counts of zero volts
+    Float_t highFit[2][2]; ///< Constant and x coefficients of the high ADC fit for positive [0] and negative [1] ADC counts
+};
+
+//!  Part of AraEvent library. The timing and voltage calibration tables of one ATRI station in one calibration epoch.
+/*!
+    Built by AraEventCalibrator::loadAtriCalib() and then only read, so every thread calibrating events of that station and epoch can share it.
+    The tables can be saved to and loaded from a binary bundle, see AraAtriCalibBundle.
+    \ingroup rootclasses
+*/
+class AraAtriCalibTables
+{
+    public:
+        AraAtriCalibTables(AraStationId_t stationId, Int_t epoch); ///< Constructor, the tables are filled by AraEventCalibrator::loadAtriCalib()
+
+        void checkSampleTiming(); ///< RJN -- Trims samples off cap arrays whose last sample is timed after the next cap array's first
+        Double_t convertADCtoMilliVolts(Double_t adcCountsIn, int dda, int block, int chan, int sample) const; ///< A conversion module from ADC counts to millivolts  -THM-
+        void convertChanADCtoMilliVolts(Int_t numSamples, const Double_t *adcCountsIn, const Int_t *sampleIndex, int dda, int chan, Double_t *voltsOut) const; ///< convertADCtoMilliVolts() for a whole channel, vectorised with SSE2 / AVX2
+        size_t getMemory() const; ///< Bytes used by the tables
+
+    AraStationId_t fStationId; ///< The station the tables belong to
+    Int_t fEpoch; ///< The calibration epoch, see AraEventCalibrator::getAtriCalibEpoch()
+    Int_t fAtriSampleIndex[DDA_PER_ATRI][RFCHAN_PER_DDA][2][SAMPLES_PER_BLOCK]; ///<The sample order
+    Double_t fAtriSampleTimes[DDA_PER_ATRI][RFCHAN_PER_DDA][2][SAMPLES_PER_BLOCK]; ///<The sample timings
+    Double_t fAtriEpsilonTimes[DDA_PER_ATRI][RFCHAN_PER_DDA][2]; ///< The timing between blocks the capArray number is the number of the second block
+    Int_t fAtriNumSamples[DDA_PER_ATRI][RFCHAN_PER_DDA][2]; ///< The number of samples per block in a particular dda, chan, capArray
+    std::vector<AraAtriVoltsConv> fAtriVoltsConv; ///< ADC to millivolts conversion of each sample of the calibrated channels, indexed by fAtriVoltsConvChan, block and sample -THM-
+    Int_t fAtriVoltsConvChan[DDA_PER_ATRI][RFCHAN_PER_DDA]; ///< Index of each channel in fAtriVoltsConv, -1 for channels without voltage calibration
+    Int_t fAtriHighAdcLimit; ///< ADC counts above which the high ADC conversion is used, 400 on A2/3, 500 on A5 -MK-
+    Double_t fAtriAdcOffset; ///< Offset added to the ADC counts before the conversion, -11 on A2/3, 0 on A5 -THM-
+    Bool_t fAtriConvStation5; ///< The conversion follows the A5 rules
+    Int_t fNumVoltsConvFallbacks; ///< Number of samples using a neighbour's voltage conversion fit because their own has a bad Chi^2/NDF
+};
+
+//!  Part of AraEvent library. The pedestals of one ATRI station.
+/*!
+    Built by AraEventCalibrator::loadAtriPedestals() and then only read.
+    Pedestals from a text file are parsed into fPedStore, a binary file is memory mapped instead (see AraAtriPedestalFile).
+    Either way fAtriPeds points at the table.
+    \ingroup rootclasses
+*/
+class AraAtriPedestals
+{
+    public:
+        AraAtriPedestals(AraStationId_t stationId); ///< Constructor, the pedestals are filled by AraEventCalibrator::loadAtriPedestals()
+        ~AraAtriPedestals(); ///< Destructor, unmaps a binary file
+        size_t getMemory() const { return sizeof(AraAtriPedestals)+fPedStore.size()*sizeof(UShort_t)+fMapLength; } ///< Bytes used by the pedestals
+
+    AraStationId_t fStationId; ///< The station the pedestals belong to
+    const UShort_t *fAtriPeds; ///< The pedestal of each sample, indexed by RawAtriStationEvent::getPedIndex()
+    std::vector<UShort_t> fPedStore; ///< The pedestals read from a text file
+    void *fMapBase; ///< The mapping of a binary file, NULL for a text file
+    size_t fMapLength; ///< Length of fMapBase
+    char fPedFile[FILENAME_MAX]; ///< The file they were read from
+
+    private:
+        AraAtriPedestals(const AraAtriPedestals&); ///< Not copyable, it may own a mapping
+        AraAtriPedestals &operator=(const AraAtriPedestals&);
+};
+
+//!  Part of AraEvent library. The per-thread scratch space used by AraEventCalibrator while calibrating one event.
+/*!
+    The calibration tables in AraEventCalibrator are only written when they are loaded and are shared by every thread.
+    Everything that changes from one event to the next lives here instead, and each thread gets its own context from AraEventCalibrator::getContext().
+    \ingroup rootclasses
+*/
+class AraCalibrationContext
+{
+    public:
+        AraCalibrationContext(); ///< Default constructor
+        void clearAtriLists(); ///< Empties the ATRI sample and capArray lists, keeping their capacity for the next event
+
+    ///These are just utility arrays that are used in the Icrr calibration
+    double v[MAX_NUMBER_SAMPLES_LAB3]; //Calibrated wrapped
+    double calwv[MAX_NUMBER_SAMPLES_LAB3]; //Calibrated unwrapped
+    double rawadc[MAX_NUMBER_SAMPLES_LAB3]; //Uncalibrated unwrapped
+    double pedsubadc[MAX_NUMBER_SAMPLES_LAB3]; //Pedestal subtracted unwrapped
+    double sampNums[MAX_NUMBER_SAMPLES_LAB3]; //Sample numbers as doubles
+    double timeNums[MAX_NUMBER_SAMPLES_LAB3]; /// time numbers
+    double tempTimeNums[MAX_NUMBER_SAMPLES_LAB3]; ///temporary array
+    double calTimeNums[MAX_NUMBER_SAMPLES_LAB3]; /// calibrated time numbers
+    double calVoltNums[MAX_NUMBER_SAMPLES_LAB3]; /// calibrated volt numbers
+    int indexNums[MAX_NUMBER_SAMPLES_LAB3]; /// for time sorting
+    double clockAlignVals[LAB3_PER_ICRR]; ///< Clock alignment of the current event, by default clock align 0 is 0
+    double clockLagVals[LAB3_PER_ICRR]; ///< Clock lag of the current event, for debugging
+
+    //Atri lists
+    std::vector<std::vector<int> > sampleList; ///< WF sample numbers of each electronics channel
+    std::vector<std::vector<int> > capArrayList; ///< 'block number' modulo 2 of each dda
+    std::vector<double> tempVolts; ///< Scratch copy of one channel used by the bad sample removal
+    std::vector<int> tempSamps; ///< Scratch copy of one channel's sample numbers used by the bad sample removal
+
+    //Atri working waveforms of an event that stores its samples in the dense arena (UsefulAtriStationEvent::usesArena())
+    std::vector<Double_t> chanTimes[CHANNELS_PER_ATRI]; ///< Times of each electronics channel
+    std::vector<Double_t> chanVolts[CHANNELS_PER_ATRI]; ///< Voltages of each electronics channel
+    Bool_t chanPresent[CHANNELS_PER_ATRI]; ///< Was the electronics channel read out in this event
+
+    //Atri tables of the event being calibrated, held so they stay in memory even if the cache drops them meanwhile
+#ifndef __CINT__
+    std::shared_ptr<const AraAtriCalibTables> atriCalib; ///< Timing and voltage calibration
+    std::shared_ptr<const AraAtriPedestals> atriPeds; ///< Pedestals
+#endif
+
+    //Atri fused calibration
+    AraAtriEventView eventView; ///< View of the RawAtriStationEvent being calibrated
+    std::vector<AraAtriBlockView> ddaBlocks[DDA_PER_ATRI]; ///< The blocks of each dda in readout order
+    Int_t ddaChanIndex[DDA_PER_ATRI][RFCHAN_PER_DDA]; ///< Row of each channel in the blocks of its dda, -1 if it was not read out
+    std::vector<Double_t> cableDelays[CHANNELS_PER_ATRI]; ///< Cable delays to subtract from each electronics channel, in the order ApplyCableDelay() would
+    Bool_t invertChan[CHANNELS_PER_ATRI]; ///< Does InvertA3Chans() flip the electronics channel
+};
+
+//!  Part of AraEvent library. What AraEventCalibrator works out once for a lazily calibrated event, kept in the event until its next calibration.
+/*!
+    AraEventCalibrator::CalibrateLazyChannel() swaps it into the calling thread's context, so each channel only goes through FusedCalibrateChannel().
+    The block views point into the event's own blocks, blockBase tells whether they still do once the event has been copied.
+    \ingroup rootclasses
+*/
+class AraAtriLazyCalibration
+{
+    public:
+        AraAtriLazyCalibration() : blockBase(0) {} ///< Default constructor
+
+#ifndef __CINT__
+    std::shared_ptr<const AraAtriCalibTables> atriCalib; ///< Timing and voltage calibration of the event
+    std::shared_ptr<const AraAtriPedestals> atriPeds; ///< Pedestals of the event
+#endif
+    const RawAtriStationBlock *blockBase; ///< The first block of the event when ddaBlocks was filled
+    std::vector<AraAtriBlockView> ddaBlocks[DDA_PER_ATRI]; ///< The blocks of each dda in readout order, from SetupFusedCalibration()
+    Int_t ddaChanIndex[DDA_PER_ATRI][RFCHAN_PER_DDA]; ///< Row of each channel in the blocks of its dda, -1 if it was not read out
+    std::vector<Double_t> cableDelays[CHANNELS_PER_ATRI]; ///< Cable delays of each electronics channel, from SetupFusedCorrections()
+    Bool_t invertChan[CHANNELS_PER_ATRI]; ///< Is the electronics channel inverted, from SetupFusedCorrections()
+    Int_t numOut[CHANNELS_PER_ATRI]; ///< Number of calibrated samples of each electronics channel, from CountFusedSamples()
+};
+
+//!  Part of AraEvent library. The calibrated waveforms of a batch of ATRI events, filled by AraEventCalibrator::calibrateEvents().
+/*!
+    All the events share one pair of time and voltage arrays, event by event and within an event in electronics channel order.
+    The arrays keep their capacity, so a batch object that is refilled over and over stops allocating once it has seen its largest batch.
+    \ingroup rootclasses
+*/
+class AraAtriCalibratedBatch
+{
+    public:
+        AraAtriCalibratedBatch() : fNumEvents(0) {} ///< Default constructor
+
+        Int_t getNumEvents() const {return fNumEvents;} ///< Number of events in the batch
+        Int_t getNumElecChannels(Int_t event) const {return fNumChannels[event];} ///< Number of electronics channels read out in an event
+        Int_t getNumSamples(Int_t event, Int_t chanId) const {return fLength[event*CHANNELS_PER_ATRI+chanId];} ///< Number of calibrated samples of an electronics channel, 0 if it was not read out
+        const Double_t *getTimes(Int_t event, Int_t chanId) const {return getNumSamples(event,chanId) ? &(fTimes[fOffset[event*CHANNELS_PER_ATRI+chanId]]) : NULL;} ///< Calibrated times of an electronics channel, NULL if it was not read out
+        const Double_t *getVolts(Int_t event, Int_t chanId) const {return getNumSamples(event,chanId) ? &(fVolts[fOffset[event*CHANNELS_PER_ATRI+chanId]]) : NULL;} ///< Calibrated voltages of an electronics channel, NULL if it was not read out
+
+    Int_t fNumEvents; ///< Number of events in the batch
+    std::vector<Double_t> fTimes; ///< The times of every channel of every event
+    std::vector<Double_t> fVolts; ///< The voltages, same layout as fTimes
+    std::vector<Long64_t> fOffset; ///< Where each channel starts, indexed by event*CHANNELS_PER_ATRI+chanId
+    std::vector<Int_t> fLength; ///< The number of samples of each channel, indexed as fOffset
+    std::vector<Int_t> fNumChannels; ///< The number of electronics channels of each event
+};
 
 //!  Part of AraEvent library. The calibrator takes Raw ATRI / ICRR events and applies Voltage, timing and bandpass filter calibrations to produce Useful ATRI / ICRR events.
 /*!
@@ -116,58 +297,71 @@ class AraEventCalibrator : public TObject
     double binWidths[ICRR_NO_STATIONS][LAB3_PER_ICRR][2][MAX_NUMBER_SAMPLES_LAB3]; ///< Array to hold the bin width calibration constants
     double epsilonVals[ICRR_NO_STATIONS][LAB3_PER_ICRR][2]; ///<Array to hold the wrap-around calibration constants
     double interleaveVals[ICRR_NO_STATIONS][8]; ///< There are only 8 interleaved channels
-    double clockAlignVals[ICRR_NO_STATIONS][LAB3_PER_ICRR]; //Well by default clock align 0 is 0
-    double clockLagVals[ICRR_NO_STATIONS][LAB3_PER_ICRR]; //For debugging
 
-    ///These are just utility arrays that are used in the calibration
-    double v[MAX_NUMBER_SAMPLES_LAB3]; //Calibrated wrapped
-    double calwv[MAX_NUMBER_SAMPLES_LAB3]; //Calibrated unwrapped
-    double rawadc[MAX_NUMBER_SAMPLES_LAB3]; //Uncalibrated unwrapped
-    double pedsubadc[MAX_NUMBER_SAMPLES_LAB3]; //Pedestal subtracted unwrapped
-    double sampNums[MAX_NUMBER_SAMPLES_LAB3]; //Sample numbers as doubles
-    double timeNums[MAX_NUMBER_SAMPLES_LAB3]; /// time numbers
-    double tempTimeNums[MAX_NUMBER_SAMPLES_LAB3]; ///temporary array
-    double calTimeNums[MAX_NUMBER_SAMPLES_LAB3]; /// calibrated time numbers
-    double calVoltNums[MAX_NUMBER_SAMPLES_LAB3]; /// calibrated volt numbers
-    int indexNums[MAX_NUMBER_SAMPLES_LAB3]; /// for time sorting
+    static AraCalibrationContext *getContext(); ///< Returns the scratch space of the calling thread, used by both the Icrr and Atri calibrations
 
     //Atri Calibrations
-    UShort_t *fAtriPeds; ///< Storage array to hold the ATRI pedestal data
-    Int_t fGotAtriPedFile[ATRI_NO_STATIONS]; ///< Flag to indicate whether the ATRI pedestals have been loaded and for which station
-    Int_t fGotAtriCalibFile[ATRI_NO_STATIONS]; ///< Flag to indicate whether the ATRI calib have been loaded and for which station
+    Int_t fGotAtriPedFile[ATRI_NO_STATIONS]; ///< Flag to indicate whether the ATRI pedestal file of a station is known, set by setAtriPedFile() for user pedestals
     char fAtriPedFile[ATRI_NO_STATIONS][FILENAME_MAX]; ///< Filename of the ATRI pedestal file
-    Int_t fAtriSampleIndex[DDA_PER_ATRI][RFCHAN_PER_DDA][2][SAMPLES_PER_BLOCK]; ///<The sample order
-    Double_t fAtriSampleADCVoltsConversion[DDA_PER_ATRI][RFCHAN_PER_DDA][512][64][9];//added for voltage conversion -THM-
-    Double_t fAtriSampleHighADCVoltsConversion[DDA_PER_ATRI][RFCHAN_PER_DDA][512][64][5];//added for high voltages -THM-
-    Double_t fAtriSampleTimes[DDA_PER_ATRI][RFCHAN_PER_DDA][2][SAMPLES_PER_BLOCK]; ///<The sample timings
-    Double_t fAtriEpsilonTimes[DDA_PER_ATRI][RFCHAN_PER_DDA][2]; ///< The timing between blocks the capArray number is the number of the second block
-    Int_t fAtriNumSamples[DDA_PER_ATRI][RFCHAN_PER_DDA][2]; ///< The number of samples per block in a particular dda, chan, capArray
 
-    void checkAtriSampleTiming();
     void calibrateEvent(UsefulAtriStationEvent *theEvent, AraCalType::AraCalType_t calType=AraCalType::kVoltageTime); ///< Apply the calibration to a UsefulAtriStationEvent, called from UsefulAtriStationEvent constructor
     Double_t convertADCtoMilliVolts(Double_t adcCountsIn, int dda, int inBlock, int chan, int sample, AraStationId_t stationId); //A conversion module from ADC counts to millivolts  -THM-
+    void convertChanADCtoMilliVolts(Int_t numSamples, const Double_t *adcCountsIn, const Int_t *sampleIndex, int dda, int chan, AraStationId_t stationId, Double_t *voltsOut); ///< convertADCtoMilliVolts() for a whole channel, vectorised with SSE2 / AVX2
+    void calibrateEvents(Int_t numEvents, RawAtriStationEvent **rawEvents, AraAtriCalibratedBatch *batch, AraCalType::AraCalType_t calType=AraCalType::kVoltageTime, Int_t numThreads=1); ///< Calibrates a batch of events into one output arena, optionally splitting them over numThreads threads (0 for one per core)
+    void calibrateEvents(Int_t numEvents, const AraAtriEventView *events, AraAtriCalibratedBatch *batch, AraCalType::AraCalType_t calType=AraCalType::kVoltageTime, Int_t numThreads=1); ///< As above for views of events, for example from an AraAtriWaveformFile
     void setAtriPedFile(char *filename, AraStationId_t stationId); ///< Allows the user to force a specific pedestal file into the calibrator instead of the default. The pedestals may vary as a function of time so using a pedestal file from a time close the the event / run is a good idea
-    void loadAtriPedestals(AraStationId_t stationId); ///< Internally used function that loads the pedestals into memory.
-    void loadAtriCalib(AraStationId_t stationId, Double_t unixtime); ///< Internally used fuction that loads the calibration values into memory. ///< Adds unix time to select the new timing table for A3 2019 data. MK added 08-02-2022
+    AraAtriPedestals *loadAtriPedestals(AraStationId_t stationId); ///< Internally used function that reads the pedestals of a station
+    AraAtriCalibTables *loadAtriCalib(AraStationId_t stationId, Double_t unixtime); ///< Internally used fuction that reads the calibration values of a station, NULL if the station is unknown. ///< Adds unix time to select the new timing table for A3 2019 data. MK added 08-02-2022
+    AraAtriCalibTables *loadAtriCalibFromText(AraStationId_t stationId, Int_t epoch); ///< Reads the calibration values of a station from the text files, as loadAtriCalib() does when there is no calibration bundle
+    static Int_t getAtriCalibEpoch(AraStationId_t stationId, Double_t unixtime); ///< Which set of calibration tables is valid for a station at a given time
+#ifndef __CINT__
+    std::shared_ptr<const AraAtriCalibTables> getAtriCalibTables(AraStationId_t stationId, Double_t unixtime); ///< The calibration tables valid for a station at a given time, loaded if not in the cache
+    std::shared_ptr<const AraAtriPedestals> getAtriPedestals(AraStationId_t stationId); ///< The pedestals of a station, loaded if not in the cache
+#endif
+    void setAtriCacheMemoryLimit(Long64_t bytes); ///< How much memory the cached ATRI tables may use before the least recently used are dropped
+    void clearAtriCache(); ///< Drops the ATRI tables and pedestals in memory, they are loaded again from the files as events need them
      
     Bool_t fileExists(char *fileName); ///< Helper function to check whether a file exists
-    Int_t numberOfPedestalValsInFile(char *fileName); ///< Helper function to check number of pedestal values in a pedestal file. This is to identify corrupted pedestal files
+    Int_t numberOfPedestalValsInFile(char *fileName); ///< Helper function to check number of pedestal values in a text or binary pedestal file. This is to identify corrupted pedestal files
 
     //! Modulates calibration step -MK-
-    void UnpackDAQFormatToElecChanFormat(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt, std::map< Int_t, std::vector <Double_t> >::iterator &timeMapIt, std::vector<std::vector<int> > *sampleList, std::vector<std::vector<int> > *capArrayList); ///< Converts DAQ data format to Electronic channel format
-    Bool_t TrimFirstBlock(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt, std::map< Int_t, std::vector <Double_t> >::iterator &timeMapIt, std::vector<std::vector<int> > *sampleList, std::vector<std::vector<int> > *capArrayList, Bool_t hasTimingCalib); ///< Erase first block that currupted by trigger
-    Bool_t TimingCalibrationAndBadSampleReomval(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt, std::map< Int_t, std::vector <Double_t> >::iterator &timeMapIt, std::vector<std::vector<int> > *sampleList, std::vector<std::vector<int> > *capArrayList, Bool_t hasTrimFirstBlk); ///< Trims samples using fAtriSampleTimes table
-    void PedestalSubtraction(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt, std::vector<std::vector<int> > *sampleList, AraCalType::AraCalType_t calType); ///< Subtracts pedestal from raw data
-    void CommonMode(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt);
-    void InvertA3Chans(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt, AraStationId_t thisStationId); ///< Inverts only RF channels = 0,4,8 in A3
-    void ApplyZeroMean(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt, std::vector<std::vector<int> > *capArrayList, Bool_t hasTrimFirstBlk, Bool_t hasTimingCalib); ///< Zeroing WF by subtracting mean. ADC or Voltage. If 1st block is still in the WF, exclude the samplesin the 1st block from mean calculation
-    void VoltageCalibration(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &voltMapIt, std::vector<std::vector<int> > *sampleList, AraStationId_t thisStationId); ///< Converts ADC to Voltage using conversion table
-    void ApplyCableDelay(UsefulAtriStationEvent *theEvent, std::map< Int_t, std::vector <Double_t> >::iterator &timeMapIt, Double_t unixtime, AraStationId_t thisStationId); ///< Remove knwon cable delay
+    void UnpackDAQFormatToElecChanFormat(UsefulAtriStationEvent *theEvent, std::vector<std::vector<int> > *sampleList, std::vector<std::vector<int> > *capArrayList); ///< Converts DAQ data format to Electronic channel format
+    Bool_t TrimFirstBlock(UsefulAtriStationEvent *theEvent, std::vector<std::vector<int> > *sampleList, std::vector<std::vector<int> > *capArrayList, Bool_t hasTimingCalib); ///< Erase first block that currupted by trigger
+    Bool_t TimingCalibrationAndBadSampleReomval(UsefulAtriStationEvent *theEvent, std::vector<std::vector<int> > *sampleList, std::vector<std::vector<int> > *capArrayList, Bool_t hasTrimFirstBlk); ///< Trims samples using fAtriSampleTimes table
+    void PedestalSubtraction(UsefulAtriStationEvent *theEvent, std::vector<std::vector<int> > *sampleList, AraCalType::AraCalType_t calType); ///< Subtracts pedestal from raw data
+    void CommonMode(UsefulAtriStationEvent *theEvent);
+    void InvertA3Chans(UsefulAtriStationEvent *theEvent, AraStationId_t thisStationId); ///< Inverts only RF channels = 0,4,8 in A3
+    void ApplyZeroMean(UsefulAtriStationEvent *theEvent, std::vector<std::vector<int> > *capArrayList, Bool_t hasTrimFirstBlk, Bool_t hasTimingCalib); ///< Zeroing WF by subtracting mean. ADC or Voltage. If 1st block is still in the WF, exclude the samplesin the 1st block from mean calculation
+    void VoltageCalibration(UsefulAtriStationEvent *theEvent, std::vector<std::vector<int> > *sampleList, AraStationId_t thisStationId); ///< Converts ADC to Voltage using conversion table
+    void ApplyCableDelay(UsefulAtriStationEvent *theEvent, Double_t unixtime, AraStationId_t thisStationId); ///< Remove knwon cable delay
+    std::vector<Double_t> *getChanVolts(UsefulAtriStationEvent *theEvent, Int_t chanId); ///< The voltages of an electronics channel being calibrated, NULL if the channel was not read out
+    std::vector<Double_t> *getChanTimes(UsefulAtriStationEvent *theEvent, Int_t chanId); ///< The times of an electronics channel being calibrated, NULL if the channel was not read out
+    void FillWaveformArena(UsefulAtriStationEvent *theEvent); ///< Packs the calibrated channels into the event's dense arena
+    Bool_t SetupFusedCalibration(RawAtriStationEvent *theEvent, AraCalType::AraCalType_t calType); ///< Checks whether FusedCalibration() can calibrate this event and sorts its blocks by dda
+    Bool_t SetupFusedCalibration(const AraAtriEventView &theEvent, AraCalType::AraCalType_t calType); ///< As above for a view of an event
+    void FusedCalibration(UsefulAtriStationEvent *theEvent, AraCalType::AraCalType_t calType, Double_t unixtime, AraStationId_t thisStationId); ///< Single pass version of the unpack to cable delay steps, gives the same samples bit for bit
+    void SetupFusedCorrections(AraCalType::AraCalType_t calType, Double_t unixtime, AraStationId_t thisStationId); ///< Looks up the A3 inversions and cable delays for FusedCalibrateChannel()
+    Int_t CountFusedSamples(AraCalType::AraCalType_t calType, Int_t numOut[CHANNELS_PER_ATRI]); ///< Number of samples FusedCalibrateChannel() writes for each channel
+    void FusedCalibrateChannel(AraCalType::AraCalType_t calType, AraStationId_t thisStationId, Int_t chanId, Int_t numPoints, Double_t *times, Double_t *volts); ///< The single pass calibration of one channel
+    void SetupLazyCalibration(UsefulAtriStationEvent *theEvent, AraCalType::AraCalType_t calType); ///< Records which channels a lazily calibrated event has, without calibrating them
+    void CalibrateLazyChannel(UsefulAtriStationEvent *theEvent, Int_t chanId); ///< Calibrates one channel of a lazily calibrated event, if it has not been done yet
+    void setCollectStats(Bool_t collect); ///< Switches on the timing and counting of the calibration steps, also done by ARA_CALIB_STATS=1
+    Bool_t getCollectStats(); ///< Are the calibration statistics collected
+    void printStats(FILE *fp=stdout); ///< Prints the calibration statistics collected so far
+    void resetStats(); ///< Zeroes the calibration statistics
+    void setUseFusedCalibration(Bool_t useFused) {fUseFusedCalibration=useFused;} ///< kFALSE forces every event through the step by step reference calibration
+    Bool_t fUseFusedCalibration; ///< Use FusedCalibration() for the calibration types it supports
 
     protected:
         static AraEventCalibrator *fgInstance;  ///< protect against multiple instances
+        AraCalibTableLock *fTableLock; //!< Shared while Icrr events are calibrated, exclusive while Icrr tables are (re)loaded
+        AraAtriCalibCache *fAtriCache; //!< The Atri calibration tables and pedestals in memory, by station and epoch
+        AraCalibStats *fStats; //!< Time and samples of each calibration step, when switched on
+        AraCalibThreadPool *fThreadPool; //!< The worker threads of calibrateEvents(), kept from one batch to the next
+        static void printStatsAtExit(); ///< Prints the statistics switched on by ARA_CALIB_STATS
+        void calibrateEventViews(Int_t numEvents, const AraAtriEventView *events, RawAtriStationEvent **rawEvents, AraAtriCalibratedBatch *batch, AraCalType::AraCalType_t calType, Int_t numThreads); ///< The batch calibration behind both calibrateEvents()
 
-    ClassDef(AraEventCalibrator,1);
+    ClassDef(AraEventCalibrator,3);
 };
 
 
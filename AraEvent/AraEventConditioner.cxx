@@ -45,6 +45,8 @@ AraEventConditioner*  AraEventConditioner::Instance()
 
 void AraEventConditioner::conditionEvent(UsefulAtriStationEvent *theEvent)
 {
+    //! The conditioning works on fTimes / fVolts, or the arena, directly, so every channel has to be calibrated first
+    theEvent->calibrateLazyChannels();
 
     if(theEvent->stationId==ARA_STATION3){
         AraEventConditioner::invertA3Chans(theEvent);
@@ -63,12 +65,26 @@ void AraEventConditioner::conditionEvent(UsefulAtriStationEvent *theEvent)
     \return void
 */
 void AraEventConditioner::makeMeanZero(UsefulAtriStationEvent *theEvent){
-    for(Int_t chan=0; chan<theEvent->fTimes.size(); chan++){
-        //compute the mean, and let C++ help by doing the addition for us
-        Double_t mean = std::accumulate(theEvent->fVolts[chan].begin(), theEvent->fVolts[chan].end(), 0.0);
-        mean/=double(theEvent->fVolts[chan].size()); //divide by N to make it a mean
-        for(Int_t samp=0; samp<theEvent->fTimes[chan].size(); samp++){
-            theEvent->fVolts[chan][samp]-=mean;
+    if(theEvent->usesArena()){
+        //the samples of each channel are contiguous in the arena, and channels not read out have no samples
+        for(Int_t chan=0; chan<CHANNELS_PER_ATRI; chan++){
+            Int_t numSamples=theEvent->fArenaLength[chan];
+            if(numSamples==0) continue;
+            Double_t *volts=&(theEvent->fArenaVolts[theEvent->fArenaOffset[chan]]);
+            Double_t mean = std::accumulate(volts, volts+numSamples, 0.0)/double(numSamples);
+            for(Int_t samp=0; samp<numSamples; samp++){
+                volts[samp]-=mean;
+            }
+        }
+    }
+    else{
+        for(Int_t chan=0; chan<theEvent->fTimes.size(); chan++){
+            //compute the mean, and let C++ help by doing the addition for us
+            Double_t mean = std::accumulate(theEvent->fVolts[chan].begin(), theEvent->fVolts[chan].end(), 0.0);
+            mean/=double(theEvent->fVolts[chan].size()); //divide by N to make it a mean
+            for(Int_t samp=0; samp<theEvent->fTimes[chan].size(); samp++){
+                theEvent->fVolts[chan][samp]-=mean;
+            }
         }
     }
     //record the making of the zero mean
@@ -83,6 +99,10 @@ void AraEventConditioner::makeMeanZero(UsefulAtriStationEvent *theEvent){
     \return void
 */
 void AraEventConditioner::trimFirstBlock(UsefulAtriStationEvent *theEvent){
+    if(theEvent->usesArena()){
+        trimArenaFirstBlock(theEvent);
+        return;
+    }
     bool hasTooFewBlocks=false;
     for(Int_t chan=0; chan<theEvent->fTimes.size(); chan++){
         if(theEvent->fTimes[chan].size()<SAMPLES_PER_BLOCK){
@@ -101,6 +121,26 @@ void AraEventConditioner::trimFirstBlock(UsefulAtriStationEvent *theEvent){
     theEvent->fConditioningList.push_back(ss.str());
 }
 
+//! As trimFirstBlock, for an event that keeps its samples in the dense arena
+/*!
+    Each channel just starts SAMPLES_PER_BLOCK samples later in the arena, nothing is copied.
+    \param ev the useful atri event pointer
+    \return void
+*/
+void AraEventConditioner::trimArenaFirstBlock(UsefulAtriStationEvent *theEvent){
+    for(Int_t chan=0; chan<CHANNELS_PER_ATRI; chan++){
+        if(theEvent->fArenaLength[chan]>0 && theEvent->fArenaLength[chan]<SAMPLES_PER_BLOCK) return;
+    }
+    for(Int_t chan=0; chan<CHANNELS_PER_ATRI; chan++){
+        if(theEvent->fArenaLength[chan]==0) continue;
+        theEvent->fArenaOffset[chan]+=SAMPLES_PER_BLOCK;
+        theEvent->fArenaLength[chan]-=SAMPLES_PER_BLOCK;
+    }
+    //record the trimming
+    std::stringstream ss;
+    ss<<"trim_first_blocks_all_chans";
+    theEvent->fConditioningList.push_back(ss.str());
+}
 
 //! Inverts channels 0, 4, and 8 on A3
 /*!
@@ -121,8 +161,16 @@ void AraEventConditioner::invertA3Chans(UsefulAtriStationEvent *theEvent){
         Int_t elec_chan = AraGeomTool::Instance()->getElecChanFromRFChan(rf_chan, theEvent->stationId);
         
         //perform inversion on every sample
-        for(Int_t samp=0; samp<theEvent->fTimes[elec_chan].size(); samp++){
-            theEvent->fVolts[elec_chan][samp]*=-1.;
+        if(theEvent->usesArena()){
+            Int_t numSamples=(elec_chan>=0 && elec_chan<CHANNELS_PER_ATRI) ? theEvent->fArenaLength[elec_chan] : 0;
+            for(Int_t samp=0; samp<numSamples; samp++){
+                theEvent->fArenaVolts[theEvent->fArenaOffset[elec_chan]+samp]*=-1.;
+            }
+        }
+        else{
+            for(Int_t samp=0; samp<theEvent->fTimes[elec_chan].size(); samp++){
+                theEvent->fVolts[elec_chan][samp]*=-1.;
+            }
         }
 
         //record the inversion
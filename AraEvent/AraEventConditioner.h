@@ -32,12 +32,13 @@ class AraEventConditioner : public TObject
      //Instance generator
      static AraEventConditioner*  Instance(); ///< Generates an instance of AraEventConditioner to use
 
-     //function to condition an event
+     //function to condition an event, whether its samples are in fTimes / fVolts or the arena
      void conditionEvent(UsefulAtriStationEvent *theEvent);
 
     private:
         void invertA3Chans(UsefulAtriStationEvent *theEvent); ///<invert channels 0, 4, 8 of A3
         void trimFirstBlock(UsefulAtriStationEvent *theEvent); ///<remove the first block from all waveforms
+        void trimArenaFirstBlock(UsefulAtriStationEvent *theEvent); ///<remove the first block from all waveforms of an event using the arena
         void makeMeanZero(UsefulAtriStationEvent *theEvent); ///<make the mean zero (to be used *after* trimFirstBlock)
 
     protected:
@@ -0,0 +1,279 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraEventIndexFile.cxx       Per-run event index sidecar files     /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Writes and reads a small file next to an event tree with one   /////
+/////     row of header fields per entry, for lookups without the tree   /////
+//////////////////////////////////////////////////////////////////////////////
+
+//C++ includes
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <zlib.h>
+
+//class definition includes
+#include "AraEventIndexFile.h"
+
+//AraRoot Includes
+#include "RawAtriStationEvent.h"
+#include "RawIcrrStationEvent.h"
+
+AraEventIndexFileWriter::AraEventIndexFileWriter()
+{
+}
+
+void AraEventIndexFileWriter::clear()
+{
+    fEntries.clear();
+}
+
+/*!
+    \param event the event just filled into the tree
+    \param entry its entry in the tree
+*/
+void AraEventIndexFileWriter::addEvent(RawAtriStationEvent *event, Long64_t entry)
+{
+    AraEventIndexEntry row;
+    memset(&row, 0, sizeof(row));
+    row.entry = entry;
+    row.eventNumber = event->eventNumber;
+    row.unixTime = event->unixTime;
+    row.unixTimeUs = event->unixTimeUs;
+    row.timeStamp = event->timeStamp;
+    row.triggerPattern = event->triggerInfo[0];
+    row.numReadoutBlocks = event->numReadoutBlocks;
+    for(int trig=0;trig<MAX_TRIG_BLOCKS;trig++) {
+        if(event->triggerInfo[trig]) row.triggerBits |= (1<<trig);
+    }
+    row.stationId = event->stationId;
+    if(event->isRFTrigger()) row.flags |= kAraIndexRFTrigger;
+    if(event->isSoftwareTrigger()) row.flags |= kAraIndexSoftwareTrigger;
+    if(event->isCalpulserEvent()) row.flags |= kAraIndexCalpulser;
+    fEntries.push_back(row);
+}
+
+/*!
+    \param event the event just filled into the tree
+    \param entry its entry in the tree
+*/
+void AraEventIndexFileWriter::addEvent(RawIcrrStationEvent *event, Long64_t entry)
+{
+    AraEventIndexEntry row;
+    memset(&row, 0, sizeof(row));
+    row.entry = entry;
+    row.eventNumber = event->head.eventNumber;
+    row.unixTime = event->head.unixTime;
+    row.unixTimeUs = event->head.unixTimeUs;
+    row.timeStamp = event->getRubidiumTriggerTime();
+    row.triggerPattern = event->trig.trigPattern;
+    row.triggerBits = event->trig.trigType;
+    row.stationId = event->stationId;
+    if(event->trig.trigType&0x1) row.flags |= kAraIndexRFTrigger;
+    if(event->trig.trigType&0x40) row.flags |= kAraIndexSoftwareTrigger;
+    fEntries.push_back(row);
+}
+
+/*!
+    \param fileName the index file, usually AraEventIndexFile::getIndexFileName() of the tree file
+    \return kTRUE if the whole file was written and renamed into place
+*/
+Bool_t AraEventIndexFileWriter::write(const char *fileName)
+{
+    const std::vector<AraEventIndexEntry> &rows = fEntries;
+    std::vector<ULong64_t> byEventNumber(rows.size());
+    std::vector<ULong64_t> byTime(rows.size());
+    for(size_t row=0;row<rows.size();row++) {
+        byEventNumber[row] = row;
+        byTime[row] = row;
+    }
+    //The rows start in entry order, so the stable sorts keep entry order among equal keys
+    std::stable_sort(byEventNumber.begin(), byEventNumber.end(), [&rows](ULong64_t a, ULong64_t b) {
+            return rows[a].eventNumber<rows[b].eventNumber;
+        });
+    std::stable_sort(byTime.begin(), byTime.end(), [&rows](ULong64_t a, ULong64_t b) {
+            if(rows[a].unixTime!=rows[b].unixTime) return rows[a].unixTime<rows[b].unixTime;
+            return rows[a].unixTimeUs<rows[b].unixTimeUs;
+        });
+
+    AraEventIndexFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ARA_EVENT_INDEX_FILE_MAGIC, sizeof(ARA_EVENT_INDEX_FILE_MAGIC));
+    header.version = ARA_EVENT_INDEX_FILE_VERSION;
+    header.headerSize = sizeof(header);
+    header.entrySize = sizeof(AraEventIndexEntry);
+    header.numEntries = rows.size();
+    uLong checksum = crc32(0L, Z_NULL, 0);
+    checksum = crc32(checksum, (const Bytef*)rows.data(), rows.size()*sizeof(AraEventIndexEntry));
+    checksum = crc32(checksum, (const Bytef*)byEventNumber.data(), byEventNumber.size()*sizeof(ULong64_t));
+    checksum = crc32(checksum, (const Bytef*)byTime.data(), byTime.size()*sizeof(ULong64_t));
+    header.checksum = checksum;
+
+    std::string tmpName = std::string(fileName) + ".tmp";
+    FILE *fp = fopen(tmpName.c_str(), "wb");
+    if(!fp) {
+        fprintf(stderr, "AraEventIndexFileWriter::write -- ERROR Can't open %s: %s\n", tmpName.c_str(), strerror(errno));
+        return kFALSE;
+    }
+    Bool_t ok = fwrite(&header, sizeof(header), 1, fp)==1;
+    if(rows.size()) {
+        ok = ok && fwrite(rows.data(), sizeof(AraEventIndexEntry), rows.size(), fp)==rows.size();
+        ok = ok && fwrite(byEventNumber.data(), sizeof(ULong64_t), rows.size(), fp)==rows.size();
+        ok = ok && fwrite(byTime.data(), sizeof(ULong64_t), rows.size(), fp)==rows.size();
+    }
+    ok = (fclose(fp)==0) && ok;
+    if(!ok || rename(tmpName.c_str(), fileName)!=0) {
+        fprintf(stderr, "AraEventIndexFileWriter::write -- ERROR Can't write %s: %s\n", fileName, strerror(errno));
+        remove(tmpName.c_str());
+        return kFALSE;
+    }
+    return kTRUE;
+}
+
+AraEventIndexFile::AraEventIndexFile()
+{
+}
+
+/*!
+    \param fileName the index file
+    \return kTRUE if the file was read and passed the checks
+*/
+Bool_t AraEventIndexFile::open(const char *fileName)
+{
+    close();
+    FILE *fp = fopen(fileName, "rb");
+    if(!fp) return kFALSE;
+
+    AraEventIndexFileHeader header;
+    const char *problem = NULL;
+    ULong64_t fileSize = 0;
+    if(fseeko(fp, 0, SEEK_END)==0) fileSize = ftello(fp);
+    rewind(fp);
+    const ULong64_t rowBytes = sizeof(AraEventIndexEntry)+2*sizeof(ULong64_t);
+    if(fread(&header, sizeof(header), 1, fp)!=1) problem = "is too short";
+    else if(memcmp(header.magic, ARA_EVENT_INDEX_FILE_MAGIC, sizeof(ARA_EVENT_INDEX_FILE_MAGIC))!=0) problem = "is not an event index file";
+    else if(header.version!=ARA_EVENT_INDEX_FILE_VERSION) problem = "has an unknown version";
+    else if(header.headerSize!=sizeof(AraEventIndexFileHeader) || header.entrySize!=sizeof(AraEventIndexEntry)) problem = "was made with different row sizes";
+    //The count is checked against the file size before anything is allocated for it
+    else if(header.numEntries>(fileSize-sizeof(header))/rowBytes) problem = "is truncated";
+    else {
+        fEntries.resize(header.numEntries);
+        fByEventNumber.resize(header.numEntries);
+        fByTime.resize(header.numEntries);
+        if(header.numEntries
+           && (fread(fEntries.data(), sizeof(AraEventIndexEntry), fEntries.size(), fp)!=fEntries.size()
+               || fread(fByEventNumber.data(), sizeof(ULong64_t), fByEventNumber.size(), fp)!=fByEventNumber.size()
+               || fread(fByTime.data(), sizeof(ULong64_t), fByTime.size(), fp)!=fByTime.size())) problem = "is truncated";
+    }
+    fclose(fp);
+    if(!problem) {
+        uLong checksum = crc32(0L, Z_NULL, 0);
+        checksum = crc32(checksum, (const Bytef*)fEntries.data(), fEntries.size()*sizeof(AraEventIndexEntry));
+        checksum = crc32(checksum, (const Bytef*)fByEventNumber.data(), fByEventNumber.size()*sizeof(ULong64_t));
+        checksum = crc32(checksum, (const Bytef*)fByTime.data(), fByTime.size()*sizeof(ULong64_t));
+        if(checksum!=header.checksum) problem = "fails the checksum";
+    }
+    for(size_t row=0;!problem && row<fEntries.size();row++) {
+        if(fByEventNumber[row]>=fEntries.size() || fByTime[row]>=fEntries.size()) problem = "has bad row numbers";
+    }
+    if(problem) {
+        fprintf(stderr, "AraEventIndexFile::open -- ERROR %s %s\n", fileName, problem);
+        close();
+        return kFALSE;
+    }
+    return kTRUE;
+}
+
+void AraEventIndexFile::close()
+{
+    fEntries.clear();
+    fByEventNumber.clear();
+    fByTime.clear();
+}
+
+/*!
+    \param row the row, the rows are in the order the entries were filled
+    \return the row, NULL if out of range
+*/
+const AraEventIndexEntry *AraEventIndexFile::getEntry(Long64_t row) const
+{
+    if(row<0 || row>=getNumEntries()) return NULL;
+    return &fEntries[row];
+}
+
+/*!
+    \param eventNumber the event number
+    \return the tree entry of the event, the first one if the number is repeated, -1 if not found
+*/
+Long64_t AraEventIndexFile::findEventNumber(UInt_t eventNumber) const
+{
+    const std::vector<AraEventIndexEntry> &rows = fEntries;
+    std::vector<ULong64_t>::const_iterator it = std::lower_bound(fByEventNumber.begin(), fByEventNumber.end(), eventNumber,
+            [&rows](ULong64_t row, UInt_t value) { return rows[row].eventNumber<value; });
+    if(it==fByEventNumber.end() || rows[*it].eventNumber!=eventNumber) return -1;
+    return rows[*it].entry;
+}
+
+/*!
+    \param firstEvent the first event number
+    \param lastEvent the last event number, included
+    \param entries cleared then filled with the tree entries
+    \return the number of entries found
+*/
+Int_t AraEventIndexFile::getEntriesInEventRange(UInt_t firstEvent, UInt_t lastEvent, std::vector<Long64_t> &entries) const
+{
+    const std::vector<AraEventIndexEntry> &rows = fEntries;
+    entries.clear();
+    std::vector<ULong64_t>::const_iterator it = std::lower_bound(fByEventNumber.begin(), fByEventNumber.end(), firstEvent,
+            [&rows](ULong64_t row, UInt_t value) { return rows[row].eventNumber<value; });
+    for(; it!=fByEventNumber.end() && rows[*it].eventNumber<=lastEvent; ++it)
+        entries.push_back(rows[*it].entry);
+    return entries.size();
+}
+
+/*!
+    \param startTime the first unix time
+    \param endTime the unix time after the range
+    \param entries cleared then filled with the tree entries
+    \return the number of entries found
+*/
+Int_t AraEventIndexFile::getEntriesInTimeRange(UInt_t startTime, UInt_t endTime, std::vector<Long64_t> &entries) const
+{
+    const std::vector<AraEventIndexEntry> &rows = fEntries;
+    entries.clear();
+    std::vector<ULong64_t>::const_iterator it = std::lower_bound(fByTime.begin(), fByTime.end(), startTime,
+            [&rows](ULong64_t row, UInt_t value) { return rows[row].unixTime<value; });
+    for(; it!=fByTime.end() && rows[*it].unixTime<endTime; ++it)
+        entries.push_back(rows[*it].entry);
+    return entries.size();
+}
+
+/*!
+    A scan of the rows, which at 40 bytes a row is still far quicker than reading the headers from the tree.
+    \param flags the AraEventIndexFlag bits to look for, for example kAraIndexCalpulser
+    \param entries cleared then filled with the tree entries
+    \return the number of entries found
+*/
+Int_t AraEventIndexFile::getEntriesWithFlags(UInt_t flags, std::vector<Long64_t> &entries) const
+{
+    entries.clear();
+    for(size_t row=0;row<fEntries.size();row++) {
+        if(fEntries[row].flags&flags)
+            entries.push_back(fEntries[row].entry);
+    }
+    return entries.size();
+}
+
+/*!
+    \param treeFileName the event tree file, for example event1234.root
+    \return the index file name, event1234.idx
+*/
+std::string AraEventIndexFile::getIndexFileName(const char *treeFileName)
+{
+    std::string name(treeFileName);
+    size_t length = name.size();
+    if(length>=5 && name.compare(length-5, 5, ".root")==0)
+        name.erase(length-5);
+    return name + ".idx";
+}
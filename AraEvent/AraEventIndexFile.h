@@ -0,0 +1,115 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraEventIndexFile.h         Per-run event index sidecar files     /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Writes and reads a small file next to an event tree with one   /////
+/////     row of header fields per entry, for lookups without the tree   /////
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARAEVENTINDEXFILE_H
+#define ARAEVENTINDEXFILE_H
+
+//Includes
+#include <string>
+#include <vector>
+#include "Rtypes.h"
+
+class RawAtriStationEvent;
+class RawIcrrStationEvent;
+
+#define ARA_EVENT_INDEX_FILE_MAGIC "ARAINDX"
+#define ARA_EVENT_INDEX_FILE_VERSION 1
+
+//! The flags of an AraEventIndexEntry
+enum AraEventIndexFlag {
+    kAraIndexRFTrigger = 0x1, ///< isRFTrigger() of the event
+    kAraIndexSoftwareTrigger = 0x2, ///< isSoftwareTrigger() of the event, for Icrr events bit 6 of the trigger type
+    kAraIndexCalpulser = 0x4 ///< isCalpulserEvent() of the event, never set for Icrr events
+};
+
+//! Part of AraEvent library. One row of an event index file, the header fields of one tree entry.
+struct AraEventIndexEntry
+{
+    ULong64_t entry; ///< The entry in the event tree
+    UInt_t eventNumber; ///< Software event number
+    UInt_t unixTime; ///< Software event time in seconds
+    UInt_t unixTimeUs; ///< Software event time in microseconds
+    UInt_t timeStamp; ///< Atri timestamp, Gray decoded, or the Icrr rubidium trigger time
+    UInt_t triggerPattern; ///< Atri triggerInfo[0], or the Icrr trigger pattern
+    UShort_t numReadoutBlocks; ///< Number of Atri readout blocks, 0 for Icrr events
+    UChar_t triggerBits; ///< Atri bit n set if triggerInfo[n] is, or the Icrr trigger type
+    UChar_t stationId; ///< The station
+    UChar_t flags; ///< AraEventIndexFlag bits
+    UChar_t padding[7]; ///< Zero
+
+    Bool_t isRFTrigger() const {return flags&kAraIndexRFTrigger;}
+    Bool_t isSoftwareTrigger() const {return flags&kAraIndexSoftwareTrigger;}
+    Bool_t isCalpulserEvent() const {return flags&kAraIndexCalpulser;}
+};
+
+//! Part of AraEvent library. The header at the start of an event index file.
+/*!
+    The header is followed by numEntries AraEventIndexEntry in tree entry order, then numEntries ULong64_t row numbers
+    sorted by event number and numEntries sorted by unix time. Everything is in the byte order of the machine that wrote it.
+*/
+struct AraEventIndexFileHeader
+{
+    char magic[8]; ///< ARA_EVENT_INDEX_FILE_MAGIC
+    UInt_t version; ///< ARA_EVENT_INDEX_FILE_VERSION
+    UInt_t headerSize; ///< sizeof(AraEventIndexFileHeader)
+    UInt_t entrySize; ///< sizeof(AraEventIndexEntry)
+    UInt_t checksum; ///< zlib crc32 of everything after the header
+    ULong64_t numEntries; ///< Number of rows
+};
+
+//! Part of AraEvent library. Collects the index rows of a tree as it is filled and writes them out.
+/*!
+    The rootifiers write the index of each event tree to getIndexFileName() of the tree file.
+    The file is written to fileName.tmp and renamed, so a half written file is never mistaken for a complete one.
+    \ingroup rootclasses
+*/
+class AraEventIndexFileWriter
+{
+    public:
+        AraEventIndexFileWriter(); ///< Default constructor
+
+        void clear(); ///< Drops the rows added so far
+        void addEvent(RawAtriStationEvent *event, Long64_t entry); ///< Adds the row of an Atri event
+        void addEvent(RawIcrrStationEvent *event, Long64_t entry); ///< Adds the row of an Icrr event
+        Bool_t write(const char *fileName); ///< Writes the rows and the sorted lookups, returns kFALSE on failure
+
+    private:
+        std::vector<AraEventIndexEntry> fEntries;
+};
+
+//! Part of AraEvent library. Reads an event index file and looks up entries by event number, time or trigger.
+/*!
+    The whole file is read by open(), it is 40 bytes an event, and the lookups are binary searches of the sorted rows.
+    Finding an event or the entries of a time range this way doesn't touch the event tree at all.
+    \ingroup rootclasses
+*/
+class AraEventIndexFile
+{
+    public:
+        AraEventIndexFile(); ///< Default constructor
+
+        Bool_t open(const char *fileName); ///< Reads and checks a file
+        void close(); ///< Drops the rows
+
+        Long64_t getNumEntries() const {return fEntries.size();}
+        const AraEventIndexEntry *getEntry(Long64_t row) const; ///< The row of tree entry row, NULL if out of range
+
+        Long64_t findEventNumber(UInt_t eventNumber) const; ///< The tree entry of an event, -1 if it isn't in the index
+        Int_t getEntriesInEventRange(UInt_t firstEvent, UInt_t lastEvent, std::vector<Long64_t> &entries) const; ///< Tree entries with firstEvent <= eventNumber <= lastEvent, in event number order
+        Int_t getEntriesInTimeRange(UInt_t startTime, UInt_t endTime, std::vector<Long64_t> &entries) const; ///< Tree entries with startTime <= unixTime < endTime, in time order
+        Int_t getEntriesWithFlags(UInt_t flags, std::vector<Long64_t> &entries) const; ///< Tree entries with any of the AraEventIndexFlag bits in flags, in entry order
+
+        static std::string getIndexFileName(const char *treeFileName); ///< The index file of a tree file, the .root replaced by .idx
+
+    private:
+        std::vector<AraEventIndexEntry> fEntries;
+        std::vector<ULong64_t> fByEventNumber;
+        std::vector<ULong64_t> fByTime;
+};
+
+#endif //ARAEVENTINDEXFILE_H
@@ -0,0 +1,267 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraEventReader.cxx          Prefetching ATRI event tree reader    /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Reads and optionally calibrates the events of ATRI event trees /////
+/////     on background threads, ahead of the analysis loop              /////
+//////////////////////////////////////////////////////////////////////////////
+
+//C++ includes
+#include <cstdio>
+#include <chrono>
+
+//class definition includes
+#include "AraEventReader.h"
+
+//ROOT includes
+#include "TChain.h"
+#include "TBranch.h"
+
+/*!
+    \param prefetchDepth the number of events read ahead, which is also the number of event objects in the pool
+    \param treeName the name of the event trees
+*/
+AraEventReader::AraEventReader(Int_t prefetchDepth, const char *treeName)
+    : fChain(new TChain(treeName)), fPrefetchDepth(prefetchDepth>0 ? prefetchDepth : 1), fCacheSize(30000000),
+      fNumCalibrators(0), fCalType(AraCalType::kLatestCalib), fUseArena(kFALSE), fUseEntryList(kFALSE), fChainReady(kFALSE),
+      fReadEvent(0), fReadRun(0), fFreeQueue(0), fStopping(false), fStarted(kFALSE), fFinished(kFALSE), fCurrent(0), fNumHandedOut(0),
+      fReadStats("read"), fCalibStats("calib"), fAnalysisStats("loop")
+{
+}
+
+AraEventReader::~AraEventReader()
+{
+    stop();
+    for(size_t slot=0;slot<fSlots.size();slot++) delete fSlots[slot];
+    delete fChain;
+    delete fReadEvent;
+}
+
+/*!
+    \param fileName a file name, which may contain wildcards, see TChain::Add()
+    \return the number of files added
+*/
+Int_t AraEventReader::addFile(const char *fileName)
+{
+    if(fStarted) {
+        fprintf(stderr, "AraEventReader::addFile -- ERROR Can't add %s once reading has started\n", fileName);
+        return 0;
+    }
+    return fChain->Add(fileName);
+}
+
+/*!
+    \param calType the calibration type
+    \param numThreads number of calibration threads, 0 to calibrate only the events asked for in getUsefulEvent()
+    \param useArena calibrate into the dense arena of the events instead of fTimes / fVolts, see UsefulAtriStationEvent
+*/
+void AraEventReader::setCalibration(AraCalType::AraCalType_t calType, Int_t numThreads, Bool_t useArena)
+{
+    if(fStarted) {
+        fprintf(stderr, "AraEventReader::setCalibration -- ERROR Can't change the calibration once reading has started\n");
+        return;
+    }
+    fCalType=calType;
+    fNumCalibrators=numThreads>0 ? numThreads : 0;
+    fUseArena=useArena;
+}
+
+/*!
+    \param entries the chain entries to read
+*/
+void AraEventReader::setEntryList(const std::vector<Long64_t> &entries)
+{
+    if(fStarted) {
+        fprintf(stderr, "AraEventReader::setEntryList -- ERROR Can't change the entries once reading has started\n");
+        return;
+    }
+    fEntryList=entries;
+    fUseEntryList=kTRUE;
+}
+
+Bool_t AraEventReader::setUpChain()
+{
+    if(fChainReady) return kTRUE;
+    fReadEvent=new RawAtriStationEvent();
+    if(fChain->SetBranchAddress("event",&fReadEvent)<0) {
+        fprintf(stderr, "AraEventReader -- ERROR The trees have no event branch\n");
+        return kFALSE;
+    }
+    if(fChain->GetBranch("run")) fChain->SetBranchAddress("run",&fReadRun);
+    if(fCacheSize>0) {
+        fChain->SetCacheSize(fCacheSize);
+        fChain->AddBranchToCache("*",kTRUE);
+    }
+    fChainReady=kTRUE;
+    return kTRUE;
+}
+
+Long64_t AraEventReader::getEntries()
+{
+    if(fUseEntryList) return fEntryList.size();
+    return fChain->GetEntries();
+}
+
+/*!
+    Reads the first entry in the calling thread, so it must be called before the first next().
+    \return the station id of the first entry, -1 if it can't be read
+*/
+Int_t AraEventReader::getStationId()
+{
+    if(fStarted) return fCurrent ? fCurrent->raw.stationId : -1;
+    if(!setUpChain() || getEntries()==0) return -1;
+    if(fChain->GetEntry(fUseEntryList ? fEntryList[0] : 0)<=0) return -1;
+    return fReadEvent->stationId;
+}
+
+void AraEventReader::start()
+{
+    fStarted=kTRUE;
+    if(!setUpChain()) {
+        fFinished=kTRUE;
+        return;
+    }
+    AraRootifierPipelineBase::enableThreadSafety();
+
+    //Every queue can hold the whole pool, so nothing but the free queue ever waits for room
+    fFreeQueue=new AraPipelineQueue<Slot*>(fPrefetchDepth+1);
+    for(int slot=0;slot<fPrefetchDepth+1;slot++) {
+        fSlots.push_back(new Slot);
+        fSlots.back()->useful.setUseArena(fUseArena);
+        fFreeQueue->push(fSlots.back(), &fReadStats);
+    }
+    Int_t numOutputs=fNumCalibrators>0 ? fNumCalibrators : 1;
+    for(int i=0;i<numOutputs;i++) fReadyQueues.push_back(new AraPipelineQueue<Slot*>(fPrefetchDepth+1));
+    for(int i=0;i<fNumCalibrators;i++) fCalibQueues.push_back(new AraPipelineQueue<Slot*>(fPrefetchDepth+1));
+
+    fReader=std::thread(&AraEventReader::readEntries, this);
+    for(int i=0;i<fNumCalibrators;i++) {
+        fCalibrators.push_back(std::thread([this, i]() {
+            typedef std::chrono::steady_clock Clock;
+            Slot *slot;
+            while(fCalibQueues[i]->pop(slot, &fCalibStats)) {
+                Clock::time_point start=Clock::now();
+                if(!fStopping.load()) {
+                    slot->useful.recalibrate(&(slot->raw), fCalType);
+                    slot->calibrated=kTRUE;
+                }
+                fCalibStats.addItems(1, 0, std::chrono::duration<double>(Clock::now()-start).count());
+                fReadyQueues[i]->push(slot, &fCalibStats);
+            }
+            fReadyQueues[i]->close();
+        }));
+    }
+}
+
+//! The background read loop, hands the entries to the calibration threads in turn, or straight to next()
+void AraEventReader::readEntries()
+{
+    typedef std::chrono::steady_clock Clock;
+    Long64_t numEntries=getEntries();
+    for(Long64_t i=0;i<numEntries && !fStopping.load();i++) {
+        Slot *slot;
+        fFreeQueue->pop(slot, &fReadStats);
+        if(fStopping.load()) break;
+        Clock::time_point start=Clock::now();
+        Long64_t entry=fUseEntryList ? fEntryList[i] : i;
+        Int_t bytes=fChain->GetEntry(entry);
+        if(bytes<=0) {
+            fprintf(stderr, "AraEventReader -- ERROR Can't read entry %lld\n", entry);
+            break;
+        }
+        //The copy reuses the blocks of the slot, so once the pool is warm nothing is allocated
+        slot->raw=*fReadEvent;
+        slot->entry=entry;
+        slot->run=fReadRun;
+        slot->calibrated=kFALSE;
+        fReadStats.addItems(1, bytes, std::chrono::duration<double>(Clock::now()-start).count());
+        if(fNumCalibrators>0) fCalibQueues[i%fNumCalibrators]->push(slot, &fReadStats);
+        else fReadyQueues[0]->push(slot, &fReadStats);
+    }
+    if(fNumCalibrators>0) {
+        for(int q=0;q<fNumCalibrators;q++) fCalibQueues[q]->close();
+    }
+    else fReadyQueues[0]->close();
+}
+
+Bool_t AraEventReader::next()
+{
+    typedef std::chrono::steady_clock Clock;
+    if(!fStarted) start();
+    if(fFinished) return kFALSE;
+    if(fCurrent) {
+        fAnalysisStats.addItems(1, 0, std::chrono::duration<double>(Clock::now()-fHandedOut).count());
+        fFreeQueue->push(fCurrent, &fAnalysisStats);
+        fCurrent=0;
+    }
+    //The slots arrive in turn from the calibration threads, so taking them in the same turn keeps the entry order
+    if(!fReadyQueues[fNumHandedOut%fReadyQueues.size()]->pop(fCurrent, &fAnalysisStats)) {
+        fCurrent=0;
+        fFinished=kTRUE;
+        return kFALSE;
+    }
+    fNumHandedOut++;
+    fHandedOut=Clock::now();
+    return kTRUE;
+}
+
+//! Stops the threads, handing the slots still on their way back to the free queue so that nothing stays blocked
+void AraEventReader::stop()
+{
+    if(!fStarted || !fFreeQueue) return;
+    fStopping.store(true);
+    if(fCurrent) {
+        fFreeQueue->push(fCurrent, &fAnalysisStats);
+        fCurrent=0;
+    }
+    for(size_t q=0;q<fReadyQueues.size();q++) {
+        Slot *slot;
+        while(fReadyQueues[q]->pop(slot, &fAnalysisStats)) fFreeQueue->push(slot, &fAnalysisStats);
+    }
+    fReader.join();
+    for(size_t i=0;i<fCalibrators.size();i++) fCalibrators[i].join();
+    fCalibrators.clear();
+    for(size_t q=0;q<fReadyQueues.size();q++) delete fReadyQueues[q];
+    for(size_t q=0;q<fCalibQueues.size();q++) delete fCalibQueues[q];
+    fReadyQueues.clear();
+    fCalibQueues.clear();
+    delete fFreeQueue;
+    fFreeQueue=0;
+    fFinished=kTRUE;
+}
+
+Long64_t AraEventReader::getEntry() const
+{
+    return fCurrent ? fCurrent->entry : -1;
+}
+
+Int_t AraEventReader::getRunNumber() const
+{
+    return fCurrent ? fCurrent->run : 0;
+}
+
+RawAtriStationEvent *AraEventReader::getRawEvent()
+{
+    return fCurrent ? &(fCurrent->raw) : NULL;
+}
+
+UsefulAtriStationEvent *AraEventReader::getUsefulEvent()
+{
+    if(!fCurrent) return NULL;
+    if(!fCurrent->calibrated) {
+        fCurrent->useful.recalibrate(&(fCurrent->raw), fCalType);
+        fCurrent->calibrated=kTRUE;
+    }
+    return &(fCurrent->useful);
+}
+
+/*!
+    \param fp where to print
+*/
+void AraEventReader::printStats(FILE *fp) const
+{
+    fprintf(fp, "Event reader:\n");
+    fReadStats.print(fp, 1);
+    if(fNumCalibrators>0) fCalibStats.print(fp, fNumCalibrators);
+    fAnalysisStats.print(fp, 1);
+}
@@ -0,0 +1,116 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraEventReader.h            Prefetching ATRI event tree reader    /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Reads and optionally calibrates the events of ATRI event trees /////
+/////     on background threads, ahead of the analysis loop              /////
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARAEVENTREADER_H
+#define ARAEVENTREADER_H
+
+//Includes
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "Rtypes.h"
+#include "RawAtriStationEvent.h"
+#include "UsefulAtriStationEvent.h"
+#include "AraEventCalibrator.h"
+#include "AraRootifierPipeline.h"
+
+class TChain;
+
+//! Part of AraEvent library. Reads ATRI event trees ahead of an analysis loop, recycling the event objects.
+/*!
+    Replaces the usual GetEntry(), new UsefulAtriStationEvent, analyse, delete loop with
+    \code
+    AraEventReader reader;
+    reader.addFile("event1234.root");
+    reader.setCalibration(AraCalType::kLatestCalib);
+    while(reader.next()) {
+      UsefulAtriStationEvent *usefulEvent = reader.getUsefulEvent();
+      ...
+    }
+    \endcode
+
+    A background thread reads the entries through a TChain with a TTreeCache, and with setCalibration() numThreads more
+    threads calibrate them, so reading, decompressing and calibrating the next events overlaps with the analysis of this one.
+    The events come back in entry order whatever the number of threads.
+
+    The events are kept in a pool of prefetchDepth slots that are used over and over, so no event objects are allocated once the
+    pool is warm. The events handed out by next() stay valid until the following call to next(), the reader owns them.
+    \ingroup rootclasses
+*/
+class AraEventReader
+{
+    public:
+        AraEventReader(Int_t prefetchDepth=16, const char *treeName="eventTree"); ///< Constructor
+        ~AraEventReader(); ///< Destructor, stops the background threads
+
+        Int_t addFile(const char *fileName); ///< Adds a file, or several with wildcards, to the chain. Returns the number added
+        void setCalibration(AraCalType::AraCalType_t calType, Int_t numThreads=1, Bool_t useArena=kFALSE); ///< Calibrates the events ahead on numThreads threads, or with 0 on demand
+        void setEntryList(const std::vector<Long64_t> &entries); ///< Reads only these entries of the chain, in this order, see AraEventIndexFile
+        void setCacheSize(Long64_t bytes) {fCacheSize=bytes;} ///< The TTreeCache size, 0 for no cache
+
+        Long64_t getEntries(); ///< Number of entries that will be read
+        Int_t getStationId(); ///< The station of the first entry, can be called before the first next() to set up pedestals
+
+        Bool_t next(); ///< Moves on to the next event, returns kFALSE at the end. Starts the background threads on the first call
+        Long64_t getEntry() const; ///< Chain entry of the current event
+        Int_t getRunNumber() const; ///< The run branch of the current event, 0 if the tree has none
+        RawAtriStationEvent *getRawEvent(); ///< The current raw event
+        UsefulAtriStationEvent *getUsefulEvent(); ///< The current calibrated event, calibrated now if it wasn't calibrated ahead
+
+        void printStats(FILE *fp=stdout) const; ///< Prints how the time went, waiting on the reader means the analysis is I/O bound
+
+    private:
+        AraEventReader(const AraEventReader&);
+        AraEventReader &operator=(const AraEventReader&);
+
+        //! One event of the pool
+        struct Slot {
+            Long64_t entry;
+            Int_t run;
+            Bool_t calibrated;
+            RawAtriStationEvent raw;
+            UsefulAtriStationEvent useful;
+        };
+
+        void start();
+        void stop();
+        void readEntries();
+        Bool_t setUpChain();
+
+        TChain *fChain;
+        Int_t fPrefetchDepth;
+        Long64_t fCacheSize;
+        Int_t fNumCalibrators;
+        AraCalType::AraCalType_t fCalType;
+        Bool_t fUseArena;
+        std::vector<Long64_t> fEntryList;
+        Bool_t fUseEntryList;
+        Bool_t fChainReady;
+        RawAtriStationEvent *fReadEvent;
+        Int_t fReadRun;
+
+        std::vector<Slot*> fSlots;
+        AraPipelineQueue<Slot*> *fFreeQueue;
+        std::vector<AraPipelineQueue<Slot*>*> fCalibQueues;
+        std::vector<AraPipelineQueue<Slot*>*> fReadyQueues;
+        std::thread fReader;
+        std::vector<std::thread> fCalibrators;
+        std::atomic<bool> fStopping;
+        Bool_t fStarted;
+        Bool_t fFinished;
+        Slot *fCurrent;
+        Long64_t fNumHandedOut;
+        std::chrono::steady_clock::time_point fHandedOut; ///< When next() last returned, to time the analysis
+
+        AraPipelineStageStats fReadStats;
+        AraPipelineStageStats fCalibStats;
+        AraPipelineStageStats fAnalysisStats;
+};
+
+#endif //ARAEVENTREADER_H
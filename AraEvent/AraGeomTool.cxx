@@ -14,6 +14,7 @@
 #include <zlib.h>
 #include <cstdlib>
 #include <ctime>
+#include <mutex>
 
 //sqlite includes
 #include <sqlite3.h>
@@ -24,6 +25,9 @@
 #include "TVector3.h"
 
 AraGeomTool * AraGeomTool::fgInstance=0;
+
+// Guards the lazy creation of the instance and of the station info objects, so that several calibration threads can share the geometry
+static std::recursive_mutex fGeomToolMutex;
 Double_t AraGeomTool::nTopOfIce=1.48;
 const Double_t fFtInm=0.3048;
 
@@ -116,6 +120,7 @@ AraGeomTool::~AraGeomTool() {
 AraGeomTool*  AraGeomTool::Instance()
 {
     // static function
+    std::lock_guard<std::recursive_mutex> lock(fGeomToolMutex);
     if(fgInstance)
         return fgInstance;
 
@@ -512,6 +517,7 @@ AraStationInfo *AraGeomTool::getStationInfo(AraStationId_t stationId,Int_t DByea
 {
     Int_t unixtime=DByear;
         
+    std::lock_guard<std::recursive_mutex> lock(fGeomToolMutex);
     int calibIndex=getStationCalibIndex(stationId);
     if(isIcrrStation(stationId)) {
         if(!fStationInfoICRR[calibIndex]) {
@@ -534,6 +540,7 @@ AraStationInfo *AraGeomTool::getStationInfo(AraStationId_t stationId,Int_t DByea
 // Changed the order of arguments of AraStationInfo to have backwards compatibility after introducing default value in the constructor of AraStationInfo by UAL 02/19/2019
 AraStationInfo *AraGeomTool::LoadSQLDbAtri(Int_t unixtime, AraStationId_t stationId)
 {
+    std::lock_guard<std::recursive_mutex> lock(fGeomToolMutex);
     int calibIndex=getStationCalibIndex(stationId);
     if(isAtriStation(stationId)) {
         if(!fStationInfoATRI[calibIndex]) {
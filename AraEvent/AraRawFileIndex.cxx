@@ -0,0 +1,509 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraRawFileIndex.cxx         Random access into raw DAQ files      /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Access points into the gzip stream of a raw ATRI event file,   /////
+/////     so any event or segment can be inflated without the rest       /////
+//////////////////////////////////////////////////////////////////////////////
+
+//C++ includes
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <sys/stat.h>
+#include <zlib.h>
+
+//class definition includes
+#include "AraRawFileIndex.h"
+
+//AraRoot Includes
+#include "AraRootifierPipeline.h"
+
+namespace {
+    const char kIndexMagic[8]={'A','R','A','Z','I','D','X','1'};
+    const size_t kWindowSize=32768; //The furthest back deflate can refer
+    const size_t kInputChunk=1<<16;
+    const size_t kOutputChunk=1<<20;
+
+    //The body of the index is put together in memory, so its checksum can go in front of it
+    void putBytes(std::vector<char> &body, const void *bytes, size_t length) {body.insert(body.end(),(const char*)bytes,(const char*)bytes+length);}
+    template<class T> void putValue(std::vector<char> &body, const T &value) {putBytes(body,&value,sizeof(T));}
+    bool getBytes(const std::vector<char> &body, size_t &pos, void *bytes, size_t length) {
+        if(body.size()-pos<length) return false;
+        if(length>0) memcpy(bytes,&body[pos],length);
+        pos+=length;
+        return true;
+    }
+    template<class T> bool getValue(const std::vector<char> &body, size_t &pos, T &value) {return getBytes(body,pos,&value,sizeof(T));}
+}
+
+AraRawFileIndex::AraRawFileIndex()
+    : fRawFileSize(0), fRawFileModTime(0), fPlain(kFALSE), fSpan(0), fUncompressedSize(0)
+{
+}
+
+/*!
+    \param rawFileName the raw file
+    \param indexDir the directory of the index, NULL for the directory of the raw file
+    \return the index file name, the raw file name with .zidx appended
+*/
+std::string AraRawFileIndex::getIndexFileName(const char *rawFileName, const char *indexDir)
+{
+    std::string indexFileName(rawFileName);
+    if(indexDir) {
+        size_t slash=indexFileName.rfind('/');
+        if(slash!=std::string::npos) indexFileName.erase(0,slash+1);
+        indexFileName=std::string(indexDir)+"/"+indexFileName;
+    }
+    return indexFileName+".zidx";
+}
+
+Bool_t AraRawFileIndex::getRawFileStat(const char *rawFileName, ULong64_t &size, Long64_t &modTime) const
+{
+    struct stat fileStat;
+    if(stat(rawFileName,&fileStat)!=0) return kFALSE;
+    size=fileStat.st_size;
+    modTime=fileStat.st_mtime;
+    return kTRUE;
+}
+
+/*!
+    This costs as much as reading the file the usual way, so passing data lets the caller use the inflated file as well.
+    \param rawFileName the raw file, gzipped or not
+    \param span the inflated bytes between access points, each of which takes up to 32 kB, usually much less, in the index
+    \param data if not NULL, filled with the inflated file
+    \return kFALSE if the file can't be read, is truncated or has more than one gzip member, the index is then incomplete and shouldn't be written
+*/
+Bool_t AraRawFileIndex::build(const char *rawFileName, ULong64_t span, std::vector<char> *data)
+{
+    fRawFileName=rawFileName;
+    fSpan=span>0 ? span : 1;
+    fPoints.clear();
+    fEventOffsets.clear();
+    fEventLengths.clear();
+    fUncompressedSize=0;
+    fPlain=kFALSE;
+
+    FILE *in=fopen(rawFileName,"rb");
+    if(!in || !getRawFileStat(rawFileName,fRawFileSize,fRawFileModTime)) {
+        fprintf(stderr, "AraRawFileIndex::build -- ERROR Can't open %s: %s\n", rawFileName, strerror(errno));
+        if(in) fclose(in);
+        return kFALSE;
+    }
+
+    //The inflated file is needed to find the events, so it is kept here if the caller doesn't want it
+    AraPipelineFile file;
+    std::vector<char> &out = data ? *data : file.data;
+    out.clear();
+    Bool_t ok=kTRUE;
+
+    unsigned char magic[2]={0,0};
+    fPlain=(fread(magic,1,2,in)!=2 || magic[0]!=0x1f || magic[1]!=0x8b);
+    rewind(in);
+    if(fPlain) {
+        out.resize(fRawFileSize);
+        if(fRawFileSize>0 && fread(&out[0],1,fRawFileSize,in)!=fRawFileSize) {
+            fprintf(stderr, "AraRawFileIndex::build -- ERROR Reading %s\n", rawFileName);
+            ok=kFALSE;
+        }
+        fUncompressedSize=out.size();
+    }
+    else {
+        //As zlib's zran.c, stopping at each deflate block boundary to see whether it is time for another access point
+        z_stream strm;
+        memset(&strm,0,sizeof(strm));
+        inflateInit2(&strm,47); //gzip header
+        std::vector<unsigned char> input(kInputChunk);
+        ULong64_t last=0;
+        int ret=Z_OK;
+        do {
+            strm.avail_in=fread(&input[0],1,kInputChunk,in);
+            if(ferror(in) || strm.avail_in==0) {
+                ret=Z_DATA_ERROR;
+                break;
+            }
+            strm.next_in=&input[0];
+            do {
+                if(strm.avail_out==0) {
+                    size_t upto=strm.total_out;
+                    out.resize(upto+kOutputChunk);
+                    strm.next_out=(Bytef*)&out[upto];
+                    strm.avail_out=kOutputChunk;
+                }
+                ret=inflate(&strm,Z_BLOCK);
+                if(ret==Z_NEED_DICT) ret=Z_DATA_ERROR;
+                if(ret==Z_MEM_ERROR || ret==Z_DATA_ERROR || ret==Z_STREAM_END) break;
+                //Bit 128 is set at the end of a block or the gzip header, bit 64 after the last block
+                if((strm.data_type & 128) && !(strm.data_type & 64) && (strm.total_out==0 || strm.total_out-last>fSpan)) {
+                    addPoint(strm.data_type & 7, strm.total_in, strm.total_out, out);
+                    last=strm.total_out;
+                }
+            } while(strm.avail_in!=0);
+        } while(ret!=Z_STREAM_END && ret!=Z_MEM_ERROR && ret!=Z_DATA_ERROR);
+        if(ret!=Z_STREAM_END) {
+            fprintf(stderr, "AraRawFileIndex::build -- ERROR %s is truncated or corrupt after %lu bytes\n", rawFileName, (unsigned long)strm.total_out);
+            ok=kFALSE;
+        }
+        else {
+            //gzread carries on into a further gzip member, which the access points would miss, but ignores other trailing bytes
+            unsigned char next[2]={0,0};
+            size_t numNext=std::min<size_t>(strm.avail_in,2);
+            if(numNext>0) memcpy(next,strm.next_in,numNext);
+            numNext+=fread(next+numNext,1,2-numNext,in);
+            if(numNext==2 && next[0]==0x1f && next[1]==0x8b) {
+                fprintf(stderr, "AraRawFileIndex::build -- ERROR %s has more than one gzip member\n", rawFileName);
+                ok=kFALSE;
+            }
+        }
+        fUncompressedSize=strm.total_out;
+        out.resize(fUncompressedSize);
+        inflateEnd(&strm);
+    }
+    fclose(in);
+
+    //The events, as the rootifiers split them
+    std::vector<AraPipelineRecord> records;
+    if(data) file.data.swap(*data);
+    AraRootifierPipelineBase::splitAtriEventFile(file,records);
+    if(data) file.data.swap(*data);
+    for(size_t i=0;i<records.size();i++) {
+        fEventOffsets.push_back(records[i].offset);
+        fEventLengths.push_back(records[i].length);
+    }
+    return ok;
+}
+
+//! Keeps an access point, with the data before it compressed as the window
+void AraRawFileIndex::addPoint(Int_t bits, ULong64_t compressedOffset, ULong64_t offset, const std::vector<char> &data)
+{
+    AraRawFileAccessPoint point;
+    point.compressedOffset=compressedOffset;
+    point.offset=offset;
+    point.bits=bits;
+    point.windowLength=std::min<ULong64_t>(offset,kWindowSize);
+    if(point.windowLength>0) {
+        uLongf compressedLength=compressBound(point.windowLength);
+        point.window.resize(compressedLength);
+        compress(&point.window[0],&compressedLength,(const Bytef*)&data[offset-point.windowLength],point.windowLength);
+        point.window.resize(compressedLength);
+    }
+    fPoints.push_back(point);
+}
+
+/*!
+    The file is written to indexFileName.tmp and then renamed, so a reader never sees half an index.
+    \param indexFileName where to write, NULL for getIndexFileName()
+    \return kFALSE if it can't be written
+*/
+Bool_t AraRawFileIndex::write(const char *indexFileName) const
+{
+    std::vector<char> body;
+    putValue(body,fRawFileSize);
+    putValue(body,fRawFileModTime);
+    putValue(body,fPlain);
+    putValue(body,fSpan);
+    putValue(body,fUncompressedSize);
+    UInt_t numPoints=fPoints.size();
+    putValue(body,numPoints);
+    for(UInt_t i=0;i<numPoints;i++) {
+        const AraRawFileAccessPoint &point=fPoints[i];
+        UInt_t compressedLength=point.window.size();
+        putValue(body,point.compressedOffset);
+        putValue(body,point.offset);
+        putValue(body,point.bits);
+        putValue(body,point.windowLength);
+        putValue(body,compressedLength);
+        if(compressedLength>0) putBytes(body,&point.window[0],compressedLength);
+    }
+    UInt_t numEvents=fEventOffsets.size();
+    putValue(body,numEvents);
+    if(numEvents>0) {
+        putBytes(body,&fEventOffsets[0],numEvents*sizeof(ULong64_t));
+        putBytes(body,&fEventLengths[0],numEvents*sizeof(UInt_t));
+    }
+    UInt_t checksum=crc32(crc32(0L, Z_NULL, 0),(const Bytef*)&body[0],body.size());
+
+    std::string fileName=indexFileName ? indexFileName : getIndexFileName(fRawFileName.c_str());
+    std::string tmpName=fileName+".tmp";
+    FILE *fp=fopen(tmpName.c_str(),"wb");
+    if(!fp) {
+        fprintf(stderr, "AraRawFileIndex::write -- ERROR Can't open %s: %s\n", tmpName.c_str(), strerror(errno));
+        return kFALSE;
+    }
+    bool ok=fwrite(kIndexMagic,1,sizeof(kIndexMagic),fp)==sizeof(kIndexMagic) && fwrite(&checksum,sizeof(checksum),1,fp)==1
+        && fwrite(&body[0],1,body.size(),fp)==body.size();
+    if(fclose(fp)!=0) ok=false;
+    if(!ok || rename(tmpName.c_str(),fileName.c_str())!=0) {
+        fprintf(stderr, "AraRawFileIndex::write -- ERROR Can't write %s: %s\n", fileName.c_str(), strerror(errno));
+        remove(tmpName.c_str());
+        return kFALSE;
+    }
+    return kTRUE;
+}
+
+/*!
+    \param rawFileName the raw file
+    \param indexFileName the index, NULL for getIndexFileName()
+    \return kFALSE if the index is missing, damaged, or was made from a different size or age of raw file
+*/
+Bool_t AraRawFileIndex::read(const char *rawFileName, const char *indexFileName)
+{
+    std::string fileName=indexFileName ? indexFileName : getIndexFileName(rawFileName);
+    FILE *fp=fopen(fileName.c_str(),"rb");
+    if(!fp) return kFALSE;
+    fRawFileName=rawFileName;
+    fPoints.clear();
+    fEventOffsets.clear();
+    fEventLengths.clear();
+
+    char magic[sizeof(kIndexMagic)];
+    UInt_t checksum=0;
+    std::vector<char> body;
+    bool ok=fread(magic,1,sizeof(magic),fp)==sizeof(magic) && memcmp(magic,kIndexMagic,sizeof(magic))==0
+        && fread(&checksum,sizeof(checksum),1,fp)==1;
+    if(ok) {
+        //The rest of the file is the body
+        const size_t chunk=1<<16;
+        size_t numRead=0;
+        do {
+            body.resize(body.size()+chunk);
+            numRead=fread(&body[body.size()-chunk],1,chunk,fp);
+            body.resize(body.size()-chunk+numRead);
+        } while(numRead==chunk);
+        ok=!ferror(fp) && !body.empty() && crc32(crc32(0L, Z_NULL, 0),(const Bytef*)&body[0],body.size())==checksum;
+    }
+    fclose(fp);
+
+    size_t pos=0;
+    ULong64_t rawFileSize=0;
+    Long64_t rawFileModTime=0;
+    ok=ok && getValue(body,pos,fRawFileSize) && getValue(body,pos,fRawFileModTime) && getValue(body,pos,fPlain)
+        && getValue(body,pos,fSpan) && getValue(body,pos,fUncompressedSize);
+    ok=ok && getRawFileStat(rawFileName,rawFileSize,rawFileModTime) && rawFileSize==fRawFileSize && rawFileModTime==fRawFileModTime;
+    UInt_t numPoints=0;
+    ok=ok && getValue(body,pos,numPoints);
+    for(UInt_t i=0;ok && i<numPoints;i++) {
+        AraRawFileAccessPoint point;
+        UInt_t compressedLength=0;
+        ok=getValue(body,pos,point.compressedOffset) && getValue(body,pos,point.offset) && getValue(body,pos,point.bits)
+            && getValue(body,pos,point.windowLength) && getValue(body,pos,compressedLength)
+            && point.windowLength<=kWindowSize && compressedLength<=body.size()-pos;
+        if(!ok) break;
+        point.window.resize(compressedLength);
+        if(compressedLength>0) getBytes(body,pos,&point.window[0],compressedLength);
+        fPoints.push_back(point);
+    }
+    UInt_t numEvents=0;
+    ok=ok && getValue(body,pos,numEvents) && numEvents*(sizeof(ULong64_t)+sizeof(UInt_t))==body.size()-pos;
+    if(ok && numEvents>0) {
+        fEventOffsets.resize(numEvents);
+        fEventLengths.resize(numEvents);
+        ok=getBytes(body,pos,&fEventOffsets[0],numEvents*sizeof(ULong64_t))
+            && getBytes(body,pos,&fEventLengths[0],numEvents*sizeof(UInt_t));
+    }
+    if(!ok || (!fPlain && fPoints.empty())) {
+        fPoints.clear();
+        fEventOffsets.clear();
+        fEventLengths.clear();
+        return kFALSE;
+    }
+    return kTRUE;
+}
+
+/*!
+    \param rawFileName the raw file
+    \param indexDir the directory of the index, NULL for the directory of the raw file, see getIndexFileName()
+    \param writeIndex write the index there if it had to be built
+    \param data if not NULL and the index had to be built, filled with the inflated file, else left empty
+    \return kFALSE if there is no index and one can't be built
+*/
+Bool_t AraRawFileIndex::readOrBuild(const char *rawFileName, const char *indexDir, Bool_t writeIndex, std::vector<char> *data)
+{
+    if(data) data->clear();
+    std::string indexFileName=getIndexFileName(rawFileName,indexDir);
+    if(read(rawFileName,indexFileName.c_str())) return kTRUE;
+    if(!build(rawFileName,1048576,data)) return kFALSE;
+    if(writeIndex) write(indexFileName.c_str());
+    return kTRUE;
+}
+
+//! The last access point at or before offset
+Int_t AraRawFileIndex::findPoint(ULong64_t offset) const
+{
+    Int_t point=0;
+    Int_t high=fPoints.size();
+    while(high-point>1) {
+        Int_t mid=(point+high)/2;
+        if(fPoints[mid].offset<=offset) point=mid;
+        else high=mid;
+    }
+    return point;
+}
+
+/*!
+    \param offset where to start in the inflated data
+    \param length number of bytes
+    \param buffer filled with them
+    \return kFALSE if the range is past the end of the file or the file can't be read
+*/
+Bool_t AraRawFileIndex::readRange(ULong64_t offset, size_t length, char *buffer) const
+{
+    if(offset+length>fUncompressedSize) {
+        fprintf(stderr, "AraRawFileIndex::readRange -- ERROR Bytes %llu to %llu are past the end of %s\n",
+                (unsigned long long)offset, (unsigned long long)(offset+length), fRawFileName.c_str());
+        return kFALSE;
+    }
+    if(length==0) return kTRUE;
+    if(fPlain) {
+        FILE *in=fopen(fRawFileName.c_str(),"rb");
+        bool ok=in && fseeko(in,offset,SEEK_SET)==0 && fread(buffer,1,length,in)==length;
+        if(in) fclose(in);
+        if(!ok) fprintf(stderr, "AraRawFileIndex::readRange -- ERROR Reading %s\n", fRawFileName.c_str());
+        return ok;
+    }
+    return inflateFrom(findPoint(offset),offset,length,buffer);
+}
+
+//! Inflates from an access point, throwing away the output before offset
+Bool_t AraRawFileIndex::inflateFrom(Int_t pointIndex, ULong64_t offset, size_t length, char *buffer) const
+{
+    if(pointIndex<0 || pointIndex>=(Int_t)fPoints.size()) return kFALSE;
+    const AraRawFileAccessPoint &point=fPoints[pointIndex];
+    FILE *in=fopen(fRawFileName.c_str(),"rb");
+    if(!in) {
+        fprintf(stderr, "AraRawFileIndex::readRange -- ERROR Can't open %s: %s\n", fRawFileName.c_str(), strerror(errno));
+        return kFALSE;
+    }
+
+    //Raw deflate from the access point, with the bits of the block in the byte before it and the window it may refer back to
+    z_stream strm;
+    memset(&strm,0,sizeof(strm));
+    inflateInit2(&strm,-15);
+    bool ok=fseeko(in,point.compressedOffset-(point.bits ? 1 : 0),SEEK_SET)==0;
+    if(ok && point.bits) {
+        int byte=getc(in);
+        ok=byte!=EOF;
+        if(ok) inflatePrime(&strm,point.bits,byte>>(8-point.bits));
+    }
+    std::vector<unsigned char> window(kWindowSize);
+    if(ok && point.windowLength>0) {
+        uLongf windowLength=point.windowLength;
+        ok=uncompress(&window[0],&windowLength,&point.window[0],point.window.size())==Z_OK && windowLength==point.windowLength;
+        if(ok) inflateSetDictionary(&strm,&window[0],point.windowLength);
+    }
+
+    std::vector<unsigned char> input(kInputChunk);
+    ULong64_t toSkip=offset-point.offset;
+    size_t done=0;
+    int ret=Z_OK;
+    while(ok && done<length) {
+        if(strm.avail_in==0) {
+            strm.avail_in=fread(&input[0],1,kInputChunk,in);
+            if(ferror(in) || strm.avail_in==0) {
+                ok=false;
+                break;
+            }
+            strm.next_in=&input[0];
+        }
+        //The window buffer is free once it is in the dictionary, so it takes the output that is skipped
+        if(toSkip>0) {
+            strm.next_out=&window[0];
+            strm.avail_out=std::min<ULong64_t>(toSkip,kWindowSize);
+        }
+        else {
+            strm.next_out=(Bytef*)buffer+done;
+            strm.avail_out=std::min<size_t>(length-done,1u<<30);
+        }
+        uInt before=strm.avail_out;
+        ret=inflate(&strm,Z_NO_FLUSH);
+        if(ret==Z_NEED_DICT || ret==Z_DATA_ERROR || ret==Z_MEM_ERROR || ret==Z_BUF_ERROR) ok=false;
+        uInt produced=before-strm.avail_out;
+        if(toSkip>0) toSkip-=produced;
+        else done+=produced;
+        if(ret==Z_STREAM_END) break;
+    }
+    inflateEnd(&strm);
+    fclose(in);
+    if(!ok || done!=length) {
+        fprintf(stderr, "AraRawFileIndex::readRange -- ERROR Can't inflate %s from access point %d\n", fRawFileName.c_str(), pointIndex);
+        return kFALSE;
+    }
+    return kTRUE;
+}
+
+/*!
+    \param event the position of the event in the file
+    \param record filled with the event, header included
+*/
+Bool_t AraRawFileIndex::readEvent(Int_t event, std::vector<char> &record) const
+{
+    if(event<0 || event>=getNumEvents()) return kFALSE;
+    record.resize(fEventLengths[event]);
+    return readRange(fEventOffsets[event],record.size(),&record[0]);
+}
+
+/*!
+    Inflates only from the access point before firstEvent, so a conversion can pick up part way through a file.
+    \param firstEvent the first event
+    \param numEvents number of events, fewer if the file ends first
+    \param file its data is filled with the events, which are contiguous in the file
+    \param records filled with one record per event, with offsets in file.data
+*/
+Bool_t AraRawFileIndex::readEvents(Int_t firstEvent, Int_t numEvents, AraPipelineFile &file, std::vector<AraPipelineRecord> &records) const
+{
+    file.data.clear();
+    records.clear();
+    if(firstEvent<0) return kFALSE;
+    Int_t lastEvent=std::min(firstEvent+numEvents,getNumEvents());
+    if(firstEvent>=lastEvent) return kTRUE;
+    ULong64_t start=fEventOffsets[firstEvent];
+    ULong64_t end=fEventOffsets[lastEvent-1]+fEventLengths[lastEvent-1];
+    file.data.resize(end-start);
+    if(!readRange(start,end-start,&file.data[0])) {
+        file.data.clear();
+        return kFALSE;
+    }
+    for(Int_t event=firstEvent;event<lastEvent;event++) {
+        AraPipelineRecord record;
+        record.offset=fEventOffsets[event]-start;
+        record.length=fEventLengths[event];
+        records.push_back(record);
+    }
+    return kTRUE;
+}
+
+/*!
+    Each thread takes the next segment between two access points and inflates it straight into its place in data.
+    \param data filled with the inflated file
+    \param numThreads number of threads, 0 for one per core
+*/
+Bool_t AraRawFileIndex::readAll(std::vector<char> &data, Int_t numThreads) const
+{
+    data.resize(fUncompressedSize);
+    if(fUncompressedSize==0) return kTRUE;
+    if(fPlain) return readRange(0,fUncompressedSize,&data[0]);
+    if(numThreads<=0) numThreads=std::thread::hardware_concurrency();
+    numThreads=std::max(1,std::min(numThreads,getNumAccessPoints()));
+
+    std::atomic<Int_t> nextPoint(0);
+    std::atomic<bool> failed(false);
+    auto inflateSegments=[&]() {
+        for(Int_t point=nextPoint++;point<getNumAccessPoints() && !failed.load();point=nextPoint++) {
+            ULong64_t start=fPoints[point].offset;
+            ULong64_t end=point+1<getNumAccessPoints() ? fPoints[point+1].offset : fUncompressedSize;
+            if(end>start && !inflateFrom(point,start,end-start,&data[start])) failed.store(true);
+        }
+    };
+    std::vector<std::thread> threads;
+    for(int i=1;i<numThreads;i++) threads.push_back(std::thread(inflateSegments));
+    inflateSegments();
+    for(size_t i=0;i<threads.size();i++) threads[i].join();
+    if(failed.load()) {
+        data.clear();
+        return kFALSE;
+    }
+    return kTRUE;
+}
@@ -0,0 +1,85 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraRawFileIndex.h           Random access into raw DAQ files      /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Access points into the gzip stream of a raw ATRI event file,   /////
+/////     so any event or segment can be inflated without the rest       /////
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARARAWFILEINDEX_H
+#define ARARAWFILEINDEX_H
+
+//Includes
+#include <string>
+#include <vector>
+#include "Rtypes.h"
+
+struct AraPipelineFile;
+struct AraPipelineRecord;
+
+//! Part of AraEvent library. A place in a gzip stream where inflating can start, see AraRawFileIndex.
+struct AraRawFileAccessPoint
+{
+    ULong64_t compressedOffset; ///< Offset in the gzip file of the first full byte of the deflate block
+    ULong64_t offset; ///< Offset in the inflated data
+    Int_t bits; ///< Number of bits of the block in the byte before compressedOffset, 0 to 7
+    UInt_t windowLength; ///< Inflated length of the window, the data before offset, at most 32 kB
+    std::vector<UChar_t> window; ///< The window, compressed with zlib, that the block may refer back to
+};
+
+//! Part of AraEvent library. An index of the access points and events of a raw ATRI event file, written next to it.
+/*!
+    The raw event files are single gzip streams, so reaching one event normally means inflating everything before it.
+    Building the index inflates the file once and, as zlib's zran example does, keeps an access point at the first
+    deflate block boundary after every span bytes of output: where the block starts and the 32 kB of output before it.
+    Inflating can then start at any access point, so reading one event only inflates from the access point before it,
+    and the segments between access points can be inflated on several threads at once.
+
+    The index also holds where each event starts in the inflated data, as split by AraRootifierPipelineBase::splitAtriEventFile(),
+    and the size and modification time of the raw file, so an index left over from an older version of the file is not used.
+    It is written to getIndexFileName(), the raw file name with .zidx appended, next to the raw file or in another directory,
+    through a temporary file and with a checksum like the other AraEvent index files. Files that are not gzipped are indexed too,
+    their access points are just the file offsets. A gzip file with several members can't be indexed, build() fails on it.
+*/
+class AraRawFileIndex
+{
+    public:
+        AraRawFileIndex(); ///< Default constructor
+
+        Bool_t build(const char *rawFileName, ULong64_t span=1048576, std::vector<char> *data=0); ///< Inflates the whole file once, optionally keeping the inflated data
+        Bool_t write(const char *indexFileName=0) const; ///< Writes the index, by default to getIndexFileName()
+        Bool_t read(const char *rawFileName, const char *indexFileName=0); ///< Reads the index of rawFileName, kFALSE if it is missing or out of date
+        Bool_t readOrBuild(const char *rawFileName, const char *indexDir=0, Bool_t writeIndex=kFALSE, std::vector<char> *data=0); ///< Reads the index, else builds it and optionally writes it
+
+        static std::string getIndexFileName(const char *rawFileName, const char *indexDir=0); ///< The index file name of a raw file, in indexDir if it is given
+
+        const std::string &getRawFileName() const {return fRawFileName;}
+        ULong64_t getUncompressedSize() const {return fUncompressedSize;} ///< Size of the inflated data
+        Int_t getNumAccessPoints() const {return fPoints.size();}
+        Int_t getNumEvents() const {return fEventOffsets.size();}
+        ULong64_t getEventOffset(Int_t event) const {return fEventOffsets[event];} ///< Where an event starts in the inflated data, header included
+        UInt_t getEventLength(Int_t event) const {return fEventLengths[event];} ///< The length of an event, header included
+
+        Bool_t readRange(ULong64_t offset, size_t length, char *buffer) const; ///< Inflates length bytes from offset, starting at the access point before it
+        Bool_t readEvent(Int_t event, std::vector<char> &record) const; ///< Inflates one event, header included
+        Bool_t readEvents(Int_t firstEvent, Int_t numEvents, AraPipelineFile &file, std::vector<AraPipelineRecord> &records) const; ///< Inflates a run of events into file.data, as the split stage of a pipeline would
+        Bool_t readAll(std::vector<char> &data, Int_t numThreads=1) const; ///< Inflates the whole file, the segments between access points on numThreads threads
+
+    private:
+        void addPoint(Int_t bits, ULong64_t compressedOffset, ULong64_t offset, const std::vector<char> &data);
+        Bool_t inflateFrom(Int_t point, ULong64_t offset, size_t length, char *buffer) const;
+        Int_t findPoint(ULong64_t offset) const;
+        Bool_t getRawFileStat(const char *rawFileName, ULong64_t &size, Long64_t &modTime) const;
+
+        std::string fRawFileName;
+        ULong64_t fRawFileSize; ///< Size of the raw file when it was indexed
+        Long64_t fRawFileModTime; ///< Modification time of the raw file when it was indexed
+        Bool_t fPlain; ///< The raw file is not gzipped
+        ULong64_t fSpan; ///< Inflated bytes between access points
+        ULong64_t fUncompressedSize;
+        std::vector<AraRawFileAccessPoint> fPoints;
+        std::vector<ULong64_t> fEventOffsets;
+        std::vector<UInt_t> fEventLengths;
+};
+
+#endif //ARARAWFILEINDEX_H
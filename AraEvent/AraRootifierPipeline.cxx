@@ -0,0 +1,209 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraRootifierPipeline.cxx    Raw file to tree conversion pipeline  /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Runs the read, split, build and fill stages of the rootifiers  /////
+/////     on their own threads, connected by bounded queues              /////
+//////////////////////////////////////////////////////////////////////////////
+
+//C++ includes
+#include <cerrno>
+#include <iostream>
+#include <zlib.h>
+
+//class definition includes
+#include "AraRootifierPipeline.h"
+
+//AraRoot Includes
+#include "araAtriStructures.h"
+#include "AraRawFileIndex.h"
+
+//ROOT includes
+#include "TROOT.h"
+#include "RVersion.h"
+
+AraPipelineStageStats::AraPipelineStageStats(const char *name)
+    : fName(name), fItems(0), fBytes(0), fBusyNs(0), fWaitNs(0)
+{
+}
+
+/*!
+    \param items number of items handled
+    \param bytes number of bytes handled
+    \param busySeconds time spent handling them
+*/
+void AraPipelineStageStats::addItems(ULong64_t items, ULong64_t bytes, Double_t busySeconds)
+{
+    fItems += items;
+    fBytes += bytes;
+    fBusyNs += ULong64_t(busySeconds*1e9);
+}
+
+/*!
+    \param waitSeconds time spent blocked on a queue
+*/
+void AraPipelineStageStats::addWait(Double_t waitSeconds)
+{
+    fWaitNs += ULong64_t(waitSeconds*1e9);
+}
+
+/*!
+    The rate is per second of busy time of one thread, so it is what the stage could do if it never had to wait.
+    \param fp where to print
+    \param numThreads number of threads running the stage
+*/
+void AraPipelineStageStats::print(FILE *fp, Int_t numThreads) const
+{
+    Double_t busy = fBusyNs.load()*1e-9;
+    Double_t wait = fWaitNs.load()*1e-9;
+    fprintf(fp, "  %-6s %2d thread(s) %10llu items %10.1f MB  busy %8.2f s  wait %8.2f s", fName.c_str(), numThreads,
+            (unsigned long long)fItems.load(), fBytes.load()/1048576., busy, wait);
+    if(busy>0)
+        fprintf(fp, "  %10.1f items/s %8.1f MB/s", fItems.load()/busy*numThreads, fBytes.load()/1048576./busy*numThreads);
+    fprintf(fp, "\n");
+}
+
+/*!
+    \param numBuilders number of build threads
+    \param queueDepth number of files each queue between two stages can hold
+*/
+AraRootifierPipelineBase::AraRootifierPipelineBase(Int_t numBuilders, size_t queueDepth)
+    : fNumBuilders(numBuilders>0 ? numBuilders : 1), fQueueDepth(queueDepth>0 ? queueDepth : 1), fReadThreads(1), fFirstEvent(0),
+      fReadStats("read"), fSplitStats("split"), fBuildStats("build"), fFillStats("fill")
+{
+}
+
+/*!
+    \param fp where to print
+*/
+void AraRootifierPipelineBase::printStats(FILE *fp) const
+{
+    fprintf(fp, "Pipeline stages:\n");
+    fReadStats.print(fp, 1);
+    fSplitStats.print(fp, 1);
+    fBuildStats.print(fp, fNumBuilders);
+    fFillStats.print(fp, 1);
+}
+
+/*!
+    The whole file is read, gzread passes plain files through unchanged.
+    With more than one thread the file's AraRawFileIndex is used to inflate it in segments. If there is no index yet it is
+    built, which costs no more than reading the file the usual way, but only written when indexDir is given, so the
+    directories of the raw data are never written to unless asked.
+    \param file file->name is read into file->data, file->readError is set if that fails part way
+    \param numThreads threads inflating the file
+    \param indexDir the directory the indices are read from and new ones written to, NULL to only read them from next to the raw files
+*/
+void AraRootifierPipelineBase::readFile(AraPipelineFile *file, Int_t numThreads, const char *indexDir)
+{
+    file->data.clear();
+    file->readError = 0;
+    if(numThreads>1) {
+        AraRawFileIndex index;
+        if(index.readOrBuild(file->name.c_str(), indexDir, indexDir!=0, &(file->data))) {
+            if(!file->data.empty() || index.readAll(file->data, numThreads)) return;
+        }
+        //A truncated file has no index, it is read as far as it goes below
+        file->data.clear();
+    }
+    gzFile infile = gzopen(file->name.c_str(), "rb");
+    if(!infile) {
+        fprintf(stderr, "AraRootifierPipeline::readFile -- ERROR Can't open %s: %s\n", file->name.c_str(), strerror(errno));
+        file->readError = 1;
+        return;
+    }
+    const size_t chunk = 1<<20;
+    size_t upto = 0;
+    int numBytes;
+    do {
+        file->data.resize(upto+chunk);
+        numBytes = gzread(infile, &(file->data[upto]), chunk);
+        if(numBytes>0) upto += numBytes;
+    } while(numBytes==int(chunk));
+    if(numBytes<0) {
+        int errnum;
+        fprintf(stderr, "AraRootifierPipeline::readFile -- ERROR Reading %s: %s\n", file->name.c_str(), gzerror(infile, &errnum));
+        file->readError = 1;
+    }
+    file->data.resize(upto);
+    gzclose(infile);
+}
+
+/*!
+    Uses the AraRawFileIndex of the file, so only the events from firstEvent on are inflated when the index has already been
+    written. A file that can't be indexed, such as a truncated one, is read whole and the events before firstEvent dropped.
+    \param file the file to read, its data is left empty if it has no more than firstEvent events
+    \param firstEvent the first event to keep, counting from 0 as splitAtriEventFile() finds them
+    \param indexDir where to find the index, and write it if it is missing, else the index next to the file is used and never written
+    \return the number of events in the whole file
+*/
+Long64_t AraRootifierPipelineBase::readAtriEventFileFrom(AraPipelineFile *file, Long64_t firstEvent, const char *indexDir)
+{
+    file->data.clear();
+    file->readError = 0;
+    std::vector<AraPipelineRecord> records;
+    AraRawFileIndex index;
+    std::vector<char> data;
+    if(index.readOrBuild(file->name.c_str(), indexDir, indexDir!=0, &data)) {
+        Long64_t numEvents = index.getNumEvents();
+        if(firstEvent>=numEvents) return numEvents;
+        //A new index keeps the data it was built from
+        if(!data.empty()) {
+            file->data.assign(data.begin()+index.getEventOffset(firstEvent), data.end());
+            return numEvents;
+        }
+        if(index.readEvents(firstEvent, numEvents-firstEvent, *file, records)) return numEvents;
+    }
+    readFile(file);
+    splitAtriEventFile(*file, records);
+    Long64_t numEvents = records.size();
+    if(firstEvent>=numEvents) file->data.clear();
+    else file->data.erase(file->data.begin(), file->data.begin()+records[firstEvent].offset);
+    return numEvents;
+}
+
+void AraRootifierPipelineBase::enableThreadSafety()
+{
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+    ROOT::EnableThreadSafety();
+#endif
+}
+
+/*!
+    Each event is a header followed by gHdr.numBytes-sizeof(header) bytes of readout blocks.
+    The split stops at the first read problem, keeping the events before it, as the serial read loops always did.
+    \param file the decompressed file
+    \param records filled with one record per event, the header included
+    \param maxEvents the most events taken from one file
+*/
+void AraRootifierPipelineBase::splitAtriEventFile(const AraPipelineFile &file, std::vector<AraPipelineRecord> &records, Int_t maxEvents)
+{
+    size_t upto=0;
+    const size_t fileSize=file.data.size();
+    for(int i=0;i<maxEvents;i++) {
+        size_t numBytes=fileSize-upto;
+        if(numBytes==0) break;
+        if(numBytes<sizeof(AraStationEventHeader_t)) {
+            std::cerr << "Read problem: " << numBytes << " of " << sizeof(AraStationEventHeader_t) << std::endl;
+            break;
+        }
+        AraStationEventHeader_t theEventHeader;
+        memcpy(&theEventHeader,&file.data[upto],sizeof(AraStationEventHeader_t));
+        if(theEventHeader.gHdr.numBytes==0) {
+            std::cerr << "How can gHdr.numBytes = " << theEventHeader.gHdr.numBytes << "\n";
+            break;
+        }
+        Int_t numDataBytes=theEventHeader.gHdr.numBytes-sizeof(AraStationEventHeader_t);
+        numBytes-=sizeof(AraStationEventHeader_t);
+        if(numBytes==0) break;
+        if(numDataBytes<0 || numBytes<size_t(numDataBytes)) {
+            std::cerr << "Read problem: " << numBytes << " of " << numDataBytes << std::endl;
+            break;
+        }
+        AraPipelineRecord record;
+        record.offset=upto;
+        record.length=sizeof(AraStationEventHeader_t)+numDataBytes;
+        records.push_back(record);
+        upto+=record.length;
+    }
+}
@@ -0,0 +1,294 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraRootifierPipeline.h      Raw file to tree conversion pipeline  /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Runs the read, split, build and fill stages of the rootifiers  /////
+/////     on their own threads, connected by bounded queues              /////
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARAROOTIFIERPIPELINE_H
+#define ARAROOTIFIERPIPELINE_H
+
+//Includes
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include "Rtypes.h"
+
+//! Part of AraEvent library. One raw file of a rootifier file list, as read by the read stage.
+struct AraPipelineFile
+{
+    size_t index; ///< Position in the file list
+    std::string name; ///< The file name
+    std::vector<char> data; ///< The decompressed contents, modifiable by the split stage
+    Int_t readError; ///< Set if the file could not be opened or stopped decompressing part way, data then holds what was read
+};
+
+//! Part of AraEvent library. One record (event, housekeeping...) found in an AraPipelineFile by the split stage.
+struct AraPipelineRecord
+{
+    size_t offset; ///< Start in AraPipelineFile::data
+    size_t length; ///< Length in bytes
+};
+
+//! Part of AraEvent library. Counters of one pipeline stage.
+/*!
+    Busy time is spent working on items, wait time is spent blocked on an empty input queue or a full output queue.
+    With several build threads the counters are summed over them.
+*/
+class AraPipelineStageStats
+{
+    public:
+        AraPipelineStageStats(const char *name);
+        void addItems(ULong64_t items, ULong64_t bytes, Double_t busySeconds); ///< Counts work done
+        void addWait(Double_t waitSeconds); ///< Counts time blocked on a queue
+        void print(FILE *fp, Int_t numThreads) const; ///< Prints one line of counters and throughput
+    private:
+        std::string fName;
+        std::atomic<ULong64_t> fItems;
+        std::atomic<ULong64_t> fBytes;
+        std::atomic<ULong64_t> fBusyNs;
+        std::atomic<ULong64_t> fWaitNs;
+};
+
+//! Part of AraEvent library. Bounded lock free queue with one producer thread and one consumer thread.
+/*!
+    push() and pop() spin, then yield, then sleep while the queue is full or empty, so a stage waiting on
+    a slow neighbour does not burn a core. The time spent waiting is added to the stage's counters.
+*/
+template<class T> class AraPipelineQueue
+{
+    public:
+        AraPipelineQueue(size_t capacity) : fSlots(capacity+1), fHead(0), fTail(0), fClosed(false) {}
+
+        //! Adds an item, waiting while the queue is full
+        void push(T item, AraPipelineStageStats *stats) {
+            size_t tail = fTail.load(std::memory_order_relaxed);
+            size_t next = (tail+1)%fSlots.size();
+            if(next==fHead.load(std::memory_order_acquire)) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                for(int spin=0; next==fHead.load(std::memory_order_acquire); spin++) backOff(spin);
+                stats->addWait(std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count());
+            }
+            fSlots[tail] = item;
+            fTail.store(next, std::memory_order_release);
+        }
+
+        //! Takes the oldest item, waiting while the queue is empty. Returns false once the queue is closed and empty.
+        bool pop(T &item, AraPipelineStageStats *stats) {
+            size_t head = fHead.load(std::memory_order_relaxed);
+            if(head==fTail.load(std::memory_order_acquire)) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                for(int spin=0; head==fTail.load(std::memory_order_acquire); spin++) {
+                    if(fClosed.load(std::memory_order_acquire) && head==fTail.load(std::memory_order_acquire)) {
+                        stats->addWait(std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count());
+                        return false;
+                    }
+                    backOff(spin);
+                }
+                stats->addWait(std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count());
+            }
+            item = fSlots[head];
+            fHead.store((head+1)%fSlots.size(), std::memory_order_release);
+            return true;
+        }
+
+        //! Called by the producer after its last push()
+        void close() { fClosed.store(true, std::memory_order_release); }
+
+    private:
+        static void backOff(int spin) {
+            if(spin<64) return;
+            if(spin<128) std::this_thread::yield();
+            else std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        std::vector<T> fSlots;
+        std::atomic<size_t> fHead;
+        std::atomic<size_t> fTail;
+        std::atomic<bool> fClosed;
+};
+
+//! Part of AraEvent library. Helpers of AraRootifierPipeline that don't depend on the object type.
+class AraRootifierPipelineBase
+{
+    public:
+        AraRootifierPipelineBase(Int_t numBuilders, size_t queueDepth);
+        void printStats(FILE *fp=stdout) const; ///< Prints the counters of every stage
+        void setReadThreads(Int_t numThreads, const char *indexDir=0) {fReadThreads=numThreads; fReadIndexDir=indexDir ? indexDir : "";} ///< Inflates each file on this many threads using its AraRawFileIndex, new indices are written to indexDir if it is given
+        void setFirstEvent(Long64_t firstEvent) {fFirstEvent=firstEvent;} ///< Skips the events of the file list before this one, e.g. to finish a conversion that stopped part way
+        static void readFile(AraPipelineFile *file, Int_t numThreads=1, const char *indexDir=0); ///< Decompresses file->name into file->data
+        static Long64_t readAtriEventFileFrom(AraPipelineFile *file, Long64_t firstEvent, const char *indexDir=0); ///< Decompresses the events of file->name from firstEvent on, returns the number of events in the file
+        static void enableThreadSafety(); ///< Lets ROOT objects be built off the main thread
+        static void splitAtriEventFile(const AraPipelineFile &file, std::vector<AraPipelineRecord> &records, Int_t maxEvents=1000); ///< Finds the events of a raw ATRI event file
+    protected:
+        Int_t fNumBuilders;
+        size_t fQueueDepth;
+        Int_t fReadThreads;
+        std::string fReadIndexDir;
+        Long64_t fFirstEvent;
+        AraPipelineStageStats fReadStats;
+        AraPipelineStageStats fSplitStats;
+        AraPipelineStageStats fBuildStats;
+        AraPipelineStageStats fFillStats;
+};
+
+//! Part of AraEvent library. Converts a list of raw files into objects of type T in four stages.
+/*!
+    - read, one thread: gzreads each file of the list whole into an AraPipelineFile, or with setFirstEvent() only the
+      events from the first one on, which must then be raw ATRI event files
+    - split, one thread: the splitter finds the records of a file, which are then copied out so each one starts 8 byte aligned
+    - build, numBuilders threads: the builder makes a T from each record, files are handed to the build threads in turn
+    - fill, the thread calling run(): the filler is given each T in file list and record order, and owns it from then on
+
+    Whatever the number of build threads the filler sees the same objects in the same order, so a tree filled by it is the
+    same as one filled from a plain serial loop over the files. At most about queueDepth files per stage are in memory.
+    \ingroup rootclasses
+*/
+template<class T> class AraRootifierPipeline : public AraRootifierPipelineBase
+{
+    public:
+        typedef std::function<Bool_t(AraPipelineFile &file, std::vector<AraPipelineRecord> &records)> Splitter; ///< Fills records, returns kFALSE to stop the run after the files before this one
+        typedef std::function<T*(const char *record, size_t length)> Builder; ///< Makes an object from one record, or returns NULL to drop it
+        typedef std::function<void(const AraPipelineFile &file)> FileStarter; ///< Called in the fill thread before the objects of each file
+        typedef std::function<void(T *object)> Filler; ///< Called in the fill thread with each object
+
+        AraRootifierPipeline(Splitter splitter, Builder builder, Filler filler, Int_t numBuilders=1, size_t queueDepth=4)
+            : AraRootifierPipelineBase(numBuilders, queueDepth), fSplitter(splitter), fBuilder(builder), fFiller(filler) {}
+
+        void setFileStarter(FileStarter starter) { fFileStarter = starter; }
+
+        //! Runs the pipeline over the files, returns kFALSE if the splitter stopped it
+        Bool_t run(const std::vector<std::string> &fileNames);
+
+    private:
+        //! A file travelling down the pipeline, the raw data is dropped once it has been split
+        struct Unit {
+            AraPipelineFile file;
+            std::vector<Long64_t> recordStore;
+            std::vector<AraPipelineRecord> records;
+            std::vector<T*> objects;
+            Bool_t stop;
+        };
+
+        Splitter fSplitter;
+        Builder fBuilder;
+        Filler fFiller;
+        FileStarter fFileStarter;
+};
+
+template<class T> Bool_t AraRootifierPipeline<T>::run(const std::vector<std::string> &fileNames)
+{
+    typedef std::chrono::steady_clock Clock;
+    enableThreadSafety();
+
+    AraPipelineQueue<Unit*> readQueue(fQueueDepth);
+    std::vector<AraPipelineQueue<Unit*>*> buildQueues;
+    std::vector<AraPipelineQueue<Unit*>*> fillQueues;
+    for(int i=0;i<fNumBuilders;i++) {
+        buildQueues.push_back(new AraPipelineQueue<Unit*>(fQueueDepth));
+        fillQueues.push_back(new AraPipelineQueue<Unit*>(fQueueDepth));
+    }
+    std::atomic<bool> stopped(false);
+
+    std::thread reader([&]() {
+        Long64_t skipEvents=fFirstEvent;
+        for(size_t i=0;i<fileNames.size() && !stopped.load();i++) {
+            Clock::time_point start = Clock::now();
+            Unit *unit = new Unit;
+            unit->file.index = i;
+            unit->file.name = fileNames[i];
+            unit->stop = kFALSE;
+            if(skipEvents>0)
+                skipEvents-=std::min(skipEvents, readAtriEventFileFrom(&(unit->file), skipEvents, fReadIndexDir.empty() ? 0 : fReadIndexDir.c_str()));
+            else
+                readFile(&(unit->file), fReadThreads, fReadIndexDir.empty() ? 0 : fReadIndexDir.c_str());
+            fReadStats.addItems(1, unit->file.data.size(), std::chrono::duration<double>(Clock::now()-start).count());
+            readQueue.push(unit, &fReadStats);
+        }
+        readQueue.close();
+    });
+
+    std::thread splitter([&]() {
+        Unit *unit;
+        while(readQueue.pop(unit, &fSplitStats)) {
+            Clock::time_point start = Clock::now();
+            if(!stopped.load()) {
+                unit->stop = !fSplitter(unit->file, unit->records);
+                if(unit->stop) {
+                    unit->records.clear();
+                    stopped.store(true);
+                }
+            }
+            //Copy the records out, each starting on an 8 byte boundary so the raw structures can be used in place
+            size_t numWords=0;
+            for(size_t r=0;r<unit->records.size();r++) numWords += (unit->records[r].length+7)/8;
+            unit->recordStore.resize(numWords);
+            char *store = (char*)(numWords ? &(unit->recordStore[0]) : 0);
+            size_t upto=0;
+            for(size_t r=0;r<unit->records.size();r++) {
+                memcpy(store+upto, &(unit->file.data[unit->records[r].offset]), unit->records[r].length);
+                unit->records[r].offset = upto;
+                upto += 8*((unit->records[r].length+7)/8);
+            }
+            fSplitStats.addItems(unit->records.size(), unit->file.data.size(), std::chrono::duration<double>(Clock::now()-start).count());
+            std::vector<char>().swap(unit->file.data);
+            buildQueues[unit->file.index%fNumBuilders]->push(unit, &fSplitStats);
+        }
+        for(int i=0;i<fNumBuilders;i++) buildQueues[i]->close();
+    });
+
+    std::vector<std::thread> builders;
+    for(int i=0;i<fNumBuilders;i++) {
+        builders.push_back(std::thread([&, i]() {
+            Unit *unit;
+            while(buildQueues[i]->pop(unit, &fBuildStats)) {
+                Clock::time_point start = Clock::now();
+                const char *store = (const char*)(unit->recordStore.empty() ? 0 : &(unit->recordStore[0]));
+                ULong64_t bytes=0;
+                for(size_t r=0;r<unit->records.size();r++) {
+                    T *object = fBuilder(store+unit->records[r].offset, unit->records[r].length);
+                    if(object) unit->objects.push_back(object);
+                    bytes += unit->records[r].length;
+                }
+                std::vector<Long64_t>().swap(unit->recordStore);
+                fBuildStats.addItems(unit->objects.size(), bytes, std::chrono::duration<double>(Clock::now()-start).count());
+                fillQueues[i]->push(unit, &fBuildStats);
+            }
+            fillQueues[i]->close();
+        }));
+    }
+
+    //The files arrive in turn from the build threads, so taking them in the same turn keeps the file list order
+    Bool_t completed = kTRUE;
+    Unit *unit;
+    for(size_t i=0; fillQueues[i%fNumBuilders]->pop(unit, &fFillStats); i++) {
+        Clock::time_point start = Clock::now();
+        if(unit->stop) completed = kFALSE;
+        if(completed) {
+            if(fFileStarter) fFileStarter(unit->file);
+            for(size_t o=0;o<unit->objects.size();o++) fFiller(unit->objects[o]);
+        }
+        else {
+            for(size_t o=0;o<unit->objects.size();o++) delete unit->objects[o];
+        }
+        fFillStats.addItems(completed ? unit->objects.size() : 0, 0, std::chrono::duration<double>(Clock::now()-start).count());
+        delete unit;
+    }
+
+    reader.join();
+    splitter.join();
+    for(int i=0;i<fNumBuilders;i++) {
+        builders[i].join();
+        delete buildQueues[i];
+        delete fillQueues[i];
+    }
+    return completed;
+}
+
+#endif //ARAROOTIFIERPIPELINE_H
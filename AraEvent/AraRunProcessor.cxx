@@ -0,0 +1,193 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraRunProcessor.cxx         Parallel event loop over a run        /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Spreads the events of a run over several threads, each with    /////
+/////     its own tree, calibration and results, merged at the end       /////
+//////////////////////////////////////////////////////////////////////////////
+
+//C++ includes
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+//class definition includes
+#include "AraRunProcessor.h"
+
+//ROOT includes
+#include "TChain.h"
+
+/*!
+    \param numSlots number of threads, 0 for one per core
+    \param treeName the name of the event trees
+*/
+AraRunProcessorBase::AraRunProcessorBase(Int_t numSlots, const char *treeName)
+    : fNumSlots(numSlots), fTreeName(treeName), fCalibrate(kFALSE), fCalType(AraCalType::kLatestCalib), fChunkSize(1000),
+      fCacheSize(10000000), fNumEntries(0), fNumChunks(0), fNextChunk(0), fFailed(false), fSlotStats("events")
+{
+    if(fNumSlots<=0) fNumSlots=std::thread::hardware_concurrency();
+    if(fNumSlots<=0) fNumSlots=1;
+}
+
+/*!
+    \param fileName a file name, which may contain wildcards
+    \return the number of files it matches
+*/
+Int_t AraRunProcessorBase::addFile(const char *fileName)
+{
+    TChain chain(fTreeName.c_str());
+    Int_t numFiles=chain.Add(fileName);
+    if(numFiles>0) fTreeFiles.push_back(fileName);
+    return numFiles;
+}
+
+/*!
+    \param fileName the raw event file
+*/
+void AraRunProcessorBase::addRawFile(const char *fileName)
+{
+    fRawFiles.push_back(fileName);
+}
+
+/*!
+    Raw files are processed if there are any, else the event trees.
+    \param process called for each event, in the thread of the slot that read it
+    \return kFALSE if there was nothing to read or an entry or raw file couldn't be read
+*/
+Bool_t AraRunProcessorBase::processSlots(SlotProcessor process)
+{
+    AraRootifierPipelineBase::enableThreadSafety();
+    if(!fRawFiles.empty()) fNumChunks=fRawFiles.size();
+    else {
+        TChain chain(fTreeName.c_str());
+        for(size_t i=0;i<fTreeFiles.size();i++) chain.Add(fTreeFiles[i].c_str());
+        fNumEntries=chain.GetEntries();
+        fNumChunks=(fNumEntries+fChunkSize-1)/fChunkSize;
+    }
+    if(fNumChunks==0) {
+        fprintf(stderr, "AraRunProcessor -- ERROR No events to process\n");
+        return kFALSE;
+    }
+    fNextChunk.store(0);
+    fFailed.store(false);
+
+    std::vector<std::thread> slots;
+    for(int slot=0;slot<fNumSlots;slot++) {
+        slots.push_back(std::thread([this, slot, &process]() {
+            if(!fRawFiles.empty()) processRawChunks(slot, process);
+            else processTreeChunks(slot, process);
+        }));
+    }
+    for(size_t slot=0;slot<slots.size();slot++) slots[slot].join();
+    return !fFailed.load();
+}
+
+//! The loop of one slot over chunks of tree entries, with its own chain so the slots never share a TTree
+void AraRunProcessorBase::processTreeChunks(Int_t slot, const SlotProcessor &process)
+{
+    typedef std::chrono::steady_clock Clock;
+    TChain chain(fTreeName.c_str());
+    for(size_t i=0;i<fTreeFiles.size();i++) chain.Add(fTreeFiles[i].c_str());
+    RawAtriStationEvent *rawEvent=0;
+    if(chain.SetBranchAddress("event",&rawEvent)<0) {
+        fprintf(stderr, "AraRunProcessor -- ERROR The trees have no event branch\n");
+        fFailed.store(true);
+        return;
+    }
+    if(fCacheSize>0) {
+        chain.SetCacheSize(fCacheSize);
+        chain.AddBranchToCache("*",kTRUE);
+    }
+    UsefulAtriStationEvent usefulEvent;
+    std::vector<Int_t> stationsSeen;
+
+    for(Long64_t chunk=fNextChunk++;chunk<fNumChunks && !fFailed.load();chunk=fNextChunk++) {
+        Clock::time_point start=Clock::now();
+        Long64_t first=chunk*fChunkSize;
+        Long64_t last=std::min(first+fChunkSize, fNumEntries);
+        //The cache only fetches the baskets of this chunk, the other slots read the rest
+        if(fCacheSize>0) chain.SetCacheEntryRange(first, last);
+        ULong64_t bytes=0;
+        for(Long64_t entry=first;entry<last;entry++) {
+            Int_t numBytes=chain.GetEntry(entry);
+            if(numBytes<=0) {
+                fprintf(stderr, "AraRunProcessor -- ERROR Can't read entry %lld\n", entry);
+                fFailed.store(true);
+                break;
+            }
+            bytes+=numBytes;
+            process(slot, entry, rawEvent, calibrate(rawEvent, &usefulEvent, stationsSeen));
+        }
+        fSlotStats.addItems(last-first, bytes, std::chrono::duration<double>(Clock::now()-start).count());
+    }
+    chain.ResetBranchAddresses();
+    delete rawEvent;
+}
+
+//! The loop of one slot over whole raw files
+void AraRunProcessorBase::processRawChunks(Int_t slot, const SlotProcessor &process)
+{
+    typedef std::chrono::steady_clock Clock;
+    AraPipelineFile file;
+    std::vector<AraPipelineRecord> records;
+    std::vector<Long64_t> dataStore;
+    UsefulAtriStationEvent usefulEvent;
+    std::vector<Int_t> stationsSeen;
+
+    for(Long64_t chunk=fNextChunk++;chunk<fNumChunks && !fFailed.load();chunk=fNextChunk++) {
+        Clock::time_point start=Clock::now();
+        file.index=chunk;
+        file.name=fRawFiles[chunk];
+        AraRootifierPipelineBase::readFile(&file);
+        if(file.readError) {
+            fprintf(stderr, "AraRunProcessor -- ERROR Can't read raw file %s\n", file.name.c_str());
+            fFailed.store(true);
+            break;
+        }
+        //splitAtriEventFile() appends, and records still holds the events of the slot's last file
+        records.clear();
+        AraRootifierPipelineBase::splitAtriEventFile(file, records, kMaxEventsPerRawFile);
+        for(size_t i=0;i<records.size();i++) {
+            //The blocks are copied out so they start 8 byte aligned, as the rootifier pipeline does
+            AraStationEventHeader_t theEventHeader;
+            memcpy(&theEventHeader, &file.data[records[i].offset], sizeof(AraStationEventHeader_t));
+            size_t numDataBytes=records[i].length-sizeof(AraStationEventHeader_t);
+            dataStore.resize(numDataBytes/sizeof(Long64_t)+1);
+            memcpy(&dataStore[0], &file.data[records[i].offset+sizeof(AraStationEventHeader_t)], numDataBytes);
+            RawAtriStationEvent rawEvent(&theEventHeader, (char*)&dataStore[0]);
+            process(slot, chunk*kMaxEventsPerRawFile+i, &rawEvent, calibrate(&rawEvent, &usefulEvent, stationsSeen));
+        }
+        fSlotStats.addItems(records.size(), file.data.size(), std::chrono::duration<double>(Clock::now()-start).count());
+    }
+}
+
+/*!
+    Sets the pedestals of a station from fPedFile the first time any slot sees it, before any of its events are calibrated.
+    \param stationsSeen the stations this slot has seen, so it only takes the lock once for each
+    \return usefulEvent calibrated from rawEvent, or NULL if there is no calibration
+*/
+UsefulAtriStationEvent *AraRunProcessorBase::calibrate(RawAtriStationEvent *rawEvent, UsefulAtriStationEvent *usefulEvent, std::vector<Int_t> &stationsSeen)
+{
+    if(!fCalibrate) return NULL;
+    if(!fPedFile.empty() && std::find(stationsSeen.begin(), stationsSeen.end(), rawEvent->stationId)==stationsSeen.end()) {
+        std::lock_guard<std::mutex> lock(fPedMutex);
+        if(std::find(fStationsSeen.begin(), fStationsSeen.end(), rawEvent->stationId)==fStationsSeen.end()) {
+            AraEventCalibrator::Instance()->setAtriPedFile((char*)fPedFile.c_str(), rawEvent->stationId);
+            fStationsSeen.push_back(rawEvent->stationId);
+        }
+        stationsSeen.push_back(rawEvent->stationId);
+    }
+    usefulEvent->recalibrate(rawEvent, fCalType);
+    return usefulEvent;
+}
+
+/*!
+    \param fp where to print
+*/
+void AraRunProcessorBase::printStats(FILE *fp) const
+{
+    fprintf(fp, "Run processor, %d slots:\n", fNumSlots);
+    fSlotStats.print(fp, fNumSlots);
+}
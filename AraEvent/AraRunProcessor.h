@@ -0,0 +1,127 @@
+//////////////////////////////////////////////////////////////////////////////
+/////  AraRunProcessor.h           Parallel event loop over a run        /////
+/////                                                                    /////
+/////  Description:                                                      /////
+/////     Spreads the events of a run over several threads, each with    /////
+/////     its own tree, calibration and results, merged at the end       /////
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARARUNPROCESSOR_H
+#define ARARUNPROCESSOR_H
+
+//Includes
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include "Rtypes.h"
+#include "RawAtriStationEvent.h"
+#include "UsefulAtriStationEvent.h"
+#include "AraEventCalibrator.h"
+#include "AraRootifierPipeline.h"
+
+//! Part of AraEvent library. The part of AraRunProcessor that doesn't depend on the result type.
+class AraRunProcessorBase
+{
+    public:
+        static const Long64_t kMaxEventsPerRawFile=1000; ///< The most events taken from one raw file, as in the rootifiers
+
+        //! Called for each event in the slot's own thread
+        typedef std::function<void(Int_t slot, Long64_t entry, RawAtriStationEvent *rawEvent, UsefulAtriStationEvent *usefulEvent)> SlotProcessor;
+
+        AraRunProcessorBase(Int_t numSlots, const char *treeName);
+
+        Int_t addFile(const char *fileName); ///< Adds an event tree file, which may contain wildcards, see TChain::Add()
+        void addRawFile(const char *fileName); ///< Adds a raw, gzipped or not, ATRI event file as written by the DAQ
+        void setCalibration(AraCalType::AraCalType_t calType) {fCalibrate=kTRUE; fCalType=calType;} ///< Calibrates every event, else the usefulEvent passed on is NULL
+        void setPedFile(const char *pedFile) {fPedFile=pedFile ? pedFile : "";} ///< Pedestal file used for every station, else the calibrator's default ones
+        void setChunkSize(Long64_t entries) {fChunkSize=entries>0 ? entries : 1;} ///< Number of tree entries a slot takes at a time
+        void setCacheSize(Long64_t bytes) {fCacheSize=bytes;} ///< The TTreeCache size of each slot, 0 for no cache
+        Int_t getNumSlots() const {return fNumSlots;}
+
+        Bool_t processSlots(SlotProcessor process); ///< Runs process over every event, returns kFALSE if an entry or raw file couldn't be read
+        void printStats(FILE *fp=stdout) const; ///< Prints the events processed and the rate summed over the slots
+
+    private:
+        void processTreeChunks(Int_t slot, const SlotProcessor &process);
+        void processRawChunks(Int_t slot, const SlotProcessor &process);
+        UsefulAtriStationEvent *calibrate(RawAtriStationEvent *rawEvent, UsefulAtriStationEvent *usefulEvent, std::vector<Int_t> &stationsSeen);
+
+        Int_t fNumSlots;
+        std::string fTreeName;
+        std::vector<std::string> fTreeFiles;
+        std::vector<std::string> fRawFiles;
+        Bool_t fCalibrate;
+        AraCalType::AraCalType_t fCalType;
+        std::string fPedFile;
+        Long64_t fChunkSize;
+        Long64_t fCacheSize;
+
+        Long64_t fNumEntries; //!< Entries of the chain, while processing trees
+        Long64_t fNumChunks; //!< Chunks of entries, or raw files, to hand out
+        std::atomic<Long64_t> fNextChunk; //!< The next chunk a slot will take
+        std::atomic<bool> fFailed; //!< Set by a slot that couldn't read an entry or raw file
+        std::mutex fPedMutex; //!< Guards fStationsSeen and the pedestal loading
+        std::vector<Int_t> fStationsSeen; //!< Stations whose pedestals have been set from fPedFile
+        AraPipelineStageStats fSlotStats;
+};
+
+//! Part of AraEvent library. Processes the events of a run on several threads, each filling its own Result, and merges the Results at the end.
+/*!
+    Each slot is a thread with its own TChain, TTreeCache, event objects and Result, and the calibration scratch space of
+    AraEventCalibrator is per thread already, so the slots share nothing but the calibration tables while they run. The slots
+    take chunks of entries, or whole raw files, from a shared counter until there are none left, so a slow chunk doesn't hold
+    the others up. Once they are all done the Results are merged into the total one slot after the other, in slot order.
+
+    Which slot sees which events changes from run to run, so the processor must only depend on the event and the merger
+    must not depend on the order of the events, as for sums, histograms or lists that are sorted afterwards by entry.
+    \code
+    struct Counts { Long64_t numEvents=0; };
+    AraRunProcessor<Counts> processor(
+        [](Counts &counts, Long64_t entry, RawAtriStationEvent *rawEvent, UsefulAtriStationEvent *usefulEvent) { counts.numEvents++; },
+        [](Counts &total, const Counts &slot) { total.numEvents+=slot.numEvents; });
+    processor.addFile("event1234.root");
+    processor.setCalibration(AraCalType::kLatestCalib);
+    Counts total;
+    processor.run(total);
+    \endcode
+    For raw files the entry is the position of the file in the list times kMaxEventsPerRawFile plus the position of the event
+    in the file, so sorting by entry still gives the run order.
+    \ingroup rootclasses
+*/
+template<class Result> class AraRunProcessor : public AraRunProcessorBase
+{
+    public:
+        typedef std::function<void(Result &result, Long64_t entry, RawAtriStationEvent *rawEvent, UsefulAtriStationEvent *usefulEvent)> Processor; ///< Adds an event to the slot's result
+        typedef std::function<void(Result &total, const Result &slotResult)> Merger; ///< Adds the result of a slot to the total
+
+        //! numSlots 0 for one slot per core
+        AraRunProcessor(Processor processor, Merger merger, Int_t numSlots=0, const char *treeName="eventTree")
+            : AraRunProcessorBase(numSlots, treeName), fProcessor(processor), fMerger(merger) {}
+
+        //! Processes every event and merges the results of the slots into total, returns kFALSE if an entry or raw file couldn't be read
+        Bool_t run(Result &total);
+
+    private:
+        Processor fProcessor;
+        Merger fMerger;
+};
+
+template<class Result> Bool_t AraRunProcessor<Result>::run(Result &total)
+{
+    //Each result is allocated on its own, so slots updating small results don't share cache lines
+    std::vector<Result*> slotResults;
+    for(int slot=0;slot<getNumSlots();slot++) slotResults.push_back(new Result());
+    Bool_t ok = processSlots([&](Int_t slot, Long64_t entry, RawAtriStationEvent *rawEvent, UsefulAtriStationEvent *usefulEvent) {
+            fProcessor(*slotResults[slot], entry, rawEvent, usefulEvent);
+        });
+    for(int slot=0;slot<getNumSlots();slot++) {
+        fMerger(total, *slotResults[slot]);
+        delete slotResults[slot];
+    }
+    return ok;
+}
+
+#endif //ARARUNPROCESSOR_H
@@ -17,7 +17,8 @@
 #pragma link C++ class IcrrTriggerMonitor+;
 #pragma link C++ class UsefulAraStationEvent+;
 #pragma link C++ class UsefulIcrrStationEvent+;
-#pragma link C++ class UsefulAtriStationEvent+;
+#pragma link C++ class UsefulAtriStationEvent-;
+#pragma link C++ class AraCompactAtriStationEvent+;
 #pragma link C++ class AraAntennaInfo+;
 #pragma link C++ class AraCalAntennaInfo;+
 #pragma link C++ class AraStationInfo+;
@@ -25,6 +26,8 @@
 #pragma link C++ class AraEventCalibrator+;
 #pragma link C++ class AraEventConditioner+;
 #pragma link C++ class RawAtriStationBlock+;
+// Version 1 stored the samples as a vector of vectors, copy them into the fixed sample buffer
+#pragma read sourceClass="RawAtriStationBlock" version="[1]" targetClass="RawAtriStationBlock" source="std::vector<std::vector<UShort_t> > data" target="samples" code="{ memset(samples,0,sizeof(samples)); for(unsigned int chan=0;chan<onfile.data.size() && chan<RFCHAN_PER_DDA;chan++) { for(unsigned int samp=0;samp<onfile.data[chan].size() && samp<SAMPLES_PER_BLOCK;samp++) samples[chan][samp]=onfile.data[chan][samp]; } }"
 #pragma link C++ class RawAtriStationEvent+;
 #pragma link C++ class RawAraGenericHeader+;
 #pragma link C++ class AraSunPos+;
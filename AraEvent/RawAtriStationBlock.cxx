@@ -16,6 +16,10 @@ ClassImp(RawAtriStationBlock);
 RawAtriStationBlock::RawAtriStationBlock()   
 {  
   //Default Constructor
+  numChannels=0;
+  irsBlockNumber=0;
+  channelMask=0;
+  memset(samples,0,sizeof(samples));
 }
 
 RawAtriStationBlock::~RawAtriStationBlock() {
@@ -36,14 +40,9 @@ RawAtriStationBlock::RawAtriStationBlock(AraStationEventBlockHeader_t *hdPtr, Ar
       numChannels++;
   }
 
-  //Now loop over and fill in the data
-  for(int chan=0;chan<numChannels;chan++) {
-    std::vector <UShort_t> tempVec;
-    for(int samp=0;samp<SAMPLES_PER_BLOCK;samp++) {
-      tempVec.push_back(channels[chan].samples[samp]);
-      //      data[chan][samp]=channels[chan].samples[samp];
-    }
-    data.push_back(tempVec);
-  }
+  //Now copy the channels straight into the sample buffer
+  memcpy(samples,channels,numChannels*sizeof(AraStationEventBlockChannel_t));
+  if(numChannels<RFCHAN_PER_DDA)
+    memset(samples[numChannels],0,(RFCHAN_PER_DDA-numChannels)*sizeof(samples[0]));
 
 }
@@ -40,17 +40,18 @@ class RawAtriStationBlock: public TObject
    UShort_t irsBlockNumber;
    UShort_t channelMask;
 
-   //The samples
-   std::vector< std::vector<UShort_t> > data;
+   //The samples, one row per channel present in channelMask (in mask bit order), rows beyond numChannels are zero
+   UShort_t samples[RFCHAN_PER_DDA][SAMPLES_PER_BLOCK];
 
    int getNumChannels() {return (int) numChannels;}
+   UShort_t *getSamples(int chanIndex) {return samples[chanIndex];} ///< Returns the SAMPLES_PER_BLOCK samples of the chanIndex'th channel read out in this block
 
    int getDda() {return (channelMask&0x300)>>8;}
    int getBlock() {return irsBlockNumber&0x1ff;}
    //   int getCapArray() { return (irsBlockNumber&0x4)>>2;} // Event format version 1
    int getCapArray() { return irsBlockNumber&0x1;} //Event Format version 2
 
-  ClassDef(RawAtriStationBlock,1);
+  ClassDef(RawAtriStationBlock,2);
 };
 
 
@@ -8,10 +8,14 @@
 //////////////////////////////////////////////////////////////////////////////
 
 #include "RawAtriStationEvent.h"
+#include "AraAtriEventView.h"
 #include <iostream>
 #include <fstream>
 #include <cstring>
 #include "TMath.h"
+#include "TTree.h"
+#include "TBranch.h"
+#include "TObjArray.h"
 ClassImp(RawAtriStationEvent);
 
 RawAtriStationEvent::RawAtriStationEvent()   
@@ -27,46 +31,27 @@ RawAtriStationEvent::~RawAtriStationEvent() {
 RawAtriStationEvent::RawAtriStationEvent(AraStationEventHeader_t *hdPtr, char *dataBuffer) // Assignment constructor
   :RawAraStationEvent(&(hdPtr->gHdr))
 {
-  
-
-   unixTime=hdPtr->unixTime;
-   unixTimeUs=hdPtr->unixTimeUs;
-   eventNumber=hdPtr->eventNumber;
-   ppsNumber=hdPtr->ppsNumber;
-   numStationBytes=hdPtr->numBytes;
-   versionId=hdPtr->versionNumber;
-   timeStamp=hdPtr->timeStamp;
-   timeStamp ^= (timeStamp >> 1);
-   timeStamp ^= (timeStamp >> 2);
-   timeStamp ^= (timeStamp >> 4);
-   timeStamp ^= (timeStamp >> 8);
-   timeStamp ^= (timeStamp >> 16);
-
-
-   eventId=hdPtr->eventId;
+   //The header decoding, Gray code timestamp included, is shared with AraAtriEventView::setFromBuffer()
+   AraAtriEventFields fields;
+   fields.getFrom(hdPtr);
+   fields.setTo(this);
    //   std::cerr << eventNumber << "\t" << versionId << "\t" << ppsNumber << "\t" << timeStamp << "\t" << eventId << std::endl;
-   numReadoutBlocks=hdPtr->numReadoutBlocks; 
-   
-   for(int trig=0;trig<MAX_TRIG_BLOCKS;trig++) {
-     triggerInfo[trig]=hdPtr->triggerInfo[trig];
-     triggerBlock[trig]=hdPtr->triggerBlock[trig];
-   }
 
+   //The blocks are built in place, so the samples are copied once, straight from dataBuffer into blockVec
+   blockVec.reserve(numReadoutBlocks);
    int uptoByte=0;
    //   std::cerr << "numReadoutBlocks " << numReadoutBlocks << "\n";
    for(int block=0;block<numReadoutBlocks;block++) {
      AraStationEventBlockHeader_t *blkPtr = (AraStationEventBlockHeader_t*)&dataBuffer[uptoByte];     
      uptoByte+=sizeof(AraStationEventBlockHeader_t);
      AraStationEventBlockChannel_t *chanPtr = (AraStationEventBlockChannel_t*)&dataBuffer[uptoByte];
-     RawAtriStationBlock blocky(blkPtr,chanPtr);
-     blockVec.push_back(blocky);
-     int numChan=blocky.getNumChannels();
+     blockVec.emplace_back(blkPtr,chanPtr);
+     int numChan=blockVec.back().getNumChannels();
 
      // std::cout << "block " << block << " numChan " << numChan 
      // 	       <<  " irsBlockNumber " << (blkPtr->irsBlockNumber&0x1ff)
      // 	       << " channelMask " << blkPtr->channelMask << "\t"
      // 	       << " uptoByte " << uptoByte << "\n";
-     // numChan=8; //HArd wire for testing
      uptoByte+=sizeof(AraStationEventBlockChannel_t)*numChan;
    }
    //   std::cerr << sizeof(AraStationEventHeader_t) << "\n";
@@ -75,56 +60,10 @@ RawAtriStationEvent::RawAtriStationEvent(AraStationEventHeader_t *hdPtr, char *d
 }
 
 RawAtriStationEvent::RawAtriStationEvent(AraStationEventHeader_t *hdPtr, char *dataBuffer, AraStationId_t forcedStationId) // Assignment constructor
-  :RawAraStationEvent(&(hdPtr->gHdr))
+  :RawAtriStationEvent(hdPtr,dataBuffer)
 {
   //JPD The same as above but forcing the stationId value
   stationId = forcedStationId;
-
-  
-  unixTime=hdPtr->unixTime;
-  unixTimeUs=hdPtr->unixTimeUs;
-  eventNumber=hdPtr->eventNumber;
-  versionId=hdPtr->versionNumber;
-  ppsNumber=hdPtr->ppsNumber;
-  numStationBytes=hdPtr->numBytes;
-  //   std::cerr << eventNumber << "\t" << ppsNumber << "\t" << numStationBytes;
-   timeStamp=hdPtr->timeStamp;
-   timeStamp ^= (timeStamp >> 1);
-   timeStamp ^= (timeStamp >> 2);
-   timeStamp ^= (timeStamp >> 4);
-   timeStamp ^= (timeStamp >> 8);
-   timeStamp ^= (timeStamp >> 16);
-
-
-
-   eventId=hdPtr->eventId;
-   numReadoutBlocks=hdPtr->numReadoutBlocks; 
-   
-   for(int trig=0;trig<MAX_TRIG_BLOCKS;trig++) {
-     triggerInfo[trig]=hdPtr->triggerInfo[trig];
-     triggerBlock[trig]=hdPtr->triggerBlock[trig];
-   }
-
-   int uptoByte=0;
-   //   std::cerr << "numReadoutBlocks " << numReadoutBlocks << "\n";
-   for(int block=0;block<numReadoutBlocks;block++) {
-     AraStationEventBlockHeader_t *blkPtr = (AraStationEventBlockHeader_t*)&dataBuffer[uptoByte];     
-     uptoByte+=sizeof(AraStationEventBlockHeader_t);
-     AraStationEventBlockChannel_t *chanPtr = (AraStationEventBlockChannel_t*)&dataBuffer[uptoByte];
-     RawAtriStationBlock blocky(blkPtr,chanPtr);
-     blockVec.push_back(blocky);
-     int numChan=blocky.getNumChannels();
-
-     // std::cout << "block " << block << " numChan " << numChan 
-     // 	       <<  " irsBlockNumber " << (blkPtr->irsBlockNumber&0x1ff)
-     // 	       << " channelMask " << blkPtr->channelMask << "\t"
-     // 	       << " uptoByte " << uptoByte << "\n";
-     // numChan=8; //HArd wire for testing
-     uptoByte+=sizeof(AraStationEventBlockChannel_t)*numChan;
-   }
-   //   std::cerr << sizeof(AraStationEventHeader_t) << "\n";
-   if(uptoByte!=int(numStationBytes))    
-     std::cerr << "Error assigned " << uptoByte <<  " bytes out of " << numStationBytes << "\n";
 }
 
 Int_t RawAtriStationEvent::getFirstCapArray(Int_t dda)
@@ -142,6 +81,10 @@ Int_t RawAtriStationEvent::getFirstCapArray(Int_t dda)
 
 
 bool RawAtriStationEvent::isCalpulserEvent(){
+  return isCalpulserTimeStamp(stationId,timeStamp);
+}
+
+bool RawAtriStationEvent::isCalpulserTimeStamp(AraStationId_t stationId, UInt_t timeStamp){
   Int_t pulserTime=0;
 
   if(stationId==ARA_STATION1B) pulserTime=254;
@@ -187,3 +130,26 @@ Int_t RawAtriStationEvent::numTriggerChansHigh(){
   return numChans;
 
 }
+
+
+Int_t RawAtriStationEvent::setHeaderOnly(TTree *eventTree, Bool_t headerOnly, const char *branchName)
+{
+  TBranch *branch = eventTree->GetBranch(branchName);
+  if(!branch) {
+    fprintf(stderr, "%s -- no branch %s\n", __FUNCTION__, branchName);
+    return 0;
+  }
+  Int_t numSwitched=0;
+  TObjArray *subBranches = branch->GetListOfBranches();
+  for(Int_t i=0;i<subBranches->GetEntriesFast();i++) {
+    TBranch *subBranch = (TBranch*) subBranches->At(i);
+    if(!strstr(subBranch->GetName(),"blockVec")) continue;
+    char pattern[FILENAME_MAX];
+    snprintf(pattern,FILENAME_MAX,"%s*",subBranch->GetName());
+    eventTree->SetBranchStatus(pattern,headerOnly ? 0 : 1);
+    numSwitched++;
+  }
+  if(!numSwitched)
+    fprintf(stderr, "%s -- branch %s is not split, whole events will be read\n", __FUNCTION__, branchName);
+  return numSwitched;
+}
@@ -19,7 +19,7 @@
 #include "araAtriStructures.h"
 #include "araSoft.h"
 
-
+class TTree;
 
 
 //! Part of AraEvent library. This is the ATRI specific Raw Event class, inheriting from RawAraStationEvent.
@@ -67,6 +67,7 @@ class RawAtriStationEvent: public RawAraStationEvent
 
    Int_t getFirstCapArray(Int_t dda); ///< Function for asking the block vector the capArray
    bool isCalpulserEvent(); ///< Uses the timeStamp (from Rubidium clock) to decide whether an event is from a local in-ice calpulser
+   static bool isCalpulserTimeStamp(AraStationId_t stationId, UInt_t timeStamp); ///< The isCalpulserEvent() decision, for callers without an event object
    
    Bool_t isTrigType(Int_t bit); ///< Was this trigger bit set? bit0 - RF0 Trigger (Deep Antennas), bit1 - RF1 Trigger (Surface Antennas), bit2 - Software trigger
 
@@ -75,6 +76,18 @@ class RawAtriStationEvent: public RawAraStationEvent
    Bool_t isTriggerChanHigh(Int_t bit); ///<Is a particular trigger channel high in RF trigger?
    Int_t numTriggerChansHigh(); ///< Number of trigger channels contributing to this trigger
 
+   //! Switches an event tree between reading whole events and reading only the header fields
+   /*!
+     The event branch is split, so the blocks are stored in their own sub-branches. With headerOnly those are disabled and
+     GetEntry() reads just the header fields, leaving blockVec of the event object as it was, for timing and trigger studies
+     that would otherwise spend nearly all their time reading samples.
+     \param eventTree the tree, with the event branch made by the rootifiers
+     \param headerOnly kTRUE to skip the blocks, kFALSE to read whole events again
+     \param branchName the name of the event branch
+     \return the number of block sub-branches switched, 0 if the branch isn't split and whole events will still be read
+   */
+   static Int_t setHeaderOnly(TTree *eventTree, Bool_t headerOnly=kTRUE, const char *branchName="event");
+
 
   ClassDef(RawAtriStationEvent,3);
 };
@@ -9,65 +9,150 @@
 
 #include "UsefulAtriStationEvent.h"
 #include "AraEventCalibrator.h"
-#include "AraEventConditioner.h"
 #include "FFTtools.h"
 #include "AraGeomTool.h"
 #include "TH1.h"
+#include "TBuffer.h"
 #include <iostream>
 #include <fstream>
 #include <cstring>
 ClassImp(UsefulAtriStationEvent);
 
-AraEventCalibrator *fCalibrator;
-AraEventConditioner *fConditioner;
-
 UsefulAtriStationEvent::UsefulAtriStationEvent() 
 {
   //Default Constructor
   fNumChannels=0;
-  fCalibrator=0;
-  fConditioner=0;
   fIsConditioned=0;
+  fUseArena=0;
+  fLazyCalibration=0;
+  fLazyCalType=0;
+  fLazyChanMask=0;
+  memset(fArenaOffset,0,sizeof(fArenaOffset));
+  memset(fArenaLength,0,sizeof(fArenaLength));
 }
 
 UsefulAtriStationEvent::~UsefulAtriStationEvent() {
    //Default Destructor
   fNumChannels=0;
-  fCalibrator=0;
-  fConditioner=0;
   fIsConditioned=0;
 }
 
-UsefulAtriStationEvent::UsefulAtriStationEvent(RawAtriStationEvent *rawEvent, AraCalType::AraCalType_t calType)
+UsefulAtriStationEvent::UsefulAtriStationEvent(RawAtriStationEvent *rawEvent, AraCalType::AraCalType_t calType, Bool_t useArena)
  :RawAtriStationEvent(*rawEvent)
 {
-  fCalibrator=AraEventCalibrator::Instance();
+  // No shared state is touched here, so events can be built in several threads at once
+  AraEventCalibrator *calibrator=AraEventCalibrator::Instance();
   fNumChannels=0;
-  fCalibrator->calibrateEvent(this,calType);
+  fUseArena=useArena;
+  fLazyCalibration=0;
+  fLazyCalType=0;
+  fLazyChanMask=0;
+  memset(fArenaOffset,0,sizeof(fArenaOffset));
+  memset(fArenaLength,0,sizeof(fArenaLength));
+  calibrator->calibrateEvent(this,calType);
   fIsConditioned=0;
+}
 
-  //! All the functions in the conditioner class are imported and available into the calibrateEvent() function -MK-
-  // only run the conditioner if we want fully calibrated waveforms
-  // i.e. if the user asks for kNoCalib or kJustPed etc, we should not condition
-  /*if(calType > AraCalType::kADC){
-    fConditioner=AraEventConditioner::Instance();
-    fConditioner->conditionEvent(this);
-  }*/
+void UsefulAtriStationEvent::recalibrate(RawAtriStationEvent *rawEvent, AraCalType::AraCalType_t calType)
+{
+  // The block vector and the arena keep their capacity across events
+  RawAtriStationEvent::operator=(*rawEvent);
+  fNumChannels=0;
+  fIsConditioned=0;
+  fConditioningList.clear();
+  fTimes.clear();
+  fVolts.clear();
+  fLazyChanMask=0;
+  memset(fArenaOffset,0,sizeof(fArenaOffset));
+  memset(fArenaLength,0,sizeof(fArenaLength));
+  AraEventCalibrator::Instance()->calibrateEvent(this,calType);
 }
 
+void UsefulAtriStationEvent::calibrateLazyChannels()
+{
+  for(int chanId=0;chanId<CHANNELS_PER_ATRI && fLazyChanMask;chanId++)
+    AraEventCalibrator::Instance()->CalibrateLazyChannel(this,chanId);
+}
+
+//! Writes the samples of an arena mode event through fTimes / fVolts, which are emptied again afterwards
+void UsefulAtriStationEvent::Streamer(TBuffer &R__b)
+{
+  if(R__b.IsReading()) {
+    R__b.ReadClassBuffer(UsefulAtriStationEvent::Class(),this);
+    // What was read is in fTimes / fVolts, whatever this object was used for before
+    fUseArena=0;
+    fLazyChanMask=0;
+    memset(fArenaOffset,0,sizeof(fArenaOffset));
+    memset(fArenaLength,0,sizeof(fArenaLength));
+    return;
+  }
+  if(fLazyChanMask) calibrateLazyChannels();
+  if(!fUseArena) {
+    R__b.WriteClassBuffer(UsefulAtriStationEvent::Class(),this);
+    return;
+  }
+  for(int chanId=0;chanId<CHANNELS_PER_ATRI;chanId++) {
+    if(fArenaLength[chanId]==0) continue;
+    const Double_t *times=&(fArenaTimes[fArenaOffset[chanId]]);
+    const Double_t *volts=&(fArenaVolts[fArenaOffset[chanId]]);
+    fTimes[chanId].assign(times,times+fArenaLength[chanId]);
+    fVolts[chanId].assign(volts,volts+fArenaLength[chanId]);
+  }
+  R__b.WriteClassBuffer(UsefulAtriStationEvent::Class(),this);
+  fTimes.clear();
+  fVolts.clear();
+}
+
+Int_t UsefulAtriStationEvent::getNumSamplesInElecChan(int chanId)
+{
+  if(fLazyChanMask) AraEventCalibrator::Instance()->CalibrateLazyChannel(this,chanId);
+  if(fUseArena) {
+    if(chanId<0 || chanId>=CHANNELS_PER_ATRI) return 0;
+    return fArenaLength[chanId];
+  }
+  std::map< Int_t, std::vector <Double_t> >::iterator timeMapIt=fTimes.find(chanId);
+  if(timeMapIt==fTimes.end()) return 0;
+  return timeMapIt->second.size();
+}
+
+const Double_t *UsefulAtriStationEvent::getTimesFromElecChan(int chanId)
+{
+  if(fLazyChanMask) AraEventCalibrator::Instance()->CalibrateLazyChannel(this,chanId);
+  if(fUseArena) {
+    if(chanId<0 || chanId>=CHANNELS_PER_ATRI || fArenaLength[chanId]==0) return NULL;
+    return &(fArenaTimes[fArenaOffset[chanId]]);
+  }
+  std::map< Int_t, std::vector <Double_t> >::iterator timeMapIt=fTimes.find(chanId);
+  if(timeMapIt==fTimes.end() || timeMapIt->second.empty()) return NULL;
+  return &(timeMapIt->second[0]);
+}
+
+const Double_t *UsefulAtriStationEvent::getVoltsFromElecChan(int chanId)
+{
+  if(fLazyChanMask) AraEventCalibrator::Instance()->CalibrateLazyChannel(this,chanId);
+  if(fUseArena) {
+    if(chanId<0 || chanId>=CHANNELS_PER_ATRI || fArenaLength[chanId]==0) return NULL;
+    return &(fArenaVolts[fArenaOffset[chanId]]);
+  }
+  std::map< Int_t, std::vector <Double_t> >::iterator voltMapIt=fVolts.find(chanId);
+  if(voltMapIt==fVolts.end() || voltMapIt->second.empty()) return NULL;
+  return &(voltMapIt->second[0]);
+}
 
 TGraph *UsefulAtriStationEvent::getGraphFromElecChan(int chanId)
 {
-  std::map< Int_t, std::vector <Double_t> >::iterator timeMapIt;
-  timeMapIt=fTimes.find(chanId);
-  if(timeMapIt==fTimes.end()) {
+  // In lazy mode the channel is calibrated here, the first time it is asked for
+  if(fLazyChanMask) AraEventCalibrator::Instance()->CalibrateLazyChannel(this,chanId);
+  Bool_t haveChan=fUseArena ? (chanId>=0 && chanId<CHANNELS_PER_ATRI && fArenaLength[chanId]>0) : (fTimes.find(chanId)!=fTimes.end());
+  if(!haveChan) {
     // This channel doesn't exist. We don't return a null pointer,
     // we return an empty graph. 
     // RJN should fix this as it is a silly idea
     return new TGraph;
   }
   
-  TGraph *gr = new TGraph(fTimes[chanId].size(),&(fTimes[chanId][0]),&(fVolts[chanId][0]));
+  Int_t numSamples=getNumSamplesInElecChan(chanId);
+  TGraph *gr = new TGraph(numSamples,getTimesFromElecChan(chanId),getVoltsFromElecChan(chanId));
 
   //Why do we need to sort the array. Shouldn't this be done in AraEventCalibrator??
   //FIXME -- jpd - this is my dumb idea
@@ -85,7 +170,7 @@ TGraph *UsefulAtriStationEvent::getGraphFromElecChan(int chanId)
 //      std::cerr << "Back in time on chan Id: " << chanId << "\t" << countNegative << "\n";
 //      gr->Sort();
 //   }
-  if(fTimes[chanId].size()==0) {
+  if(numSamples==0) {
      std::cerr << "Oh no there aren't any points\n";
   }
 
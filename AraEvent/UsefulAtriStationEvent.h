@@ -26,6 +26,12 @@
 
   The raw ADC values from a RawAtriStationEvent object are converted into calibrated voltage-time arrays using one of the calibration types defined in AraEventCalibrator. Utility functions are provided to access these arrays as TGraphs, or in the frequency domain.
 
+  In arena mode the calibrated samples are kept in one dense arena rather than in fTimes / fVolts. The arena is transient, so when such an event is written
+  its samples are streamed through fTimes / fVolts, and it reads back as an ordinary event. Channels still waiting for lazy calibration are calibrated before writing.
+
+  For analyses that only look at a few channels the calibration can be made lazy: call setLazyCalibration(kTRUE) and then recalibrate() with the raw event.
+  Each channel is then calibrated the first time it is accessed through getGraphFromElecChan(), getGraphFromRFChan() or the sample accessors.
+
   Both ATRI and ICRR specific useful events inherit from a common bas class (UsefulAraStationEvent). It is intended that analysis code process objects of the type UsefulAraStationEvent, using the provided overloaded functions (getGraphFromRFChannel etc.). Code will then be able to process both ICRR and ATRI type events instead of being station specific.
 
   \ingroup rootclasses
@@ -34,11 +40,21 @@ class UsefulAtriStationEvent: public RawAtriStationEvent, public UsefulAraStatio
 {
   public:
     UsefulAtriStationEvent(); ///< Default constructor
-    UsefulAtriStationEvent(RawAtriStationEvent *rawEvent, AraCalType::AraCalType_t calType=AraCalType::kVoltageTime); ///< Constructor from RawAtriStationEvent object. This uses AraEventCalibrator to apply calibrations to the event.
+    UsefulAtriStationEvent(RawAtriStationEvent *rawEvent, AraCalType::AraCalType_t calType=AraCalType::kVoltageTime, Bool_t useArena=kFALSE); ///< Constructor from RawAtriStationEvent object. This uses AraEventCalibrator to apply calibrations to the event, with useArena the calibrated samples are stored in the dense arena instead of fTimes / fVolts
     ~UsefulAtriStationEvent(); ///< Destructor
 
+    void recalibrate(RawAtriStationEvent *rawEvent, AraCalType::AraCalType_t calType=AraCalType::kVoltageTime); ///< Reuses this object for another raw event. In arena mode no memory is allocated once the arena has grown to the size of the largest event
+    void setUseArena(Bool_t useArena) {fUseArena=useArena;} ///< Selects the storage used by the next calibration
+    Bool_t usesArena() {return fUseArena;} ///< Are the calibrated samples in the dense arena (fTimes / fVolts are then left empty, but written to file from the arena)
+    void setLazyCalibration(Bool_t lazy) {fLazyCalibration=lazy;} ///< With lazy calibration the next recalibrate() only calibrates each channel when it is first accessed. Not used together with the arena
+    Bool_t usesLazyCalibration() {return fLazyCalibration;} ///< Is lazy calibration selected
+    void calibrateLazyChannels(); ///< Calibrates the channels that lazy calibration has not done yet, needed before using fTimes / fVolts directly
+
     Int_t getNumElecChannels() {return fNumChannels;} ///< Returns the number of electronics channels
     Int_t getNumRFChannels(); ///< Returns the number of RF channels - NB this may differ from the number of electronics channels
+    Int_t getNumSamplesInElecChan(int chanId); ///< Returns the number of calibrated samples in an electronics channel, 0 if it was not read out
+    const Double_t *getTimesFromElecChan(int chanId); ///< Returns the calibrated sample times of an electronics channel, NULL if it was not read out
+    const Double_t *getVoltsFromElecChan(int chanId); ///< Returns the calibrated sample voltages of an electronics channel, NULL if it was not read out
     TGraph *getGraphFromElecChan(int chanId); ///< Returns the voltages-time graph for the appropriate electronics channel
     TGraph *getGraphFromRFChan(int chanId); ///< Returns the voltage-time graph for the appropriate rf channel
     TGraph *getFFTForRFChan(int chan); ///<Utility function for webplotter, all channels are interpolated to 0.5 ns - the returned TGraph is from FFTtools::makePowerSpectrumMilliVoltsNanoS$
@@ -50,6 +66,19 @@ class UsefulAtriStationEvent: public RawAtriStationEvent, public UsefulAraStatio
     std::map< Int_t, std::vector <Double_t> > fTimes; ///< The times of samples
     std::map< Int_t, std::vector <Double_t> > fVolts; ///< The voltages of samples
 
+    //Dense calibrated data, used instead of fTimes / fVolts in arena mode
+    Bool_t fUseArena; //!< Are the calibrated samples stored in the arena
+    std::vector <Double_t> fArenaTimes; //!< The times of all channels, electronics channel chanId starts at fArenaOffset[chanId]
+    std::vector <Double_t> fArenaVolts; //!< The voltages of all channels, same layout as fArenaTimes
+    Int_t fArenaOffset[CHANNELS_PER_ATRI]; //!< Where each electronics channel starts in the arena
+    Int_t fArenaLength[CHANNELS_PER_ATRI]; //!< The number of samples of each electronics channel, 0 if it was not read out
+
+    //Lazy calibration, the channels are calibrated into fTimes / fVolts on first access
+    Bool_t fLazyCalibration; //!< Does recalibrate() calibrate lazily
+    Int_t fLazyCalType; //!< The calibration type of the pending channels
+    UInt_t fLazyChanMask; //!< The electronics channels read out but not calibrated yet
+    AraAtriLazyCalibration fLazySetup; //!< The tables, blocks and corrections of the pending channels
+
     //to track conditioning
     bool fIsConditioned;
     std::vector<std::string> fConditioningList;
@@ -13,6 +13,7 @@
 #include "RawAtriStationEvent.h"
 #include "UsefulAtriStationEvent.h"
 #include "AraEventCalibrator.h"
+#include "AraEventReader.h"
 #include "FFTtools.h"
 
 //ROOT Includes
@@ -57,23 +58,21 @@ int main(int argc, char **argv)
   Int_t numWaveforms[3][8]={{0}};
   Int_t chanMap[3][8]={{0,1,8,9,16,17,24,25},{3,4,10,11,18,19,26,27},{5,6,28,29,-1,-1}};
 
-  TFile *fp = TFile::Open(argv[1]);
-  if(!fp) {
+  //Only the calpulser events are calibrated, so the reader just reads ahead and leaves the calibration to getUsefulEvent()
+  AraEventReader reader;
+  if(reader.addFile(argv[1])==0) {
     std::cerr << "Can't open file\n";
      return -1;
    }
-   TTree *eventTree = (TTree*) fp->Get("eventTree");
-   if(!eventTree) {
+   Int_t stationId=reader.getStationId();
+   if(stationId<0) {
      std::cerr << "Can't find eventTree\n";
      return -1;
    }
+   reader.setCalibration(AraCalType::kFirstCalib, 0);
    
-   eventTree->SetBranchAddress("event",&rawAtriEvPtr);
-   Long64_t numEntries=eventTree->GetEntries();
+   Long64_t numEntries=reader.getEntries();
    Long64_t starEvery=numEntries/80;
-   Int_t stationId=0;
-   eventTree->GetEntry(0);
-   stationId = rawAtriEvPtr->stationId;
    if(starEvery==0) starEvery++;
 
 
@@ -81,16 +80,16 @@ int main(int argc, char **argv)
    AraEventCalibrator *calib = AraEventCalibrator::Instance();
    calib->setAtriPedFile(pedFileName,stationId);
 
-   for(Long64_t event=0;event<numEntries;event++) {
+   for(Long64_t event=0;reader.next();event++) {
      if(event%starEvery==0) {
        std::cerr << "*";       
      }
 
-     eventTree->GetEntry(event);
+     rawAtriEvPtr = reader.getRawEvent();
      
      if(rawAtriEvPtr->isCalpulserEvent()==0) continue;
 
-     realAtriEvPtr = new UsefulAtriStationEvent(rawAtriEvPtr, AraCalType::kFirstCalib);
+     realAtriEvPtr = reader.getUsefulEvent();
      
      Int_t chan=0;
      Int_t ant=0;
@@ -148,7 +147,6 @@ int main(int argc, char **argv)
 	 delete chanInt;
        }
      }
-     delete realAtriEvPtr;
    
      if(maxNumWaveforms<=numWaveforms[0][0]) break;
 
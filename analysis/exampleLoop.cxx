@@ -9,6 +9,7 @@
 
 //Includes
 #include <iostream>
+#include <cstdlib>
 
 //AraRoot Includes
 #include "RawIcrrStationEvent.h"
@@ -16,6 +17,7 @@
 #include "UsefulAraStationEvent.h"
 #include "UsefulIcrrStationEvent.h"
 #include "UsefulAtriStationEvent.h"
+#include "AraRunProcessor.h"
 
 //Include FFTtools.h if you want to ask the correlation, etc. tools
 
@@ -31,11 +33,19 @@ RawAraStationEvent *rawEvPtr;
 UsefulIcrrStationEvent *realIcrrEvPtr;
 UsefulAtriStationEvent *realAtriEvPtr;
 
+//What each thread of the Atri loop accumulates, merged at the end
+struct ExampleResults {
+  Long64_t numEvents=0;
+  Long64_t numSamples=0;
+};
+
+int processAtriRun(const char *fileName, int numThreads);
+
 int main(int argc, char **argv)
 {
 
   if(argc<2) {
-    std::cout << "Usage\n" << argv[0] << " <input file>\n";
+    std::cout << "Usage\n" << argv[0] << " <input file> [threads]\n";
     std::cout << "e.g.\n" << argv[0] << " http://www.hep.ucl.ac.uk/uhen/ara/monitor/root/run1841/event1841.root\n";
     return 0;
   }
@@ -71,6 +81,13 @@ int main(int argc, char **argv)
    }
    eventTree->ResetBranchAddresses();
 
+   //Atri runs are spread over several threads, see processAtriRun() below
+   if(isAtriEvent){
+     int numThreads = argc>2 ? atoi(argv[2]) : 0;
+     delete fp;
+     return processAtriRun(argv[1], numThreads);
+   }
+
    //Now set the appropriate branch addresses
    //The Icrr case
    if(isIcrrEvent){
@@ -151,3 +168,37 @@ int main(int argc, char **argv)
    std::cerr << "\n";
 
 }
+
+
+//The same loop for Atri events, with the events of the run shared out between numThreads threads (0 for one per core)
+int processAtriRun(const char *fileName, int numThreads)
+{
+  //Called for each event on one of the threads, only touching that thread's results
+  AraRunProcessor<ExampleResults>::Processor processEvent =
+    [](ExampleResults &results, Long64_t entry, RawAtriStationEvent *rawAtriEv, UsefulAtriStationEvent *realAtriEv) {
+    //Now you can do whatever analysis you want
+    //e.g.
+    TGraph *chan1 = realAtriEv->getGraphFromRFChan(0);
+    results.numEvents++;
+    results.numSamples+=chan1->GetN();
+    delete chan1;
+  };
+
+  //Called once for each thread at the end, in the main thread
+  AraRunProcessor<ExampleResults>::Merger mergeResults =
+    [](ExampleResults &total, const ExampleResults &results) {
+    total.numEvents+=results.numEvents;
+    total.numSamples+=results.numSamples;
+  };
+
+  AraRunProcessor<ExampleResults> processor(processEvent, mergeResults, numThreads);
+  processor.addFile(fileName);
+  processor.setCalibration(AraCalType::kLatestCalib);
+  std::cerr << "Set Branch address to Atri, processing on " << processor.getNumSlots() << " threads\n";
+
+  ExampleResults total;
+  if(!processor.run(total)) return -1;
+  processor.printStats(stderr);
+  std::cerr << "Processed " << total.numEvents << " events, " << total.numSamples << " samples in RF channel 0\n";
+  return 0;
+}
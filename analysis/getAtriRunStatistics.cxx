@@ -4,6 +4,10 @@
 #include <zlib.h>
 #include <libgen.h>     
 #include <cstdlib>
+#include <unistd.h>
+#include <vector>
+#include <string>
+#include <algorithm>
  
 using namespace std;
 
@@ -16,16 +20,28 @@ using namespace std;
 #include "AraGeomTool.h"
 #include "araAtriStructures.h"
 #include "RawAtriStationEvent.h"  
+#include "AraRunProcessor.h"
+
+//What the statistics need of each event, collected on the processor's threads
+struct RunStatsEvent {
+  Long64_t entry;
+  UInt_t unixTime;
+  Int_t numReadoutBlocks;
+  bool isCalpulser;
+  AraStationId_t stationId;
+};
+
+//The events a slot has seen, which are put back in run order before counting
+struct RunStatsEvents {
+  std::vector<RunStatsEvent> events;
+};
+
+void process(const RunStatsEvent &theEvent);
+void printStatistics(int run);
+void processFileList(char *inputName, char *outDir, int run, int numThreads);
 
-void process(int run);
-void processFileList(char *inputName, char *outDir, int run);
-
-AraStationEventHeader_t theEventHeader;
-
-char *dataBuffer;
 TFile *outFile;
 TTree *outTree;
-RawAtriStationEvent *theEvent=0;
 char outName[FILENAME_MAX];
 UInt_t realTime;
 Int_t runNumber;
@@ -58,25 +74,60 @@ Int_t firstTime=0;
 const char *filename;
 
 int main(int argc, char **argv) {
-  dataBuffer = new char[200000];
-  theEvent=0;
-  if(argc<4) {
-    std::cout << "Usage: " << basename(argv[0]) << " <file list> <outFileName> <run>" << std::endl;
+  int opt;
+  int numThreads=0; //Processor threads, -j, 0 for one per core
+  while((opt=getopt(argc,argv,"j:"))!=-1) {
+    switch(opt) {
+    case 'j':
+      numThreads=atoi(optarg);
+      break;
+    default:
+      std::cout << "Usage: " << basename(argv[0]) << " [-j <threads>] <file list> <outFileName> <run>" << std::endl;
+      return -1;
+    }
+  }
+  if(argc-optind<3) {
+    std::cout << "Usage: " << basename(argv[0]) << " [-j <threads>] <file list> <outFileName> <run>" << std::endl;
     return -1;
   }
 
-  processFileList(argv[1],argv[2], atoi(argv[3]));
-  delete [] dataBuffer;
+  processFileList(argv[optind],argv[optind+1], atoi(argv[optind+2]), numThreads);
   return 0;
 }
   
 
-void processFileList(char *inputName, char *outFileName, int run) {
+void processFileList(char *inputName, char *outFileName, int run, int numThreads) {
   cout << inputName << "\t" << outFileName << endl;
 
-  theEvent = new RawAtriStationEvent();
+  //The files are read and their events summarised on several threads, the counting below needs them in run order
+  AraRunProcessor<RunStatsEvents> processor(
+    [](RunStatsEvents &slotEvents, Long64_t entry, RawAtriStationEvent *theEvent, UsefulAtriStationEvent *) {
+      RunStatsEvent summary;
+      summary.entry=entry;
+      summary.unixTime=theEvent->unixTime;
+      summary.numReadoutBlocks=theEvent->numReadoutBlocks;
+      summary.isCalpulser=theEvent->isCalpulserEvent();
+      summary.stationId=theEvent->stationId;
+      slotEvents.events.push_back(summary);
+    },
+    [](RunStatsEvents &allEvents, const RunStatsEvents &slotEvents) {
+      allEvents.events.insert(allEvents.events.end(), slotEvents.events.begin(), slotEvents.events.end());
+    },
+    numThreads);
 
   ifstream SillyFile(inputName);
+  char fileName[FILENAME_MAX];
+  while(SillyFile >> fileName) processor.addRawFile(fileName);
+
+  RunStatsEvents allEvents;
+  if(!processor.run(allEvents)) {
+    std::cerr << "Not every raw file of " << inputName << " could be read, the rates would be wrong\n";
+    return -1;
+  }
+  processor.printStats();
+  std::sort(allEvents.events.begin(), allEvents.events.end(),
+	    [](const RunStatsEvent &a, const RunStatsEvent &b) { return a.entry<b.entry; });
+
   outFile = new TFile(outFileName, "RECREATE");
   outTree = new TTree("runStatsTree", "Tree of run statistics");
   outTree->Branch("lastUnixTime", &lastUnixTime, "lastUnixTime/i");
@@ -99,96 +150,38 @@ void processFileList(char *inputName, char *outFileName, int run) {
 
 
   firstTime=1;
-  int numBytes=0;
-  char fileName[180];
-  int error=0;
-  //    int eventNumber=1;
-  int counter=0;
-  while(SillyFile >> fileName) {
-    if(counter%100==0) 
-      cout << fileName << endl;
-    counter++;
-    
-    gzFile infile = gzopen (fileName, "rb");    
-    //    std::cout << "gzeof: " << gzeof(infile) << "\n";
-    for(int i=0;i<1000;i++) {	
-      //      cout << i << endl;
-      numBytes=gzread(infile,&theEventHeader,sizeof(AraStationEventHeader_t));
-      //      std::cout << numBytes << "\n";
-      if(numBytes==0) break;
-      if(numBytes!=sizeof(AraStationEventHeader_t)) {
-	if(numBytes)
-	  cerr << "Read problem: " <<numBytes << " of " << sizeof(AraStationEventHeader_t) << endl;
-	error=1;
-	break;
-      }
-
-      if(theEventHeader.gHdr.numBytes>0) {
-	//	std::cout << "Num bytes: " << theEventHeader.gHdr.numBytes << "\t" << theEventHeader.numBytes << "\n";
-	//	std::cout << "Event number: " << theEventHeader.eventNumber << "\t" << theEventHeader.unixTime << "\t" << theEventHeader.unixTimeUs << "\n";
-	
-	
-	Int_t numDataBytes=theEventHeader.gHdr.numBytes-sizeof(AraStationEventHeader_t);
-	numBytes=gzread(infile,dataBuffer,numDataBytes);
-	//	std::cout << numBytes << "\n";
-	if(numBytes==0) break;
-	if(numBytes!=numDataBytes) {
-	  if(numBytes)
-	    cerr << "Read problem: " <<numBytes << " of " <<  numDataBytes << endl;
-	  error=1;
-	  break;
-	}
-	stationId = theEventHeader.gHdr.stationId;
-
-	process(run);
-     	//	exit(0);
-      }
-      else {
-	std::cerr << "How can gHdr.numBytes = " << theEventHeader.gHdr.numBytes << "\n";
-	error=1;
-	break;
-      }
-
-      //      cout << ": " << theEventHeader.unixTime << endl;
-     }
-    gzclose(infile);
-    //	if(error) break;
+  for(size_t i=0;i<allEvents.events.size();i++) {
+    stationId = allEvents.events[i].stationId;
+    process(allEvents.events[i]);
+  }
+  if(allEvents.events.empty()) {
+    std::cerr << "No events in " << inputName << "\n";
   }
-  lastTime=1;
-  process(run);
+  else {
+    lastTime=1;
+    process(allEvents.events.back());
+  }
+  printStatistics(run);
 
   outFile->Write();
 
 }
 
 
-void process(int run) {
-  TString txtout="out_run";
-  txtout+=run;
-  txtout+=".txt";
-  filename=txtout.Data();
-  ofstream aout(filename);
- 
-  static int doneInit=0;
-  if(!doneInit) {
-    doneInit=1;
-  }  
-  if(theEvent) delete theEvent;
-  
-  theEvent = new RawAtriStationEvent(&theEventHeader,dataBuffer);
+void process(const RunStatsEvent &theEvent) {
   //Create stats
   if(firstTime){
-    lastUnixTime=theEvent->unixTime;
+    lastUnixTime=theEvent.unixTime;
     thisUnixTime=lastUnixTime;
     
     outTree->Fill();
     firstTime=0;
   }
-  thisUnixTime=theEvent->unixTime;
+  thisUnixTime=theEvent.unixTime;
   numEvents++;
-  if(theEvent->numReadoutBlocks<80) numEvents_CPU++;
-  if(theEvent->numReadoutBlocks>=80 && theEvent->isCalpulserEvent()==false)numEvents_RF0++;
-  if(theEvent->isCalpulserEvent()) numEvents_CALPULSER++;
+  if(theEvent.numReadoutBlocks<80) numEvents_CPU++;
+  if(theEvent.numReadoutBlocks>=80 && theEvent.isCalpulser==false)numEvents_RF0++;
+  if(theEvent.isCalpulser) numEvents_CALPULSER++;
 
 
   if(thisUnixTime >= lastUnixTime + 60*30 || lastTime){
@@ -210,6 +203,15 @@ void process(int run) {
     lastNumEvents_RF0=numEvents_RF0;
     lastNumEvents_CALPULSER=numEvents_CALPULSER;
   }
+}
+
+
+void printStatistics(int run) {
+  TString txtout="out_run";
+  txtout+=run;
+  txtout+=".txt";
+  filename=txtout.Data();
+  ofstream aout(filename);
 
   aout<<"lastUnixTime= "<<lastUnixTime<<endl;
   //aout<<"thisUnixTime= "<<thisUnixTime<<endl;
@@ -13,6 +13,7 @@
 #include "RawAtriStationEvent.h"
 #include "UsefulAraStationEvent.h"
 #include "UsefulAtriStationEvent.h"
+#include "AraEventReader.h"
 
 //Include FFTtools.h if you want to ask the correlation, etc. tools
 
@@ -61,44 +62,37 @@ int main(int argc, char **argv)
   outTree->Branch("timeStamp", &thisTimeStamp, "thisTimeStamp/I");
   outTree->Branch("pps", &pps, "pps/I");
 
-  TFile *fp = TFile::Open(argv[1]);
-  if(!fp) {
+  //The reader reads and calibrates the next events while this one is analysed
+  AraEventReader reader;
+  if(reader.addFile(argv[1])==0) {
     std::cerr << "Can't open file\n";
      return -1;
    }
-   TTree *eventTree = (TTree*) fp->Get("eventTree");
-   if(!eventTree) {
+   Int_t stationId = reader.getStationId();
+   if(stationId<0) {
      std::cerr << "Can't find eventTree\n";
      return -1;
    }
+   AraEventCalibrator::Instance()->setAtriPedFile(argv[2],stationId);
+   reader.setCalibration(AraCalType::kFirstCalib);
 
-   eventTree->SetBranchAddress("event", &rawAtriEvPtr);
-   Long64_t numEntries=eventTree->GetEntries();
+   Long64_t numEntries=reader.getEntries();
    Long64_t starEvery=numEntries/80;
    if(starEvery==0) starEvery++;
 
    TGraph *grChan;
 
-   eventTree->GetEntry(0);
-   
-   Int_t stationId = rawAtriEvPtr->stationId;
-
-   AraEventCalibrator::Instance()->setAtriPedFile(argv[2],stationId);
-
-
-   for(Long64_t event=0;event<numEntries;event++) {
+   for(Long64_t event=0;reader.next();event++) {
      if(event%starEvery==0) {
        std::cerr << "*";       
      }
 
-     //This line gets the RawIcrr or RawAtri Event
-     eventTree->GetEntry(event);
-
+     //The RawAtri Event and its calibrated UsefulAtri Event, which belong to the reader
+     rawAtriEvPtr = reader.getRawEvent();
+     realAtriEvPtr = reader.getUsefulEvent();
 
      thisTimeStamp = rawAtriEvPtr->timeStamp;
      pps = rawAtriEvPtr->ppsNumber;
-    
-     realAtriEvPtr = new UsefulAtriStationEvent(rawAtriEvPtr, AraCalType::kFirstCalib);
 
      for(chan=0;chan<CHANNELS_PER_ATRI;chan++){
        grChan = realAtriEvPtr->getGraphFromElecChan(chan);
@@ -107,8 +101,6 @@ int main(int argc, char **argv)
        delete grChan;
 
      }
-
-     delete realAtriEvPtr;
      
    }
    std::cerr << "\n";
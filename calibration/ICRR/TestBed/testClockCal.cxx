@@ -108,7 +108,7 @@ int main(int argc, char **argv)
 
 	 for(int rcoGuess=0;rcoGuess<2;rcoGuess++) {
 	   int numValid=fCalibrator->doBinCalibration(&realEvent,chanIndex,rcoGuess);	   
-	   grClock[chip]=new TGraph(numValid,fCalibrator->calTimeNums,fCalibrator->calVoltNums);
+	   grClock[chip]=new TGraph(numValid,fCalibrator->getContext()->calTimeNums,fCalibrator->getContext()->calVoltNums);
 	   //	   std::cout << event << "\t" << chip << "\t" << rcoGuess << "\n";
 	   period[rcoGuess][chip]=estimatePeriod(grClock[chip],rms[rcoGuess][chip]);
 	   //	   char canName[180];
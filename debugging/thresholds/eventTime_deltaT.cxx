@@ -50,6 +50,8 @@ int main(int argc, char **argv)
 
    RawAtriStationEvent *rawEvPtr=0;
    eventTree->SetBranchAddress("event", &rawEvPtr);
+   //Only header fields are used, so don't read the blocks
+   RawAtriStationEvent::setHeaderOnly(eventTree);
 
    Int_t numEntries=eventTree->GetEntries();
    //   numEntries=100; //FIXME
@@ -4,10 +4,27 @@
 
 #include "RawAtriStationEvent.h"
 #include "UsefulAtriStationEvent.h"
+#include "AraEventCalibrator.h"
+#include "AraGeomTool.h"
+#include "AraAtriWaveformFile.h"
+#include "AraAtriPedestalFile.h"
+#include "AraAtriCalibBundle.h"
+#include "AraEventIndexFile.h"
+#include "AraCompactAtriStationEvent.h"
+#include "AraEventReader.h"
+#include "AraRunProcessor.h"
+#include "AraRootifierPipeline.h"
+#include "AraRawFileIndex.h"
 
 #include <iostream>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <zlib.h>
+#include <sys/stat.h>
+#include <utime.h>
+#include <unistd.h>
 
 /*
 	Global variables to control our expectations for this test
@@ -17,6 +34,74 @@ int numEntries_expected = 100; // number of events in the file
 double max_mean = 1E-6; // required deviation from zero in the mean of a properly calibrated event
 double max_diff_cal = 0.1; // required difference between means of waveforms when to different cal strategies are used
 
+// writes events as the DAQ does, so the raw file readers can be tested on the events of the tree
+bool write_raw_file(const char *fileName, RawAtriStationEvent **events, int numEvents){
+	std::vector<char> buffer;
+	for(int event=0; event<numEvents; event++){
+		RawAtriStationEvent *raw = events[event];
+		AraStationEventHeader_t header;
+		memset(&header, 0, sizeof(header));
+		header.gHdr.typeId = (AraDataStructureType_t)raw->typeId;
+		header.gHdr.stationId = raw->stationId;
+		header.gHdr.verId = raw->verId;
+		header.gHdr.subVerId = raw->subVerId;
+		header.gHdr.checksum = raw->checksum;
+		header.gHdr.reserved = raw->reserved;
+		header.unixTime = raw->unixTime;
+		header.unixTimeUs = raw->unixTimeUs;
+		header.eventNumber = raw->eventNumber;
+		header.timeStamp = raw->timeStamp ^ (raw->timeStamp >> 1); // the DAQ writes it Gray coded
+		header.ppsNumber = raw->ppsNumber;
+		header.eventId = raw->eventId;
+		header.versionNumber = raw->versionId;
+		header.numReadoutBlocks = raw->blockVec.size();
+		for(int trig=0; trig<MAX_TRIG_BLOCKS; trig++){
+			header.triggerInfo[trig] = raw->triggerInfo[trig];
+			header.triggerBlock[trig] = raw->triggerBlock[trig];
+		}
+		std::vector<char> data;
+		for(size_t blk=0; blk<raw->blockVec.size(); blk++){
+			const RawAtriStationBlock &block = raw->blockVec[blk];
+			AraStationEventBlockHeader_t blockHeader;
+			blockHeader.irsBlockNumber = block.irsBlockNumber;
+			blockHeader.channelMask = block.channelMask;
+			data.insert(data.end(), (const char*)&blockHeader, (const char*)(&blockHeader+1));
+			data.insert(data.end(), (const char*)block.samples, (const char*)block.samples[block.numChannels]);
+		}
+		header.numBytes = data.size();
+		header.gHdr.numBytes = sizeof(header)+data.size();
+		buffer.insert(buffer.end(), (const char*)&header, (const char*)(&header+1));
+		buffer.insert(buffer.end(), data.begin(), data.end());
+	}
+	gzFile outFile = gzopen(fileName, "wb");
+	if(!outFile) return false;
+	bool ok = gzwrite(outFile, &buffer[0], buffer.size()) == int(buffer.size());
+	return gzclose(outFile) == Z_OK && ok;
+}
+
+// returns the first electronics channel whose calibrated samples differ between two events, -1 if they are all the same
+int first_differing_chan(UsefulAtriStationEvent *expected, UsefulAtriStationEvent *actual){
+	for(int ch=0; ch<CHANNELS_PER_ATRI; ch++){
+		int numSamples = expected->getNumSamplesInElecChan(ch);
+		if(actual->getNumSamplesInElecChan(ch) != numSamples) return ch;
+		if(numSamples==0) continue;
+		if(memcmp(expected->getTimesFromElecChan(ch), actual->getTimesFromElecChan(ch), numSamples*sizeof(double))
+			|| memcmp(expected->getVoltsFromElecChan(ch), actual->getVoltsFromElecChan(ch), numSamples*sizeof(double))) return ch;
+	}
+	return -1;
+}
+
+// what the run processor test keeps of each event
+struct ProcessedEvent {
+	Long64_t entry;
+	UInt_t eventNumber;
+	double lastVolts;
+	bool operator<(const ProcessedEvent &other) const { return entry < other.entry; }
+};
+struct ProcessedEvents {
+	std::vector<ProcessedEvent> events;
+};
+
 int main(int argc, char **argv){
 
 	if(argc<2){
@@ -86,6 +171,618 @@ int main(int argc, char **argv){
 		delete usefulEvent_cal2;
 	}
 
+	// make sure the single pass calibration gives exactly the same samples as the step by step one
+	AraEventCalibrator *calibrator = AraEventCalibrator::Instance();
+	AraCalType::AraCalType_t calTypes[3] = {AraCalType::kVoltageTime, AraCalType::kLatestCalib, AraCalType::kLatestCalibWithOutZeroMean};
+	for(int event=0; event<numEntries; event++){
+		eventTree->GetEntry(event);
+		for(int type=0; type<3; type++){
+			calibrator->setUseFusedCalibration(kFALSE);
+			UsefulAtriStationEvent *usefulEvent_staged = new UsefulAtriStationEvent(rawEvent, calTypes[type]);
+			calibrator->setUseFusedCalibration(kTRUE);
+			UsefulAtriStationEvent *usefulEvent_fused = new UsefulAtriStationEvent(rawEvent, calTypes[type]);
+			for(int ch=0; ch<CHANNELS_PER_ATRI; ch++){
+				int numSamples = usefulEvent_staged->getNumSamplesInElecChan(ch);
+				if(usefulEvent_fused->getNumSamplesInElecChan(ch) != numSamples){
+					printf("Event %d, Cal %d, Elec Ch %d: fused calibration has %d samples (%d expected). Test will fail.\n",
+						event, calTypes[type], ch, usefulEvent_fused->getNumSamplesInElecChan(ch), numSamples);
+					exit(-1);
+				}
+				if(numSamples==0) continue;
+				if(memcmp(usefulEvent_staged->getTimesFromElecChan(ch), usefulEvent_fused->getTimesFromElecChan(ch), numSamples*sizeof(double))
+					|| memcmp(usefulEvent_staged->getVoltsFromElecChan(ch), usefulEvent_fused->getVoltsFromElecChan(ch), numSamples*sizeof(double))){
+					printf("Event %d, Cal %d, Elec Ch %d: fused calibration differs from the step by step one. Test will fail.\n", event, calTypes[type], ch);
+					exit(-1);
+				}
+			}
+			delete usefulEvent_staged;
+			delete usefulEvent_fused;
+		}
+	}
+
+	// make sure lazily calibrated channels are the same as the ones calibrated up front, whatever order they are asked for in
+	for(int event=0; event<numEntries; event++){
+		eventTree->GetEntry(event);
+		for(int type=0; type<3; type++){
+			UsefulAtriStationEvent *usefulEvent_eager = new UsefulAtriStationEvent(rawEvent, calTypes[type]);
+			UsefulAtriStationEvent *usefulEvent_lazy = new UsefulAtriStationEvent();
+			usefulEvent_lazy->setLazyCalibration(kTRUE);
+			usefulEvent_lazy->recalibrate(rawEvent, calTypes[type]);
+			// a copy taken before any channel is calibrated has to calibrate from its own blocks
+			UsefulAtriStationEvent *usefulEvent_copy = new UsefulAtriStationEvent(*usefulEvent_lazy);
+			if(usefulEvent_lazy->getNumElecChannels() != usefulEvent_eager->getNumElecChannels()){
+				printf("Event %d, Cal %d: lazy calibration has %d channels (%d expected). Test will fail.\n",
+					event, calTypes[type], usefulEvent_lazy->getNumElecChannels(), usefulEvent_eager->getNumElecChannels());
+				exit(-1);
+			}
+			for(int ch=CHANNELS_PER_ATRI-1; ch>=0; ch--){
+				int numSamples = usefulEvent_eager->getNumSamplesInElecChan(ch);
+				if(usefulEvent_lazy->getNumSamplesInElecChan(ch) != numSamples){
+					printf("Event %d, Cal %d, Elec Ch %d: lazy calibration has %d samples (%d expected). Test will fail.\n",
+						event, calTypes[type], ch, usefulEvent_lazy->getNumSamplesInElecChan(ch), numSamples);
+					exit(-1);
+				}
+				if(numSamples==0) continue;
+				if(memcmp(usefulEvent_eager->getTimesFromElecChan(ch), usefulEvent_lazy->getTimesFromElecChan(ch), numSamples*sizeof(double))
+					|| memcmp(usefulEvent_eager->getVoltsFromElecChan(ch), usefulEvent_lazy->getVoltsFromElecChan(ch), numSamples*sizeof(double))){
+					printf("Event %d, Cal %d, Elec Ch %d: lazy calibration differs from the up front one. Test will fail.\n", event, calTypes[type], ch);
+					exit(-1);
+				}
+			}
+			delete usefulEvent_lazy;
+			int ch = first_differing_chan(usefulEvent_eager, usefulEvent_copy);
+			if(ch>=0){
+				printf("Event %d, Cal %d, Elec Ch %d: copy of a lazy event differs from the up front one. Test will fail.\n", event, calTypes[type], ch);
+				exit(-1);
+			}
+			delete usefulEvent_eager;
+			delete usefulEvent_copy;
+		}
+	}
+
+	// make sure events keeping their samples in the arena match the ones using fTimes / fVolts, step by step and fused
+	UsefulAtriStationEvent *usefulEvent_reused = new UsefulAtriStationEvent();
+	usefulEvent_reused->setUseArena(kTRUE);
+	for(int fused=0; fused<2; fused++){
+		calibrator->setUseFusedCalibration(fused);
+		for(int event=0; event<numEntries; event++){
+			eventTree->GetEntry(event);
+			for(int type=0; type<3; type++){
+				UsefulAtriStationEvent *usefulEvent_map = new UsefulAtriStationEvent(rawEvent, calTypes[type]);
+				UsefulAtriStationEvent *usefulEvent_arena = new UsefulAtriStationEvent(rawEvent, calTypes[type], kTRUE);
+				usefulEvent_reused->recalibrate(rawEvent, calTypes[type]);
+				UsefulAtriStationEvent *arenaEvents[2] = {usefulEvent_arena, usefulEvent_reused};
+				for(int arena=0; arena<2; arena++){
+					if(!arenaEvents[arena]->usesArena() || !arenaEvents[arena]->fVolts.empty()){
+						printf("Event %d, Cal %d: arena event keeps its samples in fVolts. Test will fail.\n", event, calTypes[type]);
+						exit(-1);
+					}
+					int ch = first_differing_chan(usefulEvent_map, arenaEvents[arena]);
+					if(ch>=0){
+						printf("Event %d, Cal %d, Elec Ch %d, Fused %d: %s arena calibration differs from the fTimes / fVolts one. Test will fail.\n",
+							event, calTypes[type], ch, fused, arena ? "reused" : "new");
+						exit(-1);
+					}
+				}
+				delete usefulEvent_map;
+				delete usefulEvent_arena;
+			}
+		}
+	}
+	calibrator->setUseFusedCalibration(kTRUE);
+
+	// make sure arena events written to a tree read back with their samples, even into an arena event
+	{
+		TFile *arenaFile = new TFile("fileAndEventCal_arena.root", "RECREATE");
+		TTree *arenaTree = new TTree("arenaTree", "Tree of arena events");
+		UsefulAtriStationEvent *usefulEvent_write = new UsefulAtriStationEvent();
+		usefulEvent_write->setUseArena(kTRUE);
+		arenaTree->Branch("calevent", "UsefulAtriStationEvent", &usefulEvent_write);
+		for(int event=0; event<numEntries; event++){
+			eventTree->GetEntry(event);
+			usefulEvent_write->recalibrate(rawEvent, AraCalType::kLatestCalib);
+			arenaTree->Fill();
+			if(!usefulEvent_write->fVolts.empty()){
+				printf("Event %d: arena event kept its samples in fVolts after being written. Test will fail.\n", event);
+				exit(-1);
+			}
+		}
+		arenaTree->Write();
+		UsefulAtriStationEvent *usefulEvent_read = usefulEvent_reused;
+		arenaTree->SetBranchAddress("calevent", &usefulEvent_read);
+		for(int event=0; event<numEntries; event++){
+			arenaTree->GetEntry(event);
+			eventTree->GetEntry(event);
+			UsefulAtriStationEvent *usefulEvent_map = new UsefulAtriStationEvent(rawEvent, AraCalType::kLatestCalib);
+			int ch = first_differing_chan(usefulEvent_map, usefulEvent_read);
+			if(usefulEvent_read->usesArena() || ch>=0){
+				printf("Event %d, Elec Ch %d: arena event read back from a tree differs from the calibrated one. Test will fail.\n", event, ch);
+				exit(-1);
+			}
+			delete usefulEvent_map;
+		}
+		arenaFile->Close();
+		delete arenaFile;
+		delete usefulEvent_write;
+		remove("fileAndEventCal_arena.root");
+	}
+	delete usefulEvent_reused;
+
+	// make sure the batch calibration gives the same samples as one event at a time, with and without threads
+	std::vector<RawAtriStationEvent*> rawEvents(numEntries);
+	for(int event=0; event<numEntries; event++){
+		eventTree->GetEntry(event);
+		rawEvents[event] = new RawAtriStationEvent(*rawEvent);
+	}
+	AraAtriCalibratedBatch batch;
+	for(int threads=1; threads<=4; threads+=3){
+		calibrator->calibrateEvents(numEntries, &rawEvents[0], &batch, AraCalType::kLatestCalib, threads);
+		for(int event=0; event<numEntries; event++){
+			UsefulAtriStationEvent *usefulEvent = new UsefulAtriStationEvent(rawEvents[event], AraCalType::kLatestCalib);
+			for(int ch=0; ch<CHANNELS_PER_ATRI; ch++){
+				int numSamples = usefulEvent->getNumSamplesInElecChan(ch);
+				if(batch.getNumSamples(event, ch) != numSamples){
+					printf("Event %d, Threads %d, Elec Ch %d: batch calibration has %d samples (%d expected). Test will fail.\n",
+						event, threads, ch, batch.getNumSamples(event, ch), numSamples);
+					exit(-1);
+				}
+				if(numSamples==0) continue;
+				if(memcmp(usefulEvent->getTimesFromElecChan(ch), batch.getTimes(event, ch), numSamples*sizeof(double))
+					|| memcmp(usefulEvent->getVoltsFromElecChan(ch), batch.getVolts(event, ch), numSamples*sizeof(double))){
+					printf("Event %d, Threads %d, Elec Ch %d: batch calibration differs from the single event one. Test will fail.\n", event, threads, ch);
+					exit(-1);
+				}
+			}
+			delete usefulEvent;
+		}
+	}
+
+	// make sure pedestals converted from the text file to a binary one and mapped calibrate to the same samples as the text ones
+	AraStationId_t stationId = rawEvents[0]->stationId;
+	int calibIndex = AraGeomTool::getStationCalibIndex(stationId);
+	const int numCompared = 10; // events kept calibrated with the text pedestals and tables, to compare against
+	std::vector<UsefulAtriStationEvent*> textEvents(numCompared*3);
+	{
+		char textPedFile[FILENAME_MAX];
+		strncpy(textPedFile, calibrator->fAtriPedFile[calibIndex], FILENAME_MAX);
+		size_t nameLength = strlen(textPedFile);
+		if(AraAtriPedestalFile::isBinary(textPedFile) && nameLength>4) strcpy(textPedFile+nameLength-4, ".txt");
+		std::vector<UShort_t> peds;
+		if(AraAtriPedestalFile::readText(textPedFile, peds) != ARA_ATRI_PED_FILE_NUM_PEDS){
+			printf("Cannot read text pedestal file %s. Test will fail.\n", textPedFile);
+			exit(-1);
+		}
+		char binPedFile[FILENAME_MAX] = "fileAndEventCal_peds.bin";
+		if(!AraAtriPedestalFile::writeBinary(binPedFile, stationId, &peds[0], peds.size())
+			|| !AraAtriPedestalFile::isBinary(binPedFile) || AraAtriPedestalFile::numberOfValues(binPedFile) != ARA_ATRI_PED_FILE_NUM_PEDS){
+			printf("Cannot write binary pedestal file %s. Test will fail.\n", binPedFile);
+			exit(-1);
+		}
+		void *mapBase = 0;
+		size_t mapLength = 0;
+		const UShort_t *mappedPeds = AraAtriPedestalFile::mapBinary(binPedFile, stationId, mapBase, mapLength);
+		if(!mappedPeds || memcmp(mappedPeds, &peds[0], peds.size()*sizeof(UShort_t))){
+			printf("Binary pedestal file %s maps to other pedestals than text file %s. Test will fail.\n", binPedFile, textPedFile);
+			exit(-1);
+		}
+		AraAtriPedestalFile::unmapBinary(mapBase, mapLength);
+
+		calibrator->setAtriPedFile(textPedFile, stationId);
+		for(int event=0; event<numCompared; event++)
+			for(int type=0; type<3; type++) textEvents[event*3+type] = new UsefulAtriStationEvent(rawEvents[event], calTypes[type]);
+		calibrator->setAtriPedFile(binPedFile, stationId);
+		if(!calibrator->getAtriPedestals(stationId)->fMapBase){
+			printf("Calibrator did not map binary pedestal file %s. Test will fail.\n", binPedFile);
+			exit(-1);
+		}
+		for(int event=0; event<numCompared; event++){
+			for(int type=0; type<3; type++){
+				UsefulAtriStationEvent *usefulEvent_bin = new UsefulAtriStationEvent(rawEvents[event], calTypes[type]);
+				int ch = first_differing_chan(textEvents[event*3+type], usefulEvent_bin);
+				if(ch>=0){
+					printf("Event %d, Cal %d, Elec Ch %d: calibration with binary pedestals differs from the text ones. Test will fail.\n", event, calTypes[type], ch);
+					exit(-1);
+				}
+				delete usefulEvent_bin;
+			}
+		}
+		calibrator->setAtriPedFile(textPedFile, stationId);
+		remove(binPedFile);
+	}
+
+	// make sure events calibrated from a calibration bundle match the ones calibrated from the text tables
+	{
+		Int_t epoch = AraEventCalibrator::getAtriCalibEpoch(stationId, rawEvents[0]->unixTime);
+		AraAtriCalibTables *textTables = calibrator->loadAtriCalibFromText(stationId, epoch);
+		const char *bundleDir = "fileAndEventCal_calib";
+		char bundleFile[FILENAME_MAX];
+		snprintf(bundleFile, FILENAME_MAX, "%s/ATRI/araAtriStation%iCalibBundleEpoch%i.bin", bundleDir, stationId, epoch);
+		mkdir(bundleDir, 0755);
+		mkdir((std::string(bundleDir)+"/ATRI").c_str(), 0755);
+		if(!textTables || !AraAtriCalibBundle::write(bundleFile, textTables)){
+			printf("Cannot write calibration bundle %s. Test will fail.\n", bundleFile);
+			exit(-1);
+		}
+		delete textTables;
+		AraAtriCalibTables *bundleTables = AraAtriCalibBundle::read(bundleFile, stationId, epoch);
+		if(!bundleTables){
+			printf("Cannot read back calibration bundle %s. Test will fail.\n", bundleFile);
+			exit(-1);
+		}
+		delete bundleTables;
+
+		// the calibrator only looks for the bundle in the calibration directory, and has to load its tables again
+		const char *calibEnv = getenv("ARA_CALIB_DIR");
+		std::string oldCalibDir = calibEnv ? calibEnv : "";
+		setenv("ARA_CALIB_DIR", bundleDir, 1);
+		calibrator->clearAtriCache();
+		for(int event=0; event<numCompared; event++){
+			for(int type=0; type<3; type++){
+				UsefulAtriStationEvent *usefulEvent_bundle = new UsefulAtriStationEvent(rawEvents[event], calTypes[type]);
+				int ch = first_differing_chan(textEvents[event*3+type], usefulEvent_bundle);
+				if(ch>=0){
+					printf("Event %d, Cal %d, Elec Ch %d: calibration from the bundle differs from the text tables. Test will fail.\n", event, calTypes[type], ch);
+					exit(-1);
+				}
+				delete usefulEvent_bundle;
+			}
+		}
+		if(calibEnv) setenv("ARA_CALIB_DIR", oldCalibDir.c_str(), 1);
+		else unsetenv("ARA_CALIB_DIR");
+		calibrator->clearAtriCache();
+		remove(bundleFile);
+		rmdir((std::string(bundleDir)+"/ATRI").c_str());
+		rmdir(bundleDir);
+	}
+
+	for(int event=0; event<numCompared*3; event++) delete textEvents[event];
+
+	// make sure events read back from a waveform file calibrate to the same samples as the events they were written from
+	const char *waveformFileName = "fileAndEventCal_waveforms.bin";
+	AraAtriWaveformFileWriter waveformWriter;
+	waveformWriter.open(waveformFileName);
+	for(int event=0; event<numEntries; event++) waveformWriter.addEvent(rawEvents[event]);
+	if(!waveformWriter.close()){
+		printf("Cannot write waveform file %s. Test will fail.\n", waveformFileName);
+		exit(-1);
+	}
+	AraAtriWaveformFile waveformFile;
+	if(!waveformFile.open(waveformFileName) || waveformFile.getNumEvents() != numEntries){
+		printf("Cannot read back waveform file %s. Test will fail.\n", waveformFileName);
+		exit(-1);
+	}
+	std::vector<AraAtriEventView> views(numEntries);
+	for(int event=0; event<numEntries; event++) waveformFile.getEvent(event, views[event]);
+	AraAtriCalibratedBatch viewBatch;
+	calibrator->calibrateEvents(numEntries, &views[0], &viewBatch, AraCalType::kLatestCalib, 4);
+	for(int event=0; event<numEntries; event++){
+		if(views[event].header.eventNumber != rawEvents[event]->eventNumber || views[event].getNumBlocks() != int(rawEvents[event]->blockVec.size())){
+			printf("Event %d: waveform file header differs from the event. Test will fail.\n", event);
+			exit(-1);
+		}
+		for(int ch=0; ch<CHANNELS_PER_ATRI; ch++){
+			int numSamples = batch.getNumSamples(event, ch);
+			if(viewBatch.getNumSamples(event, ch) != numSamples){
+				printf("Event %d, Elec Ch %d: waveform file calibration has %d samples (%d expected). Test will fail.\n",
+					event, ch, viewBatch.getNumSamples(event, ch), numSamples);
+				exit(-1);
+			}
+			if(numSamples==0) continue;
+			if(memcmp(batch.getTimes(event, ch), viewBatch.getTimes(event, ch), numSamples*sizeof(double))
+				|| memcmp(batch.getVolts(event, ch), viewBatch.getVolts(event, ch), numSamples*sizeof(double))){
+				printf("Event %d, Elec Ch %d: waveform file calibration differs from the event one. Test will fail.\n", event, ch);
+				exit(-1);
+			}
+		}
+	}
+	waveformFile.close();
+	remove(waveformFileName);
+
+	// make sure packed waveform rows decode to exactly the samples they were written from
+	waveformWriter.setPackedRows(kTRUE);
+	waveformWriter.open(waveformFileName);
+	for(int event=0; event<numEntries; event++) waveformWriter.addEvent(rawEvents[event]);
+	if(!waveformWriter.close() || !waveformFile.open(waveformFileName) || !waveformFile.hasPackedRows()){
+		printf("Cannot write and read back packed waveform file %s. Test will fail.\n", waveformFileName);
+		exit(-1);
+	}
+	for(int event=0; event<numEntries; event++){
+		AraAtriEventView packedView;
+		if(!waveformFile.getEvent(event, packedView) || packedView.getNumBlocks() != int(rawEvents[event]->blockVec.size())){
+			printf("Event %d: cannot decode packed waveform rows. Test will fail.\n", event);
+			exit(-1);
+		}
+		for(int blk=0; blk<packedView.getNumBlocks(); blk++){
+			const RawAtriStationBlock &block = rawEvents[event]->blockVec[blk];
+			if(memcmp(packedView.blocks[blk].samples, block.samples, block.numChannels*SAMPLES_PER_BLOCK*sizeof(UShort_t))){
+				printf("Event %d, Block %d: packed waveform rows differ from the event. Test will fail.\n", event, blk);
+				exit(-1);
+			}
+		}
+	}
+	waveformFile.close();
+	remove(waveformFileName);
+
+	// make sure pedestal referenced rows stay lossless for samples anywhere in the 16 bit range
+	RawAtriStationEvent extremeEvent(*rawEvents[0]);
+	std::vector<UShort_t> extremePeds(ARA_ATRI_PED_FILE_NUM_PEDS);
+	for(size_t ped=0; ped<extremePeds.size(); ped++) extremePeds[ped] = (ped%2) ? 0xffff : 0;
+	for(size_t blk=0; blk<extremeEvent.blockVec.size(); blk++){
+		RawAtriStationBlock &block = extremeEvent.blockVec[blk];
+		for(int chanIndex=0; chanIndex<block.numChannels; chanIndex++)
+			for(int samp=0; samp<SAMPLES_PER_BLOCK; samp++) block.samples[chanIndex][samp] = (samp%2) ? 0 : 0xffff;
+	}
+	waveformWriter.setPackedRows(kTRUE, &extremePeds[0]);
+	waveformWriter.open(waveformFileName);
+	waveformWriter.addEvent(&extremeEvent);
+	AraAtriEventView extremeView;
+	if(!waveformWriter.close() || !waveformFile.open(waveformFileName) || !waveformFile.getEvent(0, extremeView)
+		|| extremeView.getNumBlocks() != int(extremeEvent.blockVec.size())){
+		printf("Cannot write and read back out of range samples in packed waveform file %s. Test will fail.\n", waveformFileName);
+		exit(-1);
+	}
+	for(int blk=0; blk<extremeView.getNumBlocks(); blk++){
+		const RawAtriStationBlock &block = extremeEvent.blockVec[blk];
+		if(memcmp(extremeView.blocks[blk].samples, block.samples, block.numChannels*SAMPLES_PER_BLOCK*sizeof(UShort_t))){
+			printf("Block %d: packed out of range samples differ from the event. Test will fail.\n", blk);
+			exit(-1);
+		}
+	}
+	waveformFile.close();
+	remove(waveformFileName);
+
+	// make sure the event index finds every event at its entry
+	const char *indexFileName = "fileAndEventCal_events.idx";
+	AraEventIndexFileWriter indexWriter;
+	for(int event=0; event<numEntries; event++) indexWriter.addEvent(rawEvents[event], event);
+	AraEventIndexFile indexFile;
+	if(!indexWriter.write(indexFileName) || !indexFile.open(indexFileName) || indexFile.getNumEntries() != numEntries){
+		printf("Cannot write and read back index file %s. Test will fail.\n", indexFileName);
+		exit(-1);
+	}
+	std::vector<Long64_t> entries;
+	for(int event=0; event<numEntries; event++){
+		Long64_t entry = indexFile.findEventNumber(rawEvents[event]->eventNumber);
+		if(entry<0 || rawEvents[entry]->eventNumber != rawEvents[event]->eventNumber){
+			printf("Event %d: index finds event number %u at entry %lld. Test will fail.\n", event, rawEvents[event]->eventNumber, entry);
+			exit(-1);
+		}
+		indexFile.getEntriesInTimeRange(rawEvents[event]->unixTime, rawEvents[event]->unixTime+1, entries);
+		if(std::find(entries.begin(), entries.end(), Long64_t(event)) == entries.end()){
+			printf("Event %d: index time range misses the event. Test will fail.\n", event);
+			exit(-1);
+		}
+	}
+	remove(indexFileName);
+
+	// make sure the header only mode reads the same headers and none of the blocks
+	if(RawAtriStationEvent::setHeaderOnly(eventTree) == 0){
+		printf("Cannot switch eventTree to header only reading. Test will fail.\n");
+		exit(-1);
+	}
+	rawEvent->blockVec.clear();
+	for(int event=0; event<numEntries; event++){
+		eventTree->GetEntry(event);
+		if(rawEvent->eventNumber != rawEvents[event]->eventNumber || rawEvent->timeStamp != rawEvents[event]->timeStamp
+			|| rawEvent->numReadoutBlocks != rawEvents[event]->numReadoutBlocks || !rawEvent->blockVec.empty()){
+			printf("Event %d: header only reading differs from the whole event. Test will fail.\n", event);
+			exit(-1);
+		}
+	}
+	RawAtriStationEvent::setHeaderOnly(eventTree, kFALSE);
+
+	// make sure compact calibrated events unpack to the calibrated samples, the times to 1e-6 ns and the voltages to float precision
+	for(int event=0; event<numEntries; event++){
+		for(int type=0; type<3; type++){
+			UsefulAtriStationEvent *usefulEvent = new UsefulAtriStationEvent(rawEvents[event], calTypes[type]);
+			AraCompactAtriStationEvent compactEvent(usefulEvent, calTypes[type]);
+			UsefulAtriStationEvent *unpackedEvent = compactEvent.makeUsefulEvent();
+			if(!unpackedEvent || unpackedEvent->eventNumber != rawEvents[event]->eventNumber || !unpackedEvent->blockVec.empty()){
+				printf("Event %d, Cal %d: cannot unpack the compact event. Test will fail.\n", event, calTypes[type]);
+				exit(-1);
+			}
+			for(int ch=0; ch<CHANNELS_PER_ATRI; ch++){
+				int numSamples = usefulEvent->getNumSamplesInElecChan(ch);
+				if(unpackedEvent->getNumSamplesInElecChan(ch) != numSamples){
+					printf("Event %d, Cal %d, Elec Ch %d: compact event has %d samples (%d expected). Test will fail.\n",
+						event, calTypes[type], ch, unpackedEvent->getNumSamplesInElecChan(ch), numSamples);
+					exit(-1);
+				}
+				const double *times = usefulEvent->getTimesFromElecChan(ch);
+				const double *volts = usefulEvent->getVoltsFromElecChan(ch);
+				for(int samp=0; samp<numSamples; samp++){
+					if(TMath::Abs(unpackedEvent->getTimesFromElecChan(ch)[samp] - times[samp]) > 1E-6
+						|| TMath::Abs(unpackedEvent->getVoltsFromElecChan(ch)[samp] - volts[samp]) > 1E-6*(1+TMath::Abs(volts[samp]))){
+						printf("Event %d, Cal %d, Elec Ch %d, Sample %d: compact event differs from the calibrated one. Test will fail.\n", event, calTypes[type], ch, samp);
+						exit(-1);
+					}
+				}
+			}
+			delete usefulEvent;
+			delete unpackedEvent;
+		}
+	}
+
+	// make sure the prefetching reader hands out every event in order, calibrated as it would be in the loop
+	for(int threads=0; threads<3; threads++){
+		AraEventReader reader(4);
+		reader.addFile(argv[1]);
+		reader.setCalibration(AraCalType::kLatestCalib, threads);
+		int event=0;
+		while(reader.next()){
+			if(event>=numEntries || reader.getEntry() != event || reader.getRawEvent()->eventNumber != rawEvents[event]->eventNumber){
+				printf("Reader with %d threads, event %d: events out of order. Test will fail.\n", threads, event);
+				exit(-1);
+			}
+			UsefulAtriStationEvent *usefulEvent = new UsefulAtriStationEvent(rawEvents[event], AraCalType::kLatestCalib);
+			for(int ch=0; ch<CHANNELS_PER_ATRI; ch++){
+				int numSamples = usefulEvent->getNumSamplesInElecChan(ch);
+				if(reader.getUsefulEvent()->getNumSamplesInElecChan(ch) != numSamples
+					|| (numSamples>0 && reader.getUsefulEvent()->getVoltsFromElecChan(ch)[numSamples-1] != usefulEvent->getVoltsFromElecChan(ch)[numSamples-1])){
+					printf("Reader with %d threads, event %d, Elec Ch %d: calibration differs. Test will fail.\n", threads, event, ch);
+					exit(-1);
+				}
+			}
+			delete usefulEvent;
+			event++;
+		}
+		if(event != numEntries){
+			printf("Reader with %d threads read %d events (%d expected). Test will fail.\n", threads, event, numEntries);
+			exit(-1);
+		}
+	}
+
+	// make sure the run processor gives the serial loop's results over more raw files than slots
+	const int numRawFiles = 4;
+	const int eventsPerRawFile = numEntries/numRawFiles;
+	std::vector<std::string> rawFileNames;
+	for(int file=0; file<numRawFiles; file++){
+		char rawFileName[FILENAME_MAX];
+		sprintf(rawFileName, "fileAndEventCal_raw%d.dat.gz", file);
+		rawFileNames.push_back(rawFileName);
+		// a different number of events in each file, so a slot's second file is shorter than its first
+		int numEvents = eventsPerRawFile - 3*file;
+		if(!write_raw_file(rawFileName, &rawEvents[file*eventsPerRawFile], numEvents)){
+			printf("Cannot write raw file %s. Test will fail.\n", rawFileName);
+			exit(-1);
+		}
+	}
+	std::vector<ProcessedEvent> serialEvents;
+	for(int file=0; file<numRawFiles; file++){
+		for(int i=0; i<eventsPerRawFile - 3*file; i++){
+			RawAtriStationEvent *raw = rawEvents[file*eventsPerRawFile+i];
+			UsefulAtriStationEvent *usefulEvent = new UsefulAtriStationEvent(raw, AraCalType::kLatestCalib);
+			ProcessedEvent processed;
+			processed.entry = file*AraRunProcessorBase::kMaxEventsPerRawFile + i;
+			processed.eventNumber = raw->eventNumber;
+			int numSamples = usefulEvent->getNumSamplesInElecChan(0);
+			processed.lastVolts = numSamples>0 ? usefulEvent->getVoltsFromElecChan(0)[numSamples-1] : 0;
+			serialEvents.push_back(processed);
+			delete usefulEvent;
+		}
+	}
+	AraRunProcessor<ProcessedEvents> processor(
+		[](ProcessedEvents &slotEvents, Long64_t entry, RawAtriStationEvent *raw, UsefulAtriStationEvent *usefulEvent) {
+			ProcessedEvent processed;
+			processed.entry = entry;
+			processed.eventNumber = raw->eventNumber;
+			int numSamples = usefulEvent->getNumSamplesInElecChan(0);
+			processed.lastVolts = numSamples>0 ? usefulEvent->getVoltsFromElecChan(0)[numSamples-1] : 0;
+			slotEvents.events.push_back(processed);
+		},
+		[](ProcessedEvents &total, const ProcessedEvents &slotEvents) {
+			total.events.insert(total.events.end(), slotEvents.events.begin(), slotEvents.events.end());
+		},
+		2);
+	for(int file=0; file<numRawFiles; file++) processor.addRawFile(rawFileNames[file].c_str());
+	processor.setCalibration(AraCalType::kLatestCalib);
+	ProcessedEvents processedEvents;
+	if(!processor.run(processedEvents)){
+		printf("Run processor failed on the raw files. Test will fail.\n");
+		exit(-1);
+	}
+	std::sort(processedEvents.events.begin(), processedEvents.events.end());
+	if(processedEvents.events.size() != serialEvents.size()){
+		printf("Run processor gave %d events (%d expected). Test will fail.\n", int(processedEvents.events.size()), int(serialEvents.size()));
+		exit(-1);
+	}
+	for(size_t event=0; event<serialEvents.size(); event++){
+		if(processedEvents.events[event].entry != serialEvents[event].entry
+			|| processedEvents.events[event].eventNumber != serialEvents[event].eventNumber
+			|| processedEvents.events[event].lastVolts != serialEvents[event].lastVolts){
+			printf("Run processor event %d differs from the serial loop. Test will fail.\n", int(event));
+			exit(-1);
+		}
+	}
+	// an unreadable raw file fails the run
+	AraRunProcessor<ProcessedEvents> failingProcessor(
+		[](ProcessedEvents &, Long64_t, RawAtriStationEvent *, UsefulAtriStationEvent *) {},
+		[](ProcessedEvents &, const ProcessedEvents &) {},
+		2);
+	failingProcessor.addRawFile(rawFileNames[0].c_str());
+	failingProcessor.addRawFile("fileAndEventCal_missing.dat.gz");
+	ProcessedEvents failedEvents;
+	if(failingProcessor.run(failedEvents)){
+		printf("Run processor did not report a missing raw file. Test will fail.\n");
+		exit(-1);
+	}
+	// make sure a raw file index reads back what a plain gzread of its file does
+	{
+		const char *rawFileName = rawFileNames[0].c_str();
+		AraPipelineFile plainFile;
+		plainFile.index = 0;
+		plainFile.name = rawFileName;
+		AraRootifierPipelineBase::readFile(&plainFile);
+		std::vector<AraPipelineRecord> records;
+		AraRootifierPipelineBase::splitAtriEventFile(plainFile, records);
+		// a small span, so the file has several access points
+		AraRawFileIndex builtIndex;
+		if(!builtIndex.build(rawFileName, 16384) || builtIndex.getNumAccessPoints() < 2 || !builtIndex.write()){
+			printf("Cannot build the index of raw file %s. Test will fail.\n", rawFileName);
+			exit(-1);
+		}
+		AraRawFileIndex index;
+		if(!index.read(rawFileName) || index.getNumEvents() != int(records.size())){
+			printf("Cannot read back the index of raw file %s. Test will fail.\n", rawFileName);
+			exit(-1);
+		}
+		std::vector<char> data;
+		if(!index.readAll(data, 2) || data != plainFile.data){
+			printf("Raw file index read all of %s differently from gzread. Test will fail.\n", rawFileName);
+			exit(-1);
+		}
+		for(size_t event=0; event<records.size(); event++){
+			std::vector<char> record;
+			if(!index.readEvent(event, record) || record.size() != records[event].length
+				|| memcmp(&record[0], &plainFile.data[records[event].offset], record.size()) != 0){
+				printf("Raw file index event %d differs from the split file. Test will fail.\n", int(event));
+				exit(-1);
+			}
+		}
+		// starting part way through the file, with the index and then without it
+		const int firstEvent = records.size()/2;
+		std::vector<char> expectedData(plainFile.data.begin()+records[firstEvent].offset, plainFile.data.end());
+		for(int withIndex=1; withIndex>=0; withIndex--){
+			if(!withIndex) remove(AraRawFileIndex::getIndexFileName(rawFileName).c_str());
+			AraPipelineFile partFile;
+			partFile.index = 0;
+			partFile.name = rawFileName;
+			if(AraRootifierPipelineBase::readAtriEventFileFrom(&partFile, firstEvent) != Long64_t(records.size()) || partFile.data != expectedData){
+				printf("Reading raw file %s from event %d %s its index is wrong. Test will fail.\n", rawFileName, firstEvent, withIndex ? "with" : "without");
+				exit(-1);
+			}
+		}
+		// an index of an older version of the raw file is not used
+		if(!builtIndex.write()){
+			printf("Cannot write the index of raw file %s. Test will fail.\n", rawFileName);
+			exit(-1);
+		}
+		struct stat rawStat;
+		stat(rawFileName, &rawStat);
+		struct utimbuf times;
+		times.actime = rawStat.st_atime;
+		times.modtime = rawStat.st_mtime+10;
+		utime(rawFileName, &times);
+		if(index.read(rawFileName)){
+			printf("Raw file index was used after its file was modified. Test will fail.\n");
+			exit(-1);
+		}
+		times.modtime = rawStat.st_mtime;
+		utime(rawFileName, &times);
+		FILE *rawFile = fopen(rawFileName, "ab");
+		fputc(0, rawFile);
+		fclose(rawFile);
+		utime(rawFileName, &times);
+		if(index.read(rawFileName)){
+			printf("Raw file index was used after its file changed size. Test will fail.\n");
+			exit(-1);
+		}
+		remove(AraRawFileIndex::getIndexFileName(rawFileName).c_str());
+	}
+	for(int file=0; file<numRawFiles; file++) remove(rawFileNames[file].c_str());
+
+	for(int event=0; event<numEntries; event++) delete rawEvents[event];
+
 
 }
 
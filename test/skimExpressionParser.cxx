@@ -0,0 +1,110 @@
+#include "skimExpression.h"
+
+#include <iostream>
+#include <cstring>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+	Checks the selection expressions of quickSkimFilter on hand made event headers:
+	precedence, every comparison and modifier, number bases, and where malformed expressions fail
+
+*/
+int num_failures = 0;
+
+// compiles text and checks that it selects the event as expected
+void check_expression(const char *text, const AraAtriEventFields &header, bool expected){
+	AraSkimExpression expression;
+	if(!expression.compile(text)){
+		printf("\"%s\" does not compile.\n", text);
+		num_failures++;
+		return;
+	}
+	if(expression.evaluate(header)!=expected){
+		printf("\"%s\" gives %d, expected %d.\n", text, !expected, expected);
+		num_failures++;
+	}
+}
+
+// checks that text does not compile, and fails at the expected character
+void check_malformed(const char *text, int expected_position){
+	AraSkimExpression expression;
+	if(expression.compile(text)){
+		printf("\"%s\" compiles, it should not.\n", text);
+		num_failures++;
+		return;
+	}
+	if(expression.getErrorPosition()!=expected_position){
+		printf("\"%s\" fails at character %d, expected %d.\n", text, expression.getErrorPosition(), expected_position);
+		num_failures++;
+	}
+}
+
+int main(int argc, char **argv){
+
+	AraAtriEventFields header;
+	memset(&header, 0, sizeof(header));
+	header.eventNumber = 1230;
+	header.unixTime = 1356000100;
+	header.numReadoutBlocks = 24;
+	header.triggerInfo[0] = 0;
+	header.triggerInfo[2] = 5;
+	header.stationId = ARA_STATION2;
+	header.timeStamp = 500000; // far from the calpulser time
+
+	// comparisons
+	check_expression("eventNumber == 1230", header, true);
+	check_expression("eventNumber != 1230", header, false);
+	check_expression("eventNumber != 1231", header, true);
+	check_expression("blocks < 24", header, false);
+	check_expression("blocks <= 24", header, true);
+	check_expression("blocks > 23", header, true);
+	check_expression("blocks >= 25", header, false);
+	check_expression("software", header, true);
+	check_expression("rf", header, false);
+	check_expression("calpulser", header, false);
+
+	// modifiers
+	check_expression("eventNumber % 10 == 0", header, true);
+	check_expression("eventNumber % 7 == 5", header, true);
+	check_expression("eventNumber%100!=30", header, false);
+	check_expression("software & 4", header, true);
+	check_expression("software & 2", header, false);
+	check_expression("software & 0x6 == 4", header, true);
+	check_expression("software & 4 && blocks > 20", header, true);
+
+	// numbers are decimal unless they start with 0x, a leading zero is not octal
+	check_expression("blocks == 024", header, true);
+	check_expression("blocks == 0x18", header, true);
+	check_expression("blocks == 0X18", header, true);
+	check_expression("eventNumber == 01230", header, true);
+
+	// ! binds tighter than &&, which binds tighter than ||
+	check_expression("rf || software && blocks == 24", header, true);
+	check_expression("software || rf && blocks == 0", header, true);
+	check_expression("(software || rf) && blocks == 0", header, false);
+	check_expression("!rf && software", header, true);
+	check_expression("!(rf || software)", header, false);
+	check_expression("!!software", header, true);
+	check_expression("time >= 1356000000 && time < 1356003600 && !calpulser", header, true);
+
+	// malformed expressions, and the character they fail at
+	check_malformed("", 0);
+	check_malformed("eventNumber ==", 14);
+	check_malformed("eventNumber == 5 &&", 19);
+	check_malformed("(rf", 3);
+	check_malformed("rf junk", 3);
+	check_malformed("blocks > 5)", 10);
+	check_malformed("eventNumber % 0 == 0", 15);
+	check_malformed("eventNumber % == 0", 14);
+	check_malformed("timeX > 5", 0);
+	check_malformed("blocks == 0x", 11);
+	check_malformed("blocks = 5", 7);
+
+	if(num_failures>0){
+		printf("%d skim expression checks failed.\n", num_failures);
+		return 1;
+	}
+	printf("All skim expression checks passed.\n");
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include "TFile.h"
+#include "TMath.h"
+#include "TTree.h"
+
+#include "RawAtriStationEvent.h"
+#include "UsefulAtriStationEvent.h"
+#include "AraEventCalibrator.h"
+
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+	Global variables to control our expectations for this test
+
+*/
+double max_diff_volts = 1E-9; // allowed difference (mV) between the whole channel and the sample by sample conversion
+int num_samples = 1001; // number of samples per test channel, odd so the scalar tail after the vector part is used as well
+
+int main(int argc, char **argv){
+
+	if(argc<2){
+		std::cout<<"Usage requires input in the form: " << basename(argv[0]) << " <input data file>"<<std::endl;
+		exit(-1);
+	}
+
+	TFile *fpIn = new TFile(argv[1], "READ");
+	if(fpIn->IsZombie()){
+		printf("Cannot open ARA data file (%s). Test will fail.\n",argv[1]);
+		exit(-1);
+	}
+	fpIn->cd();
+	TTree *eventTree = (TTree*) fpIn->Get("eventTree");
+	if(!eventTree){
+		printf("Cannot find eventTree in file (%s). Test will fail.\n",argv[1]);
+		exit(-1);
+	}
+	RawAtriStationEvent *rawEvent = 0;
+	eventTree->SetBranchAddress("event", &rawEvent);
+	eventTree->GetEntry(0);
+
+	// calibrating one event loads the conversion tables of this station
+	UsefulAtriStationEvent *usefulEvent = new UsefulAtriStationEvent(rawEvent, AraCalType::kLatestCalib);
+	delete usefulEvent;
+	AraEventCalibrator *calibrator = AraEventCalibrator::Instance();
+	AraStationId_t stationId = rawEvent->stationId;
+
+	// ADC values covering the low and high ADC fits of both signs, at pseudo random capacitor samples
+	std::vector<double> adc(num_samples);
+	std::vector<int> sampleIndex(num_samples);
+	std::vector<double> volts(num_samples);
+	srand(2000);
+	for(int dda=0; dda<DDA_PER_ATRI; dda++){
+		for(int chan=0; chan<RFCHAN_PER_DDA; chan++){
+			for(int samp=0; samp<num_samples; samp++){
+				adc[samp] = -700. + 1400.*samp/num_samples + 0.5;
+				sampleIndex[samp] = rand()%(BLOCKS_PER_DDA*SAMPLES_PER_BLOCK);
+			}
+			calibrator->convertChanADCtoMilliVolts(num_samples, &adc[0], &sampleIndex[0], dda, chan, stationId, &volts[0]);
+			for(int samp=0; samp<num_samples; samp++){
+				double reference = calibrator->convertADCtoMilliVolts(adc[samp], dda, sampleIndex[samp]/SAMPLES_PER_BLOCK, chan, sampleIndex[samp]%SAMPLES_PER_BLOCK, stationId);
+				if(TMath::Abs(volts[samp]-reference)>max_diff_volts){
+					printf("DDA %d, Chan %d, ADC %.1f: whole channel conversion gives %f mV, sample by sample %f mV. Test will fail.\n",
+						dda, chan, adc[samp], volts[samp], reference);
+					exit(-1);
+				}
+			}
+		}
+	}
+}
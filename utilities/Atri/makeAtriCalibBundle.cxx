@@ -0,0 +1,32 @@
+#include <cstdio>
+#include <iostream>
+#include <libgen.h>     
+#include <stdlib.h>
+
+#include "AraEventCalibrator.h"
+#include "AraAtriCalibBundle.h"
+
+// Compiles the ATRI calibration text files of one station and epoch into the bundle AraEventCalibrator::loadAtriCalib() looks for.
+// The text files are found the same way as when calibrating events, so ARA_CALIB_DIR / ARA_UTIL_INSTALL_DIR apply.
+
+int main(int argc, char **argv) {
+  if(argc<3) {
+    std::cout << "Usage: " << basename(argv[0]) << " <station id> <epoch> [output file]" << std::endl;
+    std::cout << "The default output file is araAtriStation<station id>CalibBundleEpoch<epoch>.bin, copy it to the ATRI calib directory to use it" << std::endl;
+    return -1;
+  }
+  AraStationId_t stationId=atoi(argv[1]);
+  Int_t epoch=atoi(argv[2]);
+  char outName[FILENAME_MAX];
+  if(argc>=4)
+    snprintf(outName,FILENAME_MAX,"%s",argv[3]);
+  else
+    snprintf(outName,FILENAME_MAX,"araAtriStation%iCalibBundleEpoch%i.bin",stationId,epoch);
+
+  AraAtriCalibTables *tables=AraEventCalibrator::Instance()->loadAtriCalibFromText(stationId,epoch);
+  if(!tables) return -1;
+  if(!AraAtriCalibBundle::write(outName,tables)) return -1;
+  std::cout << "Wrote calibration bundle for station " << (int)stationId << " epoch " << epoch << " to " << outName << std::endl;
+  delete tables;
+  return 0;
+}
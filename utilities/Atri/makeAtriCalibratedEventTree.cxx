@@ -4,6 +4,7 @@
 #include <zlib.h>
 #include <libgen.h>     
 #include <cstdlib>
+#include <unistd.h>
  
 
 
@@ -16,6 +17,7 @@
 #include "araAtriStructures.h"
 #include "RawAtriStationEvent.h"  
 #include "UsefulAtriStationEvent.h"  
+#include "AraCompactAtriStationEvent.h"
 
 void process();
 void makeTree(char *inputName, char *outDir);
@@ -26,6 +28,8 @@ TFile *theFile;
 TTree *eventTree;
 RawAtriStationEvent *theEvent=0;
 UsefulAtriStationEvent *theUsefulEvent=0;
+AraCompactAtriStationEvent *theCompactEvent=0;
+int compactOutput=0; //Write AraCompactAtriStationEvent instead of the raw and useful events, -c
 char outName[FILENAME_MAX];
 UInt_t realTime;
 Int_t runNumber;
@@ -33,11 +37,31 @@ Int_t lastRunNumber;
 
 using namespace std;
 
+void usage(char *progName) {
+  std::cout << "Usage: " << basename(progName) << " [-c] <file list> <out dir> [run number]" << std::endl;
+  std::cout << "  -c  write compact calibrated events, see AraCompactAtriStationEvent, without the raw events" << std::endl;
+}
+
 int main(int argc, char **argv) {
+  int opt;
+  while((opt=getopt(argc,argv,"c"))!=-1) {
+    switch(opt) {
+    case 'c':
+      compactOutput=1;
+      break;
+    default:
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  //Shift the positional arguments down so they keep their old numbering
+  argv[optind-1]=argv[0];
+  argc-=optind-1;
+  argv+=optind-1;
   dataBuffer = new char[200000];
   theEvent=0;
   if(argc<3) {
-    std::cout << "Usage: " << basename(argv[0]) << " <file list> <out dir>" << std::endl;
+    usage(argv[0]);
     return -1;
   }
   if(argc==4) 
@@ -134,8 +158,14 @@ void process() {
     theFile = new TFile(outName,"RECREATE");
     eventTree = new TTree("eventTree","Tree of ARA Event's");
     eventTree->Branch("run",&runNumber,"run/I");
-    eventTree->Branch("event","RawAtriStationEvent",&theEvent);
-    eventTree->Branch("calevent","UsefulAtriStationEvent",&theUsefulEvent);
+    if(compactOutput) {
+      theCompactEvent = new AraCompactAtriStationEvent();
+      eventTree->Branch("compact","AraCompactAtriStationEvent",&theCompactEvent);
+    }
+    else {
+      eventTree->Branch("event","RawAtriStationEvent",&theEvent);
+      eventTree->Branch("calevent","UsefulAtriStationEvent",&theUsefulEvent);
+    }
     
     doneInit=1;
   }  
@@ -145,6 +175,8 @@ void process() {
   
   theEvent = new RawAtriStationEvent(&theEventHeader,dataBuffer);
   theUsefulEvent = new UsefulAtriStationEvent(theEvent, AraCalType::kLatestCalib);
+  if(compactOutput)
+    theCompactEvent->pack(theUsefulEvent, AraCalType::kLatestCalib);
   
   eventTree->Fill();  
   lastRunNumber=runNumber;
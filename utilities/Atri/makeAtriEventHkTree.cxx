@@ -4,6 +4,10 @@
 #include <zlib.h>
 #include <libgen.h>     
 #include <stdlib.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
  
 using namespace std;
 
@@ -16,12 +20,14 @@ using namespace std;
 #include "AraGeomTool.h"
 #include "araAtriStructures.h"
 #include "AtriEventHkData.h"  
+#include "AraRootifierPipeline.h"
 
-void processHk(Int_t newFormat);
+Bool_t splitHkFile(AraPipelineFile &file, std::vector<AraPipelineRecord> &records);
+AtriEventHkData *buildHk(const char *record, size_t length);
+void startHkFile(const AraPipelineFile &file);
+void processHk(AtriEventHkData *eventHk);
 void makeHkTree(char *inputName, char *outDir);
 
-AraEventHk_t theEventHkStruct;
-AraEventHk2_7_t theEventHkStruct_2_7;
 TFile *theFile;
 TTree *eventHkTree;
 AtriEventHkData *theEventHk=0;
@@ -58,154 +64,139 @@ void makeHkTree(char *inputName, char *outFile) {
   //    cout << sizeof(AraEventHk_t) << endl;
   ifstream SillyFile(inputName);
 
-  int numBytes=0;
+  std::vector<std::string> fileNames;
   char fileName[180];
-  int error=0;
-  //    int eventNumber=1;
-  int counter=0;
-  while(SillyFile >> fileName) {
-    if(counter%100==0) 
-      cout << fileName << endl;
-    counter++;
-    
-    //    const char *subDir = gSystem->DirName(fileName);
-    //    const char *subSubDir = gSystem->DirName(subDir);
-    //    const char *eventDir = gSystem->DirName(subSubDir);
-    //    const char *runDir = gSystem->DirName(eventDir);
-    //    const char *justRun = gSystem->BaseName(runDir);
-    //	cout << justRun << endl;
-    //    sscanf(justRun,"run%d",&runNumber);
-    
+  while(SillyFile >> fileName)
+    fileNames.push_back(fileName);
+
+  AraRootifierPipeline<AtriEventHkData> pipeline(splitHkFile,buildHk,processHk);
+  pipeline.setFileStarter(startHkFile);
+  if(!pipeline.run(fileNames)) {
+    std::cout << "Broken file -- giving up\n";
+    return;
+  }
+  pipeline.printStats();
 
+  if(eventHkTree)
+    eventHkTree->AutoSave();
+  //    theFile->Close();
+}
 
 
-    AtriGenericHeader_t theGenericHeader;
-    gzFile infile = gzopen (fileName, "rb");    
-    numBytes=gzread(infile, &theGenericHeader, sizeof(AtriGenericHeader_t));
-    //    fprintf(stderr, "read %i bytes\n", numBytes);
-    //    fprintf(stderr, "typeId %i verId %i subVerId %i\n", theGenericHeader.typeId, theGenericHeader.verId, theGenericHeader.subVerId);
-    //    fprintf(stderr, "numBytes %i checksum %i numBytes(2_7) %lu numBytes(new) %lu genericHeaderSize %lu\n", theGenericHeader.numBytes, theGenericHeader.checksum,sizeof(AraEventHk2_7_t), sizeof(AraEventHk_t), sizeof(AtriGenericHeader_t) );
-    
+//Reads the generic header at upto into theGenericHeader, returns the number of bytes read
+size_t readGenericHeader(const AraPipelineFile &file, size_t &upto, AtriGenericHeader_t &theGenericHeader) {
+  size_t numBytes=std::min(file.data.size()-upto,sizeof(AtriGenericHeader_t));
+  memcpy(&theGenericHeader,file.data.data()+upto,numBytes);
+  upto+=numBytes;
+  return numBytes;
+}
 
-    if(theGenericHeader.verId>2){
-      newHkFormat=1;      
+
+//Skips the body of the hk whose generic header has just been read
+void skipHkBody(const AraPipelineFile &file, size_t &upto, const AtriGenericHeader_t &theGenericHeader) {
+  size_t numBodyBytes=file.data.size()-upto;
+  if(theGenericHeader.numBytes>=sizeof(AtriGenericHeader_t))
+    numBodyBytes=std::min(numBodyBytes,size_t(theGenericHeader.numBytes-sizeof(AtriGenericHeader_t)));
+  upto+=numBodyBytes;
+}
+
+
+//Event hk files hold either AraEventHk_t or the older AraEventHk2_7_t, chosen from the version of the
+//first generic header and then checked against the numBytes of the first few headers
+Bool_t splitHkFile(AraPipelineFile &file, std::vector<AraPipelineRecord> &records) {
+  size_t upto=0;
+  size_t numBytes;
+  AtriGenericHeader_t theGenericHeader;
+  memset(&theGenericHeader,0,sizeof(AtriGenericHeader_t));
+  readGenericHeader(file,upto,theGenericHeader);
+  //    fprintf(stderr, "typeId %i verId %i subVerId %i\n", theGenericHeader.typeId, theGenericHeader.verId, theGenericHeader.subVerId);
+  //    fprintf(stderr, "numBytes %i checksum %i numBytes(2_7) %lu numBytes(new) %lu genericHeaderSize %lu\n", theGenericHeader.numBytes, theGenericHeader.checksum,sizeof(AraEventHk2_7_t), sizeof(AraEventHk_t), sizeof(AtriGenericHeader_t) );
+
+  if(theGenericHeader.verId>2){
+    newHkFormat=1;      
+  }
+  else if(theGenericHeader.verId==2 && theGenericHeader.subVerId >7){
+    newHkFormat=1;      
+  }
+  else{
+    newHkFormat=0;      
+  }
+  int loopCount=0;
+  while(newHkFormat && theGenericHeader.numBytes != sizeof(AraEventHk_t)){
+    fprintf(stderr, "error - wrong numBytes (%d) for newHkFormat (%lu) oldFormat (%lu)\n", theGenericHeader.numBytes, sizeof(AraEventHk_t), sizeof(AraEventHk2_7_t));
+    if(theGenericHeader.numBytes==0) theGenericHeader.numBytes=sizeof(AraEventHk2_7_t);
+
+    skipHkBody(file,upto,theGenericHeader);
+    numBytes=readGenericHeader(file,upto,theGenericHeader);
+    if(numBytes!=sizeof(AtriGenericHeader_t)) break;
+
+    if(theGenericHeader.numBytes == sizeof(AraEventHk2_7_t)){ 
+      newHkFormat=0;
+      fprintf(stderr, "Forcing event format to AraEventHk2_7_t\n");
     }
-    else if(theGenericHeader.verId==2 && theGenericHeader.subVerId >7){
-      newHkFormat=1;      
+    loopCount++;
+    if(loopCount>10) break;
+  }        
+  while(newHkFormat==0 && theGenericHeader.numBytes != sizeof(AraEventHk2_7_t)){
+    fprintf(stderr, "error - wrong numBytes (%d) for oldHkFormat (%lu) new format (%lu)\n", theGenericHeader.numBytes, sizeof(AraEventHk2_7_t), sizeof(AraEventHk_t));
+    if(theGenericHeader.numBytes==0) theGenericHeader.numBytes=sizeof(AraEventHk_t);
+
+    skipHkBody(file,upto,theGenericHeader);
+    numBytes=readGenericHeader(file,upto,theGenericHeader);
+    if(numBytes!=sizeof(AtriGenericHeader_t)) break;
+
+    if(theGenericHeader.numBytes == sizeof(AraEventHk_t)){
+      newHkFormat=1;
+      fprintf(stderr, "Forcing event format to AraEventHk_t\n");
     }
-    else{
-      newHkFormat=0;      
+    loopCount++;
+    if(loopCount>10) break;
+  }
+
+  if(loopCount>=10)
+    return kFALSE;
+
+  //The hks themselves are read from the start of the file again
+  const size_t hkSize=newHkFormat ? sizeof(AraEventHk_t) : sizeof(AraEventHk2_7_t);
+  upto=0;
+  for(int i=0;i<1000;i++) {	
+    numBytes=file.data.size()-upto;
+    if(numBytes==0) break;
+    if(numBytes<hkSize) {
+      cerr << "Read problem: " <<numBytes << " of " << hkSize << endl;
+      break;
     }
-    int loopCount=0;
-    while(newHkFormat && theGenericHeader.numBytes != sizeof(AraEventHk_t)){
-      fprintf(stderr, "error - wrong numBytes (%d) for newHkFormat (%lu) oldFormat (%lu)\n", theGenericHeader.numBytes, sizeof(AraEventHk_t), sizeof(AraEventHk2_7_t));
-      if(theGenericHeader.numBytes==0) theGenericHeader.numBytes=sizeof(AraEventHk2_7_t);
-      
-
-      numBytes = gzread(infile, &theEventHkStruct, theGenericHeader.numBytes-sizeof(AtriGenericHeader_t));
-      numBytes = gzread(infile, &theGenericHeader, sizeof(AtriGenericHeader_t));
-      if(numBytes!=sizeof(AtriGenericHeader_t)) break;
-      // fprintf(stderr, "read %i bytes\n", numBytes);
-      // fprintf(stderr, "typeId %i verId %i subVerId %i\n", theGenericHeader.typeId, theGenericHeader.verId, theGenericHeader.subVerId);
-      // fprintf(stderr, "numBytes %i checksum %i numBytes(2_7) %lu numBytes(new) %lu genericHeaderSize %lu\n", theGenericHeader.numBytes, theGenericHeader.checksum,sizeof(AraEventHk2_7_t), sizeof(AraEventHk_t), sizeof(AtriGenericHeader_t) );
-      
-      if(theGenericHeader.numBytes == sizeof(AraEventHk2_7_t)){ 
-	newHkFormat=0;
-	fprintf(stderr, "Forcing event format to AraEventHk2_7_t\n");
-      }
-      loopCount++;
-      if(loopCount>10) break;
-    }        
-    //      newHkFormat=0;    
-    while(newHkFormat==0 && theGenericHeader.numBytes != sizeof(AraEventHk2_7_t)){
-      fprintf(stderr, "error - wrong numBytes (%d) for oldHkFormat (%lu) new format (%lu)\n", theGenericHeader.numBytes, sizeof(AraEventHk2_7_t), sizeof(AraEventHk_t));
-      if(theGenericHeader.numBytes==0) theGenericHeader.numBytes=sizeof(AraEventHk_t);
-
-      numBytes = gzread(infile, &theEventHkStruct, theGenericHeader.numBytes-sizeof(AtriGenericHeader_t));
-      numBytes = gzread(infile, &theGenericHeader, sizeof(AtriGenericHeader_t));
-      if(numBytes!=sizeof(AtriGenericHeader_t)) break;
-      // fprintf(stderr, "read %i bytes\n", numBytes);
-      // fprintf(stderr, "typeId %i verId %i subVerId %i\n", theGenericHeader.typeId, theGenericHeader.verId, theGenericHeader.subVerId);
-      // fprintf(stderr, "numBytes %i checksum %i numBytes(2_7) %lu numBytes(new) %lu genericHeaderSize %lu\n", theGenericHeader.numBytes, theGenericHeader.checksum,sizeof(AraEventHk2_7_t), sizeof(AraEventHk_t), sizeof(AtriGenericHeader_t) );
-
-      if(theGenericHeader.numBytes == sizeof(AraEventHk_t)){
-	newHkFormat=1;
-	fprintf(stderr, "Forcing event format to AraEventHk_t\n");
-      }
-
-      //      fprintf(stderr, "Forcing event format to AraEventHk_t\n");
-      //      newHkFormat=1;
-      loopCount++;
-      if(loopCount>10) break;
+    //The station id is only overridden for the new format, as it always has been
+    if(newHkFormat && stationIdInt!=0) {
+      AraEventHk_t theEventHkStruct;
+      memcpy(&theEventHkStruct,&file.data[upto],sizeof(AraEventHk_t));
+      theEventHkStruct.gHdr.stationId=stationId;
+      memcpy(&file.data[upto],&theEventHkStruct,sizeof(AraEventHk_t));
     }
+    AraPipelineRecord record;
+    record.offset=upto;
+    record.length=hkSize;
+    records.push_back(record);
+    upto+=hkSize;
+  }
+  return kTRUE;
+}
 
-    
-    gzclose(infile);
 
-    infile = gzopen (fileName, "rb");    
-    //    std::cout << "gzeof: " << gzeof(infile) << "\n";
+AtriEventHkData *buildHk(const char *record, size_t length) {
+  if(length==sizeof(AraEventHk_t))
+    return new AtriEventHkData((AraEventHk_t*)record);
+  return new AtriEventHkData((AraEventHk2_7_t*)record);
+}
 
-    if(loopCount>=10) {
-      std::cout << "Broken file -- giving up\n";
-      return;
-    }
 
-    if(newHkFormat){
-      for(int i=0;i<1000;i++) {	
-	//      cout << i << endl;
-	numBytes=gzread(infile,&theEventHkStruct,sizeof(AraEventHk_t));
-	//      std::cout << numBytes << "\n";
-	// fprintf(stderr, "read %i bytes\n", numBytes);
-	//	fprintf(stderr, "verId %i subVerId %i\n", theEventHkStruct.gHdr.verId, theEventHkStruct.gHdr.subVerId);
-
-	if(stationIdInt!=0)
-	   theEventHkStruct.gHdr.stationId=stationId;
-
-	if(numBytes==0) break;
-	if(numBytes!=sizeof(AraEventHk_t)) {
-	  if(numBytes)
-	    cerr << "Read problem: " <<numBytes << " of " << sizeof(AraEventHk_t) << endl;
-	error=1;
-	break;
-	}
-	//      cout << "Hk: " << theEventHkStruct.gHdr.unixTime << endl;
-	processHk(1);
-      }
-    }//newHkFormat
-    else{
-      for(int i=0;i<1000;i++) {	
-	//      cout << i << endl;
-	numBytes=gzread(infile,&theEventHkStruct_2_7,sizeof(AraEventHk2_7_t));
-	//      std::cout << numBytes << "\n";
-	
-	// fprintf(stderr, "read %i bytes\n", numBytes);
-	//	fprintf(stderr, "verId %i subVerId %i\n", theEventHkStruct_2_7.gHdr.verId, theEventHkStruct_2_7.gHdr.subVerId);
-	
-	if(stationIdInt!=0)
-	   theEventHkStruct.gHdr.stationId=stationId;
-
-	if(numBytes==0) break;
-	if(numBytes!=sizeof(AraEventHk2_7_t)) {
-	  if(numBytes)
-	    cerr << "Read problem: " <<numBytes << " of " << sizeof(AraEventHk2_7_t) << endl;
-	  error=1;
-	  break;
-	}
-	//      cout << "Hk: " << theEventHkStruct.unixTime << endl;
-	processHk(0);
-      }
-    }//OldHkFormat
-
-    gzclose(infile);
-    //	if(error) break;
-  }
-  if(eventHkTree)
-    eventHkTree->AutoSave();
-  //    theFile->Close();
+void startHkFile(const AraPipelineFile &file) {
+  if(file.index%100==0) 
+    cout << file.name << endl;
 }
 
 
-void processHk(Int_t newFormat) {
+void processHk(AtriEventHkData *eventHk) {
   //  cout << "processHk:\t" << theEventHkStruct.eventNumber << endl;
   static int doneInit=0;
   
@@ -224,20 +215,9 @@ void processHk(Int_t newFormat) {
     doneInit=1;
   }  
   //  cout << "Here: "  << theEventHk.eventNumber << endl;
-
-  if(newFormat){
-
-    if(theEventHk) delete theEventHk;
-    theEventHk = new AtriEventHkData(&theEventHkStruct);
-    eventHkTree->Fill();  
-    lastRunNumber=runNumber;
-    //  delete theEventHk;
-  }//newFormat
-  else{
-
-    if(theEventHk) delete theEventHk;
-    theEventHk = new AtriEventHkData(&theEventHkStruct_2_7);
-    eventHkTree->Fill();  
-    lastRunNumber=runNumber;
-  }//Old Format
+  if(theEventHk) delete theEventHk;
+  theEventHk = eventHk;
+  eventHkTree->Fill();  
+  lastRunNumber=runNumber;
+  //  delete theEventHk;
 }
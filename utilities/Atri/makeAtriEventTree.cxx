@@ -4,6 +4,11 @@
 #include <zlib.h>
 #include <libgen.h>     
 #include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <algorithm>
  
 using namespace std;
 
@@ -16,13 +21,17 @@ using namespace std;
 #include "AraGeomTool.h"
 #include "araAtriStructures.h"
 #include "RawAtriStationEvent.h"  
+#include "AraRootifierPipeline.h"
+#include "AraAtriWaveformFile.h"
+#include "AraEventIndexFile.h"
+#include "AraAtriPedestalFile.h"
 
-void process();
+Bool_t splitEventFile(AraPipelineFile &file, std::vector<AraPipelineRecord> &records);
+RawAtriStationEvent *buildEvent(const char *record, size_t length);
+void startEventFile(const AraPipelineFile &file);
+void fillEvent(RawAtriStationEvent *event);
 void makeTree(char *inputName, char *outDir);
 
-AraStationEventHeader_t theEventHeader;
-
-char *dataBuffer;
 TFile *theFile;
 TTree *eventTree;
 RawAtriStationEvent *theEvent=0;
@@ -32,12 +41,73 @@ Int_t runNumber;
 //Int_t lastRunNumber;
 Int_t stationIdInt;
 AraStationId_t stationId;
+int numThreads=1; //Build threads, -j
+int numReadThreads=1; //Threads inflating each raw file, -i
+const char *rawIndexDir=0; //Where new raw file indices are written, -d
+Long64_t firstEvent=0; //Events of the file list skipped, -f
+int sortByEventNumber=0; //Fill in event number order rather than file list order, -s
+std::vector<RawAtriStationEvent*> sortedEvents;
+AraAtriWaveformFileWriter *waveformWriter=0; //Also writes the events to a waveform file, -w
+AraEventIndexFileWriter indexWriter; //The event index written next to the tree
+
+void usage(char *progName) {
+  std::cout << "Usage: " << basename(progName) << " [-j <threads>] [-i <threads> [-d <index dir>]] [-f <first event>] [-s] [-w <waveform file> [-z] [-p <ped file>]] <file list> <out dir> [run number] [station id]" << std::endl;
+  std::cout << "  -j <threads>  build the events of this many raw files at once, the output is the same as with one thread" << std::endl;
+  std::cout << "  -i <threads>  inflate each raw file on this many threads, using the .zidx index next to it, see makeAtriRawFileIndex" << std::endl;
+  std::cout << "  -d <dir>      read the .zidx indices from this directory instead, writing any that are missing" << std::endl;
+  std::cout << "  -f <event>    skip the events of the file list before this one, e.g. to convert the rest of a run whose" << std::endl;
+  std::cout << "                conversion stopped part way into a second tree. With .zidx indices they are not inflated" << std::endl;
+  std::cout << "  -s            write the events in event number order, holds the whole run in memory" << std::endl;
+  std::cout << "  -w <file>     also write the events to a memory mappable waveform file, see AraAtriWaveformFile" << std::endl;
+  std::cout << "  -z            pack the waveform file rows, lossless and decoded when read" << std::endl;
+  std::cout << "  -p <file>     pack the rows as differences from these pedestals, a binary pedestal file needs the station id" << std::endl;
+  std::cout << "The event index of the tree is written to <out file> with .root replaced by .idx, see AraEventIndexFile" << std::endl;
+}
 
 int main(int argc, char **argv) {
-  dataBuffer = new char[200000];
+  int opt;
+  const char *waveformFile=0;
+  const char *pedFile=0;
+  int packRows=0;
+  while((opt=getopt(argc,argv,"j:i:d:f:sw:zp:"))!=-1) {
+    switch(opt) {
+    case 'j':
+      numThreads=atoi(optarg);
+      break;
+    case 'i':
+      numReadThreads=atoi(optarg);
+      break;
+    case 'd':
+      rawIndexDir=optarg;
+      break;
+    case 'f':
+      firstEvent=atoll(optarg);
+      break;
+    case 's':
+      sortByEventNumber=1;
+      break;
+    case 'w':
+      waveformFile=optarg;
+      break;
+    case 'z':
+      packRows=1;
+      break;
+    case 'p':
+      pedFile=optarg;
+      packRows=1;
+      break;
+    default:
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  //Shift the positional arguments down so they keep their old numbering
+  argv[optind-1]=argv[0];
+  argc-=optind-1;
+  argv+=optind-1;
   theEvent=0;
-  if(argc<3) {
-    std::cout << "Usage: " << basename(argv[0]) << " <file list> <out dir>" << std::endl;
+  if(argc<3 || numThreads<1) {
+    usage(argv[0]);
     return -1;
   }
   if(argc>=4) 
@@ -48,8 +118,36 @@ int main(int argc, char **argv) {
   }
   //  std::cout << argc << "\t" << stationIdInt << "\t" << (int)stationId << "\n";
 
+  if(waveformFile) {
+    waveformWriter = new AraAtriWaveformFileWriter();
+    std::vector<UShort_t> peds;
+    if(pedFile && AraAtriPedestalFile::isBinary(pedFile)) {
+      void *mapBase=0;
+      size_t mapLength=0;
+      const UShort_t *mappedPeds = argc>=5 ? AraAtriPedestalFile::mapBinary(pedFile,stationId,mapBase,mapLength) : 0;
+      if(!mappedPeds) {
+	std::cerr << "Can't use binary pedestal file " << pedFile << " without its station id\n";
+	return -1;
+      }
+      peds.assign(mappedPeds,mappedPeds+ARA_ATRI_PED_FILE_NUM_PEDS);
+      AraAtriPedestalFile::unmapBinary(mapBase,mapLength);
+    }
+    else if(pedFile && AraAtriPedestalFile::readText(pedFile,peds)<=0) {
+      std::cerr << "Can't read pedestal file " << pedFile << "\n";
+      return -1;
+    }
+    waveformWriter->setPackedRows(packRows,peds.empty() ? 0 : peds.data());
+    if(!waveformWriter->open(waveformFile))
+      return -1;
+  }
+
   makeTree(argv[1],argv[2]);
-  delete [] dataBuffer;
+
+  if(waveformWriter) {
+    if(!waveformWriter->close())
+      return -1;
+    delete waveformWriter;
+  }
   return 0;
 }
   
@@ -61,79 +159,70 @@ void makeTree(char *inputName, char *outFile) {
   //    cout << sizeof(AraStationEventHeader_t) << endl;
   ifstream SillyFile(inputName);
 
-  int numBytes=0;
+  std::vector<std::string> fileNames;
   char fileName[180];
-  int error=0;
-  //    int eventNumber=1;
-  int counter=0;
-  while(SillyFile >> fileName) {
-    if(counter%100==0) 
-      cout << fileName << endl;
-    counter++;
-    
-    //    const char *subDir = gSystem->DirName(fileName);
-    //    const char *subSubDir = gSystem->DirName(subDir);
-    //    const char *eventDir = gSystem->DirName(subSubDir);
-    //    const char *runDir = gSystem->DirName(eventDir);
-    //    const char *justRun = gSystem->BaseName(runDir);
-    //	cout << justRun << endl;
-    //    sscanf(justRun,"run%d",&runNumber);
-    
-    gzFile infile = gzopen (fileName, "rb");    
-    //    std::cout << "gzeof: " << gzeof(infile) << "\n";
-    for(int i=0;i<1000;i++) {	
-      //      cout << i << endl;
-      numBytes=gzread(infile,&theEventHeader,sizeof(AraStationEventHeader_t));
-      //      std::cout << numBytes << "\n";
-      if(numBytes==0) break;
-      if(numBytes!=sizeof(AraStationEventHeader_t)) {
-	if(numBytes)
-	  cerr << "Read problem: " <<numBytes << " of " << sizeof(AraStationEventHeader_t) << endl;
-	error=1;
-	break;
-      }
-      if(stationIdInt!=0)
-	 theEventHeader.gHdr.stationId=stationId;
-      
-      //      std::cout << (int)theEventHeader.gHdr.stationId << "\t" << (int)stationId << "\n";
-
-      if(theEventHeader.gHdr.numBytes>0) {
-	//	std::cout << "Num bytes: " << theEventHeader.gHdr.numBytes << "\t" << theEventHeader.numBytes << "\n";
-	//	std::cout << "Event number: " << theEventHeader.eventNumber << "\t" << theEventHeader.unixTime << "\t" << theEventHeader.unixTimeUs << "\n";
-	
-	
-	Int_t numDataBytes=theEventHeader.gHdr.numBytes-sizeof(AraStationEventHeader_t);
-	numBytes=gzread(infile,dataBuffer,numDataBytes);
-	//	std::cout << numBytes << "\n";
-	if(numBytes==0) break;
-	if(numBytes!=numDataBytes) {
-	  if(numBytes)
-	    cerr << "Read problem: " <<numBytes << " of " <<  numDataBytes << endl;
-	  error=1;
-	  break;
-	}
-	process();
-     	//	exit(0);
-      }
-      else {
-	std::cerr << "How can gHdr.numBytes = " << theEventHeader.gHdr.numBytes << "\n";
-	error=1;
-	break;
-      }
+  while(SillyFile >> fileName)
+    fileNames.push_back(fileName);
 
-      //      cout << ": " << theEventHeader.unixTime << endl;
-     }
-    gzclose(infile);
-    //	if(error) break;
+  //The files are read, split into events, built into RawAtriStationEvent and filled on separate threads.
+  //The tree gets the events in file list order whatever the number of build threads.
+  AraRootifierPipeline<RawAtriStationEvent> pipeline(splitEventFile,buildEvent,fillEvent,numThreads);
+  pipeline.setFileStarter(startEventFile);
+  pipeline.setReadThreads(numReadThreads,rawIndexDir);
+  pipeline.setFirstEvent(firstEvent);
+  pipeline.run(fileNames);
+
+  if(sortByEventNumber) {
+    std::stable_sort(sortedEvents.begin(),sortedEvents.end(),[](const RawAtriStationEvent *a, const RawAtriStationEvent *b) {
+	return a->eventNumber<b->eventNumber;
+      });
+    sortByEventNumber=0;
+    for(size_t i=0;i<sortedEvents.size();i++)
+      fillEvent(sortedEvents[i]);
+    sortedEvents.clear();
   }
-  if(eventTree)
+  pipeline.printStats();
+
+  if(eventTree) {
     eventTree->AutoSave();
+    indexWriter.write(AraEventIndexFile::getIndexFileName(outName).c_str());
+  }
   //    theFile->Close();
 }
 
 
-void process() {
-  //  cout << "process:\t" << theEventHeader.eventNumber << endl;
+//Finds the events of one raw file, patching in the station id if it is overridden
+Bool_t splitEventFile(AraPipelineFile &file, std::vector<AraPipelineRecord> &records) {
+  AraRootifierPipelineBase::splitAtriEventFile(file,records);
+  if(stationIdInt!=0) {
+    for(size_t i=0;i<records.size();i++) {
+      AraStationEventHeader_t theEventHeader;
+      memcpy(&theEventHeader,&file.data[records[i].offset],sizeof(AraStationEventHeader_t));
+      theEventHeader.gHdr.stationId=stationId;
+      memcpy(&file.data[records[i].offset],&theEventHeader,sizeof(AraStationEventHeader_t));
+    }
+  }
+  return kTRUE;
+}
+
+
+RawAtriStationEvent *buildEvent(const char *record, size_t length) {
+  return new RawAtriStationEvent((AraStationEventHeader_t*)record,(char*)record+sizeof(AraStationEventHeader_t));
+}
+
+
+void startEventFile(const AraPipelineFile &file) {
+  if(file.index%100==0) 
+    cout << file.name << endl;
+}
+
+
+//Fills the tree with event, which the tree then owns until the next event
+void fillEvent(RawAtriStationEvent *event) {
+  if(sortByEventNumber) {
+    sortedEvents.push_back(event);
+    return;
+  }
   static int doneInit=0;
   if(!doneInit) {
     //    char dirName[FILENAME_MAX];
@@ -152,8 +241,11 @@ void process() {
   //  cout << "Here: "  << theEvent.eventNumber << endl;
   if(theEvent) delete theEvent;
   
-  theEvent = new RawAtriStationEvent(&theEventHeader,dataBuffer);
+  theEvent = event;
   eventTree->Fill();  
+  indexWriter.addEvent(theEvent,eventTree->GetEntries()-1);
+  if(waveformWriter)
+    waveformWriter->addEvent(theEvent);
   //  lastRunNumber=runNumber;
   //  delete theEvent;
 }
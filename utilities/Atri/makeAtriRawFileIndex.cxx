@@ -0,0 +1,87 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <libgen.h>
+#include <cstdlib>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+
+#include "AraRawFileIndex.h"
+
+using namespace std;
+
+void usage(char *progName) {
+  std::cout << "Usage: " << basename(progName) << " [-j <threads>] [-s <span kB>] [-d <index dir>] [-f] <file list>" << std::endl;
+  std::cout << "  Writes the random access index of each raw event file next to it, as <raw file>.zidx, see AraRawFileIndex" << std::endl;
+  std::cout << "  -d <dir>      write the indices to this directory instead" << std::endl;
+  std::cout << "  -j <threads>  index this many files at once" << std::endl;
+  std::cout << "  -s <span kB>  inflated kB between access points, default 1024" << std::endl;
+  std::cout << "  -f            rebuild indices that are already up to date" << std::endl;
+}
+
+int main(int argc, char **argv) {
+  int opt;
+  int numThreads=1; //Files indexed at once, -j
+  ULong64_t span=1048576; //-s
+  const char *indexDir=0; //-d
+  int force=0; //-f
+  while((opt=getopt(argc,argv,"j:s:d:f"))!=-1) {
+    switch(opt) {
+    case 'j':
+      numThreads=atoi(optarg);
+      break;
+    case 's':
+      span=1024ULL*atoi(optarg);
+      break;
+    case 'd':
+      indexDir=optarg;
+      break;
+    case 'f':
+      force=1;
+      break;
+    default:
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if(argc-optind<1 || numThreads<1 || span==0) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  ifstream SillyFile(argv[optind]);
+  std::vector<std::string> fileNames;
+  char fileName[FILENAME_MAX];
+  while(SillyFile >> fileName)
+    fileNames.push_back(fileName);
+
+  //Each thread takes the next file from the list
+  std::atomic<size_t> nextFile(0);
+  std::atomic<int> numFailed(0);
+  auto indexFiles=[&]() {
+    for(size_t i=nextFile++;i<fileNames.size();i=nextFile++) {
+      AraRawFileIndex index;
+      std::string indexFileName=AraRawFileIndex::getIndexFileName(fileNames[i].c_str(),indexDir);
+      if(!force && index.read(fileNames[i].c_str(),indexFileName.c_str())) continue;
+      if(!index.build(fileNames[i].c_str(),span) || !index.write(indexFileName.c_str())) {
+	numFailed++;
+	continue;
+      }
+      if(i%100==0)
+	printf("%s: %d events, %d access points\n", fileNames[i].c_str(), index.getNumEvents(), index.getNumAccessPoints());
+    }
+  };
+  std::vector<std::thread> threads;
+  for(int i=1;i<numThreads;i++) threads.push_back(std::thread(indexFiles));
+  indexFiles();
+  for(size_t i=0;i<threads.size();i++) threads[i].join();
+
+  if(numFailed.load()) {
+    std::cerr << numFailed.load() << " of " << fileNames.size() << " files could not be indexed\n";
+    return -1;
+  }
+  return 0;
+}
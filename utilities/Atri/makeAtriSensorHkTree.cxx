@@ -4,6 +4,9 @@
 #include <zlib.h>
 #include <libgen.h>     
 #include <stdlib.h>
+#include <cstring>
+#include <string>
+#include <vector>
  
 using namespace std;
 
@@ -16,11 +19,14 @@ using namespace std;
 #include "AraGeomTool.h"
 #include "araAtriStructures.h"
 #include "AtriSensorHkData.h"  
+#include "AraRootifierPipeline.h"
 
-void processHk();
+Bool_t splitHkFile(AraPipelineFile &file, std::vector<AraPipelineRecord> &records);
+AtriSensorHkData *buildHk(const char *record, size_t length);
+void startHkFile(const AraPipelineFile &file);
+void processHk(AtriSensorHkData *sensorHk);
 void makeHkTree(char *inputName, char *outDir);
 
-AraSensorHk_t theSensorHkStruct;
 TFile *theFile;
 TTree *sensorHkTree;
 AtriSensorHkData *theSensorHk=0;
@@ -55,56 +61,60 @@ void makeHkTree(char *inputName, char *outFile) {
   //    cout << sizeof(AraSensorHk_t) << endl;
   ifstream SillyFile(inputName);
 
-  int numBytes=0;
+  std::vector<std::string> fileNames;
   char fileName[180];
-  int error=0;
-  //    int eventNumber=1;
-  int counter=0;
-  while(SillyFile >> fileName) {
-    if(counter%100==0) 
-      cout << fileName << endl;
-    counter++;
-    
-    //    const char *subDir = gSystem->DirName(fileName);
-    //    const char *subSubDir = gSystem->DirName(subDir);
-    //    const char *eventDir = gSystem->DirName(subSubDir);
-    //    const char *runDir = gSystem->DirName(eventDir);
-    //    const char *justRun = gSystem->BaseName(runDir);
-    //	cout << justRun << endl;
-    //    sscanf(justRun,"run%d",&runNumber);
-    
-    gzFile infile = gzopen (fileName, "rb");    
-    //    std::cout << "gzeof: " << gzeof(infile) << "\n";
-    for(int i=0;i<1000;i++) {	
-      //      cout << i << endl;
-      numBytes=gzread(infile,&theSensorHkStruct,sizeof(AraSensorHk_t));
-      //      std::cout << numBytes << "\n";
-
-
-	if(stationIdInt!=0)
-	   theSensorHkStruct.gHdr.stationId=stationId;
-
-
-      if(numBytes==0) break;
-      if(numBytes!=sizeof(AraSensorHk_t)) {
-	if(numBytes)
-	  cerr << "Read problem: " <<numBytes << " of " << sizeof(AraSensorHk_t) << endl;
-	error=1;
-	break;
-      }
-      //      cout << "Hk: " << theSensorHkStruct.unixTime << endl;
-      processHk();
-    }
-    gzclose(infile);
-    //	if(error) break;
-  }
+  while(SillyFile >> fileName)
+    fileNames.push_back(fileName);
+
+  AraRootifierPipeline<AtriSensorHkData> pipeline(splitHkFile,buildHk,processHk);
+  pipeline.setFileStarter(startHkFile);
+  pipeline.run(fileNames);
+  pipeline.printStats();
+
   if(sensorHkTree)
     sensorHkTree->AutoSave();
   //    theFile->Close();
 }
 
 
-void processHk() {
+//Sensor hk files are back to back AraSensorHk_t, stops at the first incomplete one
+Bool_t splitHkFile(AraPipelineFile &file, std::vector<AraPipelineRecord> &records) {
+  size_t upto=0;
+  for(int i=0;i<1000;i++) {	
+    size_t numBytes=file.data.size()-upto;
+    if(numBytes==0) break;
+    if(numBytes<sizeof(AraSensorHk_t)) {
+      cerr << "Read problem: " <<numBytes << " of " << sizeof(AraSensorHk_t) << endl;
+      break;
+    }
+    if(stationIdInt!=0) {
+      AraSensorHk_t theSensorHkStruct;
+      memcpy(&theSensorHkStruct,&file.data[upto],sizeof(AraSensorHk_t));
+      theSensorHkStruct.gHdr.stationId=stationId;
+      memcpy(&file.data[upto],&theSensorHkStruct,sizeof(AraSensorHk_t));
+    }
+    AraPipelineRecord record;
+    record.offset=upto;
+    record.length=sizeof(AraSensorHk_t);
+    records.push_back(record);
+    upto+=record.length;
+  }
+  return kTRUE;
+}
+
+
+AtriSensorHkData *buildHk(const char *record, size_t length) {
+  return new AtriSensorHkData((AraSensorHk_t*)record);
+}
+
+
+void startHkFile(const AraPipelineFile &file) {
+  if(file.index%100==0) 
+    cout << file.name << endl;
+}
+
+
+void processHk(AtriSensorHkData *sensorHk) {
   //  cout << "processHk:\t" << theSensorHkStruct.eventNumber << endl;
   static int doneInit=0;
   
@@ -124,7 +134,7 @@ void processHk() {
   }  
   //  cout << "Here: "  << theSensorHk.eventNumber << endl;
   if(theSensorHk) delete theSensorHk;
-  theSensorHk = new AtriSensorHkData(&theSensorHkStruct);
+  theSensorHk = sensorHk;
   sensorHkTree->Fill();  
   lastRunNumber=runNumber;
   //  delete theSensorHk;
@@ -0,0 +1,90 @@
+/*
+   Streaming engine shared by the quick raw event filters
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include "quickFilterEngine.h"
+#include "AraRootifierPipeline.h"
+#include "RawAtriStationEvent.h"
+#include "UsefulAtriStationEvent.h"
+
+AraQuickFilterEngine::AraQuickFilterEngine(Predicate predicate, bool calibrate, int numThreads)
+  : fPredicate(predicate), fCalibrate(calibrate), fNumThreads(numThreads<1 ? 1 : numThreads), fCalType(AraCalType::kLatestCalib), fFirstEvent(0)
+{
+}
+
+void AraQuickFilterEngine::setPedFile(const char *pedFile)
+{
+  fPedFile = pedFile ? pedFile : "";
+}
+
+long AraQuickFilterEngine::run(const std::vector<std::string> &fileNames, int runNumber, const char *outName)
+{
+  ARAWriterStruct_t eventWriter;
+  int doneInit=0;
+  int newFileFlag=0;
+  long numKept=0;
+  fStationsSeen.clear();
+
+  //Split, setting the pedestals of each station before any of its events reach the build threads
+  AraRootifierPipeline<AraQuickFilterRecord>::Splitter splitter = [&](AraPipelineFile &file, std::vector<AraPipelineRecord> &records) {
+    AraRootifierPipelineBase::splitAtriEventFile(file, records);
+    if(fCalibrate && !fPedFile.empty() && !records.empty()) {
+      AraStationEventHeader_t theEventHeader;
+      memcpy(&theEventHeader, &file.data[records[0].offset], sizeof(AraStationEventHeader_t));
+      int stationId = theEventHeader.gHdr.stationId;
+      if(std::find(fStationsSeen.begin(), fStationsSeen.end(), stationId)==fStationsSeen.end()) {
+        printf("Got file %s stationId %d, setting pedestals %s\n", file.name.c_str(), stationId, fPedFile.c_str());
+        AraEventCalibrator::Instance()->setAtriPedFile((char*)fPedFile.c_str(), stationId);
+        fStationsSeen.push_back(stationId);
+      }
+    }
+    return kTRUE;
+  };
+
+  //Build, keeping a copy of the bytes of the events the predicate wants
+  AraRootifierPipeline<AraQuickFilterRecord>::Builder builder = [&](const char *record, size_t length) -> AraQuickFilterRecord* {
+    AraStationEventHeader_t *hdPtr = (AraStationEventHeader_t*)record;
+    char *dataBuffer = (char*)record+sizeof(AraStationEventHeader_t);
+    AraAtriEventView view;
+    if(view.setFromBuffer(hdPtr, dataBuffer, length-sizeof(AraStationEventHeader_t))<0) return NULL;
+    bool keep;
+    if(fCalibrate) {
+      RawAtriStationEvent rawEvent(hdPtr, dataBuffer);
+      UsefulAtriStationEvent usefulEvent(&rawEvent, fCalType);
+      keep = fPredicate(view, &usefulEvent);
+    }
+    else keep = fPredicate(view, NULL);
+    if(!keep) return NULL;
+    AraQuickFilterRecord *kept = new AraQuickFilterRecord;
+    kept->bytes.assign(record, record+length);
+    return kept;
+  };
+
+  //Write, in file list order
+  AraRootifierPipeline<AraQuickFilterRecord>::Filler filler = [&](AraQuickFilterRecord *kept) {
+    if(!doneInit) {
+      initWriter(&eventWriter, runNumber, 5, 100, 100, EVENT_FILE_HEAD, outName, NULL);
+      doneInit=1;
+    }
+    writeBuffer(&eventWriter, &(kept->bytes[0]), kept->bytes.size(), &newFileFlag);
+    numKept++;
+    delete kept;
+  };
+
+  AraRootifierPipeline<AraQuickFilterRecord> pipeline(splitter, builder, filler, fNumThreads);
+  size_t counter=0;
+  pipeline.setFileStarter([&counter](const AraPipelineFile &file) {
+      if(counter%100==0) std::cout << file.name << std::endl;
+      counter++;
+    });
+  pipeline.setFirstEvent(fFirstEvent);
+  pipeline.run(fileNames);
+  if(doneInit) closeWriter(&eventWriter);
+  pipeline.printStats();
+  return numKept;
+}
@@ -0,0 +1,69 @@
+/*
+   Streaming engine shared by the quick raw event filters
+
+   Reads the raw ATRI event files of a run, decides which events to keep on
+   several threads and writes the kept events, in their original order, with
+   fileWriterUtil.
+*/
+
+#ifndef QUICK_FILTER_ENGINE_H
+#define QUICK_FILTER_ENGINE_H
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "araAtriStructures.h"
+#include "AraAtriEventView.h"
+#include "AraEventCalibrator.h"
+
+extern "C" {
+   #include "fileWriterUtil.h"
+}
+
+class UsefulAtriStationEvent;
+
+//! The raw bytes of an event kept by an AraQuickFilterEngine, header included
+struct AraQuickFilterRecord
+{
+  std::vector<char> bytes;
+};
+
+//! Runs a quick filter over the raw event files of a run
+/*!
+  The files go through an AraRootifierPipeline: they are read and split on their own threads, the predicate is called on
+  numThreads threads, and the kept events are written in file list order whatever the number of threads.
+
+  The calibrator is the one AraEventCalibrator::Instance(), its pedestals are set once for each station the first time
+  one of its files comes along, so the memory used does not grow with the number of files.
+*/
+class AraQuickFilterEngine
+{
+ public:
+  //! Decides whether to keep an event. Called on several threads at once, so it must be thread safe.
+  /*!
+    \param event the event, viewed in the read buffer
+    \param usefulEvent the calibrated event if the engine calibrates, else NULL
+  */
+  typedef std::function<bool(const AraAtriEventView &event, UsefulAtriStationEvent *usefulEvent)> Predicate;
+
+  AraQuickFilterEngine(Predicate predicate, bool calibrate, int numThreads=1);
+
+  void setPedFile(const char *pedFile); ///< Pedestal file used for every station, else the calibrator's default ones
+  void setCalType(AraCalType::AraCalType_t calType) { fCalType=calType; }
+  void setFirstEvent(long firstEvent) { fFirstEvent=firstEvent; } ///< Skips the events of the file list before this one, only inflating the rest
+
+  //! Filters the files into run_<runNumber> files under outName, returns the number of events kept
+  long run(const std::vector<std::string> &fileNames, int runNumber, const char *outName);
+
+ private:
+  Predicate fPredicate;
+  bool fCalibrate;
+  int fNumThreads;
+  AraCalType::AraCalType_t fCalType;
+  long fFirstEvent;
+  std::string fPedFile;
+  std::vector<int> fStationsSeen;
+};
+
+#endif // QUICK_FILTER_ENGINE_H
@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <libgen.h>     
+#include <cstdlib>
+#include <unistd.h>
+#include <string>
+#include <vector>
+ 
+
+
+#include "araAtriStructures.h"
+#include "quickFilterEngine.h"
+#include "skimExpression.h"
+
+using namespace std;
+
+char outName[FILENAME_MAX];
+
+Int_t runNumber;
+
+void usage(char *progName) {
+  std::cout << "Usage: " << basename(progName) << " [-j <threads>] [-f <first event>] <expression> <file list> <out dir> <run Number>" << std::endl;
+  std::cout << "  Keeps the events whose header passes the expression, for example" << std::endl;
+  std::cout << "    \"rf && !calpulser && blocks >= 20\"" << std::endl;
+  std::cout << "    \"eventNumber % 10 == 0\"" << std::endl;
+  std::cout << "    \"time >= 1356000000 && time < 1356003600\"" << std::endl;
+  std::cout << "  Fields: eventNumber unixTime (time) unixTimeUs ppsNumber timeStamp eventId stationId blocks numBytes" << std::endl;
+  std::cout << "          trig0-trig3 rf software calpulser, a field may be followed by % n or & n" << std::endl;
+  std::cout << "  Operators: == != < <= > >= && || ! ( )" << std::endl;
+}
+
+int main(int argc, char **argv) {
+  int opt;
+  int numThreads=1; //Filter threads, -j
+  long firstEvent=0; //Events of the file list skipped, -f
+  while((opt=getopt(argc,argv,"j:f:"))!=-1) {
+    switch(opt) {
+    case 'j':
+      numThreads=atoi(optarg);
+      break;
+    case 'f':
+      firstEvent=atol(optarg);
+      break;
+    default:
+      numThreads=0;
+      break;
+    }
+  }
+  //Shift the positional arguments down so they keep their old numbering
+  argv[optind-1]=argv[0];
+  argc-=optind-1;
+  argv+=optind-1;
+  if(argc<5 || numThreads<1) {
+    usage(argv[0]);
+    return -1;
+  }
+
+  AraSkimExpression expression;
+  if(!expression.compile(argv[1])) return -1;
+
+  runNumber=atoi(argv[4]);
+
+  sprintf(outName, "%s/run_%06d/event", argv[3], runNumber);
+  cout << argv[2] << "\t" << outName << "\t" << expression.getText() << endl;
+
+  std::vector<std::string> fileNames;
+  ifstream SillyFile(argv[2]);
+  std::string fileName;
+  while(SillyFile >> fileName)
+    fileNames.push_back(fileName);
+
+  //Only the header fields are looked at, the events are never built or calibrated
+  AraQuickFilterEngine engine([&expression](const AraAtriEventView &event, UsefulAtriStationEvent *evPtr) {
+      return expression.evaluate(event.header);
+    }, false, numThreads);
+  engine.setFirstEvent(firstEvent);
+  long numKept=engine.run(fileNames, runNumber, outName);
+  cout << "Kept " << numKept << " events" << endl;
+  return 0;
+}
@@ -0,0 +1,229 @@
+/*
+   Selection expressions for skimming raw event streams
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <cstdlib>
+
+#include "skimExpression.h"
+#include "RawAtriStationEvent.h"
+
+namespace {
+  enum { kOr, kAnd, kNot, kCompare };
+  enum { kEq, kNe, kLt, kLe, kGt, kGe, kNonZero };
+  enum { kNoModifier, kModulo, kMask };
+  enum { kEventNumber, kUnixTime, kUnixTimeUs, kPpsNumber, kTimeStamp, kEventId, kStationId, kBlocks, kNumBytes,
+         kTrig0, kTrig1, kTrig2, kTrig3, kCalpulser };
+
+  struct FieldName {
+    const char *name;
+    int field;
+  };
+
+  //A name only matches a whole word, so time doesn't match the start of timeStamp
+  const FieldName fieldNames[] = {
+    {"eventNumber", kEventNumber}, {"unixTimeUs", kUnixTimeUs}, {"unixTime", kUnixTime}, {"time", kUnixTime},
+    {"ppsNumber", kPpsNumber}, {"timeStamp", kTimeStamp}, {"eventId", kEventId}, {"stationId", kStationId},
+    {"blocks", kBlocks}, {"numBytes", kNumBytes}, {"trig0", kTrig0}, {"trig1", kTrig1}, {"trig2", kTrig2},
+    {"trig3", kTrig3}, {"rf", kTrig0}, {"software", kTrig2}, {"calpulser", kCalpulser}
+  };
+
+  //Two character operators first, so <= isn't read as <
+  const FieldName compareNames[] = {
+    {"==", kEq}, {"!=", kNe}, {"<=", kLe}, {">=", kGe}, {"<", kLt}, {">", kGt}
+  };
+}
+
+AraSkimExpression::AraSkimExpression()
+  : fPos(0), fFailed(true), fErrorPos(-1), fRoot(-1)
+{
+}
+
+bool AraSkimExpression::compile(const char *text)
+{
+  fText = text;
+  fPos = 0;
+  fFailed = false;
+  fErrorPos = -1;
+  fNodes.clear();
+  fRoot = parseOr();
+  skipSpace();
+  if(!fFailed && fPos<fText.size()) fail("unexpected text");
+  return !fFailed;
+}
+
+bool AraSkimExpression::evaluate(const AraAtriEventFields &header) const
+{
+  if(fFailed) return false;
+  return evaluateNode(fRoot, header);
+}
+
+bool AraSkimExpression::evaluate(const AraStationEventHeader_t *hdPtr) const
+{
+  AraAtriEventFields header;
+  header.getFrom(hdPtr);
+  return evaluate(header);
+}
+
+int AraSkimExpression::parseOr()
+{
+  int left = parseAnd();
+  while(!fFailed && accept("||")) left = addNode(kOr, left, parseAnd());
+  return left;
+}
+
+int AraSkimExpression::parseAnd()
+{
+  int left = parseNot();
+  while(!fFailed && accept("&&")) left = addNode(kAnd, left, parseNot());
+  return left;
+}
+
+int AraSkimExpression::parseNot()
+{
+  if(accept("!")) return addNode(kNot, parseNot(), -1);
+  if(accept("(")) {
+    int inner = parseOr();
+    if(!fFailed && !accept(")")) return fail("expected )");
+    return inner;
+  }
+  return parseTerm();
+}
+
+int AraSkimExpression::parseTerm()
+{
+  if(fFailed) return -1;
+  skipSpace();
+  Node node;
+  node.op = kCompare;
+  node.field = -1;
+  for(size_t i=0;i<sizeof(fieldNames)/sizeof(FieldName);i++) {
+    size_t length = strlen(fieldNames[i].name);
+    if(fText.compare(fPos, length, fieldNames[i].name)==0
+       && (fPos+length==fText.size() || !(isalnum(fText[fPos+length]) || fText[fPos+length]=='_'))) {
+      node.field = fieldNames[i].field;
+      fPos += length;
+      break;
+    }
+  }
+  if(node.field<0) return fail("expected a field name");
+
+  node.modifier = kNoModifier;
+  node.modifierValue = 0;
+  if(accept("%")) node.modifier = kModulo;
+  else if(fText.compare(fPos, 2, "&&")!=0 && accept("&")) node.modifier = kMask;
+  if(node.modifier!=kNoModifier) {
+    if(!parseNumber(node.modifierValue)) return fail("expected a number");
+    if(node.modifier==kModulo && node.modifierValue==0) return fail("modulo 0");
+  }
+
+  node.value = 0;
+  node.compare = kNonZero;
+  for(size_t i=0;i<sizeof(compareNames)/sizeof(FieldName);i++) {
+    if(accept(compareNames[i].name)) {
+      node.compare = compareNames[i].field;
+      if(!parseNumber(node.value)) return fail("expected a number");
+      break;
+    }
+  }
+  node.left = -1;
+  node.right = -1;
+  fNodes.push_back(node);
+  return fNodes.size()-1;
+}
+
+bool AraSkimExpression::parseNumber(ULong64_t &number)
+{
+  skipSpace();
+  const char *start = fText.c_str()+fPos;
+  char *end;
+  if(!isdigit(*start)) return false;
+  //Decimal unless it starts with 0x, so a leading zero doesn't make it octal
+  bool hex = start[0]=='0' && (start[1]=='x' || start[1]=='X') && isxdigit(start[2]);
+  number = hex ? strtoull(start+2, &end, 16) : strtoull(start, &end, 10);
+  fPos += end-start;
+  return true;
+}
+
+bool AraSkimExpression::accept(const char *token)
+{
+  skipSpace();
+  size_t length = strlen(token);
+  if(fText.compare(fPos, length, token)!=0) return false;
+  //A lone ! must not swallow the first character of !=
+  if(length==1 && token[0]=='!' && fText.compare(fPos+1, 1, "=")==0) return false;
+  fPos += length;
+  return true;
+}
+
+void AraSkimExpression::skipSpace()
+{
+  while(fPos<fText.size() && isspace(fText[fPos])) fPos++;
+}
+
+int AraSkimExpression::addNode(int op, int left, int right)
+{
+  if(fFailed) return -1;
+  Node node;
+  memset(&node, 0, sizeof(node));
+  node.op = op;
+  node.left = left;
+  node.right = right;
+  fNodes.push_back(node);
+  return fNodes.size()-1;
+}
+
+int AraSkimExpression::fail(const char *message)
+{
+  if(!fFailed) {
+    fprintf(stderr, "AraSkimExpression::compile -- ERROR %s at character %d of \"%s\"\n", message, (int)fPos, fText.c_str());
+    fFailed = true;
+    fErrorPos = fPos;
+  }
+  return -1;
+}
+
+ULong64_t AraSkimExpression::getField(int field, const AraAtriEventFields &header) const
+{
+  switch(field) {
+  case kEventNumber: return header.eventNumber;
+  case kUnixTime: return header.unixTime;
+  case kUnixTimeUs: return header.unixTimeUs;
+  case kPpsNumber: return header.ppsNumber;
+  case kTimeStamp: return header.timeStamp;
+  case kEventId: return header.eventId;
+  case kStationId: return header.stationId;
+  case kBlocks: return header.numReadoutBlocks;
+  case kNumBytes: return header.numBytes;
+  case kTrig0: return header.triggerInfo[0];
+  case kTrig1: return header.triggerInfo[1];
+  case kTrig2: return header.triggerInfo[2];
+  case kTrig3: return header.triggerInfo[3];
+  case kCalpulser: return RawAtriStationEvent::isCalpulserTimeStamp(header.stationId, header.timeStamp) ? 1 : 0;
+  }
+  return 0;
+}
+
+bool AraSkimExpression::evaluateNode(int node, const AraAtriEventFields &header) const
+{
+  const Node &n = fNodes[node];
+  switch(n.op) {
+  case kOr: return evaluateNode(n.left, header) || evaluateNode(n.right, header);
+  case kAnd: return evaluateNode(n.left, header) && evaluateNode(n.right, header);
+  case kNot: return !evaluateNode(n.left, header);
+  }
+  ULong64_t value = getField(n.field, header);
+  if(n.modifier==kModulo) value %= n.modifierValue;
+  else if(n.modifier==kMask) value &= n.modifierValue;
+  switch(n.compare) {
+  case kEq: return value==n.value;
+  case kNe: return value!=n.value;
+  case kLt: return value<n.value;
+  case kLe: return value<=n.value;
+  case kGt: return value>n.value;
+  case kGe: return value>=n.value;
+  }
+  return value!=0;
+}
@@ -0,0 +1,76 @@
+/*
+   Selection expressions for skimming raw event streams
+
+   A small expression language over the header fields of ATRI events, compiled
+   once and evaluated on each event header without building the event.
+*/
+
+#ifndef SKIM_EXPRESSION_H
+#define SKIM_EXPRESSION_H
+
+#include <string>
+#include <vector>
+
+#include "araAtriStructures.h"
+#include "AraAtriEventView.h"
+
+//! A compiled selection on the header fields of ATRI events
+/*!
+  An expression is made of comparisons joined by &&, || and !, with brackets. A comparison is
+  \verbatim field [% n | & n] [op number] \endverbatim
+  where op is one of == != < <= > >=, numbers are decimal or hex (0x...), and a field on its own is true if it isn't zero.
+  The fields are
+  - eventNumber, unixTime (or time), unixTimeUs, ppsNumber, timeStamp (Gray decoded), eventId, stationId
+  - blocks, the number of readout blocks, and numBytes
+  - trig0 to trig3, the triggerInfo words, with the aliases rf (trig0) and software (trig2)
+  - calpulser, 1 if RawAtriStationEvent::isCalpulserTimeStamp() is true for the event
+
+  For example "rf && !calpulser && blocks >= 20", "eventNumber % 10 == 0" or "time >= 1356000000 && time < 1356003600".
+*/
+class AraSkimExpression
+{
+ public:
+  AraSkimExpression();
+
+  //! Compiles text, printing where it fails to stderr. Returns false if it doesn't parse.
+  bool compile(const char *text);
+  const std::string &getText() const { return fText; }
+  int getErrorPosition() const { return fErrorPos; } ///< The character compile() failed at, -1 if it didn't
+
+  bool evaluate(const AraAtriEventFields &header) const; ///< Does an event pass, only call after a successful compile()
+  bool evaluate(const AraStationEventHeader_t *hdPtr) const; ///< The same, straight from a DAQ event header
+
+ private:
+  //! One node of the compiled tree, the nodes refer to each other by index
+  struct Node {
+    int op;
+    int field;
+    int modifier;
+    ULong64_t modifierValue;
+    int compare;
+    ULong64_t value;
+    int left;
+    int right;
+  };
+
+  int parseOr();
+  int parseAnd();
+  int parseNot();
+  int parseTerm();
+  bool parseNumber(ULong64_t &number);
+  bool accept(const char *token);
+  void skipSpace();
+  int addNode(int op, int left, int right);
+  int fail(const char *message);
+  ULong64_t getField(int field, const AraAtriEventFields &header) const;
+  bool evaluateNode(int node, const AraAtriEventFields &header) const;
+
+  std::string fText;
+  size_t fPos;
+  bool fFailed;
+  int fErrorPos;
+  std::vector<Node> fNodes;
+  int fRoot;
+};
+
+#endif // SKIM_EXPRESSION_H
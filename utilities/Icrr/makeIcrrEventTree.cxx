@@ -4,23 +4,31 @@
 #include <zlib.h>
 #include <libgen.h>     
 #include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
  
 using namespace std;
 
 #include "TTree.h"
 #include "TFile.h"
 #include "TSystem.h"
+#include "TMath.h"
 
 #define HACK_FOR_ROOT
 
 #include "araIcrrStructures.h"
 #include "araAtriStructures.h"
 #include "RawIcrrStationEvent.h"  
+#include "AraRootifierPipeline.h"
+#include "AraEventIndexFile.h"
 
-void processEvent(UInt_t stationId);
+Bool_t splitEventFile(AraPipelineFile &file, std::vector<AraPipelineRecord> &records);
+RawIcrrStationEvent *buildEvent(const char *record, size_t length, UInt_t stationId);
+void startEventFile(const AraPipelineFile &file);
+void processEvent(RawIcrrStationEvent *event);
 void makeEventTree(char *inputName, char *outDir, UInt_t stationId);
 
-IcrrEventBody_t theEventBody;
 TFile *theFile;
 TTree *eventTree;
 RawIcrrStationEvent *theEvent=0;
@@ -28,6 +36,10 @@ char outName[FILENAME_MAX];
 UInt_t realTime;
 Int_t runNumber;
 Int_t lastRunNumber;
+bool debug = false; // set to true to increase the amount of commentary output
+int evt_count = 0;
+int total_evt_count = 0;
+AraEventIndexFileWriter indexWriter; //The event index written next to the tree
 
 
 int main(int argc, char **argv) {
@@ -42,8 +54,6 @@ int main(int argc, char **argv) {
 
 void makeEventTree(char *inputName, char *outFile, UInt_t stationId) {
 
-  bool debug = false; // set to true to increase the amount of commentary output
-
   cout << "user specification - input file list = " << inputName << "\t" << "outFile = " << outFile << endl;
   strncpy(outName,outFile,FILENAME_MAX);
   if ( debug ) {
@@ -53,64 +63,77 @@ void makeEventTree(char *inputName, char *outFile, UInt_t stationId) {
   //    cout << sizeof(IcrrEventBody_t) << endl;
   ifstream SillyFile(inputName);
 
-  int numBytes=0;
+  std::vector<std::string> fileNames;
   char fileName[FILENAME_MAX];
-  int error=0;
-  //    int eventNumber=1;
-
-  int total_evt_count = 0;
-  int file_count=0;
-  while( SillyFile >> fileName ) {
-    cout << "processing file: " << fileName << endl;
-    file_count++;
-    static int lastEventNumber=-1;    
-    const char *subDir = gSystem->DirName(fileName);
-    //    const char *subSubDir = gSystem->DirName(subDir);
-    //    const char *eventDir = gSystem->DirName(subSubDir);
-    const char *runDir = gSystem->DirName(subDir);
-    const char *justRun = gSystem->BaseName(runDir);
-    sscanf(justRun,"run_%d",&runNumber);
-    //    cout << justRun << "\t" << runNumber <<endl;
-    
-    gzFile infile = gzopen(fileName, "rb");    
-    numBytes=gzread(infile,&theEventBody,sizeof(IcrrEventBody_t));
-    int evt_count = 1;
-    total_evt_count++;
-    while ( numBytes == sizeof(IcrrEventBody_t) ) {
-      if ( debug                      ||
-	   ( (evt_count % 100) == 1 ) ) {
-         cout << "Event count: " << "for_file = " << evt_count << " - all_toll = " << total_evt_count << endl;
-      }
-      if(numBytes!=sizeof(IcrrEventBody_t)) {
-	if(numBytes)
-	  cerr << "Read problem: " <<numBytes << " of " << sizeof(IcrrEventBody_t) << endl;
-	error=1;
-	break;
-      }
-      //      cout << "Event: " << theEventBody.hd.eventNumber << endl;
-      if(TMath::Abs(Double_t(theEventBody.hd.eventNumber)-lastEventNumber)>1000 && lastEventNumber>=0) {
-	std::cerr << "Dodgy event\t" << theEventBody.hd.eventNumber << "\n";
-      } 
-      else {     
-	processEvent(stationId);
-	lastEventNumber=theEventBody.hd.eventNumber;
-      }
-      numBytes=gzread(infile,&theEventBody,sizeof(IcrrEventBody_t));
-      evt_count++;
-      total_evt_count++;
-    } // end of while loop over events in the input file
-    gzclose(infile);
-    //	if(error) break;
-
-  } // end of while loop over the ev_ files in the file list
-  eventTree->AutoSave();
+  while( SillyFile >> fileName )
+    fileNames.push_back(fileName);
+
+  AraRootifierPipeline<RawIcrrStationEvent> pipeline(splitEventFile,
+						     [stationId](const char *record, size_t length) { return buildEvent(record,length,stationId); },
+						     processEvent);
+  pipeline.setFileStarter(startEventFile);
+  pipeline.run(fileNames);
+  pipeline.printStats();
+
+  if(eventTree) {
+    eventTree->AutoSave();
+    indexWriter.write(AraEventIndexFile::getIndexFileName(outName).c_str());
+  }
   //    theFile->Close();
 }
 
-void processEvent(UInt_t stationId) {
-  //  cout << "processEvent:\t" << theEventBody.eventNumber << endl;
+
+//Icrr event files are back to back IcrrEventBody_t, an incomplete one at the end is dropped
+Bool_t splitEventFile(AraPipelineFile &file, std::vector<AraPipelineRecord> &records) {
+  for(size_t upto=0; upto+sizeof(IcrrEventBody_t)<=file.data.size(); upto+=sizeof(IcrrEventBody_t)) {
+    AraPipelineRecord record;
+    record.offset=upto;
+    record.length=sizeof(IcrrEventBody_t);
+    records.push_back(record);
+  }
+  return kTRUE;
+}
+
+
+RawIcrrStationEvent *buildEvent(const char *record, size_t length, UInt_t stationId) {
+  return new RawIcrrStationEvent((IcrrEventBody_t*)record, stationId);
+}
+
+
+void startEventFile(const AraPipelineFile &file) {
+  cout << "processing file: " << file.name << endl;
+  const char *subDir = gSystem->DirName(file.name.c_str());
+  //    const char *subSubDir = gSystem->DirName(subDir);
+  //    const char *eventDir = gSystem->DirName(subSubDir);
+  const char *runDir = gSystem->DirName(subDir);
+  const char *justRun = gSystem->BaseName(runDir);
+  sscanf(justRun,"run_%d",&runNumber);
+  //    cout << justRun << "\t" << runNumber <<endl;
+  evt_count = 1;
+  total_evt_count++;
+}
+
+
+void processEvent(RawIcrrStationEvent *event) {
+  //  cout << "processEvent:\t" << event->head.eventNumber << endl;
   static int doneInit=0;
+  static int lastEventNumber=-1;    
   
+  if ( debug                      ||
+       ( (evt_count % 100) == 1 ) ) {
+    cout << "Event count: " << "for_file = " << evt_count << " - all_toll = " << total_evt_count << endl;
+  }
+  evt_count++;
+  total_evt_count++;
+
+  //      cout << "Event: " << event->head.eventNumber << endl;
+  if(TMath::Abs(Double_t(event->head.eventNumber)-lastEventNumber)>1000 && lastEventNumber>=0) {
+    std::cerr << "Dodgy event\t" << event->head.eventNumber << "\n";
+    delete event;
+    return;
+  } 
+  lastEventNumber=event->head.eventNumber;
+
   if(!doneInit) {
     //    char dirName[FILENAME_MAX];
     //    char fileName[FILENAME_MAX];
@@ -127,13 +150,14 @@ void processEvent(UInt_t stationId) {
   }  
   //  cout << "Here: "  << theEvent.eventNumber << endl;
   if(theEvent) delete theEvent;
-  theEvent = new RawIcrrStationEvent(&theEventBody, stationId);
+  theEvent = event;
   
   if(theEvent->getFirstHitBus(18)!=theEvent->getFirstHitBus(19)) {
      std::cerr << "Bad event?\n"; 
   }
   else {
      eventTree->Fill();  
+     indexWriter.addEvent(theEvent,eventTree->GetEntries()-1);
   }
   lastRunNumber=runNumber;
   //  delete theEvent;
@@ -0,0 +1,44 @@
+
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "AraAtriPedestalFile.h"
+#include "araSoft.h"
+
+/** program to convert ATRI text pedestals (as written by repeder or the DAQ) into the binary format that AraEventCalibrator maps directly */
+
+
+void usage()
+{
+  std::cout << "Usage: pedtobin station_id input_pedestal_file.dat output_pedestal_file.bin" << std::endl;
+  std::cout << "The input may be gzipped. The station id is stored in the output and checked when the pedestals are loaded." << std::endl;
+}
+
+int main (int nargs, char ** args)
+{
+  if (nargs != 4)
+  {
+    usage();
+    return 1;
+  }
+
+  int station = atoi(args[1]);
+  const char * input_file = args[2];
+  const char * output_file = args[3];
+
+  std::vector<UShort_t> peds;
+  int npeds = AraAtriPedestalFile::readText(input_file, peds);
+  if (npeds != ARA_ATRI_PED_FILE_NUM_PEDS)
+  {
+    std::cerr << "Read " << npeds << " pedestals from " << input_file << ", expected " << ARA_ATRI_PED_FILE_NUM_PEDS << std::endl;
+    return 1;
+  }
+
+  if (!AraAtriPedestalFile::writeBinary(output_file, station, &peds[0], peds.size()))
+  {
+    return 1;
+  }
+
+  std::cout << "Wrote " << npeds << " pedestals for station " << station << " to " << output_file << std::endl;
+  return 0;
+}
@@ -301,10 +301,10 @@ int main (int nargs, char ** args)
         if (ev->blockVec[iblk].channelMask && (1 << ich) == 0) continue;
         int chan= chan_per_dda * ev->blockVec[iblk].getDda() + ich;
         int offset = ev->blockVec[iblk].getBlock() * samp_per_block;
-        unsigned size = ev->blockVec[iblk].data[chan_idx].size();
+        unsigned size = samp_per_block;
         for (unsigned isamp = 0; isamp < size; isamp++)
         {
-          UShort_t val = ev->blockVec[iblk].data[chan_idx][isamp];
+          UShort_t val = ev->blockVec[iblk].samples[chan_idx][isamp];
           unsigned i = (offset+isamp) % nsamp;
           sum2[chan][i] += val*val;
           sum[chan][i] += val;
@@ -322,7 +322,7 @@ int main (int nargs, char ** args)
           }
         }
 
-        entries[chan]+=ev->blockVec[iblk].data[chan_idx].size();
+        entries[chan]+=size;
         chan_idx++;
       }
     }